@@ -0,0 +1,51 @@
+/*-------------------------------------------------------------------------------\
+asset_baker
+
+    asset_baker [resources dir] [-j threads] [-f]
+
+    Bakes every model, texture, collider and scene under the resources
+    directory (../resources by default, run from asset_baker/ like the viewer
+    runs from assimp_viewer/). See asset_baker.h.
+
+    -j  worker threads, 0 (default) is one per core minus one
+    -f  bake everything even if the manifest says it is up to date
+
+    Exit code is 1 if any asset failed.
+
+\-------------------------------------------------------------------------------*/
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <asset_baker.h>
+
+void PrintUsage()
+{
+    printf("usage: asset_baker [resources dir] [-j threads] [-f]\n");
+}
+
+int main(int argc, char** argv)
+{
+    std::string root = "../resources";
+    unsigned int numThreads = 0;
+    bool force = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            numThreads = (unsigned int)atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            force = true;
+        } else if (argv[i][0] == '-') {
+            PrintUsage();
+            return 2;
+        } else {
+            root = argv[i];
+        }
+    }
+
+    return RunAssetBaker(root, numThreads, force) ? 0 : 1;
+}
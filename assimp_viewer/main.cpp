@@ -23,6 +23,7 @@
 #include <dev_gui.h>
 #include <grid.h>
 #include <model.h>
+#include <model_instance.h>
 #include <my_math.h>
 #include <shader_m.h>
 #include <skybox.h>
@@ -31,6 +32,7 @@
 
 #include <log_file_functions.h>
 #include <scene_graph.h>
+#include <hot_reload.h>
 
 
 // settings
@@ -49,6 +51,7 @@ std::string filepath(std::string path);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void ProcessInput(GLFWwindow* window, Camera* camera, glm::vec3& velocity, float dt);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 
 float acceleration = 0.15f;
@@ -152,6 +155,13 @@ int main()
     unsigned int modelShader = createShader(filepath("/shaders/6.multiple_lights.vs"), filepath("/shaders/6.multiple_lights.fs"));
     unsigned int animShader = createShader(filepath("/shaders/anim_model.vs"), filepath("/shaders/anim_model.fs"));
     unsigned int hitboxShader = createShader(filepath("/shaders/hitbox.vs"), filepath("/shaders/hitbox.fs"));
+    unsigned int modelInstancedShader = createShader(filepath("/shaders/6.multiple_lights_instanced.vs"), filepath("/shaders/6.multiple_lights.fs"));
+    unsigned int hitboxInstancedShader = createShader(filepath("/shaders/hitbox_instanced.vs"), filepath("/shaders/hitbox.fs"));
+    // needs a 4.3 context, 0 otherwise
+    unsigned int modelIndirectShader = 0;
+    if (indirectDrawSupported) {
+        modelIndirectShader = createShader(filepath("/shaders/6.multiple_lights_indirect.vs"), filepath("/shaders/6.multiple_lights.fs"));
+    }
     unsigned int animatedShader = createShader(filepath("/shaders/animated_texture.vs"), filepath("/shaders/animated_texture.fs"));
     // unsigned int lightShader  = createShader(filepath("/shaders/6.multiple_lights.vs"), filepath("/shaders/6.multiple_lights.fs"));
     unsigned int alphaShader = createShader(filepath("/shaders/alpha/alpha.vs"), filepath("/shaders/alpha/alpha.fs"));
@@ -163,30 +173,70 @@ int main()
     shaderIdArray[1] = hitboxShader;
     shaderIdArray[2] = basicShader;
 
-    Model* billboard = LoadModel(filepath("/resources/models/billboards/hp1.obj"));
-    Model* moon = LoadModel(filepath("/resources/models/billboards/moon.obj"));
-    Model* sun = LoadModel(filepath("/resources/models/billboards/sun.obj"));
+    // scene nodes sharing a mesh and one of these shaders draw as one instanced draw
+    SetInstancedProgram(modelShader, modelInstancedShader);
+    SetInstancedProgram(hitboxShader, hitboxInstancedShader);
+    if (modelIndirectShader != 0) {
+        SetIndirectProgram(modelShader, modelIndirectShader);
+    }
+
+    InitWorkerPool(0);
+    InitTextureResidency((size_t)RESIDENCY_DEFAULT_BUDGET_MB * 1024 * 1024);
+
+    ModelAsset* billboard_asset = LoadModelAsync(filepath("/resources/models/billboards/hp1.obj"));
+    ModelAsset* moon_asset = LoadModelAsync(filepath("/resources/models/billboards/moon.obj"));
+    ModelAsset* sun_asset = LoadModelAsync(filepath("/resources/models/billboards/sun.obj"));
 
-    Model* player = LoadModel(filepath("/resources/objects/vampire/dancing_vampire.dae"));
+    ModelAsset* player_asset = LoadModelAsync(filepath("/resources/objects/vampire/dancing_vampire.dae"));
 
-    Model* sphere = LoadModel(filepath("/resources/models/sphere/sphere.obj"));
+    ModelAsset* sphere_asset = LoadModelAsync(filepath("/resources/models/sphere/sphere.obj"));
 
-    Model* soid_man = LoadModel(filepath("/resources/models/man/soid_man.obj"));
+    ModelAsset* soid_man_asset = LoadModelAsync(filepath("/resources/models/man/soid_man.obj"));
 
-    Model* arrow = LoadModel(filepath("/resources/models/direction_arrows/z.obj"));
+    ModelAsset* arrow_asset = LoadModelAsync(filepath("/resources/models/direction_arrows/z.obj"));
 
-    Model* vampire = LoadModel(filepath("/resources/objects/vampire/dancing_vampire.dae"));
+    ModelAsset* vampire_asset = LoadModelAsync(filepath("/resources/objects/vampire/dancing_vampire.dae"));
 
-    Model* man = LoadModel(filepath("/resources/models/zelda/hitbox/man1.gltf"));
+    ModelAsset* man_asset = LoadModelAsync(filepath("/resources/models/zelda/hitbox/man1.gltf"));
 
-    //Model* man_run = LoadModel(filepath("/resources/models/zelda/hitbox/man1.2_run.gltf"));
-    Model* man_run = LoadModel(filepath("/resources/models/zelda/hitbox/man_2.0.gltf"));
+    //ModelAsset* man_run_asset = LoadModelAsync(filepath("/resources/models/zelda/hitbox/man1.2_run.gltf"));
+    ModelAsset* man_run_asset = LoadModelAsync(filepath("/resources/models/zelda/hitbox/man_2.0.gltf"));
 
-    Model* stride_circle = LoadModel(filepath("/resources/models/zelda/hitbox/stride circle.obj"));
+    ModelAsset* stride_circle_asset = LoadModelAsync(filepath("/resources/models/zelda/hitbox/stride circle.obj"));
 
-    Model* wave_ball = LoadModel(filepath("/resources/models/test/wave_ball.obj"));
+    ModelAsset* wave_ball_asset = LoadModelAsync(filepath("/resources/models/test/wave_ball.obj"));
 
-    Model* test_arrow = LoadModel(filepath("/resources/models/test/arrow.obj"));
+    ModelAsset* test_arrow_asset = LoadModelAsync(filepath("/resources/models/test/arrow.obj"));
+
+    if (LoadScene(filepath("/resources/scenes/scene3.json"))) {
+        printf("LoadScene Failed!\n");
+    }
+
+    // models, textures, shaders and the scene reload when their files change
+    InitHotReload();
+
+    // Scene nodes draw a placeholder until their model is ready, these are used directly every frame
+    Model* billboard = WaitForModel(billboard_asset);
+    Model* moon = WaitForModel(moon_asset);
+    Model* sun = WaitForModel(sun_asset);
+    WaitForModel(player_asset);
+    Model* sphere = WaitForModel(sphere_asset);
+    Model* soid_man = WaitForModel(soid_man_asset);
+    Model* arrow = WaitForModel(arrow_asset);
+    Model* vampire = WaitForModel(vampire_asset);
+    Model* man = WaitForModel(man_asset);
+    Model* man_run = WaitForModel(man_run_asset);
+    Model* stride_circle = WaitForModel(stride_circle_asset);
+    Model* wave_ball = WaitForModel(wave_ball_asset);
+    Model* test_arrow = WaitForModel(test_arrow_asset);
+
+    // player and vampire are the same file, so they share one Model. Bone matrices are per instance.
+    ModelInstance* player_instance = CreateModelInstance(player_asset);
+    ModelInstance* man_run_instance = CreateModelInstance(man_run_asset);
+
+    // the vampire stands next to the spawn point, man_run follows the player every frame
+    player_instance->transform = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 1.1f, 0.0f));
+    player_instance->transform = glm::scale(player_instance->transform, glm::vec3(0.3f, 0.3f, 0.3f));
 
     load_textured_grid(filepath("/resources/textures/grid.png"));
 
@@ -213,10 +263,6 @@ int main()
     // Model* cube = LoadModel(filepath("/resources/models/cube/cube_outline.obj"));
     // unsigned int cube = CreateHitbox();
 
-    if (LoadScene(filepath("/resources/scenes/scene3.json"))) {
-        printf("LoadScene Failed!\n");
-    }
-
     LoadSkybox(filepath, "skybox7");
     LoadTerrain(filepath, filepath("/resources/textures/heightmaps/map1.png"));
 
@@ -256,6 +302,12 @@ int main()
 
     while (!glfwWindowShouldClose(window)) {
 
+        // OpenGL side of loads finished by the worker threads
+        PollAssetManager();
+        PollTextureLoader();
+        UpdateTextureResidency();
+        PollHotReload(glfwGetTime());
+
         playerPosition = playerState.position;
 
         // per-frame time logic
@@ -303,6 +355,9 @@ int main()
 
         // render
         // ------
+        // the camera, lights and per draw constants of this frame go into the ring from here
+        BeginUniformFrame();
+
         glClearColor(0.3f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -310,39 +365,33 @@ int main()
         glm::mat4 projection = glm::perspective(glm::radians(playerCamera->FOV), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, RENDER_DISTANCE);
         glm::mat4 view = GetViewMatrix(*playerCamera);
 
+        SetRenderView(playerCamera->Position, view, projection, glm::radians(playerCamera->FOV), SCR_HEIGHT);
+        SetFrameUniforms(projection, view, playerCamera->Position);
 
-        
 
-        glUseProgram(basicShader);
-        setShaderMat4(basicShader, "projection", projection);
-        setShaderMat4(basicShader, "view", view);
+        
 
         glUseProgram(autoShader);
-        setShaderMat4(autoShader, "proj", projection);
+        setShaderMat4(autoShader, UNIFORM("proj"), projection);
         glm::mat4 gm = glm::mat4(1.0f);
         gm = glm::translate(gm, glm::vec3(0, 2, 0));
         gm = glm::scale(gm, glm::vec3(5, 1, 5));
         gm = gm * view;
-        setShaderMat4(autoShader, "mv", gm);
-        setShaderFloat(autoShader, "near", 0.1f);
-        setShaderFloat(autoShader, "far", RENDER_DISTANCE);
-        setShaderVec3(autoShader, "eyeWorldPosition", playerCamera->Position);
-        setShaderFloat(autoShader, "scale1", 0.01f);
-        setShaderFloat(autoShader, "scale2", 0.05f);
+        setShaderMat4(autoShader, UNIFORM("mv"), gm);
+        setShaderFloat(autoShader, UNIFORM("near"), 0.1f);
+        setShaderFloat(autoShader, UNIFORM("far"), RENDER_DISTANCE);
+        setShaderVec3(autoShader, UNIFORM("eyeWorldPosition"), playerCamera->Position);
+        setShaderFloat(autoShader, UNIFORM("scale1"), 0.01f);
+        setShaderFloat(autoShader, UNIFORM("scale2"), 0.05f);
         draw_textured_grid(autoShader);
 
         glUseProgram(gridShader);
-        setShaderMat4(gridShader, "projection", projection);
-        setShaderMat4(gridShader, "view", view);
         glm::mat4 grid_model = glm::mat4(1.0f);
         grid_model = glm::translate(grid_model, glm::vec3(0, 1, 0));
-        setShaderMat4(gridShader, "model", grid_model);
+        BindDrawUniforms(grid_model, glm::vec4(1.0f));
         draw_textured_grid(gridShader);
 
         glUseProgram(animShader);
-        // (shader, uniformName, value)
-        setShaderMat4(animShader, "projection", projection);
-        setShaderMat4(animShader, "view", view);
 
         glm::vec2 horizontal_velocity_vector = glm::vec2(playerState.velocity.x, playerState.velocity.z);
         float horizontal_velocity = glm::length(horizontal_velocity_vector);
@@ -382,33 +431,33 @@ int main()
 
         //printf("horizontal_velocity: %0.5f\n", horizontal_velocity);
         if (horizontal_velocity < 0.0001f) {
-          // AnimateModel(dt, man_run->m_Animations[0], man_run->rootSkeletonNode, man_run->m_FinalBoneMatrices);
+            // standing still plays man_run_instance->animation on the instance's own clock
+            AnimateModelInstance(man_run_instance, frameTime);
         } else {
-          // AnimateModelBlend(angular_velocity * frameTime * 0.1, man_run->m_Animations[5], man_run->m_Animations[3], animationBlend, man_run->rootSkeletonNode, man_run->m_FinalBoneMatrices);
+          // AnimateModelBlend(angular_velocity * frameTime * 0.1, man_run->m_Animations[5], man_run->m_Animations[3], animationBlend, man_run->rootSkeletonNode, man_run_instance->boneMatrices);
+            InstanceModel(man_run_instance);
+            ProceduralAnimateModel(keyFrame, man_run->m_Animations[5], man_run->rootSkeletonNode, man_run_instance->boneMatrices);
         }
 
 
         //printf("rotationForWheel: %0.5f\n", rotationForWheel);
 
-
-        ProceduralAnimateModel(keyFrame, man_run->m_Animations[5], man_run->rootSkeletonNode, man_run->m_FinalBoneMatrices);
-        
         
-        //AnimateModelBlend(animationSpeed, man_run->m_Animations[3], man_run->m_Animations[5], animationBlend, man_run->rootSkeletonNode, man_run->m_FinalBoneMatrices);
+        //AnimateModelBlend(animationSpeed, man_run->m_Animations[3], man_run->m_Animations[5], animationBlend, man_run->rootSkeletonNode, man_run_instance->boneMatrices);
 
-        //AnimateModelBlend(angular_velocity * frameTime, man_run->m_Animations[1], man_run->m_Animations[0], horizontal_velocity_normal, man_run->rootSkeletonNode, man_run->m_FinalBoneMatrices);
-        //AnimateModel(dt, man_run->m_Animations[0], man_run->rootSkeletonNode, man_run->m_FinalBoneMatrices);
+        //AnimateModelBlend(angular_velocity * frameTime, man_run->m_Animations[1], man_run->m_Animations[0], horizontal_velocity_normal, man_run->rootSkeletonNode, man_run_instance->boneMatrices);
+        //AnimateModel(dt, man_run->m_Animations[0], man_run->rootSkeletonNode, man_run_instance->boneMatrices);
  
         if (animationPlaying) {
-            //AnimateModel(dt, player->m_Animations[0], player->rootSkeletonNode, player->m_FinalBoneMatrices);
-            //AnimateModel(stride_angle, man_run->m_Animations[0], man_run->rootSkeletonNode, man_run->m_FinalBoneMatrices);
+            AnimateModelInstance(player_instance, frameTime);
+            //AnimateModel(stride_angle, man_run->m_Animations[0], man_run->rootSkeletonNode, man_run_instance->boneMatrices);
         }
 
-        for (int i = 0; i < 100; ++i)
-            setShaderMat4(animShader, "finalBonesMatrices[" + std::to_string(i) + "]", player->m_FinalBoneMatrices[i]);
-
-        for (int i = 0; i < 100; ++i)
-            setShaderMat4(animShader, "finalBonesMatrices[" + std::to_string(i) + "]", man_run->m_FinalBoneMatrices[i]);
+        // every skinned instance goes into one buffer upload
+        BeginBonePalette();
+        AddInstanceBones(player_instance);
+        AddInstanceBones(man_run_instance);
+        UploadBonePalette();
 
         glm::mat4 model = glm::mat4(1.0f);
 
@@ -424,18 +473,16 @@ int main()
         model = my_rotation(model, glm::vec3(0.0f, 270.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.3f, 0.3f, 0.3f));
 
-        setShaderMat4(animShader, "model", model);
+        man_run_instance->transform = model;
 
-        //DrawModel(vampire, animShader);
-        //DrawModel(man_run, animShader);
+        // boneOffset is per draw, each instance points the shader at its own palette range
+        BindDrawUniforms(player_instance->transform, glm::vec4(1.0f));
+        SetInstanceBones(player_instance, animShader);
+        DrawModel(InstanceModel(player_instance), animShader);
 
-        glUseProgram(modelShader);
-
-        setShaderVec3(modelShader, "viewPos", playerCamera->Position);
-        setShaderFloat(modelShader, "material.shininess", 32.0f);
-        // setInt(modelShader, "material.diffuse", 0);
-        // setInt(modelShader, "material.specular", 1);
-        // setInt(modelShader, "material.emission", 2);
+        BindDrawUniforms(man_run_instance->transform, glm::vec4(1.0f));
+        SetInstanceBones(man_run_instance, animShader);
+        DrawModel(InstanceModel(man_run_instance), animShader);
 
         float radius = 1.0f; // You can adjust the radius of the circle
         float angular_speed = dayNightSpeed; // You can adjust the speed of rotatiom
@@ -461,56 +508,58 @@ int main()
             color = lerp(orange, purple, glm::abs(sun_t));
         }
 
-        setShaderVec3(modelShader, "dirLight.direction", glm::vec3(-0.5f, -1.0f, 0.0f));
-        setShaderVec3(modelShader, "dirLight.ambient", color.x, color.y, color.z);
-        // setShaderVec3(modelShader, "dirLight.ambient", sliderColor.x, sliderColor.y, sliderColor.z);
-        setShaderVec3(modelShader, "dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        setShaderVec3(modelShader, "dirLight.specular", 0.5f, 0.5f, 0.5f);
+        // one block for the lit shader and its instanced and indirect variants
+        LightUniforms lights;
+        memset(&lights, 0, sizeof(LightUniforms));
+
+        lights.shininess = 32.0f;
+
+        lights.dirLight.direction = glm::vec3(-0.5f, -1.0f, 0.0f);
+        lights.dirLight.ambient = color;
+        // lights.dirLight.ambient = glm::vec3(sliderColor.x, sliderColor.y, sliderColor.z);
+        lights.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+        lights.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
 
         // point light 1
-        //setShaderVec3(modelShader, "pointLights[0].position", playerPosition);
-        setShaderVec3(modelShader, "pointLights[0].position", 0.0f, 100.0f, 0.0f);
-        setShaderVec3(modelShader, "pointLights[0].ambient", 1.0f, 1.0f, 1.0f);
-        setShaderVec3(modelShader, "pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-        setShaderVec3(modelShader, "pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-        setShaderFloat(modelShader, "pointLights[0].constant", 1.0f);
-        setShaderFloat(modelShader, "pointLights[0].linear", 0.09f);
-        setShaderFloat(modelShader, "pointLights[0].quadratic", 0.06f);
+        // lights.pointLights[0].position = playerPosition;
+        lights.pointLights[0].position = glm::vec3(0.0f, 100.0f, 0.0f);
+        lights.pointLights[0].ambient = glm::vec3(1.0f, 1.0f, 1.0f);
+        lights.pointLights[0].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+        lights.pointLights[0].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        lights.pointLights[0].constant = 1.0f;
+        lights.pointLights[0].linear = 0.09f;
+        lights.pointLights[0].quadratic = 0.06f;
 
         // point light 2
-        setShaderVec3(modelShader, "pointLights[1].position", pointLightPositions[1]);
-        setShaderVec3(modelShader, "pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-        setShaderVec3(modelShader, "pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-        setShaderVec3(modelShader, "pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-        setShaderFloat(modelShader, "pointLights[1].constant", 1.0f);
-        setShaderFloat(modelShader, "pointLights[1].linear", 0.09f);
-        setShaderFloat(modelShader, "pointLights[1].quadratic", 0.09f);
+        lights.pointLights[1].position = pointLightPositions[1];
+        lights.pointLights[1].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+        lights.pointLights[1].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+        lights.pointLights[1].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        lights.pointLights[1].constant = 1.0f;
+        lights.pointLights[1].linear = 0.09f;
+        lights.pointLights[1].quadratic = 0.09f;
 
         // point light 3
-        setShaderVec3(modelShader, "pointLights[2].position", pointLightPositions[2]);
-        setShaderVec3(modelShader, "pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-        setShaderVec3(modelShader, "pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-        setShaderVec3(modelShader, "pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-        setShaderFloat(modelShader, "pointLights[2].constant", 1.0f);
-        setShaderFloat(modelShader, "pointLights[2].linear", 0.09f);
-        setShaderFloat(modelShader, "pointLights[2].quadratic", 0.032f);
+        lights.pointLights[2].position = pointLightPositions[2];
+        lights.pointLights[2].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+        lights.pointLights[2].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+        lights.pointLights[2].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        lights.pointLights[2].constant = 1.0f;
+        lights.pointLights[2].linear = 0.09f;
+        lights.pointLights[2].quadratic = 0.032f;
 
         // point light 4
-        setShaderVec3(modelShader, "pointLights[3].position", pointLightPositions[3]);
-        setShaderVec3(modelShader, "pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-        setShaderVec3(modelShader, "pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-        setShaderVec3(modelShader, "pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-        setShaderFloat(modelShader, "pointLights[3].constant", 1.0f);
-        setShaderFloat(modelShader, "pointLights[3].linear", 0.09f);
-        setShaderFloat(modelShader, "pointLights[3].quadratic", 0.032f);
+        lights.pointLights[3].position = pointLightPositions[3];
+        lights.pointLights[3].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+        lights.pointLights[3].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+        lights.pointLights[3].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+        lights.pointLights[3].constant = 1.0f;
+        lights.pointLights[3].linear = 0.09f;
+        lights.pointLights[3].quadratic = 0.032f;
 
-        setShaderMat4(modelShader, "projection", projection);
-        setShaderMat4(modelShader, "view", view);
+        SetLightUniforms(lights);
 
         glLineWidth(1.0f);
-        glUseProgram(hitboxShader);
-        setShaderMat4(hitboxShader, "projection", projection);
-        setShaderMat4(hitboxShader, "view", view);
         DrawTerrain(view, projection, sunDirection, color, playerCamera->Position);
 
         if (polygonMode) {
@@ -537,13 +586,11 @@ int main()
         }
 
         model = glm::scale(model, glm::vec3(3.0f, 3.0f, 3.0f));
-        setShaderMat4(modelShader, "model", model);
+        BindDrawUniforms(model, glm::vec4(1.0f));
         //DrawModel(wave_ball, modelShader);
        
 
         glUseProgram(alphaShader);
-        setShaderMat4(alphaShader, "projection", projection);
-        setShaderMat4(alphaShader, "view", view);
         
         // Stride Wheel
         model = glm::mat4(1.0f);
@@ -562,7 +609,7 @@ int main()
         }
        
         model = glm::scale(model, glm::vec3(wheelRadius, wheelRadius, wheelRadius));
-        setShaderMat4(alphaShader, "model", model);
+        BindDrawUniforms(model, glm::vec4(1.0f));
         // DrawModel(stride_circle, alphaShader);
 
 
@@ -574,16 +621,15 @@ int main()
         glEnable(GL_CULL_FACE);
 
         glUseProgram(hitboxShader);
-        setShaderMat4(hitboxShader, "projection", projection);
-        setShaderMat4(hitboxShader, "view", view);
 
         // newDestinationPointBall
         model = glm::mat4(1.0f);
         model = glm::translate(model, newDestinationPointBall);
         model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-        setShaderMat4(hitboxShader, "model", model);
-        setShaderVec4(hitboxShader, "color", glm::vec4(0.0f, 1.0f, 1.0f, 1.0f));
-        DrawModel(sphere, hitboxShader);
+        if (ModelInFrustum(&sphere->m_Bounds, model)) {
+            BindDrawUniforms(model, glm::vec4(0.0f, 1.0f, 1.0f, 1.0f));
+            DrawModel(sphere, hitboxShader);
+        }
 
         // Collision Point Ball
         for (int i = 0; i < num_collision_points; ++i)
@@ -591,8 +637,10 @@ int main()
             model = glm::mat4(1.0f);
             model = glm::translate(model, collision_points[i]);
             model = glm::scale(model, glm::vec3(0.1f, 0.1f, 0.1f));
-            setShaderMat4(hitboxShader, "model", model);
-            setShaderVec4(hitboxShader, "color", glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
+            if (!ModelInFrustum(&sphere->m_Bounds, model)) {
+                continue;
+            }
+            BindDrawUniforms(model, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f));
             DrawModel(sphere, hitboxShader);
         }
 
@@ -603,28 +651,27 @@ int main()
         model = glm::mat4(1.0f);
         model = glm::translate(model, playerCenter);
         model = glm::scale(model, glm::vec3(2.0f, -playerState.velocity.y, 2.0f));
-        setShaderMat4(hitboxShader, "model", model);
-        setShaderVec4(hitboxShader, "color", glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
-        glDepthFunc(GL_ALWAYS);
-        DrawModel(test_arrow, hitboxShader);
-        glDepthFunc(GL_LESS);
+        if (ModelInFrustum(&test_arrow->m_Bounds, model)) {
+            BindDrawUniforms(model, glm::vec4(1.0f, 0.0f, 0.0f, 1.0f));
+            glDepthFunc(GL_ALWAYS);
+            DrawModel(test_arrow, hitboxShader);
+            glDepthFunc(GL_LESS);
+        }
 
         // Player Sphere hitbox
         model = glm::mat4(1.0f);
         model = glm::translate(model, playerCenter);
-        setShaderMat4(hitboxShader, "model", model);
-        setShaderVec4(hitboxShader, "color", glm::vec4(0.0f, 1.0f, 0.0f, 0.3f));
-        glLineWidth(2.0f);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        DrawModel(sphere, hitboxShader);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        if (ModelInFrustum(&sphere->m_Bounds, model)) {
+            BindDrawUniforms(model, glm::vec4(0.0f, 1.0f, 0.0f, 0.3f));
+            glLineWidth(2.0f);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            DrawModel(sphere, hitboxShader);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        }
 
         // BACKFACE CULLING |OFF|
         glDisable(GL_CULL_FACE);
 
-        setShaderVec4(hitboxShader, "color", glm::vec4(1.0f, 0.0f, 0.5f, 0.5f));
-        setShaderMat4(hitboxShader, "model", glm::mat4(1.0f));
-
         // Needs to be drawn last; covers up everything after it
         DrawSkybox(*playerCamera, view, projection, currentTime);
         // update, except for transparent stuff i guess
@@ -642,8 +689,7 @@ int main()
                     glm::mat4 cube_space = glm::mat4(1.0f);
                     cube_space = glm::translate(cube_space, glm::vec3(x, y, z) * scale);
                     cube_space = glm::scale(cube_space, glm::vec3(scale));
-                    setShaderMat4(hitboxShader, "model", cube_space);
-                    setShaderVec4(hitboxShader, "color", glm::vec4(1.0f, 0.0f, 0.0f, 0.5f));
+                    BindDrawUniforms(cube_space, glm::vec4(1.0f, 0.0f, 0.0f, 0.5f));
                     DrawHitbox(cube, hitboxShader);
                 }
            }
@@ -651,22 +697,29 @@ int main()
         */
 
         glUseProgram(billboardShader);
-        setShaderMat4(billboardShader, "projection", projection);
-        setShaderMat4(billboardShader, "view", view);
 
         glm::vec3 sunPosition = (sunDirection * 500.0f);
 
-        glm::mat4 b_model = glm::mat4(1.0f);
-        b_model = glm::translate(b_model, sunPosition);
-        setShaderMat4(billboardShader, "model", b_model);
+        // billboard.vs offsets the quad by pos.xy * (0.25, 0.4) after the divide
+        glm::vec2 billboardScale = glm::vec2(0.25f, 0.4f);
+
+        if (BillboardInFrustum(&sun->m_Bounds, sunPosition, billboardScale)) {
+            glm::mat4 b_model = glm::mat4(1.0f);
+            b_model = glm::translate(b_model, sunPosition);
+            BindDrawUniforms(b_model, glm::vec4(1.0f));
+
+            DrawModel(sun, billboardShader);
+        }
 
-        DrawModel(sun, billboardShader);
+        if (BillboardInFrustum(&moon->m_Bounds, -sunPosition, billboardScale)) {
+            glm::mat4 b_model = glm::mat4(1.0f);
+            b_model = glm::translate(b_model, -sunPosition);
+            BindDrawUniforms(b_model, glm::vec4(1.0f));
 
-        b_model = glm::mat4(1.0f);
-        b_model = glm::translate(b_model, -sunPosition);
-        setShaderMat4(billboardShader, "model", b_model);
+            DrawModel(moon, billboardShader);
+        }
 
-        DrawModel(moon, billboardShader);
+        EndUniformFrame();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
@@ -681,6 +734,9 @@ int main()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    ShutdownHotReload();
+    ShutdownWorkerPool();
+
     glfwTerminate();
     return 0;
 }
@@ -690,13 +746,18 @@ GLFWwindow* InitializeWindow()
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
+    // 4.3 for the multi-draw indirect path (indirect_draw.h), 4.1 where there's no 4.3 (macOS)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
     // glfw window creation
     // --------------------
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Model Viewer", NULL, NULL);
+    if (window == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Model Viewer", NULL, NULL);
+    }
     if (window == NULL) {
         std::cout << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
@@ -704,6 +765,7 @@ GLFWwindow* InitializeWindow()
     glfwMakeContextCurrent(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
@@ -713,6 +775,8 @@ GLFWwindow* InitializeWindow()
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
     }
+    InitIndirectDraw((GLADloadproc)glfwGetProcAddress);
+    InitUniformRing((GLADloadproc)glfwGetProcAddress);
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(true);
@@ -810,6 +874,37 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos)
     }
 }
 
+// glfw: a left click outside the gui selects the scene node under the cursor
+// ---------------------------------------------------------------------------
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS || ImGui::GetIO().WantCaptureMouse) {
+        return;
+    }
+
+    double xpos, ypos;
+    glfwGetCursorPos(window, &xpos, &ypos);
+
+    // cursor is in window coordinates, not framebuffer pixels
+    int width, height;
+    glfwGetWindowSize(window, &width, &height);
+
+    float x = 2.0f * (float)xpos / width - 1.0f;
+    float y = 1.0f - 2.0f * (float)ypos / height;
+
+    glm::mat4 inverse = glm::inverse(renderView.projection * renderView.view);
+    glm::vec4 nearPoint = inverse * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 farPoint = inverse * glm::vec4(x, y, 1.0f, 1.0f);
+
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin);
+
+    SceneNode* node = PickSceneNode(origin, direction, NULL);
+    if (node != NULL) {
+        selectedNode = node;
+    }
+}
+
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
 // ----------------------------------------------------------------------
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
@@ -69,6 +69,7 @@ void AABB_AABB_Collision(AABB_node a, AABB_node b, glm::mat4* a_matrix, glm::mat
 
 // AABB Creation
 void TopDownABBB_Tree(AABB_node** tree, Triangle triangles[], int numObjects);
+void FreeAABB_Tree(AABB_node* tree);
 
 
 
@@ -242,6 +243,22 @@ void TopDownABBB_Tree(AABB_node** tree, Triangle triangles[], int numObjects)
     }
 }
 
+// Frees the nodes. Leaves only point into the triangle array, its owner frees that
+void FreeAABB_Tree(AABB_node* tree)
+{
+    if (tree == NULL) {
+        return;
+    }
+
+    // leaves never set left and right
+    if (tree->type == NODE) {
+        FreeAABB_Tree(tree->left);
+        FreeAABB_Tree(tree->right);
+    }
+
+    free(tree);
+}
+
 
 
 
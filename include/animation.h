@@ -38,6 +38,10 @@ glm::mat4 FindBoneAndGetTransform(Animation animation, const char* boneNodeName,
 Animation* LoadAnimations(unsigned int mNumAnimations, aiAnimation** mAnimations);
 BoneAnimationChannel* LoadBoneAnimationChannels(unsigned int mNumChannels, aiNodeAnim** mChannels);
 
+void FreeAnimations(Animation* animations, unsigned int numAnimations);
+size_t AnimationsArenaBytes(const Animation* animations, unsigned int numAnimations);
+Animation* CopyAnimations(LinearArena* arena, const Animation* animations, unsigned int numAnimations);
+
 glm::mat4 FindBoneAndGetTransform(Animation animation, const char* boneNodeName, float animationTime)
 {
     for (int i = 0; i < animation.m_NumBoneAnimations; ++i) {
@@ -189,7 +193,7 @@ Animation* LoadAnimations(unsigned int mNumAnimations, aiAnimation** mAnimations
         const char* mName  = aiAnimation->mName.C_Str();
         size_t mNameLength = aiAnimation->mName.length;
 
-        m_Animations[i].m_Name = (char*)malloc(mNameLength * sizeof(char));
+        m_Animations[i].m_Name = (char*)malloc((mNameLength + 1) * sizeof(char));
         std::strcpy(m_Animations[i].m_Name, mName);
 
         m_Animations[i].m_Duration = aiAnimation->mDuration;
@@ -217,7 +221,7 @@ BoneAnimationChannel* LoadBoneAnimationChannels(unsigned int mNumChannels, aiNod
         const char* nodemName = aiNodeAnim->mNodeName.C_Str();
         size_t nameLength     = aiNodeAnim->mNodeName.length;
 
-        m_BoneAnimations[i].m_NodeName = (char*)malloc(nameLength * sizeof(char));
+        m_BoneAnimations[i].m_NodeName = (char*)malloc((nameLength + 1) * sizeof(char));
         std::strcpy(m_BoneAnimations[i].m_NodeName, nodemName);
 
         m_BoneAnimations[i].m_NumPositions = m_NumPositions;
@@ -270,4 +274,83 @@ BoneAnimationChannel* LoadBoneAnimationChannels(unsigned int mNumChannels, aiNod
     return m_BoneAnimations;
 }
 
+// Only for arrays from LoadAnimations or the mesh cache, not ones in an arena
+void FreeAnimations(Animation* animations, unsigned int numAnimations)
+{
+    if (animations == NULL) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < numAnimations; ++i) {
+        Animation* animation = &animations[i];
+
+        for (unsigned int j = 0; j < animation->m_NumBoneAnimations && animation->m_BoneAnimations != NULL; ++j) {
+            BoneAnimationChannel* channel = &animation->m_BoneAnimations[j];
+
+            free(channel->m_NodeName);
+            free(channel->m_Positions);
+            free(channel->m_Rotations);
+            free(channel->m_Scales);
+        }
+        free(animation->m_BoneAnimations);
+        free(animation->m_Name);
+    }
+    free(animations);
+}
+
+// What CopyAnimations takes from the arena
+size_t AnimationsArenaBytes(const Animation* animations, unsigned int numAnimations)
+{
+    if (animations == NULL) {
+        return 0;
+    }
+
+    size_t size = ArenaBytes(numAnimations * sizeof(Animation));
+
+    for (unsigned int i = 0; i < numAnimations; ++i) {
+        const Animation* animation = &animations[i];
+
+        size += ArenaStringBytes(animation->m_Name);
+        size += ArenaBytes(animation->m_NumBoneAnimations * sizeof(BoneAnimationChannel));
+
+        for (unsigned int j = 0; j < animation->m_NumBoneAnimations; ++j) {
+            const BoneAnimationChannel* channel = &animation->m_BoneAnimations[j];
+
+            size += ArenaStringBytes(channel->m_NodeName);
+            size += ArenaBytes(channel->m_NumPositions * sizeof(KeyPosition));
+            size += ArenaBytes(channel->m_NumRotations * sizeof(KeyRotation));
+            size += ArenaBytes(channel->m_NumScalings * sizeof(KeyScale));
+        }
+    }
+    return size;
+}
+
+Animation* CopyAnimations(LinearArena* arena, const Animation* animations, unsigned int numAnimations)
+{
+    if (animations == NULL) {
+        return NULL;
+    }
+
+    Animation* copy = (Animation*)ArenaCopy(arena, animations, numAnimations * sizeof(Animation));
+
+    for (unsigned int i = 0; i < numAnimations; ++i) {
+        const Animation* animation = &animations[i];
+
+        copy[i].m_Name = ArenaCopyString(arena, animation->m_Name);
+        copy[i].m_BoneAnimations = (BoneAnimationChannel*)ArenaCopy(arena, animation->m_BoneAnimations,
+            animation->m_NumBoneAnimations * sizeof(BoneAnimationChannel));
+
+        for (unsigned int j = 0; j < animation->m_NumBoneAnimations; ++j) {
+            const BoneAnimationChannel* channel = &animation->m_BoneAnimations[j];
+            BoneAnimationChannel* channelCopy = &copy[i].m_BoneAnimations[j];
+
+            channelCopy->m_NodeName = ArenaCopyString(arena, channel->m_NodeName);
+            channelCopy->m_Positions = (KeyPosition*)ArenaCopy(arena, channel->m_Positions, channel->m_NumPositions * sizeof(KeyPosition));
+            channelCopy->m_Rotations = (KeyRotation*)ArenaCopy(arena, channel->m_Rotations, channel->m_NumRotations * sizeof(KeyRotation));
+            channelCopy->m_Scales = (KeyScale*)ArenaCopy(arena, channel->m_Scales, channel->m_NumScalings * sizeof(KeyScale));
+        }
+    }
+    return copy;
+}
+
 #endif
\ No newline at end of file
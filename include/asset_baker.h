@@ -0,0 +1,804 @@
+/*-------------------------------------------------------------------------------\
+asset_baker.h
+
+Functions:
+    Offline baking for the asset_baker command line tool (asset_baker/main.cpp).
+    Walks resources/ and writes the runtime caches next to every source file,
+    so the viewer never has to import or decode anything on a warm start.
+
+    model       Assimp import, optimize, clusters, LODs -> <source>.meshcache
+    texture     stb_image decode and box filtered mips  -> <source>.texcache
+                BC1/BC4/BC5/BC7 compressed mips          -> <source>.ktx2
+    collider    .obj used by a "hitbox" scene node      -> <source>.hitbox
+    scene       json is parsed and every "filepath" checked, nothing is written,
+                the viewer reads the json itself
+
+    Each asset is one job on the worker pool, no OpenGL calls are made so no
+    context or window is needed.
+
+    bake_manifest.json in the root records for every source its content hash,
+    the files it depends on (.mtl, gltf buffers) with their hashes, the
+    textures a model references and the files that were written. An asset is
+    only baked again if one of those hashes or the cache version changed or an
+    output is missing. Paths in the manifest are relative to the root.
+
+    A report with time and input/output size of every asset is printed at the
+    end.
+
+\-------------------------------------------------------------------------------*/
+#ifndef ASSET_BAKER_H
+#define ASSET_BAKER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <cjson/cJSON.h>
+
+#include <collider_cache.h>
+#include <mapped_file.h>
+#include <mesh_cache.h>
+#include <model.h>
+#include <texture_cache.h>
+#include <texture_compress.h>
+#include <worker_pool.h>
+
+#define BAKE_MANIFEST_NAME "bake_manifest.json"
+#define BAKE_MANIFEST_VERSION 1
+#define SCENE_BAKE_VERSION 1
+
+enum BakeKind {
+    BAKE_MODEL,
+    BAKE_TEXTURE,
+    BAKE_COLLIDER,
+    BAKE_SCENE
+};
+
+const char* BakeKindNames[] = { "model", "texture", "collider", "scene" };
+
+enum BakeStatus {
+    BAKE_PENDING,
+    BAKE_UP_TO_DATE,
+    BAKE_BAKED,
+    BAKE_FAILED
+};
+
+struct BakeAsset {
+    BakeKind kind;
+    // absolute, '/' separators. Same string filepath() gives the viewer, the
+    // mesh cache stores it
+    std::string path;
+    // relative to the root, key in the manifest
+    std::string key;
+
+    // entry from the last run, read only while the jobs run
+    cJSON* previous;
+
+    unsigned long long hash;
+    // a change in one of these bakes the asset again
+    std::vector<std::string> dependencies;
+    std::vector<unsigned long long> dependencyHashes;
+    // textures a model uses, baked as their own assets
+    std::vector<std::string> textures;
+    std::vector<std::string> outputs;
+
+    BakeStatus status;
+    std::string message;
+
+    double ms;
+    unsigned long long inputBytes;
+    unsigned long long outputBytes;
+};
+
+struct AssetBaker {
+    std::string root;
+    // parent of the root, "filepath" values in the scenes are relative to it
+    std::string projectDir;
+    std::string manifestPath;
+    bool force;
+
+    std::vector<BakeAsset*> assets;
+    cJSON* manifest;
+
+    std::mutex mutex;
+    size_t numFinished;
+};
+
+AssetBaker assetBaker;
+
+bool RunAssetBaker(std::string const& root, unsigned int numThreads, bool force);
+
+void FindBakeAssets();
+BakeAsset* AddBakeAsset(BakeKind kind, std::string const& path);
+void CollectSceneFiles(cJSON* jsonNode, std::vector<std::string>& models, std::vector<std::string>& hitboxes);
+bool IsModelExtension(std::string const& extension);
+bool IsTextureExtension(std::string const& extension);
+
+void BakeAssetJob(void* arg);
+bool BakeIsUpToDate(BakeAsset* asset);
+void RestorePreviousBake(BakeAsset* asset);
+bool BakeModel(BakeAsset* asset);
+bool BakeTexture(BakeAsset* asset);
+bool BakeCollider(BakeAsset* asset);
+bool BakeScene(BakeAsset* asset);
+void FindModelDependencies(BakeAsset* asset);
+void AddBakeDependency(BakeAsset* asset, std::string const& path);
+unsigned int BakeVersion(BakeKind kind);
+
+std::string BakeKey(std::string const& path);
+std::string BakePath(std::string const& key);
+std::string HashToString(unsigned long long hash);
+unsigned long long FileBytes(std::string const& path);
+
+cJSON* ReadBakeManifest(std::string const& path);
+bool WriteBakeManifest(std::string const& path);
+void PrintBakeReport(double wallMs);
+
+bool RunAssetBaker(std::string const& root, unsigned int numThreads, bool force)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::filesystem::path rootPath = std::filesystem::absolute(root).lexically_normal();
+    if (!std::filesystem::is_directory(rootPath)) {
+        printf("AssetBaker: %s is not a directory\n", root.c_str());
+        return false;
+    }
+
+    assetBaker.root = rootPath.generic_string();
+    if (!assetBaker.root.empty() && assetBaker.root.back() == '/') {
+        assetBaker.root.pop_back();
+    }
+    assetBaker.projectDir = assetBaker.root.substr(0, assetBaker.root.find_last_of('/'));
+    assetBaker.manifestPath = assetBaker.root + "/" + BAKE_MANIFEST_NAME;
+    assetBaker.force = force;
+    assetBaker.numFinished = 0;
+
+    assetBaker.manifest = ReadBakeManifest(assetBaker.manifestPath);
+
+    FindBakeAssets();
+
+    cJSON* previousAssets = cJSON_GetObjectItem(assetBaker.manifest, "assets");
+    for (size_t i = 0; i < assetBaker.assets.size(); ++i) {
+        assetBaker.assets[i]->previous = cJSON_GetObjectItem(previousAssets, assetBaker.assets[i]->key.c_str());
+    }
+
+    InitWorkerPool(numThreads);
+    printf("AssetBaker: %d assets in %s, %d threads\n", (int)assetBaker.assets.size(), assetBaker.root.c_str(), (int)workerPool.threads.size());
+
+    // largest first so one big model doesn't start last
+    std::vector<BakeAsset*> queue = assetBaker.assets;
+    std::sort(queue.begin(), queue.end(), [](BakeAsset* a, BakeAsset* b) { return a->inputBytes > b->inputBytes; });
+
+    for (size_t i = 0; i < queue.size(); ++i) {
+        PushWorkerJob(BakeAssetJob, queue[i]);
+    }
+
+    while (true) {
+        unsigned long long jobsFinished = WorkerJobsFinished();
+        {
+            std::lock_guard<std::mutex> lock(assetBaker.mutex);
+            if (assetBaker.numFinished == assetBaker.assets.size()) {
+                break;
+            }
+        }
+        WaitForWorkerJobs(jobsFinished);
+    }
+
+    ShutdownWorkerPool();
+
+    bool written = WriteBakeManifest(assetBaker.manifestPath);
+    if (!written) {
+        printf("AssetBaker: could not write %s\n", assetBaker.manifestPath.c_str());
+    }
+
+    PrintBakeReport(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+    bool failed = !written;
+    for (size_t i = 0; i < assetBaker.assets.size(); ++i) {
+        failed = failed || assetBaker.assets[i]->status == BAKE_FAILED;
+        delete assetBaker.assets[i];
+    }
+    assetBaker.assets.clear();
+
+    cJSON_Delete(assetBaker.manifest);
+    assetBaker.manifest = NULL;
+
+    return !failed;
+}
+
+/* Finding assets */
+
+void FindBakeAssets()
+{
+    std::vector<std::filesystem::path> files;
+
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(assetBaker.root, std::filesystem::directory_options::skip_permission_denied, error);
+    for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (it->is_regular_file(error)) {
+            files.push_back(it->path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    // Scenes first, a .obj some "hitbox" node uses is a collider and not a model
+    std::set<std::string> sceneModels;
+    std::set<std::string> sceneHitboxes;
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string path = files[i].generic_string();
+        if (files[i].extension() != ".json" || files[i].filename() == BAKE_MANIFEST_NAME) {
+            continue;
+        }
+
+        MappedFile* file = MapFile(path.c_str());
+        if (file == NULL) {
+            continue;
+        }
+        cJSON* json = cJSON_ParseWithLength((const char*)file->data, file->size);
+        UnmapFile(file);
+
+        // scene files are an array of nodes
+        if (cJSON_IsArray(json)) {
+            std::vector<std::string> models;
+            std::vector<std::string> hitboxes;
+            CollectSceneFiles(json->child, models, hitboxes);
+
+            sceneModels.insert(models.begin(), models.end());
+            sceneHitboxes.insert(hitboxes.begin(), hitboxes.end());
+
+            AddBakeAsset(BAKE_SCENE, path);
+        }
+        cJSON_Delete(json);
+    }
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::string path = files[i].generic_string();
+
+        std::string extension = files[i].extension().generic_string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+        if (IsTextureExtension(extension)) {
+            AddBakeAsset(BAKE_TEXTURE, path);
+        } else if (IsModelExtension(extension)) {
+            bool hitbox = sceneHitboxes.count(path) > 0;
+
+            if (hitbox) {
+                AddBakeAsset(BAKE_COLLIDER, path);
+            }
+            if (!hitbox || sceneModels.count(path) > 0) {
+                AddBakeAsset(BAKE_MODEL, path);
+            }
+        }
+    }
+}
+
+BakeAsset* AddBakeAsset(BakeKind kind, std::string const& path)
+{
+    BakeAsset* asset = new BakeAsset();
+
+    asset->kind = kind;
+    asset->path = path;
+    asset->key = BakeKey(path);
+    asset->previous = NULL;
+    asset->hash = 0;
+    asset->status = BAKE_PENDING;
+    asset->ms = 0.0;
+    asset->inputBytes = FileBytes(path);
+    asset->outputBytes = 0;
+
+    assetBaker.assets.push_back(asset);
+    return asset;
+}
+
+// "filepath" of every node and its children, as absolute paths
+void CollectSceneFiles(cJSON* jsonNode, std::vector<std::string>& models, std::vector<std::string>& hitboxes)
+{
+    for (; jsonNode != NULL; jsonNode = jsonNode->next) {
+        cJSON* type = cJSON_GetObjectItem(jsonNode, "type");
+        cJSON* path = cJSON_GetObjectItem(jsonNode, "filepath");
+
+        if (cJSON_IsString(type) && cJSON_IsString(path)) {
+            std::string file = assetBaker.projectDir + path->valuestring;
+
+            if (strcmp(type->valuestring, "model") == 0) {
+                models.push_back(file);
+            } else if (strcmp(type->valuestring, "hitbox") == 0) {
+                hitboxes.push_back(file);
+            }
+        }
+
+        cJSON* children = cJSON_GetObjectItem(jsonNode, "children");
+        if (cJSON_IsArray(children)) {
+            CollectSceneFiles(children->child, models, hitboxes);
+        }
+    }
+}
+
+bool IsModelExtension(std::string const& extension)
+{
+    static const char* extensions[] = { ".obj", ".dae", ".fbx", ".gltf", ".glb", ".3ds", ".blend" };
+
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i) {
+        if (extension == extensions[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool IsTextureExtension(std::string const& extension)
+{
+    static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); ++i) {
+        if (extension == extensions[i]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Baking, worker threads */
+
+void BakeAssetJob(void* arg)
+{
+    BakeAsset* asset = (BakeAsset*)arg;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    bool hashed;
+    asset->hash = HashFileContents(asset->path.c_str(), &hashed);
+
+    if (!hashed) {
+        asset->status = BAKE_FAILED;
+        asset->message = "could not read source";
+    } else if (!assetBaker.force && BakeIsUpToDate(asset)) {
+        RestorePreviousBake(asset);
+        asset->status = BAKE_UP_TO_DATE;
+    } else {
+        bool baked = false;
+
+        if (asset->kind == BAKE_MODEL) {
+            baked = BakeModel(asset);
+        } else if (asset->kind == BAKE_TEXTURE) {
+            baked = BakeTexture(asset);
+        } else if (asset->kind == BAKE_COLLIDER) {
+            baked = BakeCollider(asset);
+        } else if (asset->kind == BAKE_SCENE) {
+            baked = BakeScene(asset);
+        }
+
+        asset->status = baked ? BAKE_BAKED : BAKE_FAILED;
+    }
+
+    for (size_t i = 0; i < asset->outputs.size(); ++i) {
+        asset->outputBytes += FileBytes(asset->outputs[i]);
+    }
+
+    asset->ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::lock_guard<std::mutex> lock(assetBaker.mutex);
+    assetBaker.numFinished++;
+}
+
+// Compares against the manifest entry from the last run
+bool BakeIsUpToDate(BakeAsset* asset)
+{
+    cJSON* previous = asset->previous;
+    if (previous == NULL) {
+        return false;
+    }
+
+    cJSON* kind = cJSON_GetObjectItem(previous, "kind");
+    cJSON* version = cJSON_GetObjectItem(previous, "version");
+    cJSON* hash = cJSON_GetObjectItem(previous, "hash");
+
+    if (!cJSON_IsString(kind) || strcmp(kind->valuestring, BakeKindNames[asset->kind]) != 0
+        || !cJSON_IsNumber(version) || version->valueint != (int)BakeVersion(asset->kind)
+        || !cJSON_IsString(hash) || HashToString(asset->hash) != hash->valuestring) {
+        return false;
+    }
+
+    cJSON* dependency;
+    cJSON_ArrayForEach(dependency, cJSON_GetObjectItem(previous, "dependencies"))
+    {
+        bool dependencyHashed;
+        unsigned long long dependencyHash = HashFileContents(BakePath(dependency->string).c_str(), &dependencyHashed);
+
+        if (!dependencyHashed || !cJSON_IsString(dependency) || HashToString(dependencyHash) != dependency->valuestring) {
+            return false;
+        }
+    }
+
+    cJSON* output;
+    cJSON_ArrayForEach(output, cJSON_GetObjectItem(previous, "outputs"))
+    {
+        if (!cJSON_IsString(output) || !std::filesystem::exists(BakePath(output->valuestring))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Keeps the lists of an asset that didn't need baking, for the new manifest
+void RestorePreviousBake(BakeAsset* asset)
+{
+    cJSON* item;
+
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(asset->previous, "dependencies"))
+    {
+        asset->dependencies.push_back(BakePath(item->string));
+        asset->dependencyHashes.push_back(strtoull(item->valuestring, NULL, 16));
+    }
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(asset->previous, "textures"))
+    {
+        asset->textures.push_back(BakePath(item->valuestring));
+    }
+    cJSON_ArrayForEach(item, cJSON_GetObjectItem(asset->previous, "outputs"))
+    {
+        asset->outputs.push_back(BakePath(item->valuestring));
+    }
+}
+
+bool BakeModel(BakeAsset* asset)
+{
+    ModelData* data = ImportModelData(asset->path);
+    if (data == NULL) {
+        asset->message = "assimp import failed";
+        return false;
+    }
+
+    FindModelDependencies(asset);
+
+    // same path LoadMeshTextures resolves
+    std::set<std::string> textures;
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* mesh = &data->m_Meshes[i];
+
+        for (unsigned int j = 0; j < mesh->numTextures; ++j) {
+            std::string texture = std::string(data->m_Directory) + "/" + mesh->textures[j].path;
+            std::replace(texture.begin(), texture.end(), '\\', '/');
+
+            if (textures.insert(texture).second) {
+                asset->textures.push_back(texture);
+
+                if (!std::filesystem::exists(texture)) {
+                    asset->message += "missing texture " + BakeKey(texture) + " ";
+                }
+            }
+        }
+    }
+
+    bool written = WriteModelCache(asset->path, data);
+
+    FreeModelData(data);
+
+    if (!written) {
+        asset->message = "could not write " + BakeKey(MeshCachePath(asset->path));
+        return false;
+    }
+
+    asset->outputs.push_back(MeshCachePath(asset->path));
+    return true;
+}
+
+// .mtl files of an .obj, buffers of a .gltf. Assimp reads them but doesn't say which.
+void FindModelDependencies(BakeAsset* asset)
+{
+    std::string directory = asset->path.substr(0, asset->path.find_last_of('/'));
+    std::string extension = std::filesystem::path(asset->path).extension().generic_string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    if (extension == ".obj") {
+        FILE* file = fopen(asset->path.c_str(), "r");
+        if (file == NULL) {
+            return;
+        }
+
+        char line[512];
+        while (fgets(line, sizeof(line), file)) {
+            if (strncmp(line, "mtllib", 6) != 0 || (line[6] != ' ' && line[6] != '\t')) {
+                continue;
+            }
+
+            std::string name = line + 7;
+            name.erase(0, name.find_first_not_of(" \t"));
+            name.erase(name.find_last_not_of(" \t\r\n") + 1);
+
+            if (!name.empty()) {
+                AddBakeDependency(asset, directory + "/" + name);
+            }
+        }
+
+        fclose(file);
+    } else if (extension == ".gltf") {
+        MappedFile* file = MapFile(asset->path.c_str());
+        if (file == NULL) {
+            return;
+        }
+        cJSON* json = cJSON_ParseWithLength((const char*)file->data, file->size);
+        UnmapFile(file);
+
+        cJSON* buffer;
+        cJSON_ArrayForEach(buffer, cJSON_GetObjectItem(json, "buffers"))
+        {
+            cJSON* uri = cJSON_GetObjectItem(buffer, "uri");
+            if (cJSON_IsString(uri) && strncmp(uri->valuestring, "data:", 5) != 0) {
+                AddBakeDependency(asset, directory + "/" + uri->valuestring);
+            }
+        }
+
+        cJSON_Delete(json);
+    }
+}
+
+void AddBakeDependency(BakeAsset* asset, std::string const& path)
+{
+    bool hashed;
+    unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+
+    if (!hashed) {
+        asset->message += "missing " + BakeKey(path) + " ";
+        return;
+    }
+
+    asset->dependencies.push_back(path);
+    asset->dependencyHashes.push_back(hash);
+}
+
+bool BakeTexture(BakeAsset* asset)
+{
+    MappedFile* file = MapFile(asset->path.c_str());
+    if (file == NULL) {
+        asset->message = "could not read source";
+        return false;
+    }
+
+    // rows stay top to bottom, the loader flips them
+    stbi_set_flip_vertically_on_load_thread(0);
+
+    int width, height, channels;
+    unsigned char* pixels = stbi_load_from_memory((const stbi_uc*)file->data, (int)file->size, &width, &height, &channels, 0);
+
+    UnmapFile(file);
+
+    if (pixels == NULL) {
+        asset->message = stbi_failure_reason();
+        return false;
+    }
+
+    // the texcache still serves cubemaps, channel ops and drivers without BC1/BC7
+    bool written = WriteTextureCache(asset->path, pixels, width, height, channels);
+
+    TextureCompression compression;
+    bool compressed = written && WriteCompressedTexture(asset->path, pixels, width, height, channels, &compression);
+
+    stbi_image_free(pixels);
+
+    if (!written) {
+        asset->message = "could not write " + BakeKey(TextureCachePath(asset->path));
+        return false;
+    }
+    if (!compressed) {
+        asset->message = "could not write " + BakeKey(Ktx2Path(asset->path));
+        return false;
+    }
+
+    asset->outputs.push_back(TextureCachePath(asset->path));
+    asset->outputs.push_back(Ktx2Path(asset->path));
+    asset->message = TextureCompressionNames[compression];
+    return true;
+}
+
+bool BakeCollider(BakeAsset* asset)
+{
+    std::vector<ColliderTriangle> triangles;
+    if (!ParseColliderObj(asset->path, triangles)) {
+        asset->message = "could not read source";
+        return false;
+    }
+
+    if (triangles.empty()) {
+        asset->message = "no \"f v/t/n\" or \"f v//n\" faces";
+        return false;
+    }
+
+    if (!WriteColliderCache(asset->path, triangles)) {
+        asset->message = "could not write " + BakeKey(ColliderCachePath(asset->path));
+        return false;
+    }
+
+    asset->outputs.push_back(ColliderCachePath(asset->path));
+    return true;
+}
+
+// Only checks that everything the scene loads exists
+bool BakeScene(BakeAsset* asset)
+{
+    MappedFile* file = MapFile(asset->path.c_str());
+    if (file == NULL) {
+        asset->message = "could not read source";
+        return false;
+    }
+    cJSON* json = cJSON_ParseWithLength((const char*)file->data, file->size);
+    UnmapFile(file);
+
+    if (!cJSON_IsArray(json)) {
+        cJSON_Delete(json);
+        asset->message = "not a json array";
+        return false;
+    }
+
+    std::vector<std::string> files;
+    CollectSceneFiles(json->child, files, files);
+    cJSON_Delete(json);
+
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (!std::filesystem::exists(files[i])) {
+            asset->message += "missing " + files[i].substr(assetBaker.projectDir.size()) + " ";
+        }
+    }
+
+    return asset->message.empty();
+}
+
+unsigned int BakeVersion(BakeKind kind)
+{
+    if (kind == BAKE_MODEL)
+        return MESH_CACHE_VERSION;
+    if (kind == BAKE_TEXTURE)
+        return TEXTURE_CACHE_VERSION * 100 + TEXTURE_COMPRESS_VERSION;
+    if (kind == BAKE_COLLIDER)
+        return COLLIDER_CACHE_VERSION;
+    return SCENE_BAKE_VERSION;
+}
+
+/* Manifest */
+
+// Relative to the root, files outside it keep the absolute path
+std::string BakeKey(std::string const& path)
+{
+    std::string prefix = assetBaker.root + "/";
+    if (path.compare(0, prefix.size(), prefix) == 0) {
+        return path.substr(prefix.size());
+    }
+    return path;
+}
+
+std::string BakePath(std::string const& key)
+{
+    if (std::filesystem::path(key).is_absolute()) {
+        return key;
+    }
+    return assetBaker.root + "/" + key;
+}
+
+// cJSON numbers are doubles, 64 bit hashes are stored as hex strings
+std::string HashToString(unsigned long long hash)
+{
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", hash);
+    return buffer;
+}
+
+unsigned long long FileBytes(std::string const& path)
+{
+    std::error_code error;
+    uintmax_t size = std::filesystem::file_size(path, error);
+    return error ? 0 : (unsigned long long)size;
+}
+
+// An empty manifest if there is none or it is from another version
+cJSON* ReadBakeManifest(std::string const& path)
+{
+    cJSON* manifest = NULL;
+
+    MappedFile* file = MapFile(path.c_str());
+    if (file != NULL) {
+        manifest = cJSON_ParseWithLength((const char*)file->data, file->size);
+        UnmapFile(file);
+    }
+
+    cJSON* version = cJSON_GetObjectItem(manifest, "version");
+    if (!cJSON_IsNumber(version) || version->valueint != BAKE_MANIFEST_VERSION) {
+        cJSON_Delete(manifest);
+        manifest = cJSON_CreateObject();
+    }
+
+    return manifest;
+}
+
+// Failed assets are left out so the next run tries them again
+bool WriteBakeManifest(std::string const& path)
+{
+    cJSON* manifest = cJSON_CreateObject();
+    cJSON_AddNumberToObject(manifest, "version", BAKE_MANIFEST_VERSION);
+    cJSON* assets = cJSON_AddObjectToObject(manifest, "assets");
+
+    for (size_t i = 0; i < assetBaker.assets.size(); ++i) {
+        BakeAsset* asset = assetBaker.assets[i];
+        if (asset->status == BAKE_FAILED) {
+            continue;
+        }
+
+        cJSON* entry = cJSON_AddObjectToObject(assets, asset->key.c_str());
+        cJSON_AddStringToObject(entry, "kind", BakeKindNames[asset->kind]);
+        cJSON_AddNumberToObject(entry, "version", BakeVersion(asset->kind));
+        cJSON_AddStringToObject(entry, "hash", HashToString(asset->hash).c_str());
+
+        cJSON* dependencies = cJSON_AddObjectToObject(entry, "dependencies");
+        for (size_t j = 0; j < asset->dependencies.size(); ++j) {
+            cJSON_AddStringToObject(dependencies, BakeKey(asset->dependencies[j]).c_str(), HashToString(asset->dependencyHashes[j]).c_str());
+        }
+
+        cJSON* textures = cJSON_AddArrayToObject(entry, "textures");
+        for (size_t j = 0; j < asset->textures.size(); ++j) {
+            cJSON_AddItemToArray(textures, cJSON_CreateString(BakeKey(asset->textures[j]).c_str()));
+        }
+
+        cJSON* outputs = cJSON_AddArrayToObject(entry, "outputs");
+        for (size_t j = 0; j < asset->outputs.size(); ++j) {
+            cJSON_AddItemToArray(outputs, cJSON_CreateString(BakeKey(asset->outputs[j]).c_str()));
+        }
+    }
+
+    char* json = cJSON_Print(manifest);
+    cJSON_Delete(manifest);
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+        cJSON_free(json);
+        return false;
+    }
+
+    size_t length = strlen(json);
+    bool written = fwrite(json, 1, length, file) == length;
+    written = (fclose(file) == 0) && written;
+
+    cJSON_free(json);
+    return written;
+}
+
+void PrintBakeReport(double wallMs)
+{
+    static const char* statusNames[] = { "pending", "cached", "baked", "FAILED" };
+
+    int counts[4] = { 0, 0, 0, 0 };
+    double totalMs = 0.0;
+    unsigned long long totalInput = 0;
+    unsigned long long totalOutput = 0;
+
+    printf("\n%-8s  %-7s  %10s  %10s  %10s  %s\n", "kind", "status", "ms", "in KB", "out KB", "asset");
+
+    for (size_t i = 0; i < assetBaker.assets.size(); ++i) {
+        BakeAsset* asset = assetBaker.assets[i];
+
+        printf("%-8s  %-7s  %10.2f  %10.1f  %10.1f  %s", BakeKindNames[asset->kind], statusNames[asset->status],
+            asset->ms, asset->inputBytes / 1024.0, asset->outputBytes / 1024.0, asset->key.c_str());
+        if (!asset->message.empty()) {
+            printf("  (%s)", asset->message.c_str());
+        }
+        printf("\n");
+
+        counts[asset->status]++;
+        totalMs += asset->ms;
+        totalInput += asset->inputBytes;
+        totalOutput += asset->outputBytes;
+    }
+
+    printf("\n%d baked, %d up to date, %d failed\n", counts[BAKE_BAKED], counts[BAKE_UP_TO_DATE], counts[BAKE_FAILED]);
+    printf("%.1f MB in, %.1f MB out, %.0f ms of work in %.0f ms\n",
+        totalInput / (1024.0 * 1024.0), totalOutput / (1024.0 * 1024.0), totalMs, wallMs);
+}
+
+#endif
@@ -0,0 +1,249 @@
+/*-------------------------------------------------------------------------------\
+asset_manager.h
+
+Functions:
+    Asynchronous model loading.
+
+    LoadModelAsync returns a ModelAsset handle straight away. The worker pool
+    (worker_pool.h) runs the CPU side of the load (mesh cache read or Assimp
+    import, processMesh, AssignBoneId). The finished ModelData is queued for the
+    main thread, where PollAssetManager does the OpenGL upload once per frame.
+
+    handle->state goes PENDING -> READY (handle->model is set) or FAILED.
+    It is only changed on the main thread, so it can be read there without locks.
+
+    Every path is loaded once. Asking for a path again returns the same handle
+    with refCount raised, so all users share one immutable Model (meshes,
+    textures, skeleton, animations). Per-object state goes in a ModelInstance
+    (model_instance.h). ReleaseModelAsset drops a reference. The last one
+    unloads the model (UnloadModel) and frees the handle, or does so once a
+    load still in flight has finished.
+
+    ReloadModelAsync loads a READY model again and swaps it into the same Model
+    (ReplaceModelData), so nodes holding the pointer pick it up. If the reload
+    fails the old model stays. A FAILED asset is simply loaded again.
+
+\-------------------------------------------------------------------------------*/
+#ifndef ASSET_MANAGER_H
+#define ASSET_MANAGER_H
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <mapped_file.h>
+#include <worker_pool.h>
+#include <model.h>
+
+enum AssetState {
+    ASSET_PENDING,
+    ASSET_READY,
+    ASSET_FAILED
+};
+
+struct ModelAsset {
+    char* path;
+    AssetState state;
+
+    // Set when state == ASSET_READY
+    Model* model;
+
+    // Handed from the worker to the main thread
+    ModelData* data;
+
+    // a reload job is in flight
+    bool reloading;
+
+    // LoadModelAsync calls minus ReleaseModelAsset calls
+    int refCount;
+};
+
+struct AssetManager {
+    std::mutex mutex;
+    std::vector<ModelAsset*> completed;
+
+    // every handle ever returned, main thread only
+    std::vector<ModelAsset*> assets;
+    // resolved path -> handle
+    std::unordered_map<std::string, ModelAsset*> byPath;
+    int numPending;
+    // LoadModelAsync calls that returned an existing handle
+    int numShared;
+};
+
+AssetManager assetManager;
+
+ModelAsset* LoadModelAsync(std::string const& path);
+void ReleaseModelAsset(ModelAsset* asset);
+void UnloadModelAsset(ModelAsset* asset);
+bool ReloadModelAsync(ModelAsset* asset);
+void PollAssetManager();
+
+Model* WaitForModel(ModelAsset* asset);
+void WaitForAllAssets();
+
+void LoadModelJob(void* arg);
+
+void LoadModelJob(void* arg)
+{
+    ModelAsset* asset = (ModelAsset*)arg;
+
+    ModelData* data = LoadModelData(asset->path);
+
+    std::lock_guard<std::mutex> lock(assetManager.mutex);
+    asset->data = data;
+    assetManager.completed.push_back(asset);
+}
+
+ModelAsset* LoadModelAsync(std::string const& path)
+{
+    // "a/../b.obj" and "b.obj" share a handle
+    std::string key = NormalizePath(path);
+
+    std::unordered_map<std::string, ModelAsset*>::iterator found = assetManager.byPath.find(key);
+    if (found != assetManager.byPath.end()) {
+        found->second->refCount++;
+        assetManager.numShared++;
+        return found->second;
+    }
+
+    ModelAsset* asset = (ModelAsset*)malloc(sizeof(ModelAsset));
+
+    asset->path = CopyString(path.c_str());
+    asset->state = ASSET_PENDING;
+    asset->model = NULL;
+    asset->data = NULL;
+    asset->reloading = false;
+    asset->refCount = 1;
+
+    assetManager.assets.push_back(asset);
+    assetManager.byPath[key] = asset;
+    assetManager.numPending++;
+
+    PushWorkerJob(LoadModelJob, asset);
+
+    return asset;
+}
+
+// The handle is invalid after the last release
+void ReleaseModelAsset(ModelAsset* asset)
+{
+    if (asset == NULL || asset->refCount <= 0) {
+        return;
+    }
+
+    asset->refCount--;
+
+    // a worker still writes to the handle, PollAssetManager unloads it when it's done
+    if (asset->refCount == 0 && asset->state != ASSET_PENDING && !asset->reloading) {
+        UnloadModelAsset(asset);
+    }
+}
+
+void UnloadModelAsset(ModelAsset* asset)
+{
+    UnloadModel(asset->model);
+
+    assetManager.byPath.erase(NormalizePath(asset->path));
+    assetManager.assets.erase(std::find(assetManager.assets.begin(), assetManager.assets.end(), asset));
+
+    free(asset->path);
+    free(asset);
+}
+
+// Returns false if the asset is still loading
+bool ReloadModelAsync(ModelAsset* asset)
+{
+    if (asset->state == ASSET_PENDING || asset->reloading) {
+        return false;
+    }
+
+    if (asset->state == ASSET_FAILED) {
+        asset->state = ASSET_PENDING;
+    } else {
+        asset->reloading = true;
+    }
+    assetManager.numPending++;
+
+    PushWorkerJob(LoadModelJob, asset);
+
+    return true;
+}
+
+// Main thread, once per frame. Uploads every model the workers have finished.
+void PollAssetManager()
+{
+    std::vector<ModelAsset*> completed;
+
+    {
+        std::lock_guard<std::mutex> lock(assetManager.mutex);
+        completed.swap(assetManager.completed);
+    }
+
+    for (size_t i = 0; i < completed.size(); ++i) {
+        ModelAsset* asset = completed[i];
+
+        if (asset->reloading) {
+            asset->reloading = false;
+
+            if (asset->data == NULL) {
+                printf("AssetManager: failed to reload %s, keeping the old model\n", asset->path);
+            } else {
+                ReplaceModelData(asset->model, asset->data);
+
+                FreeModelData(asset->data);
+                asset->data = NULL;
+            }
+        } else if (asset->data == NULL) {
+            printf("AssetManager: failed to load %s\n", asset->path);
+            asset->state = ASSET_FAILED;
+        } else {
+            asset->model = CreateModelFromData(asset->data);
+            asset->state = ASSET_READY;
+
+            FreeModelData(asset->data);
+            asset->data = NULL;
+        }
+
+        assetManager.numPending--;
+
+        if (asset->refCount == 0) {
+            UnloadModelAsset(asset);
+        }
+    }
+}
+
+// Blocks the main thread until the model is uploaded. Returns NULL if the load failed.
+Model* WaitForModel(ModelAsset* asset)
+{
+    while (true) {
+        unsigned long long jobsFinished = WorkerJobsFinished();
+
+        PollAssetManager();
+
+        if (asset->state != ASSET_PENDING) {
+            return asset->model;
+        }
+
+        WaitForWorkerJobs(jobsFinished);
+    }
+}
+
+void WaitForAllAssets()
+{
+    while (true) {
+        unsigned long long jobsFinished = WorkerJobsFinished();
+
+        PollAssetManager();
+
+        if (assetManager.numPending == 0) {
+            return;
+        }
+
+        WaitForWorkerJobs(jobsFinished);
+    }
+}
+
+#endif
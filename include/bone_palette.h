@@ -0,0 +1,136 @@
+/*-------------------------------------------------------------------------------\
+bone_palette.h
+
+Functions:
+    One texture buffer holds the bone matrices of every skinned instance drawn
+    this frame. BeginBonePalette empties the CPU copy, AddBonePalette appends
+    an instance's matrices and returns where they start, UploadBonePalette
+    sends the whole frame in one glBufferSubData. anim_model.vs reads its bones
+    with texelFetch from bonePalette starting at boneOffset.
+
+    A bone is stored as the top 3 rows of its matrix (mat3x4, 3 RGBA32F
+    texels), the last row of a bone transform is always 0 0 0 1. That's 48
+    bytes instead of 64.
+
+    OpenGL 4.1 has no persistent mapping, so the buffer object stays and its
+    storage is orphaned every frame with glBufferData(NULL), the driver hands
+    out fresh memory instead of waiting for last frame's draws. It grows by
+    doubling when a frame needs more bones.
+
+\-------------------------------------------------------------------------------*/
+#ifndef BONE_PALETTE_H
+#define BONE_PALETTE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <stdlib.h>
+
+#include <shader_uniforms.h>
+
+// texture unit for bonePalette, after the material units of model.h
+#define BONE_PALETTE_UNIT 8
+#define BONE_PALETTE_MIN_BONES 256
+
+struct BonePalette {
+    GLuint buffer;
+    GLuint texture;
+    // bones the buffer storage holds
+    int capacity;
+
+    // this frame, 12 floats per bone
+    float* rows;
+    int numBones;
+    int rowCapacity;
+};
+
+BonePalette bonePalette;
+
+void BeginBonePalette();
+int AddBonePalette(const glm::mat4* matrices, int count);
+void UploadBonePalette();
+void BindBonePalette(unsigned int shaderID);
+
+void BeginBonePalette()
+{
+    bonePalette.numBones = 0;
+}
+
+// Returns the offset of the first bone, for the boneOffset uniform
+int AddBonePalette(const glm::mat4* matrices, int count)
+{
+    int offset = bonePalette.numBones;
+
+    if (offset + count > bonePalette.rowCapacity) {
+        int capacity = (bonePalette.rowCapacity > 0) ? bonePalette.rowCapacity : BONE_PALETTE_MIN_BONES;
+        while (capacity < offset + count) {
+            capacity *= 2;
+        }
+        bonePalette.rows = (float*)realloc(bonePalette.rows, (size_t)capacity * 12 * sizeof(float));
+        bonePalette.rowCapacity = capacity;
+    }
+
+    float* dst = bonePalette.rows + (size_t)offset * 12;
+
+    for (int i = 0; i < count; ++i) {
+        const glm::mat4& m = matrices[i];
+
+        // glm is column major, m[column][row]
+        for (int row = 0; row < 3; ++row) {
+            dst[row * 4 + 0] = m[0][row];
+            dst[row * 4 + 1] = m[1][row];
+            dst[row * 4 + 2] = m[2][row];
+            dst[row * 4 + 3] = m[3][row];
+        }
+        dst += 12;
+    }
+
+    bonePalette.numBones += count;
+    return offset;
+}
+
+// Once per frame, after every AddBonePalette and before the skinned draws
+void UploadBonePalette()
+{
+    if (bonePalette.numBones == 0) {
+        return;
+    }
+
+    if (bonePalette.buffer == 0) {
+        glGenBuffers(1, &bonePalette.buffer);
+        glGenTextures(1, &bonePalette.texture);
+
+        // the texture follows the buffer object, orphaning doesn't detach it
+        glActiveTexture(GL_TEXTURE0 + BONE_PALETTE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, bonePalette.texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, bonePalette.buffer);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    if (bonePalette.numBones > bonePalette.capacity) {
+        int capacity = (bonePalette.capacity > 0) ? bonePalette.capacity : BONE_PALETTE_MIN_BONES;
+        while (capacity < bonePalette.numBones) {
+            capacity *= 2;
+        }
+        bonePalette.capacity = capacity;
+    }
+
+    size_t size = (size_t)bonePalette.capacity * 12 * sizeof(float);
+
+    glBindBuffer(GL_TEXTURE_BUFFER, bonePalette.buffer);
+    glBufferData(GL_TEXTURE_BUFFER, size, NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, (size_t)bonePalette.numBones * 12 * sizeof(float), bonePalette.rows);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// The program has to be bound
+void BindBonePalette(unsigned int shaderID)
+{
+    glActiveTexture(GL_TEXTURE0 + BONE_PALETTE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, bonePalette.texture);
+    glActiveTexture(GL_TEXTURE0);
+
+    glUniform1i(ShaderUniformLocation(shaderID, UNIFORM("bonePalette")), BONE_PALETTE_UNIT);
+}
+
+#endif
@@ -0,0 +1,219 @@
+/*-------------------------------------------------------------------------------\
+collider_cache.h
+
+Functions:
+    Collider triangles for CreateHitbox (collision.h). ParseColliderObj reads
+    the triangulated .obj hitbox files, LoadColliderTriangles uses the baked
+    <source>.hitbox from the asset baker when it is current and falls back to
+    parsing the .obj.
+
+    Triangles are in object space, CreateHitbox applies the node matrix.
+    Keyed by source mtime, size and content hash the same way as mesh_cache.h.
+
+Layout (native endian):
+    ColliderCacheHeader
+    triangles  { vertices[3] normal } 12 floats each
+
+\-------------------------------------------------------------------------------*/
+#ifndef COLLIDER_CACHE_H
+#define COLLIDER_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <mapped_file.h>
+
+#define COLLIDER_CACHE_VERSION 1
+#define COLLIDER_CACHE_EXTENSION ".hitbox"
+
+struct ColliderTriangle {
+    glm::vec3 vertices[3];
+    // the first vertex normal of the face
+    glm::vec3 normal;
+};
+
+struct ColliderCacheHeader {
+    char magic[4];
+    unsigned int version;
+    long long sourceMtime;
+    unsigned long long sourceSize;
+    unsigned long long contentHash;
+    unsigned int numTriangles;
+};
+
+std::string ColliderCachePath(std::string const& path);
+
+bool LoadColliderTriangles(std::string const& path, std::vector<ColliderTriangle>& triangles);
+bool ParseColliderObj(std::string const& path, std::vector<ColliderTriangle>& triangles);
+bool WriteColliderCache(std::string const& path, std::vector<ColliderTriangle> const& triangles);
+bool ReadColliderCache(std::string const& path, std::vector<ColliderTriangle>& triangles);
+
+std::string ColliderCachePath(std::string const& path)
+{
+    return path + COLLIDER_CACHE_EXTENSION;
+}
+
+bool LoadColliderTriangles(std::string const& path, std::vector<ColliderTriangle>& triangles)
+{
+    if (ReadColliderCache(path, triangles)) {
+        return true;
+    }
+    return ParseColliderObj(path, triangles);
+}
+
+// Assumes triangulated faces with normals, "f v/t/n v/t/n v/t/n" or "f v//n v//n v//n"
+bool ParseColliderObj(std::string const& path, std::vector<ColliderTriangle>& triangles)
+{
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == NULL) {
+        perror("Error opening file");
+        return false;
+    }
+
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+
+    char line[256];
+
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == 'v') {
+            if (line[1] == ' ') {
+                float x, y, z;
+                sscanf(line, "v %f %f %f", &x, &y, &z);
+                vertices.push_back(glm::vec3(x, y, z));
+            } else if (line[1] == 'n') {
+                float nx, ny, nz;
+                sscanf(line, "vn %f %f %f", &nx, &ny, &nz);
+                normals.push_back(glm::vec3(nx, ny, nz));
+            }
+        } else if (line[0] == 'f') {
+            int vertex_1, vertex_2, vertex_3, vertex_normal;
+
+            int basic = sscanf(line, "f %d/%*d/%d %d/%*d/%*d %d/%*d/%*d", &vertex_1, &vertex_normal, &vertex_2, &vertex_3);
+            if (basic != 4) {
+                int with_color = sscanf(line, "f %d//%d %d//%*d %d//%*d", &vertex_1, &vertex_normal, &vertex_2, &vertex_3);
+                if (with_color != 4) {
+                    continue;
+                }
+            }
+
+            int numVertices = (int)vertices.size();
+            if (vertex_1 < 1 || vertex_1 > numVertices || vertex_2 < 1 || vertex_2 > numVertices
+                || vertex_3 < 1 || vertex_3 > numVertices || vertex_normal < 1 || vertex_normal > (int)normals.size()) {
+                continue;
+            }
+
+            ColliderTriangle triangle;
+            triangle.vertices[0] = vertices[vertex_1 - 1];
+            triangle.vertices[1] = vertices[vertex_2 - 1];
+            triangle.vertices[2] = vertices[vertex_3 - 1];
+            triangle.normal = normals[vertex_normal - 1];
+
+            triangles.push_back(triangle);
+        }
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+bool WriteColliderCache(std::string const& path, std::vector<ColliderTriangle> const& triangles)
+{
+    ColliderCacheHeader header;
+    memcpy(header.magic, "AVHB", 4);
+    header.version = COLLIDER_CACHE_VERSION;
+    header.numTriangles = (unsigned int)triangles.size();
+
+    if (!GetSourceStamp(path, &header.sourceMtime, &header.sourceSize)) {
+        return false;
+    }
+
+    bool hashed;
+    header.contentHash = HashFileContents(path.c_str(), &hashed);
+    if (!hashed) {
+        return false;
+    }
+
+    // Written under a unique name and renamed, so a reader never maps a half written file
+    std::string cachePath = ColliderCachePath(path);
+    std::string tempPath = TempFilePath(cachePath);
+
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == NULL) {
+        std::cout << "COLLIDER_CACHE:: could not create " << tempPath << std::endl;
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(triangles.data(), sizeof(ColliderTriangle), triangles.size(), file) == triangles.size();
+
+    written = (fclose(file) == 0) && written;
+
+    if (!written) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// False if there is no cache or it is stale
+bool ReadColliderCache(std::string const& path, std::vector<ColliderTriangle>& triangles)
+{
+    long long mtime;
+    unsigned long long size;
+    if (!GetSourceStamp(path, &mtime, &size)) {
+        return false;
+    }
+
+    MappedFile* mapping = MapFile(ColliderCachePath(path).c_str());
+    if (mapping == NULL) {
+        return false;
+    }
+
+    ColliderCacheHeader header;
+    bool valid = mapping->size >= sizeof(ColliderCacheHeader);
+
+    if (valid) {
+        memcpy(&header, mapping->data, sizeof(ColliderCacheHeader));
+
+        valid = memcmp(header.magic, "AVHB", 4) == 0
+            && header.version == COLLIDER_CACHE_VERSION
+            && header.sourceSize == size
+            && mapping->size >= sizeof(ColliderCacheHeader) + (size_t)header.numTriangles * sizeof(ColliderTriangle);
+    }
+
+    // Same size but touched since the cache was written, check the contents
+    if (valid && header.sourceMtime != mtime) {
+        bool hashed;
+        unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+        valid = hashed && hash == header.contentHash;
+    }
+
+    if (valid) {
+        const ColliderTriangle* src = (const ColliderTriangle*)(mapping->data + sizeof(ColliderCacheHeader));
+        triangles.assign(src, src + header.numTriangles);
+    }
+
+    UnmapFile(mapping);
+
+    return valid;
+}
+
+#endif
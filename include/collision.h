@@ -8,9 +8,11 @@ collision.h
 
 #include <glad/glad.h>s
 
+#include <algorithm>
 #include <vector>
 
 #include <aabb.h>
+#include <collider_cache.h>
 
 const float EPSILON = 1e-7;
 float scaleFactor = 1;
@@ -19,6 +21,8 @@ struct Polygon {
     std::vector<Point> vertices;
     Vector normal;
     glm::mat4* matrix;
+    // tree from CreateHitbox, FreeHitbox removes the polygon with it
+    AABB_node* hitbox;
 };
 
 struct Sphere {
@@ -51,6 +55,7 @@ int CollisionDetection(Sphere sphere, Vector& velocity, Point& collision_point);
 void CollisionResponse(Vector& originalVelocity, Sphere sphere, Point collision_point, Plane collision_plane);
 
 AABB_node* CreateHitbox(std::string const& path, glm::mat4 matrix);
+void FreeHitbox(AABB_node* rootAABB);
 
 // Primitive Equations
 Point ClosestPtPointPlane(Point q, Plane p);
@@ -349,77 +354,34 @@ void CollisionResponse(Vector& originalVelocity, Sphere sphere, Point collision_
 //Create hitbox from .obj and add to hitbox array. Assumes triangulated
 AABB_node* CreateHitbox(std::string const& path, glm::mat4 matrix)
 {
-    const char* file_path = path.c_str();
-
-    FILE* file = fopen(file_path, "r");
-    if (file == NULL) {
-        perror("Error opening file");
+    // <path>.hitbox from the asset baker, or the .obj itself
+    std::vector<ColliderTriangle> colliderTriangles;
+    if (!LoadColliderTriangles(path, colliderTriangles)) {
         return NULL;
     }
 
-    int vertexCount = 0;
-    int normalCount = 0;
-    int faceCount = 0;
-
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
     std::vector<Polygon> polygons;
 
-    char line[256];
-
     glm::mat4 normalMatrix = glm::transpose(glm::inverse(matrix));
 
-    while (fgets(line, sizeof(line), file)) {
-        if (line[0] == 'v') {
-            if (line[1] == ' ') {
-                float x, y, z;
-                sscanf(line, "v %f %f %f", &x, &y, &z);
-                vertices.push_back(glm::vec3(matrix * glm::vec4(x, y, z, 1.0f)));
-                //vertices.push_back(glm::vec3(x, y, z));
-                //verticeCount++;
-            } else if (line[1] == 'n') {
-                float nx, ny, nz;
-                sscanf(line, "vn %f %f %f", &nx, &ny, &nz);
-                normals.push_back(glm::normalize(glm::vec3(normalMatrix * glm::vec4(nx, ny, nz, 1.0))));
-                //normals.push_back(glm::vec3(nx, ny, nz));
-                
-                //normalCount++;
-            }
-        } else if (line[0] == 'f') {
-            int vertex_1, vertex_2, vertex_3, vertex_normal;
-
-            int basic = sscanf(line, "f %d/%*d/%d %d/%*d/%*d %d/%*d/%*d", &vertex_1, &vertex_normal, &vertex_2, &vertex_3);
-            int with_color = sscanf(line, "f %d//%d %d//%*d %d//%*d", &vertex_1, &vertex_normal, &vertex_2, &vertex_3);
-
-            if (basic == 4) {
-                sscanf(line, "f %d/%*d/%d %d/%*d/%*d %d/%*d/%*d", &vertex_1, &vertex_normal, &vertex_2, &vertex_3);
-            } else if (with_color == 4) {
-                sscanf(line, "f %d//%d %d//%*d %d//%*d", &vertex_1, &vertex_normal, &vertex_2, &vertex_3);
-            }
-
+    for (size_t i = 0; i < colliderTriangles.size(); ++i) {
+        ColliderTriangle* triangle = &colliderTriangles[i];
 
-            Polygon polygon;
+        Polygon polygon;
 
-            polygon.vertices.push_back(vertices[vertex_1 - 1]);
-            polygon.vertices.push_back(vertices[vertex_2 - 1]);
-            polygon.vertices.push_back(vertices[vertex_3 - 1]);
-            
-            polygon.normal = normals[vertex_normal - 1];
+        polygon.vertices.push_back(glm::vec3(matrix * glm::vec4(triangle->vertices[0], 1.0f)));
+        polygon.vertices.push_back(glm::vec3(matrix * glm::vec4(triangle->vertices[1], 1.0f)));
+        polygon.vertices.push_back(glm::vec3(matrix * glm::vec4(triangle->vertices[2], 1.0f)));
 
-            polygons.push_back(polygon);
+        polygon.normal = glm::normalize(glm::vec3(normalMatrix * glm::vec4(triangle->normal, 1.0)));
 
-            //faceCount++;
-        }
+        polygons.push_back(polygon);
     }
 
-    fclose(file);
-
     Triangle* triangles = (Triangle*)malloc(sizeof(Triangle) * polygons.size());
         
 
     for (int i = 0; i < polygons.size(); ++i) {
-        potentialColliders.push_back(polygons[i]);
-
         triangles[i].vertices[0] = polygons[i].vertices[0];
         triangles[i].vertices[1] = polygons[i].vertices[1];
         triangles[i].vertices[2] = polygons[i].vertices[2];
@@ -434,6 +396,11 @@ AABB_node* CreateHitbox(std::string const& path, glm::mat4 matrix)
 
     root_AABB_nodes.push_back(rootAABBnode);
 
+    for (int i = 0; i < polygons.size(); ++i) {
+        polygons[i].hitbox = rootAABBnode;
+        potentialColliders.push_back(polygons[i]);
+    }
+
     //updateAABB(rootAABBnode, matrix);
 
     for (int i = 0; i < polygons.size(); i++) {
@@ -445,6 +412,33 @@ AABB_node* CreateHitbox(std::string const& path, glm::mat4 matrix)
     return rootAABBnode;
 }
 
+// Frees a tree from CreateHitbox with its triangles and takes its polygons out of potentialColliders.
+// The first leaf points at the start of the triangle array.
+void FreeHitbox(AABB_node* rootAABB)
+{
+    if (rootAABB == NULL) {
+        return;
+    }
+
+    root_AABB_nodes.erase(std::remove(root_AABB_nodes.begin(), root_AABB_nodes.end(), rootAABB), root_AABB_nodes.end());
+
+    size_t kept = 0;
+    for (size_t i = 0; i < potentialColliders.size(); ++i) {
+        if (potentialColliders[i].hitbox != rootAABB) {
+            potentialColliders[kept++] = potentialColliders[i];
+        }
+    }
+    potentialColliders.resize(kept);
+
+    AABB_node* first = rootAABB;
+    while (first->type == NODE) {
+        first = first->left;
+    }
+    free(first->object);
+
+    FreeAABB_Tree(rootAABB);
+}
+
 Point ClosestPtPointPlane(Point q, Plane p)
 {
     float t = (glm::dot(p.n, q) - p.d) / glm::dot(p.n, p.n);
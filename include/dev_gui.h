@@ -72,6 +72,53 @@ static void ShowExampleAppSimpleOverlay(bool* p_open, int fps)
         // FPS
         ImVec4 textColor = ImVec4(0.0f, 1.0f, 0.0f, 1.0f);
         ImGui::TextColored(textColor, "FPS %d", fps);
+        // LOD
+        long long trianglesSaved = renderStats.trianglesFull - renderStats.trianglesDrawn;
+        ImGui::Text("Triangles: %lld / %lld (LOD saved %.1f%%)", renderStats.trianglesDrawn, renderStats.trianglesFull,
+            renderStats.trianglesFull > 0 ? 100.0 * trianglesSaved / renderStats.trianglesFull : 0.0);
+        ImGui::Text("Models per LOD: %d %d %d %d", renderStats.modelsPerLod[0], renderStats.modelsPerLod[1],
+            renderStats.modelsPerLod[2], renderStats.modelsPerLod[3]);
+        ImGui::SliderFloat("LOD pixel error", &lodPixelError, 0.25f, 8.0f);
+        // Frustum
+        ImGui::Text("Models: %d visible, %d culled", renderStats.modelsVisible, renderStats.modelsCulled);
+        ImGui::Text("Meshes: %d visible, %d culled", renderStats.meshesVisible, renderStats.meshesCulled);
+        ImGui::Checkbox("Frustum culling", &frustumCulling);
+        // Scene BVH
+        static std::vector<SceneNode*> nearbyNodes;
+        nearbyNodes.clear();
+        QuerySceneSphere(renderView.position, 25.0f, nearbyNodes);
+        ImGui::Text("Scene BVH: %d nodes, height %d, %d within 25", sceneBvh.numProxies, BvhHeight(&sceneBvh), (int)nearbyNodes.size());
+        if (ImGui::Button("Benchmark BVH")) {
+            BenchmarkBvh(100000);
+        }
+        // Occlusion
+        ImGui::Text("Occlusion: %d culled, %d occluder triangles, %.2f ms", renderStats.occlusionCulled, renderStats.occluderTriangles, renderStats.occlusionMs);
+        ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+        // Clusters
+        ImGui::Text("Submitted: %lld triangles, culled %lld", renderStats.trianglesDrawn - renderStats.trianglesCulled, renderStats.trianglesCulled);
+        ImGui::Text("Clusters: %d drawn, %d culled", renderStats.clustersDrawn, renderStats.clustersCulled);
+        ImGui::Text("Texture binds: %d for %d meshes", renderStats.textureBinds, renderStats.meshesDrawn);
+        ImGui::Text("Program switches: %d, VAO switches: %d", renderStats.programSwitches, renderStats.vaoSwitches);
+        ImGui::Text("Draw calls: %d", renderStats.drawCalls);
+        ImGui::Checkbox("Sort render queue", &renderQueueSorted);
+        ImGui::Checkbox("Instancing", &instancingEnabled);
+        if (indirectDrawSupported) {
+            ImGui::Checkbox("Multi-draw indirect", &indirectDrawEnabled);
+        } else {
+            ImGui::Text("Multi-draw indirect needs OpenGL 4.3");
+        }
+        // counted since the overlay was last drawn, so one frame
+        ImGui::Text("Uniform sets: %d, %d unknown names", shaderUniformStats.numLookups, shaderUniformStats.numMissing);
+        ResetShaderUniformStats();
+        if (ImGui::Button("Benchmark uniforms")) {
+            BenchmarkShaderUniforms(shaderIdArray[0], 1000);
+        }
+        ImGui::Text("Uniform ring: %zu of %zu KB, %s, %d fence waits", uniformRing.bytesUsed / 1024, uniformRing.frameSize / 1024,
+            uniformRingPersistent ? "persistent" : "orphaned", uniformRing.fenceWaits);
+        ImGui::Text("Models: %d loaded, %d shared loads", (int)assetManager.assets.size(), assetManager.numShared);
+        ImGui::Checkbox("Cluster culling", &clusterCulling);
+        ImGui::SameLine();
+        ImGui::Checkbox("Backface culling", &cullBackfaces);
         // **
         if (ImGui::IsMousePosValid())
             ImGui::Text("Mouse Position: (%.1f,%.1f)", io.MousePos.x, io.MousePos.y);
@@ -249,12 +296,21 @@ void DrawTree(SceneNode* node)
 
         if (node->type == "model") {
             ImGui::Text("shaderID: %d", node->shaderID);
-            ImGui::Text("m_NumMeshes: %d", node->model->m_NumMeshes);
-            ImGui::Text("m_NumAnimations: %d", node->model->m_NumAnimations);
+            if (node->model != NULL) {
+                ImGui::Text("m_NumMeshes: %d", node->model->m_NumMeshes);
+                ImGui::Text("m_NumAnimations: %d", node->model->m_NumAnimations);
+            } else {
+                ImGui::Text("loading...");
+            }
         }
 
         ImGui::Text("id: %d", node->id);
 
+        if (node->model != NULL) {
+            Model* model = node->model;
+            ImGui::Text("lod: %d / %d, %u triangles", node->lodLevel, model->m_NumLods, model->m_LodTriangles[node->lodLevel]);
+        }
+
         if (ImGui::Button("Click Me")) {
             selectedNode = node;
         }
@@ -598,6 +654,8 @@ void Main_GUI_Loop(double time)
 
     if (showTextureWindow) {
         //TextureWindow();
+        TextureRegistryWindow();
+        TextureResidencyWindow();
     }
 
     MainMenuBar();
@@ -0,0 +1,241 @@
+/*-------------------------------------------------------------------------------\
+frustum_cull.h
+
+Functions:
+    View frustum culling with axis aligned boxes. processMesh gives every mesh
+    an object space box, TransformBounds moves one into world space (Arvo, the
+    box around the transformed box) as a center and half extent.
+
+    The scene graph collects the world boxes of its meshes in a CullBoxes list
+    and tests them all with CullBoxesAgainstFrustum, SSE does 4 boxes against
+    a plane at once. A box is outside when it's entirely behind one of the 6
+    planes of renderView.frustum:
+
+        dot(n, center) + d < -dot(|n|, extent)
+
+    Boxes that straddle a corner of the frustum can pass, the test never drops
+    a visible box.
+
+    ModelInFrustum and BillboardInFrustum are for the one off draws in
+    main.cpp, they count into renderStats like the scene graph does. They take
+    the model's ModelBounds, this header doesn't need model.h.
+
+\-------------------------------------------------------------------------------*/
+#ifndef FRUSTUM_CULL_H
+#define FRUSTUM_CULL_H
+
+#include <glm/glm.hpp>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULL_SSE 1
+#include <xmmintrin.h>
+#endif
+
+#include <model_bounds.h>
+#include <render_view.h>
+
+// Structure of arrays so 4 boxes load into one register per component.
+// Capacity is a multiple of 4, the lanes after count are padding.
+struct CullBoxes {
+    float* centerX;
+    float* centerY;
+    float* centerZ;
+    float* extentX;
+    float* extentY;
+    float* extentZ;
+    unsigned char* visible;
+
+    int count;
+    int capacity;
+};
+
+bool frustumCulling = true;
+
+void TransformBounds(glm::mat4 const& matrix, glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec3* center, glm::vec3* extent);
+bool BoxInFrustum(glm::vec3 center, glm::vec3 extent, const glm::vec4* planes);
+
+void BeginCullBoxes(CullBoxes* boxes);
+int AddCullBox(CullBoxes* boxes, glm::vec3 center, glm::vec3 extent);
+void CullBoxesAgainstFrustum(CullBoxes* boxes, const glm::vec4* planes);
+
+bool ModelInFrustum(ModelBounds* bounds, glm::mat4 const& modelMatrix);
+bool BillboardInFrustum(ModelBounds* bounds, glm::vec3 position, glm::vec2 screenScale);
+
+// Skinned models are never culled, the boxes only hold the bind pose
+void TransformBounds(glm::mat4 const& matrix, glm::vec3 boundsMin, glm::vec3 boundsMax, glm::vec3* center, glm::vec3* extent)
+{
+    glm::vec3 localCenter = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 localExtent = (boundsMax - boundsMin) * 0.5f;
+
+    *center = glm::vec3(matrix * glm::vec4(localCenter, 1.0f));
+
+    // glm is column major, row i of the 3x3 part is (matrix[0][i], matrix[1][i], matrix[2][i])
+    for (int i = 0; i < 3; ++i) {
+        (*extent)[i] = fabsf(matrix[0][i]) * localExtent.x + fabsf(matrix[1][i]) * localExtent.y + fabsf(matrix[2][i]) * localExtent.z;
+    }
+}
+
+bool BoxInFrustum(glm::vec3 center, glm::vec3 extent, const glm::vec4* planes)
+{
+    for (int i = 0; i < 6; ++i) {
+        glm::vec3 normal = glm::vec3(planes[i]);
+
+        float distance = glm::dot(normal, center) + planes[i].w;
+        float radius = glm::dot(glm::abs(normal), extent);
+
+        if (distance < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void BeginCullBoxes(CullBoxes* boxes)
+{
+    boxes->count = 0;
+}
+
+// Returns the index of the box in visible
+int AddCullBox(CullBoxes* boxes, glm::vec3 center, glm::vec3 extent)
+{
+    if (boxes->count == boxes->capacity) {
+        int capacity = (boxes->capacity > 0) ? boxes->capacity * 2 : 256;
+
+        boxes->centerX = (float*)realloc(boxes->centerX, capacity * sizeof(float));
+        boxes->centerY = (float*)realloc(boxes->centerY, capacity * sizeof(float));
+        boxes->centerZ = (float*)realloc(boxes->centerZ, capacity * sizeof(float));
+        boxes->extentX = (float*)realloc(boxes->extentX, capacity * sizeof(float));
+        boxes->extentY = (float*)realloc(boxes->extentY, capacity * sizeof(float));
+        boxes->extentZ = (float*)realloc(boxes->extentZ, capacity * sizeof(float));
+        boxes->visible = (unsigned char*)realloc(boxes->visible, capacity);
+        boxes->capacity = capacity;
+    }
+
+    int index = boxes->count++;
+
+    boxes->centerX[index] = center.x;
+    boxes->centerY[index] = center.y;
+    boxes->centerZ[index] = center.z;
+    boxes->extentX[index] = extent.x;
+    boxes->extentY[index] = extent.y;
+    boxes->extentZ[index] = extent.z;
+
+    return index;
+}
+
+// Sets visible[i] for every box. With frustumCulling off everything is visible.
+void CullBoxesAgainstFrustum(CullBoxes* boxes, const glm::vec4* planes)
+{
+    int count = boxes->count;
+
+    if (!frustumCulling) {
+        memset(boxes->visible, 1, count);
+        return;
+    }
+
+#ifdef FRUSTUM_CULL_SSE
+    // zero the padding lanes of the last group, their results are never read
+    int padded = (count + 3) & ~3;
+    for (int i = count; i < padded; ++i) {
+        boxes->centerX[i] = boxes->centerY[i] = boxes->centerZ[i] = 0.0f;
+        boxes->extentX[i] = boxes->extentY[i] = boxes->extentZ[i] = 0.0f;
+    }
+
+    __m128 zero = _mm_setzero_ps();
+
+    for (int i = 0; i < padded; i += 4) {
+        __m128 centerX = _mm_loadu_ps(boxes->centerX + i);
+        __m128 centerY = _mm_loadu_ps(boxes->centerY + i);
+        __m128 centerZ = _mm_loadu_ps(boxes->centerZ + i);
+        __m128 extentX = _mm_loadu_ps(boxes->extentX + i);
+        __m128 extentY = _mm_loadu_ps(boxes->extentY + i);
+        __m128 extentZ = _mm_loadu_ps(boxes->extentZ + i);
+
+        __m128 outside = zero;
+
+        for (int p = 0; p < 6; ++p) {
+            glm::vec4 plane = planes[p];
+
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, _mm_set1_ps(plane.x)), _mm_mul_ps(centerY, _mm_set1_ps(plane.y))),
+                _mm_add_ps(_mm_mul_ps(centerZ, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+            __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, _mm_set1_ps(fabsf(plane.x))), _mm_mul_ps(extentY, _mm_set1_ps(fabsf(plane.y)))),
+                _mm_mul_ps(extentZ, _mm_set1_ps(fabsf(plane.z))));
+
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(distance, radius), zero));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        int lanes = (count - i < 4) ? count - i : 4;
+
+        for (int lane = 0; lane < lanes; ++lane) {
+            boxes->visible[i + lane] = ((mask >> lane) & 1) == 0;
+        }
+    }
+#else
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 center(boxes->centerX[i], boxes->centerY[i], boxes->centerZ[i]);
+        glm::vec3 extent(boxes->extentX[i], boxes->extentY[i], boxes->extentZ[i]);
+
+        boxes->visible[i] = BoxInFrustum(center, extent, planes);
+    }
+#endif
+}
+
+bool ModelInFrustum(ModelBounds* bounds, glm::mat4 const& modelMatrix)
+{
+    if (!frustumCulling || bounds->animated) {
+        renderStats.modelsVisible++;
+        return true;
+    }
+
+    glm::vec3 center;
+    glm::vec3 extent;
+    TransformBounds(modelMatrix, bounds->min, bounds->max, &center, &extent);
+
+    if (BoxInFrustum(center, extent, renderView.frustum)) {
+        renderStats.modelsVisible++;
+        return true;
+    }
+
+    renderStats.modelsCulled++;
+    return false;
+}
+
+// billboard.vs divides by w and then adds pos.xy * screenScale, the quad has a
+// fixed size on screen. So the test is done in NDC on the projected position,
+// with the screen offset and the projected size of the model as the margin.
+bool BillboardInFrustum(ModelBounds* bounds, glm::vec3 position, glm::vec2 screenScale)
+{
+    if (!frustumCulling) {
+        renderStats.modelsVisible++;
+        return true;
+    }
+
+    glm::vec4 clip = renderView.projection * renderView.view * glm::vec4(position, 1.0f);
+
+    bool visible = false;
+
+    // behind the camera the divide mirrors the quad, nothing sensible to draw
+    if (clip.w > 0.0f) {
+        glm::vec3 extent = glm::max(glm::abs(bounds->min), glm::abs(bounds->max));
+        float projected = glm::length(extent) * glm::max(fabsf(renderView.projection[0][0]), fabsf(renderView.projection[1][1])) / clip.w;
+
+        float marginX = 1.0f + extent.x * screenScale.x + projected;
+        float marginY = 1.0f + extent.y * screenScale.y + projected;
+
+        visible = fabsf(clip.x / clip.w) <= marginX && fabsf(clip.y / clip.w) <= marginY;
+    }
+
+    if (visible) {
+        renderStats.modelsVisible++;
+    } else {
+        renderStats.modelsCulled++;
+    }
+    return visible;
+}
+
+#endif
@@ -10,6 +10,7 @@ opengl VA/texture binding functions
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#include <texture_registry.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -80,70 +81,11 @@ unsigned int gltf_load_texture(gltfTexture texture, int type, gltfSampler* gltf_
     char filename[FILENAME_MAX];
     sprintf(filename, "%s/%s", currentDirectory, image.m_URI);
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    // type 1-3 pick a single channel, done on the decode thread
+    TextureSettings settings = DefaultTextureSettings();
+    settings.channelOp = type;
 
-    int width, height, numChannels;
-    unsigned char* data = stbi_load(filename, &width, &height, &numChannels, 0);
-
-    if (data) {
-        GLenum format;
-        if (numChannels == 1)
-            format = GL_RED;
-        else if (numChannels == 3)
-            format = GL_RGB;
-        else if (numChannels == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-
-        if (type == 1) {
-            // metallness value in "blue" color channel
-            for (int i = 0; i < width * height * numChannels; i += numChannels) {
-                data[i] = data[i + 2];
-                data[i + 1] = data[i + 2];
-            }
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        } else if (type == 2) {
-            // roughness value in "green" color channel
-            for (int i = 0; i < width * height * numChannels; i += numChannels) {
-                data[i] = data[i + 1];
-                data[i + 2] = data[i + 1];
-            }
-
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-
-        } else if (type == 3) {
-            for (int i = 0; i < width * height * numChannels; i += numChannels) {
-                data[i + 1] = data[i];
-                data[i + 2] = data[i];
-            }
-
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        } else {
-            // Load the entire texture for other types (type = 0)
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        }
-
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-        // THESE IMPORTANT TO INCREASE TEXTURE QUALITY (from distance)
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 2.0f);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 2.0f);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        printf("Texture failed to load at path: %s\n", filename);
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    return AcquireTexture(filename, settings);
 }
 
 Material gltf_load_material(gltfMaterial gltf_material, gltfImage* gltf_images, gltfSampler* gltf_samplers, gltfTexture* textures)
@@ -4,6 +4,8 @@
 #include <GLFW/glfw3.h>
 #include <glad/glad.h>
 
+#include <texture_registry.h>
+
 unsigned int grid_texture_id;
 unsigned int grid_VAO;
 
@@ -69,8 +71,8 @@ unsigned int gridShader = createShader(filepath("/shaders/grid.vs"), filepath("/
 
 // Draw Grid, with instance array
         glUseProgram(gridShader);
-        setShaderMat4(gridShader, "projection", projection);
-        setShaderMat4(gridShader, "view", view);
+        setShaderMat4(gridShader, UNIFORM("projection"), projection);
+        setShaderMat4(gridShader, UNIFORM("view"), view);
         glBindVertexArray(grid_VAO);
         //glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
         glDrawArraysInstanced(GL_TRIANGLES, 0, 6, 100);
@@ -79,8 +81,6 @@ unsigned int gridShader = createShader(filepath("/shaders/grid.vs"), filepath("/
 
 void load_textured_grid(std::string grid_texture)
 {
-    const char* filename = grid_texture.c_str();
-
     float vertices[] = {
         // Position         // Texture Coords
         0.5f, 0.0f, 0.5f, 1.0f, 0.0f,
@@ -126,41 +126,7 @@ void load_textured_grid(std::string grid_texture)
     grid_VAO = VAO;
 
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename, &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-
-        // THESE IMPORTANt TO INCREASE TEXTURE QUALITY
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 2.0f);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 2.0f);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << grid_texture << std::endl;
-        stbi_image_free(data);
-    }
-
-    grid_texture_id = textureID;
+    grid_texture_id = AcquireTexture(grid_texture, DefaultTextureSettings());
 }
 
 
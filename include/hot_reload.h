@@ -0,0 +1,319 @@
+/*-------------------------------------------------------------------------------\
+hot_reload.h
+
+Functions:
+    Reloads assets while the viewer runs. InitHotReload watches resources/ and
+    shaders/, PollHotReload runs once per frame on the main thread and handles
+    every file that changed.
+
+    model       loaded again on a worker (the mesh cache misses because the
+                source changed) and swapped into the same Model by
+                ReplaceModelData, reusing its arena ranges where it still fits
+    texture     decoded again into the same OpenGL id (ReloadTexture)
+    shader      relinked into the same program (reloadShaderProgram), a
+                shader that doesn't compile keeps the old program
+    scene json  diffed against the live SceneNode tree (ReloadScene)
+
+    Linux uses inotify on every directory under the roots. Elsewhere, or if
+    inotify isn't available, the files that are actually loaded are polled for
+    a new modification time.
+
+    Editors save in several steps (truncate, write, rename), so a file is only
+    reloaded once it has been quiet for HOT_RELOAD_SETTLE seconds.
+
+\-------------------------------------------------------------------------------*/
+#ifndef HOT_RELOAD_H
+#define HOT_RELOAD_H
+
+#include <stdio.h>
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#define HOT_RELOAD_INOTIFY
+#endif
+
+#include <asset_manager.h>
+#include <dev_gui.h>
+#include <scene_graph.h>
+#include <shader_m.h>
+#include <texture_registry.h>
+
+// seconds a file has to stay unchanged before it is reloaded
+#define HOT_RELOAD_SETTLE 0.25
+// seconds between modification time checks when polling
+#define HOT_RELOAD_POLL_INTERVAL 1.0
+
+struct HotReload {
+    bool enabled;
+    std::vector<std::string> roots;
+
+    // changed path -> last time it changed
+    std::unordered_map<std::string, double> pending;
+
+    // -1 when polling
+    int inotifyFd;
+    std::unordered_map<int, std::string> watchDirs;
+
+    // polling, path -> last modification time seen
+    std::unordered_map<std::string, std::filesystem::file_time_type> mtimes;
+    double nextPoll;
+
+    int numReloads;
+};
+
+HotReload hotReload;
+
+void InitHotReload();
+void PollHotReload(double currentTime);
+void ShutdownHotReload();
+
+std::string HotReloadPath(std::string const& path);
+void WatchDirectoryTree(std::string const& root);
+void ReadWatchEvents(double currentTime);
+void PollWatchedFiles(double currentTime);
+void CheckFileTime(std::string const& path, double currentTime);
+bool ReloadChangedFile(std::string const& path);
+
+void InitHotReload()
+{
+    hotReload.enabled = true;
+    hotReload.inotifyFd = -1;
+    hotReload.nextPoll = 0.0;
+    hotReload.numReloads = 0;
+
+    hotReload.roots.push_back(HotReloadPath(filepath("/resources")));
+    hotReload.roots.push_back(HotReloadPath(filepath("/shaders")));
+
+#ifdef HOT_RELOAD_INOTIFY
+    hotReload.inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (hotReload.inotifyFd >= 0) {
+        for (size_t i = 0; i < hotReload.roots.size(); ++i) {
+            WatchDirectoryTree(hotReload.roots[i]);
+        }
+        printf("HotReload: watching %d directories\n", (int)hotReload.watchDirs.size());
+        return;
+    }
+
+    printf("HotReload: inotify_init1 failed (%d), polling instead\n", errno);
+#endif
+
+    printf("HotReload: polling loaded files every %.1f s\n", HOT_RELOAD_POLL_INTERVAL);
+}
+
+void ShutdownHotReload()
+{
+#ifdef HOT_RELOAD_INOTIFY
+    if (hotReload.inotifyFd >= 0) {
+        close(hotReload.inotifyFd);
+        hotReload.inotifyFd = -1;
+    }
+#endif
+    hotReload.enabled = false;
+}
+
+// NormalizePath, the key form of every loader, so their paths compare equal
+std::string HotReloadPath(std::string const& path)
+{
+    return NormalizePath(path);
+}
+
+void WatchDirectoryTree(std::string const& root)
+{
+#ifdef HOT_RELOAD_INOTIFY
+    std::vector<std::string> directories(1, root);
+
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(root, std::filesystem::directory_options::skip_permission_denied, error);
+    for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        if (it->is_directory(error)) {
+            directories.push_back(it->path().generic_string());
+        }
+    }
+
+    for (size_t i = 0; i < directories.size(); ++i) {
+        int wd = inotify_add_watch(hotReload.inotifyFd, directories[i].c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd >= 0) {
+            hotReload.watchDirs[wd] = directories[i];
+        }
+    }
+#endif
+}
+
+void ReadWatchEvents(double currentTime)
+{
+#ifdef HOT_RELOAD_INOTIFY
+    alignas(struct inotify_event) char buffer[4096];
+
+    while (true) {
+        ssize_t length = read(hotReload.inotifyFd, buffer, sizeof(buffer));
+        if (length <= 0) {
+            // EAGAIN, nothing left this frame
+            return;
+        }
+
+        for (char* ptr = buffer; ptr < buffer + length;) {
+            struct inotify_event* event = (struct inotify_event*)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            std::unordered_map<int, std::string>::iterator dir = hotReload.watchDirs.find(event->wd);
+            if (event->len == 0 || dir == hotReload.watchDirs.end()) {
+                continue;
+            }
+
+            std::string path = dir->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR) {
+                // a new folder of assets
+                WatchDirectoryTree(path);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                hotReload.pending[path] = currentTime;
+            }
+        }
+    }
+#endif
+}
+
+// Checks every file something has loaded
+void PollWatchedFiles(double currentTime)
+{
+    for (size_t i = 0; i < shaderPrograms.size(); ++i) {
+        CheckFileTime(shaderPrograms[i].vertexPath, currentTime);
+        CheckFileTime(shaderPrograms[i].fragmentPath, currentTime);
+    }
+
+    std::unordered_map<unsigned int, TextureEntry*>::iterator it;
+    for (it = textureRegistry.byId.begin(); it != textureRegistry.byId.end(); ++it) {
+        for (size_t i = 0; i < it->second->paths.size(); ++i) {
+            CheckFileTime(it->second->paths[i], currentTime);
+        }
+    }
+
+    for (size_t i = 0; i < assetManager.assets.size(); ++i) {
+        CheckFileTime(assetManager.assets[i]->path, currentTime);
+    }
+
+    if (!scenePath.empty()) {
+        CheckFileTime(scenePath, currentTime);
+    }
+}
+
+void CheckFileTime(std::string const& path, double currentTime)
+{
+    std::error_code error;
+    std::filesystem::file_time_type mtime = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return;
+    }
+
+    std::string key = HotReloadPath(path);
+
+    std::unordered_map<std::string, std::filesystem::file_time_type>::iterator found = hotReload.mtimes.find(key);
+    if (found == hotReload.mtimes.end()) {
+        hotReload.mtimes[key] = mtime;
+    } else if (found->second != mtime) {
+        found->second = mtime;
+        hotReload.pending[key] = currentTime;
+    }
+}
+
+// Main thread, once per frame
+void PollHotReload(double currentTime)
+{
+    if (!hotReload.enabled) {
+        return;
+    }
+
+    if (hotReload.inotifyFd >= 0) {
+        ReadWatchEvents(currentTime);
+    } else if (currentTime >= hotReload.nextPoll) {
+        PollWatchedFiles(currentTime);
+        hotReload.nextPoll = currentTime + HOT_RELOAD_POLL_INTERVAL;
+    }
+
+    std::unordered_map<std::string, double>::iterator it = hotReload.pending.begin();
+    while (it != hotReload.pending.end()) {
+        if (currentTime - it->second < HOT_RELOAD_SETTLE) {
+            ++it;
+            continue;
+        }
+
+        if (ReloadChangedFile(it->first)) {
+            it = hotReload.pending.erase(it);
+        } else {
+            // still loading, try again once it's done
+            it->second = currentTime;
+            ++it;
+        }
+    }
+}
+
+// Returns false if something using the file is still loading. Files nothing uses are ignored.
+bool ReloadChangedFile(std::string const& path)
+{
+    std::string key = HotReloadPath(path);
+    bool done = true;
+
+    for (size_t i = 0; i < shaderPrograms.size(); ++i) {
+        ShaderProgram* program = &shaderPrograms[i];
+
+        if (HotReloadPath(program->vertexPath) == key || HotReloadPath(program->fragmentPath) == key) {
+            printf("HotReload: shader %s\n", key.c_str());
+            reloadShaderProgram(program);
+            // the samplers are set again the next time DrawModelLod uses it
+            ForgetMaterialUniforms(program->id);
+            hotReload.numReloads++;
+        }
+    }
+
+    std::unordered_map<unsigned int, TextureEntry*>::iterator it;
+    for (it = textureRegistry.byId.begin(); it != textureRegistry.byId.end(); ++it) {
+        TextureEntry* entry = it->second;
+
+        for (size_t i = 0; i < entry->paths.size(); ++i) {
+            if (entry->paths[i] == key) {
+                if (ReloadTexture(entry)) {
+                    printf("HotReload: texture %s\n", key.c_str());
+                    hotReload.numReloads++;
+                } else {
+                    done = false;
+                }
+                break;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < assetManager.assets.size(); ++i) {
+        ModelAsset* asset = assetManager.assets[i];
+
+        if (HotReloadPath(asset->path) == key) {
+            if (ReloadModelAsync(asset)) {
+                printf("HotReload: model %s\n", key.c_str());
+                hotReload.numReloads++;
+            } else {
+                done = false;
+            }
+        }
+    }
+
+    if (!scenePath.empty() && HotReloadPath(scenePath) == key) {
+        printf("HotReload: scene %s\n", key.c_str());
+        ReloadScene(scenePath);
+        hotReload.numReloads++;
+
+        if (selectedNode != NULL && !SceneContainsNode(root_node, selectedNode)) {
+            selectedNode = NULL;
+        }
+    }
+
+    return done;
+}
+
+#endif
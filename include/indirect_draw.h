@@ -0,0 +1,281 @@
+/*-------------------------------------------------------------------------------\
+indirect_draw.h
+
+Functions:
+    Multi-draw indirect path for GL 4.3 contexts. The render queue turns every
+    run of packets that share a program, VAO and texture arrays into
+    DrawElementsIndirectCommands and submits the run with one
+    glMultiDrawElementsIndirect. The 4.1 path in render_queue.h stays for
+    contexts without it and when it's turned off in the dev gui.
+
+    Per draw data is in two shader storage buffers, binding 0 holds the model
+    matrix and material index of every draw, binding 1 the texture layer and
+    scale of every material (what materialLayers is on the 4.1 path). A draw
+    finds its entry through drawIndex, location 12, an attribute with divisor
+    1 over 0 1 2 3... so it reads the command's baseInstance plus the instance.
+    gl_DrawID would need GL 4.6 or ARB_shader_draw_parameters.
+
+    Nothing past 4.3 core is used (no bindless, no DSA, no persistent maps),
+    it runs on Mesa llvmpipe, LIBGL_ALWAYS_SOFTWARE=1 to try it without a GPU.
+
+    glad.h is generated for 4.1, InitIndirectDraw loads the one 4.3 function
+    once the context is current.
+
+\-------------------------------------------------------------------------------*/
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <stdio.h>
+
+#include <vector>
+
+#include <model_data.h>
+
+#ifndef GL_VERSION_4_3
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+typedef void (APIENTRYP PFNGLMULTIDRAWELEMENTSINDIRECTPROC)(GLenum mode, GLenum type, const void* indirect, GLsizei drawcount, GLsizei stride);
+PFNGLMULTIDRAWELEMENTSINDIRECTPROC glad_glMultiDrawElementsIndirect;
+#define glMultiDrawElementsIndirect glad_glMultiDrawElementsIndirect
+#endif
+
+#define INDIRECT_DRAW_ID_LOCATION 12
+#define INDIRECT_DRAW_BINDING 0
+#define INDIRECT_MATERIAL_BINDING 1
+#define INDIRECT_MIN_CAPACITY 256
+
+// layout GL reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// std430 DrawData in 6.multiple_lights_indirect.vs
+struct IndirectDrawData {
+    glm::mat4 model;
+    GLuint material;
+    GLuint padding[3];
+};
+
+// std430 MaterialData, (scale x, scale y, layer, 0) per texture type
+struct IndirectMaterial {
+    float layers[NUM_TEXTURE_TYPES][4];
+};
+
+struct IndirectProgram {
+    unsigned int program;
+    unsigned int indirect;
+};
+
+struct IndirectDrawBuffers {
+    GLuint commandBuffer;
+    GLuint drawBuffer;
+    GLuint materialBuffer;
+    // 0 1 2 3... for drawIndex
+    GLuint drawIdBuffer;
+
+    int commandCapacity;
+    int drawCapacity;
+    int materialCapacity;
+    int drawIdCapacity;
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<IndirectDrawData> draws;
+    std::vector<IndirectMaterial> materials;
+};
+
+IndirectDrawBuffers indirectDraw;
+std::vector<IndirectProgram> indirectPrograms;
+
+bool indirectDrawSupported = false;
+bool indirectDrawEnabled = true;
+
+void InitIndirectDraw(GLADloadproc load);
+bool IndirectDrawActive();
+void SetIndirectProgram(unsigned int program, unsigned int indirect);
+unsigned int FindIndirectProgram(unsigned int program);
+
+void BeginIndirectDraws();
+int AddIndirectMaterial(const float* layers);
+int AddIndirectDraw(const glm::mat4& model, int material);
+void AddIndirectCommand(GLuint count, GLuint instanceCount, GLuint firstIndex, GLint baseVertex, GLuint baseInstance);
+void UploadIndirectDraws();
+void BindIndirectDrawIds();
+void MultiDrawIndirect(GLenum indexType, int firstCommand, int numCommands);
+
+void UploadIndirectBuffer(GLenum target, GLuint* buffer, int* capacity, const void* data, int count, size_t elementSize);
+
+// After gladLoadGLLoader, with the context current
+void InitIndirectDraw(GLADloadproc load)
+{
+    indirectDrawSupported = false;
+
+    if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 3)) {
+#ifndef GL_VERSION_4_3
+        glad_glMultiDrawElementsIndirect = (PFNGLMULTIDRAWELEMENTSINDIRECTPROC)load("glMultiDrawElementsIndirect");
+#endif
+        indirectDrawSupported = glMultiDrawElementsIndirect != NULL;
+    }
+
+    printf("IndirectDraw: OpenGL %d.%d, multi-draw indirect %s\n", GLVersion.major, GLVersion.minor,
+        indirectDrawSupported ? "available" : "not available, using the 4.1 path");
+}
+
+bool IndirectDrawActive()
+{
+    return indirectDrawSupported && indirectDrawEnabled;
+}
+
+void SetIndirectProgram(unsigned int program, unsigned int indirect)
+{
+    for (size_t i = 0; i < indirectPrograms.size(); ++i) {
+        if (indirectPrograms[i].program == program) {
+            indirectPrograms[i].indirect = indirect;
+            return;
+        }
+    }
+    indirectPrograms.push_back({ program, indirect });
+}
+
+// 0 if the program can't draw indirect
+unsigned int FindIndirectProgram(unsigned int program)
+{
+    for (size_t i = 0; i < indirectPrograms.size(); ++i) {
+        if (indirectPrograms[i].program == program) {
+            return indirectPrograms[i].indirect;
+        }
+    }
+    return 0;
+}
+
+void BeginIndirectDraws()
+{
+    indirectDraw.commands.clear();
+    indirectDraw.draws.clear();
+    indirectDraw.materials.clear();
+}
+
+// layers is the vec3 per texture type of MeshMaterial
+int AddIndirectMaterial(const float* layers)
+{
+    IndirectMaterial material;
+
+    for (int i = 0; i < NUM_TEXTURE_TYPES; ++i) {
+        material.layers[i][0] = layers[i * 3 + 0];
+        material.layers[i][1] = layers[i * 3 + 1];
+        material.layers[i][2] = layers[i * 3 + 2];
+        material.layers[i][3] = 0.0f;
+    }
+
+    indirectDraw.materials.push_back(material);
+    return (int)indirectDraw.materials.size() - 1;
+}
+
+// Returns the draw index, the baseInstance of its command
+int AddIndirectDraw(const glm::mat4& model, int material)
+{
+    IndirectDrawData draw;
+    draw.model = model;
+    draw.material = (GLuint)material;
+    draw.padding[0] = draw.padding[1] = draw.padding[2] = 0;
+
+    indirectDraw.draws.push_back(draw);
+    return (int)indirectDraw.draws.size() - 1;
+}
+
+// firstIndex in indices, not bytes
+void AddIndirectCommand(GLuint count, GLuint instanceCount, GLuint firstIndex, GLint baseVertex, GLuint baseInstance)
+{
+    DrawElementsIndirectCommand command = { count, instanceCount, firstIndex, baseVertex, baseInstance };
+    indirectDraw.commands.push_back(command);
+}
+
+// Once per frame, after the render queue is batched and before it's submitted
+void UploadIndirectDraws()
+{
+    if (indirectDraw.commands.empty()) {
+        return;
+    }
+
+    int numDraws = (int)indirectDraw.draws.size();
+
+    UploadIndirectBuffer(GL_DRAW_INDIRECT_BUFFER, &indirectDraw.commandBuffer, &indirectDraw.commandCapacity,
+        indirectDraw.commands.data(), (int)indirectDraw.commands.size(), sizeof(DrawElementsIndirectCommand));
+    UploadIndirectBuffer(GL_SHADER_STORAGE_BUFFER, &indirectDraw.drawBuffer, &indirectDraw.drawCapacity,
+        indirectDraw.draws.data(), numDraws, sizeof(IndirectDrawData));
+    UploadIndirectBuffer(GL_SHADER_STORAGE_BUFFER, &indirectDraw.materialBuffer, &indirectDraw.materialCapacity,
+        indirectDraw.materials.data(), (int)indirectDraw.materials.size(), sizeof(IndirectMaterial));
+
+    // the ids never change, only grow
+    if (numDraws > indirectDraw.drawIdCapacity) {
+        int capacity = (indirectDraw.drawIdCapacity > 0) ? indirectDraw.drawIdCapacity : INDIRECT_MIN_CAPACITY;
+        while (capacity < numDraws) {
+            capacity *= 2;
+        }
+
+        std::vector<GLuint> ids(capacity);
+        for (int i = 0; i < capacity; ++i) {
+            ids[i] = (GLuint)i;
+        }
+
+        if (indirectDraw.drawIdBuffer == 0) {
+            glGenBuffers(1, &indirectDraw.drawIdBuffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, indirectDraw.drawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)capacity * sizeof(GLuint), ids.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        indirectDraw.drawIdCapacity = capacity;
+    }
+}
+
+// Orphans the buffer and grows it by doubling, like instancing.h
+void UploadIndirectBuffer(GLenum target, GLuint* buffer, int* capacity, const void* data, int count, size_t elementSize)
+{
+    if (*buffer == 0) {
+        glGenBuffers(1, buffer);
+    }
+
+    if (count > *capacity) {
+        int newCapacity = (*capacity > 0) ? *capacity : INDIRECT_MIN_CAPACITY;
+        while (newCapacity < count) {
+            newCapacity *= 2;
+        }
+        *capacity = newCapacity;
+    }
+
+    glBindBuffer(target, *buffer);
+    glBufferData(target, (size_t)*capacity * elementSize, NULL, GL_STREAM_DRAW);
+    glBufferSubData(target, 0, (size_t)count * elementSize, data);
+    glBindBuffer(target, 0);
+}
+
+// The VAO has to be bound. Location 12 stays enabled in it.
+void BindIndirectDrawIds()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, indirectDraw.drawIdBuffer);
+    glEnableVertexAttribArray(INDIRECT_DRAW_ID_LOCATION);
+    glVertexAttribIPointer(INDIRECT_DRAW_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(INDIRECT_DRAW_ID_LOCATION, 1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// The program and VAO have to be bound
+void MultiDrawIndirect(GLenum indexType, int firstCommand, int numCommands)
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_DRAW_BINDING, indirectDraw.drawBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDIRECT_MATERIAL_BINDING, indirectDraw.materialBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectDraw.commandBuffer);
+
+    glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (void*)((size_t)firstCommand * sizeof(DrawElementsIndirectCommand)),
+        numCommands, sizeof(DrawElementsIndirectCommand));
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*-------------------------------------------------------------------------------\
+instancing.h
+
+Functions:
+    Model matrices of instanced draws. A scene that places the same model many
+    times draws each of its meshes once with glDrawElementsInstancedBaseVertex,
+    the matrices come from a vertex attribute that advances per instance.
+
+    BeginInstances empties the CPU copy, AddInstances appends a batch and
+    returns its first instance, UploadInstances sends the frame in one
+    glBufferSubData (orphaned like bone_palette.h). BindInstanceAttributes
+    points locations 8-11 of the bound VAO at a batch, GL 4.1 has no base
+    instance so the pointer offset does it instead.
+
+    A program only draws instanced if SetInstancedProgram gave it a variant
+    that reads "layout (location = 8) in mat4 model" instead of the uniform.
+    6.multiple_lights_instanced.vs and hitbox_instanced.vs are the ones main.cpp
+    makes. Every other uniform has to be set on the variant as well.
+
+\-------------------------------------------------------------------------------*/
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// a mat4 takes 4 locations, 8 to 11
+#define INSTANCE_MATRIX_LOCATION 8
+#define INSTANCE_MIN_CAPACITY 256
+
+// fewer copies than this draw one by one, they keep cluster culling
+#define INSTANCING_MIN_COUNT 2
+
+struct InstanceBuffer {
+    GLuint buffer;
+    // matrices the buffer storage holds
+    int capacity;
+
+    std::vector<glm::mat4> matrices;
+};
+
+struct InstancedProgram {
+    unsigned int program;
+    unsigned int instanced;
+};
+
+InstanceBuffer instanceBuffer;
+std::vector<InstancedProgram> instancedPrograms;
+bool instancingEnabled = true;
+
+void SetInstancedProgram(unsigned int program, unsigned int instanced);
+unsigned int FindInstancedProgram(unsigned int program);
+void BeginInstances();
+int AddInstances(const glm::mat4* matrices, int count);
+int AddInstance(const glm::mat4& matrix);
+void UploadInstances();
+void BindInstanceAttributes(int firstInstance);
+
+void SetInstancedProgram(unsigned int program, unsigned int instanced)
+{
+    for (size_t i = 0; i < instancedPrograms.size(); ++i) {
+        if (instancedPrograms[i].program == program) {
+            instancedPrograms[i].instanced = instanced;
+            return;
+        }
+    }
+    instancedPrograms.push_back({ program, instanced });
+}
+
+// 0 if the program has no instanced variant
+unsigned int FindInstancedProgram(unsigned int program)
+{
+    for (size_t i = 0; i < instancedPrograms.size(); ++i) {
+        if (instancedPrograms[i].program == program) {
+            return instancedPrograms[i].instanced;
+        }
+    }
+    return 0;
+}
+
+void BeginInstances()
+{
+    instanceBuffer.matrices.clear();
+}
+
+// Returns the first instance of the batch, for BindInstanceAttributes
+int AddInstances(const glm::mat4* matrices, int count)
+{
+    int first = (int)instanceBuffer.matrices.size();
+    instanceBuffer.matrices.insert(instanceBuffer.matrices.end(), matrices, matrices + count);
+    return first;
+}
+
+int AddInstance(const glm::mat4& matrix)
+{
+    instanceBuffer.matrices.push_back(matrix);
+    return (int)instanceBuffer.matrices.size() - 1;
+}
+
+// Once per frame, after every AddInstances and before the instanced draws
+void UploadInstances()
+{
+    int count = (int)instanceBuffer.matrices.size();
+
+    if (count == 0) {
+        return;
+    }
+
+    if (instanceBuffer.buffer == 0) {
+        glGenBuffers(1, &instanceBuffer.buffer);
+    }
+
+    if (count > instanceBuffer.capacity) {
+        int capacity = (instanceBuffer.capacity > 0) ? instanceBuffer.capacity : INSTANCE_MIN_CAPACITY;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        instanceBuffer.capacity = capacity;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.buffer);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)instanceBuffer.capacity * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, (size_t)count * sizeof(glm::mat4), instanceBuffer.matrices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// The VAO has to be bound. Leaves locations 8-11 enabled in it, shaders
+// without them ignore the attribute.
+void BindInstanceAttributes(int firstInstance)
+{
+    size_t offset = (size_t)firstInstance * sizeof(glm::mat4);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer.buffer);
+
+    for (int column = 0; column < 4; ++column) {
+        GLuint location = INSTANCE_MATRIX_LOCATION + column;
+
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+#endif
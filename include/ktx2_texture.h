@@ -0,0 +1,462 @@
+/*-------------------------------------------------------------------------------\
+ktx2_texture.h
+
+Functions:
+    Block compressed textures in a KTX2 container, written next to the source
+    image as <source>.ktx2 by the asset baker (texture_compress.h encodes them).
+    texture_loader.h uploads every level with glCompressedTexImage2D.
+
+    Only what the baker writes is read back: one 2D image, no supercompression,
+    BC1, BC4, BC5 or BC7 with the whole mip chain.
+
+    Key/value data:
+        AVsource        "<mtime> <size> <content hash>" of the source image,
+                        checked the same way as mesh_cache.h
+        KTXorientation  "ru" when the rows were flipped for OpenGL (bottom row
+                        first, what TextureFromFile asks for), "rd" otherwise
+        KTXwriter
+
+Layout (little endian, KTX 2.0):
+    Ktx2Header
+    Ktx2LevelIndex  level 0 first
+    data format descriptor
+    key/value data
+    levels          smallest first, each aligned to its block size
+
+\-------------------------------------------------------------------------------*/
+#ifndef KTX2_TEXTURE_H
+#define KTX2_TEXTURE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <mapped_file.h>
+
+#define KTX2_EXTENSION ".ktx2"
+#define KTX2_MAX_LEVELS 16
+
+// VkFormat values
+#define KTX2_BC1_RGB_UNORM 131
+#define KTX2_BC1_RGB_SRGB 132
+#define KTX2_BC4_UNORM 139
+#define KTX2_BC5_UNORM 141
+#define KTX2_BC7_UNORM 145
+#define KTX2_BC7_SRGB 146
+
+const unsigned char Ktx2Identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+struct Ktx2Header {
+    unsigned char identifier[12];
+    unsigned int vkFormat;
+    unsigned int typeSize;
+    unsigned int pixelWidth;
+    unsigned int pixelHeight;
+    unsigned int pixelDepth;
+    unsigned int layerCount;
+    unsigned int faceCount;
+    unsigned int levelCount;
+    unsigned int supercompressionScheme;
+
+    unsigned int dfdByteOffset;
+    unsigned int dfdByteLength;
+    unsigned int kvdByteOffset;
+    unsigned int kvdByteLength;
+    unsigned long long sgdByteOffset;
+    unsigned long long sgdByteLength;
+};
+
+struct Ktx2LevelIndex {
+    unsigned long long byteOffset;
+    unsigned long long byteLength;
+    unsigned long long uncompressedByteLength;
+};
+
+// What ReadKtx2Texture found, the level pointers are into the mapping
+struct Ktx2Texture {
+    unsigned int vkFormat;
+    int width;
+    int height;
+    int numLevels;
+    int blockBytes;
+    // KTXorientation "ru"
+    bool flipped;
+    unsigned long long contentHash;
+
+    const unsigned char* levels[KTX2_MAX_LEVELS];
+    size_t levelBytes[KTX2_MAX_LEVELS];
+};
+
+std::string Ktx2Path(std::string const& path);
+int Ktx2BlockBytes(unsigned int vkFormat);
+bool Ktx2IsSrgb(unsigned int vkFormat);
+const char* Ktx2FormatName(unsigned int vkFormat);
+size_t CompressedLevelBytes(int width, int height, int blockBytes, int level);
+
+bool WriteKtx2Texture(std::string const& path, unsigned int vkFormat, int width, int height, bool flipped,
+    std::vector<std::vector<unsigned char> > const& levels);
+MappedFile* ReadKtx2Texture(std::string const& path, Ktx2Texture* texture);
+
+void Ktx2WriteDFD(std::vector<unsigned char>& out, unsigned int vkFormat);
+void Ktx2WriteKeyValue(std::vector<unsigned char>& out, const char* key, std::string const& value);
+bool Ktx2FindKeyValue(const unsigned char* kvd, size_t length, const char* key, std::string* value);
+void Ktx2Append(std::vector<unsigned char>& out, const void* data, size_t size);
+void Ktx2Align(std::vector<unsigned char>& out, size_t alignment);
+
+std::string Ktx2Path(std::string const& path)
+{
+    return path + KTX2_EXTENSION;
+}
+
+// 0 for anything the baker doesn't write
+int Ktx2BlockBytes(unsigned int vkFormat)
+{
+    switch (vkFormat) {
+    case KTX2_BC1_RGB_UNORM:
+    case KTX2_BC1_RGB_SRGB:
+    case KTX2_BC4_UNORM:
+        return 8;
+    case KTX2_BC5_UNORM:
+    case KTX2_BC7_UNORM:
+    case KTX2_BC7_SRGB:
+        return 16;
+    }
+    return 0;
+}
+
+bool Ktx2IsSrgb(unsigned int vkFormat)
+{
+    return vkFormat == KTX2_BC1_RGB_SRGB || vkFormat == KTX2_BC7_SRGB;
+}
+
+const char* Ktx2FormatName(unsigned int vkFormat)
+{
+    switch (vkFormat) {
+    case KTX2_BC1_RGB_UNORM:
+    case KTX2_BC1_RGB_SRGB:
+        return "BC1";
+    case KTX2_BC4_UNORM:
+        return "BC4";
+    case KTX2_BC5_UNORM:
+        return "BC5";
+    case KTX2_BC7_UNORM:
+    case KTX2_BC7_SRGB:
+        return "BC7";
+    }
+    return "?";
+}
+
+// 4x4 blocks, a level smaller than a block still takes a whole one
+size_t CompressedLevelBytes(int width, int height, int blockBytes, int level)
+{
+    for (int i = 0; i < level; ++i) {
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+void Ktx2Append(std::vector<unsigned char>& out, const void* data, size_t size)
+{
+    out.insert(out.end(), (const unsigned char*)data, (const unsigned char*)data + size);
+}
+
+void Ktx2Align(std::vector<unsigned char>& out, size_t alignment)
+{
+    while (out.size() % alignment != 0) {
+        out.push_back(0);
+    }
+}
+
+// Basic descriptor block, one sample per 64 bit half of the block
+void Ktx2WriteDFD(std::vector<unsigned char>& out, unsigned int vkFormat)
+{
+    // KHR_DF_MODEL_BC1A, BC4, BC5, BC7
+    unsigned int colorModel;
+    int numSamples = 1;
+
+    if (vkFormat == KTX2_BC1_RGB_UNORM || vkFormat == KTX2_BC1_RGB_SRGB) {
+        colorModel = 128;
+    } else if (vkFormat == KTX2_BC4_UNORM) {
+        colorModel = 131;
+    } else if (vkFormat == KTX2_BC5_UNORM) {
+        colorModel = 132;
+        numSamples = 2;
+    } else {
+        colorModel = 134;
+    }
+
+    int blockBytes = Ktx2BlockBytes(vkFormat);
+    unsigned int blockSize = 24 + 16 * numSamples;
+
+    unsigned int words[6];
+    words[0] = 4 + blockSize;
+    // vendor 0 (Khronos), descriptor type 0
+    words[1] = 0;
+    // version 2
+    words[2] = 2 | (blockSize << 16);
+    // BT.709 primaries, sRGB or linear transfer, straight alpha
+    words[3] = colorModel | (1 << 8) | ((Ktx2IsSrgb(vkFormat) ? 2u : 1u) << 16);
+    // 4x4x1x1 texels, stored as size - 1
+    words[4] = 3 | (3 << 8);
+    // bytes in plane 0
+    words[5] = (unsigned int)blockBytes;
+
+    Ktx2Append(out, words, sizeof(words));
+
+    unsigned int plane1 = 0;
+    Ktx2Append(out, &plane1, sizeof(plane1));
+
+    for (int i = 0; i < numSamples; ++i) {
+        unsigned int bitLength = (blockBytes * 8) / numSamples;
+
+        unsigned int sample[4];
+        // bit offset, bit length - 1, channel (BC5 red then green, the others 0)
+        sample[0] = (unsigned int)(i * bitLength) | ((bitLength - 1) << 16) | ((unsigned int)i << 24);
+        sample[1] = 0;
+        sample[2] = 0;
+        sample[3] = 0xFFFFFFFF;
+
+        Ktx2Append(out, sample, sizeof(sample));
+    }
+}
+
+void Ktx2WriteKeyValue(std::vector<unsigned char>& out, const char* key, std::string const& value)
+{
+    unsigned int length = (unsigned int)(strlen(key) + 1 + value.size() + 1);
+
+    Ktx2Append(out, &length, sizeof(length));
+    Ktx2Append(out, key, strlen(key) + 1);
+    Ktx2Append(out, value.c_str(), value.size() + 1);
+    Ktx2Align(out, 4);
+}
+
+bool Ktx2FindKeyValue(const unsigned char* kvd, size_t length, const char* key, std::string* value)
+{
+    size_t offset = 0;
+    size_t keyLength = strlen(key) + 1;
+
+    while (offset + 4 <= length) {
+        unsigned int entryLength;
+        memcpy(&entryLength, kvd + offset, 4);
+        offset += 4;
+
+        if (entryLength > length - offset) {
+            return false;
+        }
+
+        const char* entry = (const char*)kvd + offset;
+        if (entryLength > keyLength && memcmp(entry, key, keyLength) == 0) {
+            // the value is NUL terminated, but don't trust it
+            size_t valueLength = entryLength - keyLength;
+            while (valueLength > 0 && entry[keyLength + valueLength - 1] == '\0') {
+                valueLength--;
+            }
+            value->assign(entry + keyLength, valueLength);
+            return true;
+        }
+
+        offset += (entryLength + 3) & ~3u;
+    }
+    return false;
+}
+
+// levels[0] is the full size image. Stamped with the source so a stale file is ignored.
+bool WriteKtx2Texture(std::string const& path, unsigned int vkFormat, int width, int height, bool flipped,
+    std::vector<std::vector<unsigned char> > const& levels)
+{
+    int blockBytes = Ktx2BlockBytes(vkFormat);
+    int numLevels = (int)levels.size();
+
+    if (blockBytes == 0 || numLevels < 1 || numLevels > KTX2_MAX_LEVELS) {
+        return false;
+    }
+
+    long long mtime;
+    unsigned long long size;
+    if (!GetSourceStamp(path, &mtime, &size)) {
+        return false;
+    }
+
+    bool hashed;
+    unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+    if (!hashed) {
+        return false;
+    }
+
+    std::vector<unsigned char> dfd;
+    Ktx2WriteDFD(dfd, vkFormat);
+
+    char stamp[64];
+    snprintf(stamp, sizeof(stamp), "%lld %llu %016llx", mtime, size, hash);
+
+    // keys sorted by their bytes, as the spec asks
+    std::vector<unsigned char> kvd;
+    Ktx2WriteKeyValue(kvd, "AVsource", stamp);
+    Ktx2WriteKeyValue(kvd, "KTXorientation", flipped ? "ru" : "rd");
+    Ktx2WriteKeyValue(kvd, "KTXwriter", "assimp_viewer asset_baker");
+
+    Ktx2Header header;
+    memcpy(header.identifier, Ktx2Identifier, sizeof(Ktx2Identifier));
+    header.vkFormat = vkFormat;
+    header.typeSize = 1;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.pixelDepth = 0;
+    header.layerCount = 0;
+    header.faceCount = 1;
+    header.levelCount = numLevels;
+    header.supercompressionScheme = 0;
+
+    header.dfdByteOffset = (unsigned int)(sizeof(Ktx2Header) + numLevels * sizeof(Ktx2LevelIndex));
+    header.dfdByteLength = (unsigned int)dfd.size();
+    header.kvdByteOffset = header.dfdByteOffset + header.dfdByteLength;
+    header.kvdByteLength = (unsigned int)kvd.size();
+    header.sgdByteOffset = 0;
+    header.sgdByteLength = 0;
+
+    std::vector<unsigned char> file;
+    file.resize(sizeof(Ktx2Header) + numLevels * sizeof(Ktx2LevelIndex));
+    Ktx2Append(file, dfd.data(), dfd.size());
+    Ktx2Append(file, kvd.data(), kvd.size());
+
+    std::vector<Ktx2LevelIndex> index(numLevels);
+
+    for (int level = numLevels - 1; level >= 0; --level) {
+        if (levels[level].size() != CompressedLevelBytes(width, height, blockBytes, level)) {
+            return false;
+        }
+
+        Ktx2Align(file, blockBytes);
+
+        index[level].byteOffset = file.size();
+        index[level].byteLength = levels[level].size();
+        index[level].uncompressedByteLength = levels[level].size();
+
+        Ktx2Append(file, levels[level].data(), levels[level].size());
+    }
+
+    memcpy(file.data(), &header, sizeof(header));
+    memcpy(file.data() + sizeof(header), index.data(), numLevels * sizeof(Ktx2LevelIndex));
+
+    // Written under a name of this process and thread and renamed once closed,
+    // so a reader never maps a half written file
+    std::string ktxPath = Ktx2Path(path);
+    std::string tempPath = TempFilePath(ktxPath);
+
+    FILE* out = fopen(tempPath.c_str(), "wb");
+    if (out == NULL) {
+        std::cout << "KTX2:: could not create " << tempPath << std::endl;
+        return false;
+    }
+
+    bool written = fwrite(file.data(), 1, file.size(), out) == file.size();
+    written = (fclose(out) == 0) && written;
+
+    if (!written) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, ktxPath, error);
+    if (error) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Returns NULL if there is no .ktx2, it is stale or not something the baker wrote
+MappedFile* ReadKtx2Texture(std::string const& path, Ktx2Texture* texture)
+{
+    long long mtime;
+    unsigned long long size;
+    if (!GetSourceStamp(path, &mtime, &size)) {
+        return NULL;
+    }
+
+    MappedFile* mapping = MapFile(Ktx2Path(path).c_str());
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    Ktx2Header header;
+    bool valid = mapping->size >= sizeof(Ktx2Header);
+
+    if (valid) {
+        memcpy(&header, mapping->data, sizeof(Ktx2Header));
+
+        valid = memcmp(header.identifier, Ktx2Identifier, sizeof(Ktx2Identifier)) == 0
+            && Ktx2BlockBytes(header.vkFormat) != 0
+            && header.pixelWidth > 0 && header.pixelHeight > 0 && header.pixelDepth == 0
+            && header.layerCount == 0 && header.faceCount == 1 && header.supercompressionScheme == 0
+            && header.levelCount >= 1 && header.levelCount <= KTX2_MAX_LEVELS
+            && sizeof(Ktx2Header) + header.levelCount * sizeof(Ktx2LevelIndex) <= mapping->size
+            && header.kvdByteOffset <= mapping->size && header.kvdByteLength <= mapping->size - header.kvdByteOffset;
+    }
+
+    if (valid) {
+        texture->vkFormat = header.vkFormat;
+        texture->width = (int)header.pixelWidth;
+        texture->height = (int)header.pixelHeight;
+        texture->numLevels = (int)header.levelCount;
+        texture->blockBytes = Ktx2BlockBytes(header.vkFormat);
+
+        const Ktx2LevelIndex* index = (const Ktx2LevelIndex*)(mapping->data + sizeof(Ktx2Header));
+
+        for (int level = 0; level < texture->numLevels && valid; ++level) {
+            Ktx2LevelIndex entry;
+            memcpy(&entry, &index[level], sizeof(entry));
+
+            size_t expected = CompressedLevelBytes(texture->width, texture->height, texture->blockBytes, level);
+
+            valid = entry.byteLength == expected && entry.byteOffset <= mapping->size
+                && entry.byteLength <= mapping->size - entry.byteOffset;
+
+            texture->levels[level] = mapping->data + entry.byteOffset;
+            texture->levelBytes[level] = expected;
+        }
+    }
+
+    std::string stamp;
+    std::string orientation;
+
+    if (valid) {
+        const unsigned char* kvd = mapping->data + header.kvdByteOffset;
+
+        valid = Ktx2FindKeyValue(kvd, header.kvdByteLength, "AVsource", &stamp)
+            && Ktx2FindKeyValue(kvd, header.kvdByteLength, "KTXorientation", &orientation);
+    }
+
+    long long sourceMtime = 0;
+    unsigned long long sourceSize = 0;
+
+    if (valid) {
+        valid = sscanf(stamp.c_str(), "%lld %llu %llx", &sourceMtime, &sourceSize, &texture->contentHash) == 3
+            && sourceSize == size;
+        texture->flipped = orientation.compare(0, 2, "ru") == 0;
+    }
+
+    // Same size but touched since the file was written, check the contents
+    if (valid && sourceMtime != mtime) {
+        bool hashed;
+        unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+        valid = hashed && hash == texture->contentHash;
+    }
+
+    if (!valid) {
+        UnmapFile(mapping);
+        return NULL;
+    }
+
+    return mapping;
+}
+
+#endif
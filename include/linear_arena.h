@@ -0,0 +1,150 @@
+/*-------------------------------------------------------------------------------\
+linear_arena.h
+
+Functions:
+    Bump allocator for data that is created together and freed together. Each
+    Model keeps its CPU side (meshes, texture paths, skeleton, animations) in
+    one, so unloading it is a single FreeLinearArena.
+
+    InitLinearArena allocates the first block. Size it with a pre-pass, adding
+    ArenaBytes for every allocation, and everything fits in that one block.
+    Anything that doesn't fit goes into an extra block, nothing is ever moved.
+
+    Allocations can't be freed one by one.
+
+\-------------------------------------------------------------------------------*/
+#ifndef LINEAR_ARENA_H
+#define LINEAR_ARENA_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_ALIGNMENT 16
+// smallest extra block, when the pre-pass was short
+#define ARENA_MIN_EXTRA_BLOCK (16 * 1024)
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    size_t size;
+    size_t used;
+};
+
+struct LinearArena {
+    ArenaBlock* first;
+    ArenaBlock* current;
+
+    // bytes handed out, including alignment padding
+    size_t used;
+    int numBlocks;
+};
+
+void InitLinearArena(LinearArena* arena, size_t size);
+void FreeLinearArena(LinearArena* arena);
+
+void* ArenaAlloc(LinearArena* arena, size_t size);
+void* ArenaCopy(LinearArena* arena, const void* data, size_t size);
+char* ArenaCopyString(LinearArena* arena, const char* str);
+
+size_t ArenaBytes(size_t size);
+size_t ArenaStringBytes(const char* str);
+
+template <typename T>
+T* ArenaAllocArray(LinearArena* arena, size_t count)
+{
+    return (T*)ArenaAlloc(arena, count * sizeof(T));
+}
+
+// What ArenaAlloc(size) takes from a block, for sizing pre-passes
+size_t ArenaBytes(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+size_t ArenaStringBytes(const char* str)
+{
+    return (str != NULL) ? ArenaBytes(strlen(str) + 1) : 0;
+}
+
+ArenaBlock* CreateArenaBlock(size_t size)
+{
+    // the header is padded so the first allocation is aligned too
+    ArenaBlock* block = (ArenaBlock*)malloc(ArenaBytes(sizeof(ArenaBlock)) + size);
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void InitLinearArena(LinearArena* arena, size_t size)
+{
+    arena->first = (size > 0) ? CreateArenaBlock(size) : NULL;
+    arena->current = arena->first;
+    arena->used = 0;
+    arena->numBlocks = (size > 0) ? 1 : 0;
+}
+
+void FreeLinearArena(LinearArena* arena)
+{
+    ArenaBlock* block = arena->first;
+    while (block != NULL) {
+        ArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->used = 0;
+    arena->numBlocks = 0;
+}
+
+// 16 byte aligned. Returns NULL for size 0.
+void* ArenaAlloc(LinearArena* arena, size_t size)
+{
+    if (size == 0) {
+        return NULL;
+    }
+
+    size = ArenaBytes(size);
+
+    ArenaBlock* block = arena->current;
+
+    if (block == NULL || block->size - block->used < size) {
+        size_t blockSize = (size > ARENA_MIN_EXTRA_BLOCK) ? size : ARENA_MIN_EXTRA_BLOCK;
+        ArenaBlock* extra = CreateArenaBlock(blockSize);
+
+        if (block == NULL) {
+            arena->first = extra;
+        } else {
+            block->next = extra;
+        }
+        arena->current = extra;
+        arena->numBlocks++;
+        block = extra;
+    }
+
+    void* ptr = (unsigned char*)block + ArenaBytes(sizeof(ArenaBlock)) + block->used;
+    block->used += size;
+    arena->used += size;
+
+    return ptr;
+}
+
+void* ArenaCopy(LinearArena* arena, const void* data, size_t size)
+{
+    void* copy = ArenaAlloc(arena, size);
+    if (copy != NULL) {
+        memcpy(copy, data, size);
+    }
+    return copy;
+}
+
+char* ArenaCopyString(LinearArena* arena, const char* str)
+{
+    if (str == NULL) {
+        return NULL;
+    }
+    return (char*)ArenaCopy(arena, str, strlen(str) + 1);
+}
+
+#endif
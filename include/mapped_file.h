@@ -0,0 +1,229 @@
+/*-------------------------------------------------------------------------------\
+mapped_file.h
+
+Functions:
+    Map a whole file read-only into memory and unmap it again.
+    Windows uses CreateFileMapping, everything else uses mmap.
+
+    64 bit FNV-1a hash of a byte range, used to key cached files by content.
+    HashFileContents and GetSourceStamp are what every cache file (mesh_cache.h,
+    texture_cache.h, collider_cache.h) checks its source against.
+
+    NormalizePath is the one key form for paths, the texture registry, the
+    asset manager and hot reload all compare files by it.
+
+    TempFilePath names the file a cache is written to before it is renamed
+    over the real one. It holds the process and thread id, so the baker and
+    the viewer, or two bakers, writing the same cache never share one.
+
+\-------------------------------------------------------------------------------*/
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct MappedFile {
+    const unsigned char* data;
+    size_t size;
+
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+};
+
+#define FNV1A_64_OFFSET 14695981039346656037ULL
+#define FNV1A_64_PRIME 1099511628211ULL
+
+MappedFile* MapFile(const char* path);
+void UnmapFile(MappedFile* mappedFile);
+
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long hash);
+unsigned long long HashFileContents(const char* path, bool* ok);
+bool GetSourceStamp(std::string const& path, long long* mtime, unsigned long long* size);
+std::string NormalizePath(std::string const& path);
+std::string TempFilePath(std::string const& path);
+
+// Pass FNV1A_64_OFFSET to start a new hash, or a previous result to continue it
+unsigned long long HashBytes(const void* data, size_t size, unsigned long long hash)
+{
+    const unsigned char* bytes = (const unsigned char*)data;
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV1A_64_PRIME;
+    }
+
+    return hash;
+}
+
+// 64 bit FNV-1a over the whole file
+unsigned long long HashFileContents(const char* path, bool* ok)
+{
+    unsigned long long hash = FNV1A_64_OFFSET;
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        *ok = false;
+        return 0;
+    }
+
+    unsigned char buffer[64 * 1024];
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        hash = HashBytes(buffer, bytesRead, hash);
+    }
+
+    fclose(file);
+
+    *ok = true;
+    return hash;
+}
+
+bool GetSourceStamp(std::string const& path, long long* mtime, unsigned long long* size)
+{
+    std::error_code error;
+
+    std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+    if (error) {
+        return false;
+    }
+
+    uintmax_t fileSize = std::filesystem::file_size(path, error);
+    if (error) {
+        return false;
+    }
+
+    *mtime = (long long)writeTime.time_since_epoch().count();
+    *size = (unsigned long long)fileSize;
+    return true;
+}
+
+// Absolute with "." and ".." removed, so "a/../b.png" and "b.png" give the same key
+std::string NormalizePath(std::string const& path)
+{
+    std::error_code error;
+    std::filesystem::path normalized = std::filesystem::weakly_canonical(std::filesystem::absolute(path, error), error);
+
+    if (error) {
+        return path;
+    }
+    return normalized.generic_string();
+}
+
+// "<path>.<process>.<thread>.tmp"
+std::string TempFilePath(std::string const& path)
+{
+#ifdef _WIN32
+    unsigned long long process = GetCurrentProcessId();
+#else
+    unsigned long long process = (unsigned long long)getpid();
+#endif
+    unsigned long long thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+
+    return path + "." + std::to_string(process) + "." + std::to_string(thread) + ".tmp";
+}
+
+MappedFile* MapFile(const char* path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (data == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return NULL;
+    }
+
+    MappedFile* mappedFile = (MappedFile*)malloc(sizeof(MappedFile));
+    mappedFile->data = (const unsigned char*)data;
+    mappedFile->size = (size_t)fileSize.QuadPart;
+    mappedFile->file = file;
+    mappedFile->mapping = mapping;
+
+    return mappedFile;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    MappedFile* mappedFile = (MappedFile*)malloc(sizeof(MappedFile));
+    mappedFile->data = (const unsigned char*)data;
+    mappedFile->size = (size_t)fileStat.st_size;
+    mappedFile->fd = fd;
+
+    return mappedFile;
+#endif
+}
+
+void UnmapFile(MappedFile* mappedFile)
+{
+    if (mappedFile == NULL) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(mappedFile->data);
+    CloseHandle(mappedFile->mapping);
+    CloseHandle(mappedFile->file);
+#else
+    munmap((void*)mappedFile->data, mappedFile->size);
+    close(mappedFile->fd);
+#endif
+
+    free(mappedFile);
+}
+
+#endif
@@ -0,0 +1,358 @@
+/*-------------------------------------------------------------------------------\
+mesh_arena.h
+
+Functions:
+    Shared vertex/index buffers for model meshes. Meshes with the same vertex
+    layout are suballocated from a few large blocks, each with one VAO, VBO and
+    EBO. A mesh only keeps its range (baseVertex, firstIndex, numIndices) and is
+    drawn with glDrawElementsBaseVertex, so consecutive meshes need no VAO bind.
+
+    Every block keeps a sorted free list of vertex and index ranges. Freed ranges
+    are merged with their neighbours. A new block is created when no range fits.
+
+    UpdateMeshRange rewrites a mesh in place when the new data has the same
+    layout and fits in the old range (used by hot_reload.h).
+
+    FreeMeshArena deletes every block at shutdown, once no model uses them.
+
+    Layouts: 0 is the full VertexData, 1-4 are the packed layouts from
+    vertex_format.h (skinned and/or colours). Each layout has separate blocks
+    for 16 bit and 32 bit index buffers.
+
+\-------------------------------------------------------------------------------*/
+#ifndef MESH_ARENA_H
+#define MESH_ARENA_H
+
+#include <glad/glad.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include <model_data.h>
+#include <vertex_format.h>
+
+#define MESH_ARENA_LAYOUTS 5
+#define MESH_ARENA_VERTEX_BYTES (32 * 1024 * 1024)
+#define MESH_ARENA_INDEX_BYTES (8 * 1024 * 1024)
+
+struct ArenaRange {
+    unsigned int offset;
+    unsigned int count;
+};
+
+struct MeshArenaBlock {
+    int layout;
+    int stride;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLenum indexType;
+    int indexSize;
+
+    unsigned int VAO;
+    unsigned int VBO;
+    unsigned int EBO;
+
+    unsigned int vertexCapacity;
+    unsigned int indexCapacity;
+
+    // sorted by offset
+    std::vector<ArenaRange> freeVertices;
+    std::vector<ArenaRange> freeIndices;
+};
+
+// Where a mesh lives in the arena
+struct MeshRange {
+    MeshArenaBlock* block;
+    GLenum indexType;
+    int baseVertex;
+    unsigned int firstIndex;
+    unsigned int numVertices;
+    unsigned int numIndices;
+};
+
+// [layout][0 = 32 bit indices, 1 = 16 bit indices]
+std::vector<MeshArenaBlock*> meshArenaBlocks[MESH_ARENA_LAYOUTS][2];
+
+bool AllocateMeshRange(MeshData* meshData, MeshRange* range);
+void FreeMeshRange(MeshRange* range);
+bool UpdateMeshRange(MeshData* meshData, MeshRange* range);
+void PrintMeshArenaStats();
+void FreeMeshArena();
+
+int MeshArenaLayout(MeshData* meshData);
+MeshArenaBlock* CreateMeshArenaBlock(int layout, bool shortIndices, PackedVertexLayout* packedLayout, unsigned int numVertices, unsigned int numIndices);
+void SetVertexDataAttributes();
+void UploadMeshRange(MeshData* meshData, MeshArenaBlock* block, unsigned int vertexOffset, unsigned int indexOffset);
+bool AllocateArenaRange(std::vector<ArenaRange>& freeList, unsigned int count, unsigned int* offset);
+void FreeArenaRange(std::vector<ArenaRange>& freeList, unsigned int offset, unsigned int count);
+
+int MeshArenaLayout(MeshData* meshData)
+{
+    if (meshData->packedVertices == NULL) {
+        return 0;
+    }
+    return 1 + (meshData->packedLayout.skinned ? 1 : 0) + (meshData->packedLayout.colors ? 2 : 0);
+}
+
+// Full VertexData attributes. VAO and GL_ARRAY_BUFFER must be bound
+void SetVertexDataAttributes()
+{
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
+    // vertex normals
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Normal));
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, TexCoords));
+    // vertex tangent
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Tangent));
+    // vertex bitangent
+    glEnableVertexAttribArray(4);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Bitangent));
+    // ids
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, GL_INT, sizeof(VertexData), (void*)offsetof(VertexData, m_BoneIDs));
+
+    // weights
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, m_Weights));
+
+    // vertex colors
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Color));
+}
+
+// Block big enough for at least numVertices / numIndices
+MeshArenaBlock* CreateMeshArenaBlock(int layout, bool shortIndices, PackedVertexLayout* packedLayout, unsigned int numVertices, unsigned int numIndices)
+{
+    MeshArenaBlock* block = new MeshArenaBlock();
+
+    block->layout = layout;
+    block->stride = (layout == 0) ? (int)sizeof(VertexData) : packedLayout->stride;
+    block->indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    block->indexSize = shortIndices ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    block->vertexCapacity = MESH_ARENA_VERTEX_BYTES / block->stride;
+    if (block->vertexCapacity < numVertices) {
+        block->vertexCapacity = numVertices;
+    }
+    block->indexCapacity = MESH_ARENA_INDEX_BYTES / block->indexSize;
+    if (block->indexCapacity < numIndices) {
+        block->indexCapacity = numIndices;
+    }
+
+    block->freeVertices.push_back({ 0, block->vertexCapacity });
+    block->freeIndices.push_back({ 0, block->indexCapacity });
+
+    glGenVertexArrays(1, &block->VAO);
+    glGenBuffers(1, &block->VBO);
+    glGenBuffers(1, &block->EBO);
+
+    glBindVertexArray(block->VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, block->VBO);
+    glBufferData(GL_ARRAY_BUFFER, (size_t)block->vertexCapacity * block->stride, NULL, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, block->EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)block->indexCapacity * block->indexSize, NULL, GL_STATIC_DRAW);
+
+    if (layout == 0) {
+        SetVertexDataAttributes();
+    } else {
+        SetPackedVertexAttributes(packedLayout);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    meshArenaBlocks[layout][shortIndices].push_back(block);
+
+    printf("MeshArena: layout %d block %d, %u vertices, %u %d bit indices\n", layout,
+        (int)meshArenaBlocks[layout][shortIndices].size() - 1, block->vertexCapacity, block->indexCapacity, block->indexSize * 8);
+
+    return block;
+}
+
+// First fit
+bool AllocateArenaRange(std::vector<ArenaRange>& freeList, unsigned int count, unsigned int* offset)
+{
+    for (size_t i = 0; i < freeList.size(); ++i) {
+        if (freeList[i].count >= count) {
+            *offset = freeList[i].offset;
+
+            freeList[i].offset += count;
+            freeList[i].count -= count;
+            if (freeList[i].count == 0) {
+                freeList.erase(freeList.begin() + i);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void FreeArenaRange(std::vector<ArenaRange>& freeList, unsigned int offset, unsigned int count)
+{
+    size_t i = 0;
+    while (i < freeList.size() && freeList[i].offset < offset) {
+        i++;
+    }
+
+    freeList.insert(freeList.begin() + i, { offset, count });
+
+    // merge with the next range, then with the previous one
+    if (i + 1 < freeList.size() && freeList[i].offset + freeList[i].count == freeList[i + 1].offset) {
+        freeList[i].count += freeList[i + 1].count;
+        freeList.erase(freeList.begin() + i + 1);
+    }
+    if (i > 0 && freeList[i - 1].offset + freeList[i - 1].count == freeList[i].offset) {
+        freeList[i - 1].count += freeList[i].count;
+        freeList.erase(freeList.begin() + i);
+    }
+}
+
+// Main thread. Copies the mesh streams into an arena block.
+bool AllocateMeshRange(MeshData* meshData, MeshRange* range)
+{
+    int layout = MeshArenaLayout(meshData);
+    bool shortIndices = meshData->shortIndices != NULL;
+    std::vector<MeshArenaBlock*>& blocks = meshArenaBlocks[layout][shortIndices];
+
+    MeshArenaBlock* block = NULL;
+    unsigned int vertexOffset = 0;
+    unsigned int indexOffset = 0;
+
+    for (size_t i = 0; i < blocks.size() && block == NULL; ++i) {
+        if (!AllocateArenaRange(blocks[i]->freeVertices, meshData->numVertices, &vertexOffset)) {
+            continue;
+        }
+        if (!AllocateArenaRange(blocks[i]->freeIndices, meshData->numIndices, &indexOffset)) {
+            FreeArenaRange(blocks[i]->freeVertices, vertexOffset, meshData->numVertices);
+            continue;
+        }
+        block = blocks[i];
+    }
+
+    if (block == NULL) {
+        block = CreateMeshArenaBlock(layout, shortIndices, &meshData->packedLayout, meshData->numVertices, meshData->numIndices);
+
+        if (!AllocateArenaRange(block->freeVertices, meshData->numVertices, &vertexOffset)
+            || !AllocateArenaRange(block->freeIndices, meshData->numIndices, &indexOffset)) {
+            printf("MeshArena: could not allocate %u vertices %u indices\n", meshData->numVertices, meshData->numIndices);
+            return false;
+        }
+    }
+
+    UploadMeshRange(meshData, block, vertexOffset, indexOffset);
+
+    range->block = block;
+    range->indexType = block->indexType;
+    range->baseVertex = (int)vertexOffset;
+    range->firstIndex = indexOffset;
+    range->numVertices = meshData->numVertices;
+    range->numIndices = meshData->numIndices;
+
+    return true;
+}
+
+void UploadMeshRange(MeshData* meshData, MeshArenaBlock* block, unsigned int vertexOffset, unsigned int indexOffset)
+{
+    const void* vertices = (block->layout == 0) ? (const void*)meshData->vertices : (const void*)meshData->packedVertices;
+    const void* indices = (block->indexType == GL_UNSIGNED_SHORT) ? (const void*)meshData->shortIndices : (const void*)meshData->indices;
+
+    // GL_COPY_WRITE_BUFFER leaves the element buffer binding of whatever VAO is bound alone
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block->VBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)vertexOffset * block->stride, (size_t)meshData->numVertices * block->stride, vertices);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, block->EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)indexOffset * block->indexSize, (size_t)meshData->numIndices * block->indexSize, indices);
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+// Writes meshData over the mesh's current range if it has the same layout and fits, the unused tail is freed.
+// Returns false and leaves the range alone otherwise.
+bool UpdateMeshRange(MeshData* meshData, MeshRange* range)
+{
+    MeshArenaBlock* block = range->block;
+
+    if (block == NULL || block->layout != MeshArenaLayout(meshData)
+        || (block->indexType == GL_UNSIGNED_SHORT) != (meshData->shortIndices != NULL)
+        || meshData->numVertices > range->numVertices || meshData->numIndices > range->numIndices) {
+        return false;
+    }
+
+    UploadMeshRange(meshData, block, (unsigned int)range->baseVertex, range->firstIndex);
+
+    if (meshData->numVertices < range->numVertices) {
+        FreeArenaRange(block->freeVertices, range->baseVertex + meshData->numVertices, range->numVertices - meshData->numVertices);
+    }
+    if (meshData->numIndices < range->numIndices) {
+        FreeArenaRange(block->freeIndices, range->firstIndex + meshData->numIndices, range->numIndices - meshData->numIndices);
+    }
+
+    range->numVertices = meshData->numVertices;
+    range->numIndices = meshData->numIndices;
+
+    return true;
+}
+
+// Returns the range to its block. The buffer contents are left as they are.
+void FreeMeshRange(MeshRange* range)
+{
+    if (range->block == NULL) {
+        return;
+    }
+
+    FreeArenaRange(range->block->freeVertices, (unsigned int)range->baseVertex, range->numVertices);
+    FreeArenaRange(range->block->freeIndices, range->firstIndex, range->numIndices);
+
+    range->block = NULL;
+}
+
+void PrintMeshArenaStats()
+{
+    for (int layout = 0; layout < MESH_ARENA_LAYOUTS * 2; ++layout) {
+        std::vector<MeshArenaBlock*>& blocks = meshArenaBlocks[layout / 2][layout % 2];
+
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            MeshArenaBlock* block = blocks[i];
+
+            unsigned int freeVertices = 0;
+            for (size_t j = 0; j < block->freeVertices.size(); ++j) {
+                freeVertices += block->freeVertices[j].count;
+            }
+            unsigned int freeIndices = 0;
+            for (size_t j = 0; j < block->freeIndices.size(); ++j) {
+                freeIndices += block->freeIndices[j].count;
+            }
+
+            printf("MeshArena: layout %d block %d, vertices %u/%u, %d bit indices %u/%u, %d free ranges\n", block->layout, (int)i,
+                block->vertexCapacity - freeVertices, block->vertexCapacity,
+                block->indexSize * 8, block->indexCapacity - freeIndices, block->indexCapacity,
+                (int)(block->freeVertices.size() + block->freeIndices.size()));
+        }
+    }
+}
+
+// Needs the GL context. Ranges still pointing into a block are invalid afterwards.
+void FreeMeshArena()
+{
+    for (int layout = 0; layout < MESH_ARENA_LAYOUTS * 2; ++layout) {
+        std::vector<MeshArenaBlock*>& blocks = meshArenaBlocks[layout / 2][layout % 2];
+
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            glDeleteVertexArrays(1, &blocks[i]->VAO);
+            glDeleteBuffers(1, &blocks[i]->VBO);
+            glDeleteBuffers(1, &blocks[i]->EBO);
+            delete blocks[i];
+        }
+        blocks.clear();
+    }
+}
+
+#endif
@@ -0,0 +1,516 @@
+/*-------------------------------------------------------------------------------\
+mesh_cache.h
+
+Functions:
+    Versioned on-disk cache of imported models. Written next to the source file
+    as <source>.meshcache after a cold Assimp import.
+
+    Holds the final vertex/index streams, texture references, the SkeletonNode
+    tree, the model's bones and Animation channels. A warm load maps the file and
+    hands the vertex/index streams straight to LoadMeshVertexData.
+
+    Keyed by source path, mtime and content hash. If the mtime/size changed the
+    source is hashed, so touching a file without editing it keeps the cache.
+
+Layout (native endian, strings are u32 length + bytes, streams 16 byte aligned):
+    MeshCacheHeader, path, name, directory
+    meshes     { numVertices numIndices numLods lods[MAX_MESH_LODS] boundsMin boundsMax
+                 center radius numClusters numTextures,
+                 textures { type path }, vertices, indices, clusters }
+    bones      { name id offset }   id is the model local index
+    skeleton   { name id transformation offset numChildren children... } pre-order
+    animations { name duration ticks numChannels, channels { name counts keys } }
+
+\-------------------------------------------------------------------------------*/
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include <model_data.h>
+#include <mapped_file.h>
+
+// Bump whenever the layout or the content of the vertex streams changes
+#define MESH_CACHE_VERSION 7
+#define MESH_CACHE_EXTENSION ".meshcache"
+
+struct MeshCacheHeader {
+    char magic[4];
+    unsigned int version;
+    long long sourceMtime;
+    unsigned long long sourceSize;
+    unsigned long long contentHash;
+    unsigned int numMeshes;
+    unsigned int numAnimations;
+    unsigned int numBones;
+    unsigned int numSkeletonNodes;
+};
+
+struct CacheWriter {
+    FILE* file;
+    size_t offset;
+    bool failed;
+};
+
+struct CacheReader {
+    const unsigned char* data;
+    size_t size;
+    size_t offset;
+    bool failed;
+};
+
+std::string MeshCachePath(std::string const& path);
+
+ModelData* ReadModelCache(std::string const& path);
+bool WriteModelCache(std::string const& path, ModelData* data);
+
+std::string MeshCachePath(std::string const& path)
+{
+    return path + MESH_CACHE_EXTENSION;
+}
+
+/* Writing */
+
+void CacheWrite(CacheWriter* writer, const void* data, size_t size)
+{
+    if (writer->failed || size == 0) {
+        return;
+    }
+
+    if (fwrite(data, 1, size, writer->file) != size) {
+        writer->failed = true;
+        return;
+    }
+    writer->offset += size;
+}
+
+template <typename T>
+void CacheWriteValue(CacheWriter* writer, const T& value)
+{
+    CacheWrite(writer, &value, sizeof(T));
+}
+
+void CacheWriteString(CacheWriter* writer, const char* str)
+{
+    unsigned int length = (str != NULL) ? (unsigned int)strlen(str) : 0;
+    CacheWriteValue(writer, length);
+    CacheWrite(writer, str, length);
+}
+
+void CacheAlign(CacheWriter* writer, size_t alignment)
+{
+    static const unsigned char zeros[16] = { 0 };
+
+    size_t padding = (alignment - (writer->offset % alignment)) % alignment;
+    CacheWrite(writer, zeros, padding);
+}
+
+unsigned int CountSkeletonNodes(SkeletonNode* node)
+{
+    if (node == NULL) {
+        return 0;
+    }
+
+    unsigned int count = 1;
+    for (unsigned int i = 0; i < node->m_NumChildren; ++i) {
+        count += CountSkeletonNodes(node->m_Children[i]);
+    }
+    return count;
+}
+
+void CacheWriteSkeleton(CacheWriter* writer, SkeletonNode* node)
+{
+    CacheWriteString(writer, node->m_NodeName);
+    CacheWriteValue(writer, node->id);
+    CacheWriteValue(writer, node->m_Transformation);
+    CacheWriteValue(writer, node->m_Offset);
+    CacheWriteValue(writer, node->m_NumChildren);
+
+    for (unsigned int i = 0; i < node->m_NumChildren; ++i) {
+        CacheWriteSkeleton(writer, node->m_Children[i]);
+    }
+}
+
+bool WriteModelCache(std::string const& path, ModelData* data)
+{
+    long long mtime;
+    unsigned long long size;
+    if (!GetSourceStamp(path, &mtime, &size)) {
+        return false;
+    }
+
+    bool hashed;
+    unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+    if (!hashed) {
+        return false;
+    }
+
+    // Written under a unique name and renamed, so a reader never maps a half written file
+    std::string cachePath = MeshCachePath(path);
+    std::string tempPath = TempFilePath(cachePath);
+
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == NULL) {
+        std::cout << "MESH_CACHE:: could not create " << tempPath << std::endl;
+        return false;
+    }
+
+    CacheWriter writer = { file, 0, false };
+
+    MeshCacheHeader header;
+    memcpy(header.magic, "AVMC", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.sourceMtime = mtime;
+    header.sourceSize = size;
+    header.contentHash = hash;
+    header.numMeshes = data->m_NumMeshes;
+    header.numAnimations = data->m_NumAnimations;
+    header.numBones = data->m_NumBones;
+    header.numSkeletonNodes = CountSkeletonNodes(data->rootSkeletonNode);
+
+    CacheWriteValue(&writer, header);
+    CacheWriteString(&writer, path.c_str());
+    CacheWriteString(&writer, data->m_Name);
+    CacheWriteString(&writer, data->m_Directory);
+
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* mesh = &data->m_Meshes[i];
+
+        CacheWriteValue(&writer, mesh->numVertices);
+        CacheWriteValue(&writer, mesh->numIndices);
+        CacheWriteValue(&writer, mesh->numLods);
+        CacheWrite(&writer, mesh->lods, sizeof(mesh->lods));
+        CacheWriteValue(&writer, mesh->boundsMin);
+        CacheWriteValue(&writer, mesh->boundsMax);
+        CacheWriteValue(&writer, mesh->center);
+        CacheWriteValue(&writer, mesh->radius);
+        CacheWriteValue(&writer, mesh->numClusters);
+        CacheWriteValue(&writer, mesh->numTextures);
+
+        for (unsigned int j = 0; j < mesh->numTextures; ++j) {
+            CacheWriteString(&writer, mesh->textures[j].type);
+            CacheWriteString(&writer, mesh->textures[j].path);
+        }
+
+        CacheAlign(&writer, 16);
+        CacheWrite(&writer, mesh->vertices, mesh->numVertices * sizeof(VertexData));
+        CacheAlign(&writer, 16);
+        CacheWrite(&writer, mesh->indices, mesh->numIndices * sizeof(unsigned int));
+        CacheAlign(&writer, 16);
+        CacheWrite(&writer, mesh->clusters, mesh->numClusters * sizeof(MeshCluster));
+    }
+
+    for (int i = 0; i < data->m_NumBones; ++i) {
+        CacheWriteString(&writer, data->m_BoneNames[i]);
+        CacheWriteValue(&writer, data->m_Bones[i].ID);
+        CacheWriteValue(&writer, data->m_Bones[i].Offset);
+    }
+
+    if (header.numSkeletonNodes > 0) {
+        CacheWriteSkeleton(&writer, data->rootSkeletonNode);
+    }
+
+    for (int i = 0; i < data->m_NumAnimations; ++i) {
+        Animation* animation = &data->m_Animations[i];
+
+        CacheWriteString(&writer, animation->m_Name);
+        CacheWriteValue(&writer, animation->m_Duration);
+        CacheWriteValue(&writer, animation->m_TicksPerSecond);
+        CacheWriteValue(&writer, animation->m_NumBoneAnimations);
+
+        for (unsigned int j = 0; j < animation->m_NumBoneAnimations; ++j) {
+            BoneAnimationChannel* channel = &animation->m_BoneAnimations[j];
+
+            CacheWriteString(&writer, channel->m_NodeName);
+            CacheWriteValue(&writer, channel->m_NumPositions);
+            CacheWriteValue(&writer, channel->m_NumRotations);
+            CacheWriteValue(&writer, channel->m_NumScalings);
+
+            CacheWrite(&writer, channel->m_Positions, channel->m_NumPositions * sizeof(KeyPosition));
+            CacheWrite(&writer, channel->m_Rotations, channel->m_NumRotations * sizeof(KeyRotation));
+            CacheWrite(&writer, channel->m_Scales, channel->m_NumScalings * sizeof(KeyScale));
+        }
+    }
+
+    bool failed = writer.failed;
+    if (fclose(file) != 0) {
+        failed = true;
+    }
+
+    if (failed) {
+        std::cout << "MESH_CACHE:: failed writing " << tempPath << std::endl;
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+/* Reading */
+
+const void* CacheRead(CacheReader* reader, size_t size)
+{
+    if (reader->failed || size > reader->size - reader->offset) {
+        reader->failed = true;
+        return NULL;
+    }
+
+    const void* ptr = reader->data + reader->offset;
+    reader->offset += size;
+    return ptr;
+}
+
+template <typename T>
+T CacheReadValue(CacheReader* reader)
+{
+    T value;
+    const void* ptr = CacheRead(reader, sizeof(T));
+    if (ptr == NULL) {
+        memset(&value, 0, sizeof(T));
+        return value;
+    }
+    memcpy(&value, ptr, sizeof(T));
+    return value;
+}
+
+// Returns a heap copy, null terminated
+char* CacheReadString(CacheReader* reader)
+{
+    unsigned int length = CacheReadValue<unsigned int>(reader);
+    const char* chars = (const char*)CacheRead(reader, length);
+    if (chars == NULL) {
+        return NULL;
+    }
+
+    char* str = (char*)malloc(length + 1);
+    memcpy(str, chars, length);
+    str[length] = '\0';
+    return str;
+}
+
+// Returns a heap copy of an array stored in the cache
+void* CacheReadArray(CacheReader* reader, size_t size)
+{
+    const void* ptr = CacheRead(reader, size);
+    if (ptr == NULL || size == 0) {
+        return NULL;
+    }
+
+    void* copy = malloc(size);
+    memcpy(copy, ptr, size);
+    return copy;
+}
+
+void CacheSkipAlign(CacheReader* reader, size_t alignment)
+{
+    size_t padding = (alignment - (reader->offset % alignment)) % alignment;
+    CacheRead(reader, padding);
+}
+
+SkeletonNode* CacheReadSkeleton(CacheReader* reader, unsigned int* nodesLeft)
+{
+    if (reader->failed || *nodesLeft == 0) {
+        reader->failed = true;
+        return NULL;
+    }
+    (*nodesLeft)--;
+
+    SkeletonNode* node = (SkeletonNode*)malloc(sizeof(SkeletonNode));
+
+    node->m_NodeName = CacheReadString(reader);
+    node->id = CacheReadValue<int>(reader);
+    node->m_Transformation = CacheReadValue<glm::mat4>(reader);
+    node->m_Offset = CacheReadValue<glm::mat4>(reader);
+    node->m_NumChildren = CacheReadValue<unsigned int>(reader);
+
+    if (reader->failed || node->m_NumChildren > *nodesLeft) {
+        reader->failed = true;
+        node->m_NumChildren = 0;
+    }
+
+    node->m_Children = (SkeletonNode**)malloc(node->m_NumChildren * sizeof(SkeletonNode*));
+
+    for (unsigned int i = 0; i < node->m_NumChildren; ++i) {
+        node->m_Children[i] = CacheReadSkeleton(reader, nodesLeft);
+    }
+
+    return node;
+}
+
+// Returns NULL if there is no cache or it is stale, the caller then imports with Assimp
+ModelData* ReadModelCache(std::string const& path)
+{
+    long long mtime;
+    unsigned long long size;
+    if (!GetSourceStamp(path, &mtime, &size)) {
+        return NULL;
+    }
+
+    std::string cachePath = MeshCachePath(path);
+
+    MappedFile* mapping = MapFile(cachePath.c_str());
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    CacheReader reader = { mapping->data, mapping->size, 0, false };
+
+    MeshCacheHeader header = CacheReadValue<MeshCacheHeader>(&reader);
+    char* sourcePath = CacheReadString(&reader);
+
+    bool valid = !reader.failed
+        && memcmp(header.magic, "AVMC", 4) == 0
+        && header.version == MESH_CACHE_VERSION
+        && sourcePath != NULL
+        && path == sourcePath
+        && header.sourceSize == size;
+
+    free(sourcePath);
+
+    // Same size but touched since the cache was written, check the contents
+    if (valid && header.sourceMtime != mtime) {
+        bool hashed;
+        unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+        valid = hashed && hash == header.contentHash;
+    }
+
+    if (!valid) {
+        UnmapFile(mapping);
+        return NULL;
+    }
+
+    ModelData* data = (ModelData*)calloc(1, sizeof(ModelData));
+    data->m_Mapping = mapping;
+
+    data->m_Name = CacheReadString(&reader);
+    data->m_Directory = CacheReadString(&reader);
+
+    data->m_NumMeshes = header.numMeshes;
+    data->m_Meshes = (MeshData*)calloc(header.numMeshes, sizeof(MeshData));
+
+    for (unsigned int i = 0; i < header.numMeshes && !reader.failed; ++i) {
+        MeshData* mesh = &data->m_Meshes[i];
+
+        mesh->numVertices = CacheReadValue<unsigned int>(&reader);
+        mesh->numIndices = CacheReadValue<unsigned int>(&reader);
+        mesh->numLods = CacheReadValue<int>(&reader);
+        const MeshLod* lods = (const MeshLod*)CacheRead(&reader, sizeof(mesh->lods));
+        if (lods != NULL) {
+            memcpy(mesh->lods, lods, sizeof(mesh->lods));
+        }
+        mesh->boundsMin = CacheReadValue<glm::vec3>(&reader);
+        mesh->boundsMax = CacheReadValue<glm::vec3>(&reader);
+        mesh->center = CacheReadValue<glm::vec3>(&reader);
+        mesh->radius = CacheReadValue<float>(&reader);
+        mesh->numClusters = CacheReadValue<unsigned int>(&reader);
+        unsigned int numTextures = CacheReadValue<unsigned int>(&reader);
+
+        if (reader.failed || numTextures > mapping->size || mesh->numClusters > mapping->size || mesh->numLods < 0 || mesh->numLods > MAX_MESH_LODS) {
+            reader.failed = true;
+            break;
+        }
+
+        mesh->textures = (Texture*)calloc(numTextures, sizeof(Texture));
+        mesh->numTextures = numTextures;
+
+        for (unsigned int j = 0; j < numTextures; ++j) {
+            char* type = CacheReadString(&reader);
+            mesh->textures[j].path = CacheReadString(&reader);
+            mesh->textures[j].type = (type != NULL) ? TextureTypeFromName(type) : NULL;
+            free(type);
+
+            if (mesh->textures[j].type == NULL || mesh->textures[j].path == NULL) {
+                reader.failed = true;
+            }
+        }
+
+        // Streams stay in the mapped file, no copy
+        CacheSkipAlign(&reader, 16);
+        mesh->vertices = (VertexData*)CacheRead(&reader, (size_t)mesh->numVertices * sizeof(VertexData));
+        CacheSkipAlign(&reader, 16);
+        mesh->indices = (unsigned int*)CacheRead(&reader, (size_t)mesh->numIndices * sizeof(unsigned int));
+        CacheSkipAlign(&reader, 16);
+        mesh->clusters = (MeshCluster*)CacheRead(&reader, (size_t)mesh->numClusters * sizeof(MeshCluster));
+    }
+
+    if (!reader.failed && header.numBones <= mapping->size) {
+        data->m_NumBones = header.numBones;
+        data->m_BoneNames = (char**)calloc(header.numBones, sizeof(char*));
+        data->m_Bones = (BoneStruct*)calloc(header.numBones, sizeof(BoneStruct));
+
+        for (unsigned int i = 0; i < header.numBones; ++i) {
+            data->m_BoneNames[i] = CacheReadString(&reader);
+            data->m_Bones[i].ID = CacheReadValue<int>(&reader);
+            data->m_Bones[i].Offset = CacheReadValue<glm::mat4>(&reader);
+        }
+    }
+
+    if (!reader.failed && header.numSkeletonNodes > 0) {
+        unsigned int nodesLeft = header.numSkeletonNodes;
+        data->rootSkeletonNode = CacheReadSkeleton(&reader, &nodesLeft);
+    }
+
+    if (!reader.failed && header.numAnimations > 0 && header.numAnimations <= mapping->size) {
+        data->m_NumAnimations = header.numAnimations;
+        data->m_Animations = (Animation*)calloc(header.numAnimations, sizeof(Animation));
+
+        for (unsigned int i = 0; i < header.numAnimations && !reader.failed; ++i) {
+            Animation* animation = &data->m_Animations[i];
+
+            animation->m_Name = CacheReadString(&reader);
+            animation->m_Duration = CacheReadValue<float>(&reader);
+            animation->m_TicksPerSecond = CacheReadValue<int>(&reader);
+            unsigned int numChannels = CacheReadValue<unsigned int>(&reader);
+
+            if (reader.failed || numChannels > mapping->size) {
+                reader.failed = true;
+                break;
+            }
+
+            animation->m_NumBoneAnimations = numChannels;
+            animation->m_BoneAnimations = (BoneAnimationChannel*)calloc(numChannels, sizeof(BoneAnimationChannel));
+
+            for (unsigned int j = 0; j < numChannels && !reader.failed; ++j) {
+                BoneAnimationChannel* channel = &animation->m_BoneAnimations[j];
+
+                channel->m_NodeName = CacheReadString(&reader);
+                channel->m_NumPositions = CacheReadValue<int>(&reader);
+                channel->m_NumRotations = CacheReadValue<int>(&reader);
+                channel->m_NumScalings = CacheReadValue<int>(&reader);
+
+                if (channel->m_NumPositions < 0 || channel->m_NumRotations < 0 || channel->m_NumScalings < 0) {
+                    reader.failed = true;
+                    break;
+                }
+
+                channel->m_Positions = (KeyPosition*)CacheReadArray(&reader, channel->m_NumPositions * sizeof(KeyPosition));
+                channel->m_Rotations = (KeyRotation*)CacheReadArray(&reader, channel->m_NumRotations * sizeof(KeyRotation));
+                channel->m_Scales = (KeyScale*)CacheReadArray(&reader, channel->m_NumScalings * sizeof(KeyScale));
+            }
+        }
+    }
+
+    if (reader.failed) {
+        // A truncated or corrupt cache is treated like a missing one
+        std::cout << "MESH_CACHE:: corrupt cache, reimporting " << path << std::endl;
+        FreeModelData(data);
+        return NULL;
+    }
+
+    return data;
+}
+
+#endif
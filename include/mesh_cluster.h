@@ -0,0 +1,365 @@
+/*-------------------------------------------------------------------------------\
+mesh_cluster.h
+
+Functions:
+    Splits the LOD 0 triangles of a mesh into clusters of at most
+    CLUSTER_MAX_TRIANGLES triangles and CLUSTER_MAX_VERTICES vertices, each
+    with a bounding sphere and a normal cone. Run by ImportModelData after
+    mesh_optimizer.h and before the LODs are generated, so the clusters are
+    stored in the mesh cache.
+
+    Clusters are grown greedily over shared vertices, preferring triangles
+    that add few vertices and face the same way as the cluster. The index
+    buffer is rewritten so every cluster is one contiguous range.
+
+    CullMeshClusters runs per frame on the CPU. A cluster is rejected when its
+    sphere is outside the frustum, or when the normal cone shows every
+    triangle faces away from the camera (Wihlidal, "Optimizing the Graphics
+    Pipeline with Compute"). The visible clusters become a draw list for
+    glMultiDrawElementsBaseVertex, neighbouring clusters are merged into
+    one draw.
+
+\-------------------------------------------------------------------------------*/
+#ifndef MESH_CLUSTER_H
+#define MESH_CLUSTER_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <model_data.h>
+#include <mesh_optimizer.h>
+#include <render_view.h>
+
+#define CLUSTER_MAX_TRIANGLES 124
+#define CLUSTER_MAX_VERTICES 64
+// meshes with fewer triangles are drawn whole
+#define CLUSTER_MIN_MESH_TRIANGLES (2 * CLUSTER_MAX_TRIANGLES)
+// cost of a candidate triangle facing 90 degrees away, in added vertices
+#define CLUSTER_NORMAL_WEIGHT 2.0f
+
+// Object space bounds of the view, for one model
+struct ClusterCullInfo {
+    glm::vec4 planes[6];
+    glm::vec3 cameraPosition;
+    // only valid while back faces are culled and the model matrix keeps the winding
+    bool coneCulling;
+};
+
+// Scratch arguments for glMultiDrawElementsBaseVertex, reused every draw
+struct ClusterDrawList {
+    GLsizei* counts;
+    void** offsets;
+    GLint* baseVertices;
+    unsigned int numDraws;
+    unsigned int capacity;
+};
+
+bool clusterCulling = true;
+// DrawScene enables GL_CULL_FACE while this is set, the cone test depends on it
+bool cullBackfaces = true;
+ClusterDrawList clusterDrawList;
+
+void BuildModelClusters(ModelData* data);
+unsigned int BuildMeshClusters(MeshData* mesh);
+void ComputeClusterBounds(MeshCluster* cluster, unsigned int* indices, VertexData* vertices);
+
+void SetupClusterCull(ClusterCullInfo* info, glm::mat4 modelMatrix, bool backfaceCulling);
+unsigned int CullMeshClusters(const MeshCluster* clusters, unsigned int numClusters, ClusterCullInfo* info,
+    size_t indexOffset, size_t indexSize, GLint baseVertex);
+
+void BuildModelClusters(ModelData* data)
+{
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* mesh = &data->m_Meshes[i];
+
+        if (BuildMeshClusters(mesh) > 0) {
+            VertexCacheStats stats = AnalyzeVertexCache(mesh->indices, mesh->numIndices, mesh->numVertices, VERTEX_CACHE_FIFO);
+
+            printf("MeshClusters: %s mesh %d, %u triangles in %u clusters, ACMR %.3f\n", data->m_Name, i,
+                mesh->numIndices / 3, mesh->numClusters, stats.acmr);
+        }
+    }
+}
+
+// Returns the number of clusters, 0 if the mesh is left whole
+unsigned int BuildMeshClusters(MeshData* mesh)
+{
+    // clusters cover the whole index buffer, so they have to be built before the LODs are appended
+    if (mesh->numLods > 0 || mesh->numIndices % 3 != 0 || mesh->numIndices / 3 < CLUSTER_MIN_MESH_TRIANGLES) {
+        return 0;
+    }
+
+    unsigned int numTriangles = mesh->numIndices / 3;
+    unsigned int* indices = mesh->indices;
+
+    // triangles using each vertex
+    std::vector<unsigned int> adjacencyOffset(mesh->numVertices + 1, 0);
+    std::vector<unsigned int> adjacency(mesh->numIndices);
+
+    for (unsigned int i = 0; i < mesh->numIndices; ++i) {
+        adjacencyOffset[indices[i] + 1]++;
+    }
+    for (unsigned int v = 0; v < mesh->numVertices; ++v) {
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    }
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (unsigned int i = 0; i < mesh->numIndices; ++i) {
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<glm::vec3> faceNormals(numTriangles);
+    for (unsigned int t = 0; t < numTriangles; ++t) {
+        glm::vec3 p0 = mesh->vertices[indices[t * 3 + 0]].Position;
+        glm::vec3 p1 = mesh->vertices[indices[t * 3 + 1]].Position;
+        glm::vec3 p2 = mesh->vertices[indices[t * 3 + 2]].Position;
+
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(n);
+        faceNormals[t] = (length > 0.0f) ? n / length : glm::vec3(0.0f);
+    }
+
+    std::vector<bool> used(numTriangles, false);
+    // cluster each vertex was last added to
+    std::vector<unsigned int> vertexCluster(mesh->numVertices, 0xFFFFFFFF);
+
+    std::vector<unsigned int> output;
+    output.reserve(mesh->numIndices);
+    std::vector<MeshCluster> clusters;
+    std::vector<unsigned int> clusterVertices;
+
+    unsigned int nextSeed = 0;
+    unsigned int clustered = 0;
+
+    while (clustered < numTriangles) {
+        unsigned int clusterId = (unsigned int)clusters.size();
+        MeshCluster cluster;
+        cluster.firstIndex = (unsigned int)output.size();
+
+        clusterVertices.clear();
+        glm::vec3 normalSum(0.0f);
+        unsigned int numClusterTriangles = 0;
+
+        unsigned int triangle;
+        while (used[nextSeed]) {
+            nextSeed++;
+        }
+        triangle = nextSeed;
+
+        for (;;) {
+            used[triangle] = true;
+            clustered++;
+            numClusterTriangles++;
+            normalSum += faceNormals[triangle];
+
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[triangle * 3 + k];
+                output.push_back(v);
+
+                if (vertexCluster[v] != clusterId) {
+                    vertexCluster[v] = clusterId;
+                    clusterVertices.push_back(v);
+                }
+            }
+
+            if (numClusterTriangles == CLUSTER_MAX_TRIANGLES || clustered == numTriangles) {
+                break;
+            }
+
+            glm::vec3 clusterNormal = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+
+            // cheapest unused triangle touching the cluster
+            int best = -1;
+            float bestScore = 0.0f;
+
+            for (size_t i = 0; i < clusterVertices.size(); ++i) {
+                unsigned int v = clusterVertices[i];
+
+                for (unsigned int a = adjacencyOffset[v]; a < adjacencyOffset[v + 1]; ++a) {
+                    unsigned int candidate = adjacency[a];
+                    if (used[candidate]) {
+                        continue;
+                    }
+
+                    int added = 0;
+                    for (int k = 0; k < 3; ++k) {
+                        added += vertexCluster[indices[candidate * 3 + k]] != clusterId;
+                    }
+                    if (clusterVertices.size() + added > CLUSTER_MAX_VERTICES) {
+                        continue;
+                    }
+
+                    float score = added + (1.0f - glm::dot(clusterNormal, faceNormals[candidate])) * CLUSTER_NORMAL_WEIGHT;
+                    if (best < 0 || score < bestScore) {
+                        best = (int)candidate;
+                        bestScore = score;
+                    }
+                }
+            }
+
+            // nothing connected left, continue with the next triangle in cache order
+            if (best < 0) {
+                while (nextSeed < numTriangles && used[nextSeed]) {
+                    nextSeed++;
+                }
+                if (nextSeed == numTriangles || clusterVertices.size() + 3 > CLUSTER_MAX_VERTICES) {
+                    break;
+                }
+                best = (int)nextSeed;
+            }
+
+            triangle = (unsigned int)best;
+        }
+
+        cluster.numIndices = (unsigned int)output.size() - cluster.firstIndex;
+        ComputeClusterBounds(&cluster, output.data() + cluster.firstIndex, mesh->vertices);
+
+        clusters.push_back(cluster);
+    }
+
+    memcpy(mesh->indices, output.data(), mesh->numIndices * sizeof(unsigned int));
+    OptimizeVertexFetch(mesh);
+
+    mesh->numClusters = (unsigned int)clusters.size();
+    mesh->clusters = (MeshCluster*)malloc(clusters.size() * sizeof(MeshCluster));
+    memcpy(mesh->clusters, clusters.data(), clusters.size() * sizeof(MeshCluster));
+
+    return mesh->numClusters;
+}
+
+void ComputeClusterBounds(MeshCluster* cluster, unsigned int* indices, VertexData* vertices)
+{
+    glm::vec3 minimum(INFINITY);
+    glm::vec3 maximum(-INFINITY);
+
+    for (unsigned int i = 0; i < cluster->numIndices; ++i) {
+        minimum = glm::min(minimum, vertices[indices[i]].Position);
+        maximum = glm::max(maximum, vertices[indices[i]].Position);
+    }
+
+    cluster->center = (minimum + maximum) * 0.5f;
+    cluster->radius = 0.0f;
+    for (unsigned int i = 0; i < cluster->numIndices; ++i) {
+        cluster->radius = glm::max(cluster->radius, glm::length(vertices[indices[i]].Position - cluster->center));
+    }
+
+    // area weighted average normal
+    glm::vec3 axis(0.0f);
+    for (unsigned int i = 0; i < cluster->numIndices; i += 3) {
+        glm::vec3 p0 = vertices[indices[i + 0]].Position;
+        glm::vec3 p1 = vertices[indices[i + 1]].Position;
+        glm::vec3 p2 = vertices[indices[i + 2]].Position;
+        axis += glm::cross(p1 - p0, p2 - p0);
+    }
+
+    // a cutoff of 1 never passes the cone test
+    cluster->coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    cluster->coneCutoff = 1.0f;
+
+    float length = glm::length(axis);
+    if (length == 0.0f) {
+        return;
+    }
+    axis /= length;
+
+    float minDot = 1.0f;
+    for (unsigned int i = 0; i < cluster->numIndices; i += 3) {
+        glm::vec3 p0 = vertices[indices[i + 0]].Position;
+        glm::vec3 p1 = vertices[indices[i + 1]].Position;
+        glm::vec3 p2 = vertices[indices[i + 2]].Position;
+
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if (area > 0.0f) {
+            minDot = glm::min(minDot, glm::dot(n / area, axis));
+        }
+    }
+
+    // wider than ~85 degrees, almost never culled, not worth testing
+    if (minDot <= 0.1f) {
+        return;
+    }
+
+    cluster->coneAxis = axis;
+    // sine of the cone's half angle
+    cluster->coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+// Moves the view into the model's space, so clusters are tested without transforming them
+void SetupClusterCull(ClusterCullInfo* info, glm::mat4 modelMatrix, bool backfaceCulling)
+{
+    ExtractFrustumPlanes(renderView.projection * renderView.view * modelMatrix, info->planes);
+
+    info->cameraPosition = glm::vec3(glm::inverse(modelMatrix) * glm::vec4(renderView.position, 1.0f));
+
+    // a mirrored model matrix flips which side GL culls
+    info->coneCulling = backfaceCulling && glm::determinant(glm::mat3(modelMatrix)) > 0.0f;
+}
+
+// Fills clusterDrawList with the visible clusters of one mesh and returns the number of culled triangles.
+// indexOffset is the mesh's first index in the element buffer.
+unsigned int CullMeshClusters(const MeshCluster* clusters, unsigned int numClusters, ClusterCullInfo* info,
+    size_t indexOffset, size_t indexSize, GLint baseVertex)
+{
+    ClusterDrawList* list = &clusterDrawList;
+
+    if (list->capacity < numClusters) {
+        list->capacity = numClusters;
+        list->counts = (GLsizei*)realloc(list->counts, numClusters * sizeof(GLsizei));
+        list->offsets = (void**)realloc(list->offsets, numClusters * sizeof(void*));
+        list->baseVertices = (GLint*)realloc(list->baseVertices, numClusters * sizeof(GLint));
+    }
+
+    list->numDraws = 0;
+    unsigned int culledIndices = 0;
+    // end of the last draw, to merge neighbouring clusters
+    unsigned int drawEnd = 0xFFFFFFFF;
+
+    for (unsigned int i = 0; i < numClusters; ++i) {
+        const MeshCluster* cluster = &clusters[i];
+        bool visible = true;
+
+        for (int p = 0; p < 6 && visible; ++p) {
+            if (glm::dot(glm::vec3(info->planes[p]), cluster->center) + info->planes[p].w < -cluster->radius) {
+                visible = false;
+            }
+        }
+
+        if (visible && info->coneCulling) {
+            glm::vec3 toCluster = cluster->center - info->cameraPosition;
+
+            if (glm::dot(toCluster, cluster->coneAxis) >= cluster->coneCutoff * glm::length(toCluster) + cluster->radius) {
+                visible = false;
+            }
+        }
+
+        if (!visible) {
+            culledIndices += cluster->numIndices;
+            renderStats.clustersCulled++;
+            continue;
+        }
+
+        renderStats.clustersDrawn++;
+
+        if (cluster->firstIndex == drawEnd) {
+            list->counts[list->numDraws - 1] += cluster->numIndices;
+        } else {
+            list->counts[list->numDraws] = cluster->numIndices;
+            list->offsets[list->numDraws] = (void*)((indexOffset + cluster->firstIndex) * indexSize);
+            list->baseVertices[list->numDraws] = baseVertex;
+            list->numDraws++;
+        }
+        drawEnd = cluster->firstIndex + cluster->numIndices;
+    }
+
+    return culledIndices / 3;
+}
+
+#endif
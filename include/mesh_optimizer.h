@@ -0,0 +1,442 @@
+/*-------------------------------------------------------------------------------\
+mesh_optimizer.h
+
+Functions:
+    Load time mesh optimization, run by ImportModelData before the mesh cache
+    is written, so warm loads get the optimized streams for free.
+
+    1. WeldVertices           merge bit-identical vertices
+    2. OptimizeVertexCache    Forsyth's linear speed triangle order for the
+                              post-transform cache
+    3. OptimizeOverdraw       split the cache order into clusters and draw the
+                              outward facing ones first (Sander, Nehab and
+                              Barczak), kept only if ACMR stays within the threshold
+    4. OptimizeVertexFetch    renumber vertices in order of first use
+
+    ACMR (transformed vertices per triangle) and ATVR (transformed vertices per
+    vertex) are printed before and after, using a 16 entry FIFO cache.
+
+    ShrinkMeshIndices makes a 16 bit copy of the index buffer for meshes with
+    fewer than 65536 vertices.
+
+\-------------------------------------------------------------------------------*/
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <model_data.h>
+
+#define VERTEX_CACHE_SIZE 32
+// FIFO size used to report ACMR / ATVR and to find overdraw cluster boundaries
+#define VERTEX_CACHE_FIFO 16
+// the overdraw order may make ACMR this much worse
+#define OVERDRAW_THRESHOLD 1.05f
+
+struct VertexCacheStats {
+    float acmr;
+    float atvr;
+};
+
+void OptimizeModelMeshes(ModelData* data);
+void OptimizeMesh(MeshData* mesh, const char* name, int meshIndex);
+
+unsigned int WeldVertices(MeshData* mesh);
+void OptimizeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices);
+void OptimizeOverdraw(unsigned int* indices, unsigned int numIndices, VertexData* vertices, unsigned int numVertices, float threshold);
+void OptimizeVertexFetch(MeshData* mesh);
+void ShrinkMeshIndices(MeshData* mesh);
+
+VertexCacheStats AnalyzeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices, int cacheSize);
+float VertexCacheScore(int cachePosition, int valence);
+
+void OptimizeModelMeshes(ModelData* data)
+{
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        OptimizeMesh(&data->m_Meshes[i], data->m_Name, i);
+    }
+}
+
+void OptimizeMesh(MeshData* mesh, const char* name, int meshIndex)
+{
+    // not referenced by any node, or not triangulated
+    if (mesh->numVertices == 0 || mesh->numIndices == 0 || mesh->numIndices % 3 != 0) {
+        return;
+    }
+
+    unsigned int originalVertices = mesh->numVertices;
+    VertexCacheStats before = AnalyzeVertexCache(mesh->indices, mesh->numIndices, mesh->numVertices, VERTEX_CACHE_FIFO);
+
+    WeldVertices(mesh);
+    OptimizeVertexCache(mesh->indices, mesh->numIndices, mesh->numVertices);
+    OptimizeOverdraw(mesh->indices, mesh->numIndices, mesh->vertices, mesh->numVertices, OVERDRAW_THRESHOLD);
+    OptimizeVertexFetch(mesh);
+
+    VertexCacheStats after = AnalyzeVertexCache(mesh->indices, mesh->numIndices, mesh->numVertices, VERTEX_CACHE_FIFO);
+
+    printf("MeshOptimizer: %s mesh %d, vertices %u -> %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name, meshIndex,
+        originalVertices, mesh->numVertices, before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+VertexCacheStats AnalyzeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices, int cacheSize)
+{
+    VertexCacheStats stats = { 0.0f, 0.0f };
+    if (numIndices == 0 || numVertices == 0) {
+        return stats;
+    }
+
+    // timestamp of the last time each vertex was put in the FIFO
+    std::vector<unsigned int> cacheTime(numVertices, 0);
+    unsigned int time = cacheSize + 1;
+    unsigned int misses = 0;
+
+    for (unsigned int i = 0; i < numIndices; ++i) {
+        unsigned int v = indices[i];
+
+        if (time - cacheTime[v] > (unsigned int)cacheSize) {
+            cacheTime[v] = time++;
+            misses++;
+        }
+    }
+
+    stats.acmr = (float)misses / (numIndices / 3);
+    stats.atvr = (float)misses / numVertices;
+
+    return stats;
+}
+
+struct WeldKey {
+    const VertexData* vertex;
+};
+
+struct WeldHash {
+    size_t operator()(WeldKey const& key) const
+    {
+        return (size_t)HashBytes(key.vertex, sizeof(VertexData), FNV1A_64_OFFSET);
+    }
+};
+
+struct WeldEqual {
+    bool operator()(WeldKey const& a, WeldKey const& b) const
+    {
+        return memcmp(a.vertex, b.vertex, sizeof(VertexData)) == 0;
+    }
+};
+
+// Returns the new vertex count. Compacts mesh->vertices in place and rewrites the indices.
+unsigned int WeldVertices(MeshData* mesh)
+{
+    std::vector<unsigned int> remap(mesh->numVertices);
+    std::unordered_map<WeldKey, unsigned int, WeldHash, WeldEqual> unique;
+    unique.reserve(mesh->numVertices);
+
+    unsigned int numUnique = 0;
+
+    for (unsigned int i = 0; i < mesh->numVertices; ++i) {
+        WeldKey key = { &mesh->vertices[i] };
+
+        std::unordered_map<WeldKey, unsigned int, WeldHash, WeldEqual>::iterator found = unique.find(key);
+        if (found != unique.end()) {
+            remap[i] = found->second;
+            continue;
+        }
+
+        // earlier slots are already final, so the key pointer stays valid
+        mesh->vertices[numUnique] = mesh->vertices[i];
+        unique[{ &mesh->vertices[numUnique] }] = numUnique;
+        remap[i] = numUnique++;
+    }
+
+    for (unsigned int i = 0; i < mesh->numIndices; ++i) {
+        mesh->indices[i] = remap[mesh->indices[i]];
+    }
+
+    mesh->numVertices = numUnique;
+
+    return numUnique;
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation"
+float VertexCacheScore(int cachePosition, int valence)
+{
+    if (valence == 0) {
+        return -1.0f;
+    }
+
+    float score = 0.0f;
+
+    if (cachePosition >= 0) {
+        if (cachePosition < 3) {
+            // the last triangle's vertices, no matter which order they are used in
+            score = 0.75f;
+        } else {
+            float scale = 1.0f / (VERTEX_CACHE_SIZE - 3);
+            score = powf(1.0f - (cachePosition - 3) * scale, 1.5f);
+        }
+    }
+
+    // favour vertices with few triangles left, to finish them off
+    score += 2.0f * powf((float)valence, -0.5f);
+
+    return score;
+}
+
+void OptimizeVertexCache(unsigned int* indices, unsigned int numIndices, unsigned int numVertices)
+{
+    unsigned int numTriangles = numIndices / 3;
+
+    // triangles using each vertex
+    std::vector<unsigned int> adjacencyOffset(numVertices + 1, 0);
+    for (unsigned int i = 0; i < numIndices; ++i) {
+        adjacencyOffset[indices[i] + 1]++;
+    }
+    for (unsigned int v = 0; v < numVertices; ++v) {
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    }
+
+    std::vector<unsigned int> adjacency(numIndices);
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (unsigned int i = 0; i < numIndices; ++i) {
+        adjacency[fill[indices[i]]++] = i / 3;
+    }
+
+    std::vector<int> valence(numVertices);
+    std::vector<int> cachePosition(numVertices, -1);
+    std::vector<float> vertexScore(numVertices);
+
+    for (unsigned int v = 0; v < numVertices; ++v) {
+        valence[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+        vertexScore[v] = VertexCacheScore(-1, valence[v]);
+    }
+
+    std::vector<float> triangleScore(numTriangles);
+    std::vector<bool> emitted(numTriangles, false);
+
+    for (unsigned int t = 0; t < numTriangles; ++t) {
+        triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+    }
+
+    std::vector<unsigned int> output;
+    output.reserve(numIndices);
+
+    // +3 so a triangle can be added before the oldest entries drop out
+    unsigned int cache[VERTEX_CACHE_SIZE + 3];
+    int cacheCount = 0;
+
+    unsigned int nextCandidate = 0;
+    int bestTriangle = -1;
+
+    for (unsigned int emittedCount = 0; emittedCount < numTriangles; ++emittedCount) {
+        if (bestTriangle < 0) {
+            // nothing in the cache is usable, take the best triangle left
+            float bestScore = -1.0f;
+            while (nextCandidate < numTriangles && emitted[nextCandidate]) {
+                nextCandidate++;
+            }
+            for (unsigned int t = nextCandidate; t < numTriangles; ++t) {
+                if (!emitted[t] && triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+
+        unsigned int triangle = bestTriangle;
+        emitted[triangle] = true;
+
+        unsigned int newCache[VERTEX_CACHE_SIZE + 3];
+        int newCount = 0;
+
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[triangle * 3 + k];
+            output.push_back(v);
+            newCache[newCount++] = v;
+
+            // take the triangle out of the vertex's list
+            valence[v]--;
+            unsigned int* begin = &adjacency[adjacencyOffset[v]];
+            unsigned int* end = begin + valence[v] + 1;
+            unsigned int* found = std::find(begin, end, triangle);
+            std::swap(*found, *(end - 1));
+        }
+
+        for (int i = 0; i < cacheCount; ++i) {
+            unsigned int v = cache[i];
+            if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+                newCache[newCount++] = v;
+            }
+        }
+
+        // vertices pushed out of the cache
+        for (int i = VERTEX_CACHE_SIZE; i < newCount; ++i) {
+            cachePosition[newCache[i]] = -1;
+        }
+
+        cacheCount = std::min(newCount, VERTEX_CACHE_SIZE);
+        memcpy(cache, newCache, cacheCount * sizeof(unsigned int));
+
+        // rescore the cache and its triangles, remembering the best one
+        bestTriangle = -1;
+        float bestScore = -1.0f;
+
+        for (int i = 0; i < newCount; ++i) {
+            unsigned int v = newCache[i];
+
+            cachePosition[v] = (i < VERTEX_CACHE_SIZE) ? i : -1;
+
+            float score = VertexCacheScore(cachePosition[v], valence[v]);
+            float delta = score - vertexScore[v];
+            vertexScore[v] = score;
+
+            for (int j = 0; j < valence[v]; ++j) {
+                unsigned int t = adjacency[adjacencyOffset[v] + j];
+                triangleScore[t] += delta;
+
+                if (i < VERTEX_CACHE_SIZE && triangleScore[t] > bestScore) {
+                    bestScore = triangleScore[t];
+                    bestTriangle = t;
+                }
+            }
+        }
+    }
+
+    memcpy(indices, output.data(), numIndices * sizeof(unsigned int));
+}
+
+// Expects a cache optimized index buffer
+void OptimizeOverdraw(unsigned int* indices, unsigned int numIndices, VertexData* vertices, unsigned int numVertices, float threshold)
+{
+    unsigned int numTriangles = numIndices / 3;
+    if (numTriangles < 2) {
+        return;
+    }
+
+    VertexCacheStats baseline = AnalyzeVertexCache(indices, numIndices, numVertices, VERTEX_CACHE_FIFO);
+
+    // cluster boundaries where a triangle misses on all three vertices
+    std::vector<unsigned int> clusters;
+    std::vector<unsigned int> cacheTime(numVertices, 0);
+    unsigned int time = VERTEX_CACHE_FIFO + 1;
+
+    for (unsigned int t = 0; t < numTriangles; ++t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            unsigned int v = indices[t * 3 + k];
+            if (time - cacheTime[v] > VERTEX_CACHE_FIFO) {
+                cacheTime[v] = time++;
+                misses++;
+            }
+        }
+        if (t == 0 || misses == 3) {
+            clusters.push_back(t);
+        }
+    }
+    clusters.push_back(numTriangles);
+
+    int numClusters = (int)clusters.size() - 1;
+    if (numClusters < 2) {
+        return;
+    }
+
+    glm::vec3 meshCentroid(0.0f);
+    for (unsigned int v = 0; v < numVertices; ++v) {
+        meshCentroid += vertices[v].Position;
+    }
+    meshCentroid /= (float)numVertices;
+
+    // clusters facing away from the centre are likely to occlude the others
+    std::vector<float> sortKey(numClusters);
+    for (int c = 0; c < numClusters; ++c) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float totalArea = 0.0f;
+
+        for (unsigned int t = clusters[c]; t < clusters[c + 1]; ++t) {
+            glm::vec3 p0 = vertices[indices[t * 3]].Position;
+            glm::vec3 p1 = vertices[indices[t * 3 + 1]].Position;
+            glm::vec3 p2 = vertices[indices[t * 3 + 2]].Position;
+
+            // area weighted, the cross product length is twice the area
+            glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+            float area = glm::length(n);
+
+            centroid += (p0 + p1 + p2) * (area / 3.0f);
+            normal += n;
+            totalArea += area;
+        }
+
+        if (totalArea > 0.0f) {
+            centroid /= totalArea;
+        }
+
+        float normalLength = glm::length(normal);
+        if (normalLength > 0.0f) {
+            normal /= normalLength;
+        }
+
+        sortKey[c] = glm::dot(centroid - meshCentroid, normal);
+    }
+
+    std::vector<int> order(numClusters);
+    for (int c = 0; c < numClusters; ++c) {
+        order[c] = c;
+    }
+    std::stable_sort(order.begin(), order.end(), [&sortKey](int a, int b) { return sortKey[a] > sortKey[b]; });
+
+    std::vector<unsigned int> output;
+    output.reserve(numIndices);
+    for (int i = 0; i < numClusters; ++i) {
+        int c = order[i];
+        output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+    }
+
+    VertexCacheStats reordered = AnalyzeVertexCache(output.data(), numIndices, numVertices, VERTEX_CACHE_FIFO);
+    if (reordered.acmr <= baseline.acmr * threshold) {
+        memcpy(indices, output.data(), numIndices * sizeof(unsigned int));
+    }
+}
+
+// Vertices are renumbered in the order the index buffer first uses them, unused ones are dropped
+void OptimizeVertexFetch(MeshData* mesh)
+{
+    std::vector<unsigned int> remap(mesh->numVertices, 0xFFFFFFFF);
+    VertexData* reordered = (VertexData*)malloc(mesh->numVertices * sizeof(VertexData));
+
+    unsigned int next = 0;
+    for (unsigned int i = 0; i < mesh->numIndices; ++i) {
+        unsigned int v = mesh->indices[i];
+
+        if (remap[v] == 0xFFFFFFFF) {
+            reordered[next] = mesh->vertices[v];
+            remap[v] = next++;
+        }
+        mesh->indices[i] = remap[v];
+    }
+
+    free(mesh->vertices);
+    mesh->vertices = reordered;
+    mesh->numVertices = next;
+}
+
+// Fills mesh->shortIndices when every index fits in 16 bits
+void ShrinkMeshIndices(MeshData* mesh)
+{
+    if (mesh->numVertices == 0 || mesh->numVertices > 65536) {
+        return;
+    }
+
+    mesh->shortIndices = (unsigned short*)malloc(mesh->numIndices * sizeof(unsigned short));
+
+    for (unsigned int i = 0; i < mesh->numIndices; ++i) {
+        mesh->shortIndices[i] = (unsigned short)mesh->indices[i];
+    }
+}
+
+#endif
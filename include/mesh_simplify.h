@@ -0,0 +1,397 @@
+/*-------------------------------------------------------------------------------\
+mesh_simplify.h
+
+Functions:
+    LOD generation with quadric error edge collapse (Garland and Heckbert).
+    Run by ImportModelData after mesh_optimizer.h, so the LODs end up in the
+    mesh cache.
+
+    Collapses are half edge collapses: a vertex is merged into one of its
+    neighbours and never moved, so every LOD indexes the base vertex buffer and
+    only adds an index range. LOD index ranges are appended to mesh->indices
+    and described by mesh->lods, level 0 is the full mesh.
+
+    Kept intact:
+    - UV / normal seams: vertices sharing a position with another vertex are locked
+    - open borders: vertices on an edge used by one triangle are locked
+    - skinning: a vertex only collapses into one with the same dominant bone
+
+    Each LOD stores its geometric error (object space distance) for
+    screen space selection in scene_graph.h.
+
+\-------------------------------------------------------------------------------*/
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include <model_data.h>
+#include <mesh_optimizer.h>
+
+// each LOD keeps this fraction of the previous level's triangles
+#define LOD_REDUCTION 0.5f
+// stop when a level saves less than this fraction
+#define LOD_MIN_SAVING 0.1f
+// largest collapse error per level as a fraction of the mesh radius
+const float LodErrorLimits[MAX_MESH_LODS] = { 0.0f, 0.01f, 0.03f, 0.08f };
+
+struct Quadric {
+    double a2, ab, ac, ad;
+    double b2, bc, bd;
+    double c2, cd;
+    double d2;
+};
+
+struct EdgeCollapse {
+    unsigned int from;
+    unsigned int to;
+    float cost;
+};
+
+void GenerateModelLods(ModelData* data);
+void GenerateMeshLods(MeshData* mesh);
+
+unsigned int SimplifyIndices(std::vector<unsigned int>& indices, VertexData* vertices, unsigned int numVertices,
+    std::vector<unsigned char>& locked, std::vector<Quadric>& quadrics, unsigned int targetIndices, float maxError, float* resultError);
+
+void QuadricAdd(Quadric* q, Quadric const* other);
+void QuadricFromTriangle(Quadric* q, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2);
+float QuadricError(Quadric const* q, glm::vec3 p);
+int DominantBone(VertexData const* vertex);
+bool CollapseFlipsTriangle(std::vector<unsigned int>& indices, std::vector<unsigned int>& triangles,
+    std::vector<unsigned int>& remap, VertexData* vertices, unsigned int from, unsigned int to);
+
+void QuadricAdd(Quadric* q, Quadric const* other)
+{
+    q->a2 += other->a2; q->ab += other->ab; q->ac += other->ac; q->ad += other->ad;
+    q->b2 += other->b2; q->bc += other->bc; q->bd += other->bd;
+    q->c2 += other->c2; q->cd += other->cd;
+    q->d2 += other->d2;
+}
+
+// Plane of the triangle. Degenerate triangles add nothing.
+void QuadricFromTriangle(Quadric* q, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+{
+    memset(q, 0, sizeof(Quadric));
+
+    glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+    float length = glm::length(n);
+    if (length == 0.0f) {
+        return;
+    }
+    n /= length;
+
+    double a = n.x, b = n.y, c = n.z;
+    double d = -glm::dot(n, p0);
+
+    q->a2 = a * a; q->ab = a * b; q->ac = a * c; q->ad = a * d;
+    q->b2 = b * b; q->bc = b * c; q->bd = b * d;
+    q->c2 = c * c; q->cd = c * d;
+    q->d2 = d * d;
+}
+
+// Sum of squared distances from p to the planes in q
+float QuadricError(Quadric const* q, glm::vec3 p)
+{
+    double x = p.x, y = p.y, z = p.z;
+
+    double error = q->a2 * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x
+        + q->b2 * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+        + q->c2 * z * z + 2.0 * q->cd * z
+        + q->d2;
+
+    return (float)fabs(error);
+}
+
+// -1 for vertices without bones
+int DominantBone(VertexData const* vertex)
+{
+    int bone = -1;
+    float weight = 0.0f;
+
+    for (int k = 0; k < MAX_BONE_INFLUENCE; ++k) {
+        if (vertex->m_BoneIDs[k] >= 0 && vertex->m_Weights[k] > weight) {
+            bone = vertex->m_BoneIDs[k];
+            weight = vertex->m_Weights[k];
+        }
+    }
+
+    return bone;
+}
+
+void GenerateModelLods(ModelData* data)
+{
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        GenerateMeshLods(&data->m_Meshes[i]);
+    }
+}
+
+void GenerateMeshLods(MeshData* mesh)
+{
+    mesh->numLods = 1;
+    mesh->lods[0].firstIndex = 0;
+    mesh->lods[0].numIndices = mesh->numIndices;
+    mesh->lods[0].error = 0.0f;
+
+    if (mesh->numVertices == 0 || mesh->numIndices < 3 * 64 || mesh->numIndices % 3 != 0) {
+        return;
+    }
+
+    VertexData* vertices = mesh->vertices;
+    unsigned int numVertices = mesh->numVertices;
+
+    glm::vec3 minimum = vertices[0].Position;
+    glm::vec3 maximum = vertices[0].Position;
+    for (unsigned int v = 1; v < numVertices; ++v) {
+        minimum = glm::min(minimum, vertices[v].Position);
+        maximum = glm::max(maximum, vertices[v].Position);
+    }
+    float radius = glm::length(maximum - minimum) * 0.5f;
+
+    std::vector<unsigned char> locked(numVertices, 0);
+
+    // seams: more than one vertex at the same position
+    std::unordered_map<unsigned long long, unsigned int> positions;
+    std::vector<unsigned int> positionId(numVertices);
+
+    for (unsigned int v = 0; v < numVertices; ++v) {
+        unsigned long long key = HashBytes(&vertices[v].Position, sizeof(glm::vec3), FNV1A_64_OFFSET);
+
+        std::unordered_map<unsigned long long, unsigned int>::iterator found = positions.find(key);
+        if (found == positions.end()) {
+            positions[key] = v;
+            positionId[v] = v;
+        } else {
+            positionId[v] = found->second;
+            locked[v] = 1;
+            locked[found->second] = 1;
+        }
+    }
+
+    // borders: edges with a single triangle, matched by position
+    std::unordered_map<unsigned long long, int> edgeCount;
+    for (unsigned int i = 0; i < mesh->numIndices; i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            unsigned int a = positionId[mesh->indices[i + k]];
+            unsigned int b = positionId[mesh->indices[i + (k + 1) % 3]];
+            unsigned long long key = (a < b) ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+            edgeCount[key]++;
+        }
+    }
+    for (unsigned int i = 0; i < mesh->numIndices; i += 3) {
+        for (int k = 0; k < 3; ++k) {
+            unsigned int va = mesh->indices[i + k];
+            unsigned int vb = mesh->indices[i + (k + 1) % 3];
+            unsigned int a = positionId[va];
+            unsigned int b = positionId[vb];
+            unsigned long long key = (a < b) ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+            if (edgeCount[key] == 1) {
+                locked[va] = 1;
+                locked[vb] = 1;
+            }
+        }
+    }
+
+    std::vector<Quadric> quadrics(numVertices);
+    memset(quadrics.data(), 0, numVertices * sizeof(Quadric));
+
+    for (unsigned int i = 0; i < mesh->numIndices; i += 3) {
+        Quadric q;
+        QuadricFromTriangle(&q, vertices[mesh->indices[i]].Position, vertices[mesh->indices[i + 1]].Position, vertices[mesh->indices[i + 2]].Position);
+
+        for (int k = 0; k < 3; ++k) {
+            QuadricAdd(&quadrics[mesh->indices[i + k]], &q);
+        }
+    }
+
+    std::vector<unsigned int> levels(mesh->indices, mesh->indices + mesh->numIndices);
+    std::vector<unsigned int> current(levels);
+    float error = 0.0f;
+
+    for (int level = 1; level < MAX_MESH_LODS; ++level) {
+        unsigned int previous = (unsigned int)current.size();
+        unsigned int target = (unsigned int)(previous * LOD_REDUCTION) / 3 * 3;
+
+        float levelError = 0.0f;
+        SimplifyIndices(current, vertices, numVertices, locked, quadrics, target, LodErrorLimits[level] * radius, &levelError);
+
+        if (current.size() > previous * (1.0f - LOD_MIN_SAVING) || current.empty()) {
+            break;
+        }
+
+        error = std::max(error, levelError);
+
+        std::vector<unsigned int> lodIndices(current);
+        OptimizeVertexCache(lodIndices.data(), (unsigned int)lodIndices.size(), numVertices);
+
+        mesh->lods[level].firstIndex = (unsigned int)levels.size();
+        mesh->lods[level].numIndices = (unsigned int)lodIndices.size();
+        mesh->lods[level].error = error;
+        mesh->numLods = level + 1;
+
+        levels.insert(levels.end(), lodIndices.begin(), lodIndices.end());
+    }
+
+    if (mesh->numLods == 1) {
+        return;
+    }
+
+    // the index buffer now holds every level
+    free(mesh->indices);
+    mesh->indices = (unsigned int*)malloc(levels.size() * sizeof(unsigned int));
+    memcpy(mesh->indices, levels.data(), levels.size() * sizeof(unsigned int));
+    mesh->numIndices = (unsigned int)levels.size();
+}
+
+// Would moving `from` onto `to` turn any of from's remaining triangles over?
+bool CollapseFlipsTriangle(std::vector<unsigned int>& indices, std::vector<unsigned int>& triangles,
+    std::vector<unsigned int>& remap, VertexData* vertices, unsigned int from, unsigned int to)
+{
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        unsigned int t = triangles[i];
+        unsigned int v[3] = { remap[indices[t * 3]], remap[indices[t * 3 + 1]], remap[indices[t * 3 + 2]] };
+
+        if (v[0] == v[1] || v[1] == v[2] || v[0] == v[2]) {
+            continue;
+        }
+        if (v[0] == to || v[1] == to || v[2] == to) {
+            // becomes degenerate and is removed
+            continue;
+        }
+
+        glm::vec3 p[3];
+        glm::vec3 q[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = vertices[v[k]].Position;
+            q[k] = (v[k] == from) ? vertices[to].Position : p[k];
+        }
+
+        glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        glm::vec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+
+        if (glm::dot(before, after) <= 0.0f) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Collapses edges, cheapest first, until indices.size() <= targetIndices or the next
+// collapse would cost more than maxError. Returns the new index count.
+unsigned int SimplifyIndices(std::vector<unsigned int>& indices, VertexData* vertices, unsigned int numVertices,
+    std::vector<unsigned char>& locked, std::vector<Quadric>& quadrics, unsigned int targetIndices, float maxError, float* resultError)
+{
+    float maxCost = maxError * maxError;
+
+    std::vector<unsigned int> remap(numVertices);
+    for (unsigned int v = 0; v < numVertices; ++v) {
+        remap[v] = v;
+    }
+
+    while (indices.size() > targetIndices) {
+        unsigned int numTriangles = (unsigned int)indices.size() / 3;
+
+        // triangles around each vertex
+        std::vector<std::vector<unsigned int>> vertexTriangles(numVertices);
+        for (unsigned int t = 0; t < numTriangles; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                vertexTriangles[indices[t * 3 + k]].push_back(t);
+            }
+        }
+
+        std::vector<EdgeCollapse> collapses;
+        for (unsigned int t = 0; t < numTriangles; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int from = indices[t * 3 + k];
+                unsigned int to = indices[t * 3 + (k + 1) % 3];
+
+                if (locked[from] || DominantBone(&vertices[from]) != DominantBone(&vertices[to])) {
+                    continue;
+                }
+
+                Quadric q = quadrics[from];
+                QuadricAdd(&q, &quadrics[to]);
+
+                float cost = QuadricError(&q, vertices[to].Position);
+                if (cost <= maxCost) {
+                    collapses.push_back({ from, to, cost });
+                }
+            }
+        }
+
+        if (collapses.empty()) {
+            break;
+        }
+
+        std::sort(collapses.begin(), collapses.end(), [](EdgeCollapse const& a, EdgeCollapse const& b) { return a.cost < b.cost; });
+
+        // one collapse per vertex and pass, so costs and flip tests stay valid
+        std::vector<unsigned char> touched(numVertices, 0);
+        unsigned int removedTriangles = 0;
+        unsigned int trianglesToRemove = numTriangles - targetIndices / 3;
+        int performed = 0;
+
+        for (size_t i = 0; i < collapses.size() && removedTriangles < trianglesToRemove; ++i) {
+            EdgeCollapse collapse = collapses[i];
+
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+            if (CollapseFlipsTriangle(indices, vertexTriangles[collapse.from], remap, vertices, collapse.from, collapse.to)) {
+                continue;
+            }
+
+            remap[collapse.from] = collapse.to;
+            QuadricAdd(&quadrics[collapse.to], &quadrics[collapse.from]);
+
+            touched[collapse.from] = 1;
+            touched[collapse.to] = 1;
+
+            *resultError = std::max(*resultError, sqrtf(collapse.cost));
+
+            // triangles that contained the edge disappear
+            std::vector<unsigned int>& triangles = vertexTriangles[collapse.from];
+            for (size_t j = 0; j < triangles.size(); ++j) {
+                unsigned int t = triangles[j];
+                if (indices[t * 3] == collapse.to || indices[t * 3 + 1] == collapse.to || indices[t * 3 + 2] == collapse.to) {
+                    removedTriangles++;
+                }
+            }
+
+            performed++;
+        }
+
+        if (performed == 0) {
+            break;
+        }
+
+        // apply the collapses and drop degenerate triangles
+        size_t write = 0;
+        for (unsigned int t = 0; t < numTriangles; ++t) {
+            unsigned int a = remap[indices[t * 3]];
+            unsigned int b = remap[indices[t * 3 + 1]];
+            unsigned int c = remap[indices[t * 3 + 2]];
+
+            if (a == b || b == c || a == c) {
+                continue;
+            }
+
+            indices[write++] = a;
+            indices[write++] = b;
+            indices[write++] = c;
+        }
+        indices.resize(write);
+    }
+
+    return (unsigned int)indices.size();
+}
+
+#endif
@@ -6,13 +6,25 @@ Functions:
 
         Last function to all meshes in model
 
+        LoadModel first tries <path>.meshcache (mesh_cache.h). On a miss the model
+        is imported with Assimp into a ModelData and the cache is written for the
+        next start. CreateModelFromData does the OpenGL side in both cases.
+
+        A Model keeps its CPU side (name, meshes, clusters, texture paths,
+        skeleton, animations) in one linear arena (linear_arena.h), sized by
+        ModelArenaBytes before anything is copied. UnloadModel returns the mesh
+        ranges and textures and frees the arena in one go.
+
+        Mesh textures are packed into texture arrays (texture_array.h). Every
+        texture type has a fixed unit (TextureTypeSlot) and DrawModelLod passes
+        the layer and texture coordinate scale of each one in materialLayers,
+        so a bind only happens when a mesh uses a different array.
+
 \-------------------------------------------------------------------------------*/
 
 #ifndef MODEL_H
 #define MODEL_H
 
-#define MAX_BONE_INFLUENCE 4
-
 #include <glad/glad.h>
 
 #include <assimp/Importer.hpp>
@@ -25,6 +37,7 @@ Functions:
 #include <stb_image.h>
 
 #include <assimp_glm_helpers.h>
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -32,38 +45,75 @@ Functions:
 
 #include <animation.h>
 #include <skeleton.h>
+#include <linear_arena.h>
+
+#include <model_data.h>
+#include <mesh_cache.h>
+#include <texture_registry.h>
+#include <texture_residency.h>
+#include <vertex_format.h>
+#include <mesh_arena.h>
+#include <mesh_optimizer.h>
+#include <mesh_simplify.h>
+#include <mesh_cluster.h>
+#include <model_bounds.h>
+#include <render_view.h>
+#include <shader_uniforms.h>
+#include <uniform_ring.h>
+#include <instancing.h>
 
 #include <collision.h>
 #include <aabb.h>
 
-struct VertexData {
-    glm::vec3 Position;
-    glm::vec3 Normal;
-    glm::vec2 TexCoords;
-    glm::vec3 Tangent;
-    glm::vec3 Bitangent;
-    glm::vec3 Color;
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    float m_Weights[MAX_BONE_INFLUENCE];
-};
-
-struct Texture {
-    unsigned int id;
-    const char* type;
-    char* path;
-};
-
 struct Mesh {
+    // shared by every mesh in the same arena block
     unsigned int VAO;
+    MeshRange range;
+    // buffers of a mesh without an arena block (hitbox boxes), 0 otherwise
+    unsigned int VBO;
+    unsigned int EBO;
     //unsigned int numVertices;
 
    // unsigned int* indices;
     unsigned int numIndices;
 
+    // vertex buffer uses the vertex_format.h layout
+    bool packed;
+
+    // index ranges relative to range.firstIndex, level 0 is the full mesh
+    int numLods;
+    MeshLod lods[MAX_MESH_LODS];
+
+    // LOD 0 split for culling, NULL when the mesh is drawn whole
+    MeshCluster* clusters;
+    unsigned int numClusters;
+
+    // object space, from processMesh. The sphere is for texture footprints,
+    // the box for frustum culling.
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 center;
+    float radius;
+
     Texture* textures;
     unsigned int numTextures;
 };
 
+// What a mesh binds for its textures, see SetupMeshMaterial
+struct MeshMaterial {
+    unsigned int arrays[NUM_TEXTURE_TYPES];
+    float layers[NUM_TEXTURE_TYPES * 3];
+};
+
+// Looked up once per program, the samplers are set when it's first drawn with
+struct MaterialUniforms {
+    unsigned int program;
+    GLint packedVertices;
+    GLint layers;
+};
+
+std::vector<MaterialUniforms> materialUniforms;
+
 struct Model {
     char* m_Name;
 
@@ -73,27 +123,61 @@ struct Model {
     int m_NumAnimations;
     Animation* m_Animations;
 
-    glm::mat4* m_FinalBoneMatrices;
+    // bone ids run 0..m_NumBones-1, a ModelInstance holds the matrices
+    int m_NumBones;
     SkeletonNode* rootSkeletonNode;
+
+    // largest mesh error and total triangles at each level. Meshes with fewer
+    // levels draw their last one.
+    int m_NumLods;
+    float m_LodError[MAX_MESH_LODS];
+    unsigned int m_LodTriangles[MAX_MESH_LODS];
+
+    // object space box around every mesh, see model_bounds.h
+    ModelBounds m_Bounds;
+
+    // everything above that is a pointer, except the Model itself
+    LinearArena m_Arena;
 };
 
-std::vector<Texture> textures_loaded;
 std::string directory;
 
 Model* LoadModel(std::string const& path);
 
-void processNode(aiNode* node, const aiScene* scene, Model* model);
-Mesh processMesh(aiMesh* mesh, const aiScene* scene);
+ModelData* LoadModelData(std::string const& path);
+ModelData* ImportModelData(std::string const& path);
+Model* CreateModelFromData(ModelData* data);
+void ReplaceModelData(Model* model, ModelData* data);
+void UnloadModel(Model* model);
+size_t ModelArenaBytes(ModelData* data);
+void SetupMesh(Mesh* mesh, MeshData* meshData, LinearArena* arena);
+
+void processNode(aiNode* node, const aiScene* scene, ModelData* data);
+MeshData processMesh(aiMesh* mesh, const aiScene* scene);
+void CollectModelBones(const aiScene* scene, ModelData* data);
+void CompactBoneIds(ModelData* data);
+void CompactSkeletonIds(SkeletonNode* node, std::map<int, int>& localIds);
 
 unsigned int TextureFromFile(const char* path, const std::string& directory);
 void loadMaterialTextures(Texture* textures, int startIndex, int numTextures, aiMaterial* mat, aiTextureType type, const char* typeName);
+void LoadMeshTextures(Mesh* mesh, MeshData* meshData, LinearArena* arena);
+void ReleaseMeshTextures(Texture* textures, unsigned int numTextures);
 
 void SetVertexBoneDataToDefault(VertexData& vertex);
 void AssignBoneId(VertexData* vertexData, aiMesh* mesh, const aiScene* scene);
 
-unsigned int LoadMeshVertexData(VertexData* vertices, unsigned int* indices, int numVertices, int numIndices);
+unsigned int LoadMeshVertexData(MeshData* meshData, MeshRange* range);
+void PackModelVertices(ModelData* data);
 
 void DrawModel(Model* model, unsigned int shaderID);
+void DrawModelLod(Model* model, unsigned int shaderID, int lod, const glm::mat4* modelMatrix);
+void SetupMeshMaterial(Mesh* mesh, float footprint, MeshMaterial* material);
+void DrawMeshLod(Mesh* mesh, int lod, ClusterCullInfo* cullInfo);
+void DrawMeshLodInstanced(Mesh* mesh, int lod, int firstInstance, int count);
+MaterialUniforms* FindMaterialUniforms(unsigned int shaderID);
+void ForgetMaterialUniforms(unsigned int shaderID);
+void ComputeModelLods(Model* model);
+void ComputeModelBounds(Model* model);
 
 
 
@@ -101,10 +185,56 @@ void DrawModel(Model* model, unsigned int shaderID);
 
 Model* LoadModel(std::string const& path)
 {
+    ModelData* data = LoadModelData(path);
+
+    if (data == NULL) {
+        return NULL;
+    }
+
+    Model* newModel = CreateModelFromData(data);
+
+    FreeModelData(data);
+
+    return newModel;
+}
+
+// CPU only, no OpenGL calls. Safe to run on a worker thread
+ModelData* LoadModelData(std::string const& path)
+{
+    ModelData* data = ReadModelCache(path);
+
+    if (data == NULL) {
+        data = ImportModelData(path);
+
+        if (data == NULL) {
+            return NULL;
+        }
+
+        if (!WriteModelCache(path, data)) {
+            std::cout << "MESH_CACHE:: could not write cache for " << path << std::endl;
+        }
+    }
+
+    if (usePackedVertices) {
+        PackModelVertices(data);
+    }
+
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        ShrinkMeshIndices(&data->m_Meshes[i]);
+    }
 
-    // I want textures_loaded to remain global for now. In future I will make sure to only load every texture once in case different models share textures.
-    textures_loaded.clear();
+    return data;
+}
+
+void PackModelVertices(ModelData* data)
+{
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        PackMeshVertices(&data->m_Meshes[i]);
+    }
+}
 
+ModelData* ImportModelData(std::string const& path)
+{
     size_t lastSlashPos = path.find_last_of('/');
     std::string substring = path.substr(lastSlashPos + 1);
     size_t dotPos = substring.find('.');
@@ -118,47 +248,318 @@ Model* LoadModel(std::string const& path)
         return NULL;
     }
 
-    Model* newModel = (Model*)malloc(sizeof(Model));
+    ModelData* data = (ModelData*)calloc(1, sizeof(ModelData));
 
-    newModel->m_Name = (char*)malloc(nameFromPath.size() * sizeof(char));
+    data->m_Name = CopyString(nameFromPath.c_str());
+    data->m_Directory = CopyString(path.substr(0, path.find_last_of('/')).c_str());
 
-    std::strcpy(newModel->m_Name, nameFromPath.c_str());
+    data->m_NumMeshes = scene->mNumMeshes;
+    data->m_Meshes = (MeshData*)calloc(scene->mNumMeshes, sizeof(MeshData));
 
-    newModel->m_NumMeshes = scene->mNumMeshes;
-    newModel->m_Meshes = (Mesh*)malloc(scene->mNumMeshes * sizeof(Mesh));
-
-    newModel->m_NumAnimations = scene->mNumAnimations;
+    data->m_NumAnimations = scene->mNumAnimations;
 
     if (scene->mNumAnimations > 0) {
-        newModel->m_Animations = LoadAnimations(scene->mNumAnimations, scene->mAnimations);
+        data->m_Animations = LoadAnimations(scene->mNumAnimations, scene->mAnimations);
     } else {
-        newModel->m_Animations = nullptr;
+        data->m_Animations = nullptr;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(skeletonMutex);
+
+        data->rootSkeletonNode = LoadSkeleton(scene);
+
+        CollectModelBones(scene, data);
     }
 
-    newModel->rootSkeletonNode = LoadSkeleton(scene);
-    newModel->m_FinalBoneMatrices = (glm::mat4*)malloc(100 * sizeof(glm::mat4));
+    processNode(scene->mRootNode, scene, data);
+
+    CompactBoneIds(data);
+
+    OptimizeModelMeshes(data);
+    BuildModelClusters(data);
+    GenerateModelLods(data);
+
+    return data;
+}
+
+// Copies what the model keeps out of data, the caller still frees data
+Model* CreateModelFromData(ModelData* data)
+{
+    Model* newModel = (Model*)malloc(sizeof(Model));
+
+    LinearArena* arena = &newModel->m_Arena;
+    InitLinearArena(arena, ModelArenaBytes(data));
+
+    newModel->m_Name = ArenaCopyString(arena, data->m_Name);
+
+    newModel->m_NumMeshes = data->m_NumMeshes;
+    newModel->m_Meshes = ArenaAllocArray<Mesh>(arena, data->m_NumMeshes);
+
+    newModel->m_NumAnimations = data->m_NumAnimations;
+    newModel->m_Animations = CopyAnimations(arena, data->m_Animations, data->m_NumAnimations);
+
+    newModel->rootSkeletonNode = CopySkeleton(arena, data->rootSkeletonNode);
+    newModel->m_NumBones = data->m_NumBones;
+
+    directory = data->m_Directory;
+
+    size_t fullBytes = 0;
+    size_t uploadedBytes = 0;
+
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* meshData = &data->m_Meshes[i];
+        Mesh* mesh = &newModel->m_Meshes[i];
+
+        mesh->VAO = LoadMeshVertexData(meshData, &mesh->range);
+        SetupMesh(mesh, meshData, arena);
+        LoadMeshTextures(mesh, meshData, arena);
+
+        fullBytes += (size_t)meshData->numVertices * sizeof(VertexData);
+        uploadedBytes += (size_t)meshData->numVertices * (mesh->packed ? meshData->packedLayout.stride : sizeof(VertexData));
+    }
 
-    for (int i = 0; i < 100; ++i) {
-        newModel->m_FinalBoneMatrices[i] = glm::mat4(1.0f);
+    if (uploadedBytes < fullBytes) {
+        printf("Model %s: vertices %.1f KB, packed %.1f KB, saved %.1f KB (%.2fx)\n", newModel->m_Name,
+            fullBytes / 1024.0, uploadedBytes / 1024.0, (fullBytes - uploadedBytes) / 1024.0, (double)fullBytes / uploadedBytes);
     }
 
-    directory = path.substr(0, path.find_last_of('/'));
+    if (arena->numBlocks > 1) {
+        printf("Model %s: arena pre-pass was short, %d blocks\n", newModel->m_Name, arena->numBlocks);
+    }
 
-    processNode(scene->mRootNode, scene, newModel);
+    ComputeModelLods(newModel);
+    ComputeModelBounds(newModel);
 
     return newModel;
 }
 
-void processNode(aiNode* node, const aiScene* scene, Model* model)
+// Bytes CreateModelFromData takes from the model arena, so it is a single block
+size_t ModelArenaBytes(ModelData* data)
+{
+    size_t size = ArenaStringBytes(data->m_Name) + ArenaBytes(data->m_NumMeshes * sizeof(Mesh));
+
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* meshData = &data->m_Meshes[i];
+
+        size += ArenaBytes(meshData->numClusters * sizeof(MeshCluster));
+        size += ArenaBytes(meshData->numTextures * sizeof(Texture));
+
+        for (unsigned int j = 0; j < meshData->numTextures; ++j) {
+            size += ArenaStringBytes(meshData->textures[j].path);
+        }
+    }
+
+    size += SkeletonArenaBytes(data->rootSkeletonNode);
+    size += AnimationsArenaBytes(data->m_Animations, data->m_NumAnimations);
+
+    return size;
+}
+
+// Everything but the vertex upload and the textures
+void SetupMesh(Mesh* mesh, MeshData* meshData, LinearArena* arena)
+{
+    mesh->VBO = 0;
+    mesh->EBO = 0;
+    mesh->packed = meshData->packedVertices != NULL;
+
+    if (meshData->numLods > 0) {
+        mesh->numLods = meshData->numLods;
+        memcpy(mesh->lods, meshData->lods, sizeof(mesh->lods));
+    } else {
+        mesh->numLods = 1;
+        mesh->lods[0] = { 0, meshData->numIndices, 0.0f };
+    }
+    mesh->numIndices = mesh->lods[0].numIndices;
+
+    // the data may be a mapped cache file, keep a copy
+    mesh->numClusters = meshData->numClusters;
+    mesh->clusters = (MeshCluster*)ArenaCopy(arena, meshData->clusters, meshData->numClusters * sizeof(MeshCluster));
+
+    mesh->boundsMin = meshData->boundsMin;
+    mesh->boundsMax = meshData->boundsMax;
+    mesh->center = meshData->center;
+    mesh->radius = meshData->radius;
+}
+
+// Hot reload. Swaps a freshly loaded ModelData into an existing Model, so every pointer to it stays valid.
+// Meshes that still fit are rewritten in their old arena range, the rest are moved.
+// The CPU side is copied into a new linear arena and the old one is freed whole.
+void ReplaceModelData(Model* model, ModelData* data)
+{
+    directory = data->m_Directory;
+
+    int reused = 0;
+
+    LinearArena arena;
+    InitLinearArena(&arena, ModelArenaBytes(data));
+
+    Mesh* meshes = ArenaAllocArray<Mesh>(&arena, data->m_NumMeshes);
+
+    // meshes the new data doesn't have anymore
+    for (int i = data->m_NumMeshes; i < model->m_NumMeshes; ++i) {
+        FreeMeshRange(&model->m_Meshes[i].range);
+        ReleaseMeshTextures(model->m_Meshes[i].textures, model->m_Meshes[i].numTextures);
+    }
+
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* meshData = &data->m_Meshes[i];
+        Mesh* mesh = &meshes[i];
+
+        if (i < model->m_NumMeshes) {
+            Mesh* oldMesh = &model->m_Meshes[i];
+
+            mesh->VAO = oldMesh->VAO;
+            mesh->range = oldMesh->range;
+
+            if (UpdateMeshRange(meshData, &mesh->range)) {
+                reused++;
+            } else {
+                FreeMeshRange(&mesh->range);
+                mesh->VAO = LoadMeshVertexData(meshData, &mesh->range);
+            }
+
+            // acquire before releasing, so textures the mesh keeps aren't loaded again
+            LoadMeshTextures(mesh, meshData, &arena);
+            ReleaseMeshTextures(oldMesh->textures, oldMesh->numTextures);
+        } else {
+            mesh->VAO = LoadMeshVertexData(meshData, &mesh->range);
+            LoadMeshTextures(mesh, meshData, &arena);
+        }
+
+        SetupMesh(mesh, meshData, &arena);
+    }
+
+    printf("Model %s: reloaded %d meshes, %d in place\n", data->m_Name, data->m_NumMeshes, reused);
+
+    model->m_Name = ArenaCopyString(&arena, data->m_Name);
+    model->m_NumMeshes = data->m_NumMeshes;
+    model->m_Meshes = meshes;
+
+    model->m_NumAnimations = data->m_NumAnimations;
+    model->m_Animations = CopyAnimations(&arena, data->m_Animations, data->m_NumAnimations);
+    model->rootSkeletonNode = CopySkeleton(&arena, data->rootSkeletonNode);
+    // instances resize their bone palette on the next InstanceModel
+    model->m_NumBones = data->m_NumBones;
+
+    FreeLinearArena(&model->m_Arena);
+    model->m_Arena = arena;
+
+    ComputeModelLods(model);
+    ComputeModelBounds(model);
+}
+
+// Returns the meshes to the mesh arena, deletes the buffers of meshes outside it, releases
+// the textures and frees the model. Every pointer into the model is invalid afterwards.
+void UnloadModel(Model* model)
+{
+    if (model == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < model->m_NumMeshes; ++i) {
+        Mesh* mesh = &model->m_Meshes[i];
+        if (mesh->range.block == NULL && mesh->VAO != 0) {
+            glDeleteVertexArrays(1, &mesh->VAO);
+            glDeleteBuffers(1, &mesh->VBO);
+            glDeleteBuffers(1, &mesh->EBO);
+        }
+        FreeMeshRange(&mesh->range);
+        ReleaseMeshTextures(mesh->textures, mesh->numTextures);
+    }
+
+    FreeLinearArena(&model->m_Arena);
+    free(model);
+}
+
+void processNode(aiNode* node, const aiScene* scene, ModelData* data)
 {
     for (unsigned int i = 0; i < node->mNumMeshes; i++) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
+        unsigned int meshIndex = node->mMeshes[i];
+
+        // a mesh can be referenced by more than one node
+        if (data->m_Meshes[meshIndex].vertices != NULL) {
+            continue;
+        }
 
-        model->m_Meshes[i] = processMesh(mesh, scene);
+        aiMesh* mesh = scene->mMeshes[meshIndex];
+
+        data->m_Meshes[meshIndex] = processMesh(mesh, scene);
     }
 
     for (unsigned int i = 0; i < node->mNumChildren; i++) {
-        processNode(node->mChildren[i], scene, model);
+        processNode(node->mChildren[i], scene, data);
+    }
+}
+
+// BoneMap entries this model's vertices refer to, stored in the mesh cache
+void CollectModelBones(const aiScene* scene, ModelData* data)
+{
+    std::vector<std::string> names;
+
+    for (unsigned int i = 0; i < scene->mNumMeshes; ++i) {
+        aiMesh* mesh = scene->mMeshes[i];
+
+        for (unsigned int j = 0; j < mesh->mNumBones; ++j) {
+            std::string boneName = mesh->mBones[j]->mName.C_Str();
+
+            if (BoneMap.find(boneName) != BoneMap.end() && std::find(names.begin(), names.end(), boneName) == names.end()) {
+                names.push_back(boneName);
+            }
+        }
+    }
+
+    data->m_NumBones = (int)names.size();
+    data->m_BoneNames = (char**)malloc(names.size() * sizeof(char*));
+    data->m_Bones = (BoneStruct*)malloc(names.size() * sizeof(BoneStruct));
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        data->m_BoneNames[i] = CopyString(names[i].c_str());
+        data->m_Bones[i] = BoneMap[names[i]];
+    }
+}
+
+// BoneID is shared by every model and imports finish in any order, so the global ids
+// are remapped to 0..m_NumBones-1 for this model. Keeps bone matrix indices
+// under MAX_BONES and the cached ids valid no matter what was loaded before.
+void CompactBoneIds(ModelData* data)
+{
+    std::map<int, int> localIds;
+    for (int i = 0; i < data->m_NumBones; ++i) {
+        localIds[data->m_Bones[i].ID] = i;
+        data->m_Bones[i].ID = i;
+    }
+
+    CompactSkeletonIds(data->rootSkeletonNode, localIds);
+
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* mesh = &data->m_Meshes[i];
+
+        for (unsigned int j = 0; j < mesh->numVertices; ++j) {
+            for (int k = 0; k < MAX_BONE_INFLUENCE; ++k) {
+                int boneID = mesh->vertices[j].m_BoneIDs[k];
+                if (boneID >= 0) {
+                    mesh->vertices[j].m_BoneIDs[k] = localIds[boneID];
+                }
+            }
+        }
+    }
+}
+
+// Nodes that only share a name with another model's bone are not bones of this model
+void CompactSkeletonIds(SkeletonNode* node, std::map<int, int>& localIds)
+{
+    if (node == NULL) {
+        return;
+    }
+
+    if (node->id >= 0) {
+        std::map<int, int>::iterator it = localIds.find(node->id);
+        node->id = (it != localIds.end()) ? it->second : -1;
+    }
+
+    for (unsigned int i = 0; i < node->m_NumChildren; ++i) {
+        CompactSkeletonIds(node->m_Children[i], localIds);
     }
 }
 
@@ -170,7 +571,7 @@ void SetVertexBoneDataToDefault(VertexData& vertex)
     }
 }
 
-Mesh processMesh(aiMesh* mesh, const aiScene* scene)
+MeshData processMesh(aiMesh* mesh, const aiScene* scene)
 {
     int numVertices = mesh->mNumVertices;
 
@@ -193,6 +594,14 @@ Mesh processMesh(aiMesh* mesh, const aiScene* scene)
         vertexData.Position = AssimpGLMHelpers::GetGLMVec(mesh->mVertices[i]);
         vertexData.Normal = AssimpGLMHelpers::GetGLMVec(mesh->mNormals[i]);
 
+        // written to the cache as is, so never leave these uninitialized
+        vertexData.Tangent = glm::vec3(0.0f, 0.0f, 0.0f);
+        vertexData.Bitangent = glm::vec3(0.0f, 0.0f, 0.0f);
+        if (mesh->HasTangentsAndBitangents()) {
+            vertexData.Tangent = AssimpGLMHelpers::GetGLMVec(mesh->mTangents[i]);
+            vertexData.Bitangent = AssimpGLMHelpers::GetGLMVec(mesh->mBitangents[i]);
+        }
+
         vertexData.Color = glm::vec3(0.0f, 0.0f, 0.0f);
         if (mesh->HasVertexColors(0)) {
             aiColor4D color = mesh->mColors[0][i];
@@ -233,27 +642,41 @@ Mesh processMesh(aiMesh* mesh, const aiScene* scene)
     Texture* textures = (Texture*)malloc(numTextures * sizeof(Texture));
 
     int textures_index = 0;
-    loadMaterialTextures(textures, textures_index, numDiffuse, material, aiTextureType_DIFFUSE, "texture_diffuse");
+    loadMaterialTextures(textures, textures_index, numDiffuse, material, aiTextureType_DIFFUSE, TextureTypeFromName("texture_diffuse"));
     textures_index += numDiffuse;
-    loadMaterialTextures(textures, textures_index, numSpecular, material, aiTextureType_SPECULAR, "texture_specular");
+    loadMaterialTextures(textures, textures_index, numSpecular, material, aiTextureType_SPECULAR, TextureTypeFromName("texture_specular"));
     textures_index += numSpecular;
-    loadMaterialTextures(textures, textures_index, numHeight, material, aiTextureType_HEIGHT, "texture_normal");
+    loadMaterialTextures(textures, textures_index, numHeight, material, aiTextureType_HEIGHT, TextureTypeFromName("texture_normal"));
     textures_index += numHeight;
-    loadMaterialTextures(textures, textures_index, numAmbient, material, aiTextureType_AMBIENT, "texture_height");
+    loadMaterialTextures(textures, textures_index, numAmbient, material, aiTextureType_AMBIENT, TextureTypeFromName("texture_height"));
     textures_index += numAmbient;
-    loadMaterialTextures(textures, textures_index, numEmissive, material, aiTextureType_EMISSIVE, "texture_emissive");
+    loadMaterialTextures(textures, textures_index, numEmissive, material, aiTextureType_EMISSIVE, TextureTypeFromName("texture_emissive"));
 
     AssignBoneId(vertices, mesh, scene);
 
-    unsigned int VAO = LoadMeshVertexData(vertices, indices, numVertices, numIndices);
+    MeshData newMesh;
+    memset(&newMesh, 0, sizeof(MeshData));
+
+    newMesh.vertices = vertices;
+    newMesh.numVertices = (unsigned int)numVertices;
+    newMesh.indices = indices;
+    newMesh.numIndices = (unsigned int)numIndices;
+    newMesh.textures = textures;
+    newMesh.numTextures = (unsigned int)numTextures;
 
-    Mesh newMesh = { VAO, numIndices, textures, numTextures };
+    ComputeMeshBounds(&newMesh);
 
     return newMesh;
 }
 
 void AssignBoneId(VertexData* vertexData, aiMesh* mesh, const aiScene* scene)
 {
+    if (mesh->mNumBones == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(skeletonMutex);
+
     for (int i = 0; i < mesh->mNumBones; ++i) {
 
         aiBone* bone = mesh->mBones[i];
@@ -285,194 +708,293 @@ void AssignBoneId(VertexData* vertexData, aiMesh* mesh, const aiScene* scene)
     }
 }
 
-unsigned int LoadMeshVertexData(VertexData* vertices, unsigned int* indices, int numVertices, int numIndices)
+// Copies the mesh into a shared arena block (mesh_arena.h) and returns the block's VAO, 0 on failure.
+// Uploads meshData->packedVertices if the mesh was packed, the full VertexData otherwise
+unsigned int LoadMeshVertexData(MeshData* meshData, MeshRange* range)
 {
-    unsigned int VAO, VBO, EBO;
-
-    // initializes all the buffer objects/arrays
-    // now that we have all the required data, set the vertex buffers and its attribute pointers.
-    // create buffers/arrays
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-    // load data into vertex buffers
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    // A great thing about structs is that their memory layout is sequential for all its items.
-    // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-    // again translates to 3/2 floats which translates to a byte array.
-    glBufferData(GL_ARRAY_BUFFER, numVertices * sizeof(VertexData), &vertices[0], GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, numIndices * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
-
-    // set the vertex attribute pointers
-    // vertex Positions
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, TexCoords));
-    // vertex tangent
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Tangent));
-    // vertex bitangent
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Bitangent));
-    // ids
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(VertexData), (void*)offsetof(VertexData, m_BoneIDs));
-
-    // weights
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, m_Weights));
-
-    // vertex colors
-    glEnableVertexAttribArray(7);
-    glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(VertexData), (void*)offsetof(VertexData, Color));
-
-    glBindVertexArray(0);
+    if (!AllocateMeshRange(meshData, range)) {
+        range->block = NULL;
+        return 0;
+    }
 
-    return VAO;
+    return range->block->VAO;
 }
 
+// Returns right away, the texture is decoded and uploaded by texture_loader.h.
+// Holds a reference in texture_registry.h, release it with ReleaseTexture.
 unsigned int TextureFromFile(const char* path, const std::string& directory)
 {
     std::string filename = std::string(path);
     filename = directory + '/' + filename;
 
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+    return AcquireTexture(filename, DefaultTextureSettings());
+}
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+// records the material textures of a given type, the files are loaded later in LoadMeshTextures
+void loadMaterialTextures(Texture* textures, int startIndex, int numTextures, aiMaterial* mat, aiTextureType type, const char* typeName)
+{
+    for (unsigned int i = 0; i < numTextures; ++i) {
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        aiString str;
+        mat->GetTexture(type, i, &str);
 
-        // THESE IMPORTANt TO INCREASE TEXTURE QUALITY
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 2.0f);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_LOD, 2.0f);
+        // printf("GetTexture(): %s; typeName: %s\n", str.C_Str(), typeName);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        Texture texture;
+        texture.id = 0;
+        texture.type = typeName;
+        texture.path = CopyString(str.C_Str());
 
-        stbi_image_free(data);
-    } else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+        textures[startIndex + i] = texture;
     }
+}
+
+// loads the mesh textures. Files already loaded by any model come from the texture registry.
+void LoadMeshTextures(Mesh* mesh, MeshData* meshData, LinearArena* arena)
+{
+    mesh->numTextures = meshData->numTextures;
+    mesh->textures = ArenaAllocArray<Texture>(arena, meshData->numTextures);
+
+    for (unsigned int i = 0; i < meshData->numTextures; ++i) {
+
+        const char* path = meshData->textures[i].path;
 
-    return textureID;
+        // DrawModelLod reports the mesh size on screen, so texture_residency.h can pick the levels
+        TextureSettings settings = DefaultTextureSettings();
+        settings.streamed = true;
+        settings.packed = true;
+
+        Texture texture;
+        texture.id = AcquireTexture(directory + '/' + path, settings);
+        texture.type = meshData->textures[i].type;
+        texture.path = ArenaCopyString(arena, path);
+        // printf("texture: %s; typeName: %s; index: %d\n", texture.path, texture.type, i);
+
+        mesh->textures[i] = texture;
+    }
 }
 
-// checks all material textures of a given type and loads the textures if they're not loaded yet.
-// the required info is returned as a Texture structs
-void loadMaterialTextures(Texture* textures, int startIndex, int numTextures, aiMaterial* mat, aiTextureType type, const char* typeName)
+// Drops the registry references. The array and paths live in the model arena.
+void ReleaseMeshTextures(Texture* textures, unsigned int numTextures)
 {
     for (unsigned int i = 0; i < numTextures; ++i) {
+        ReleaseTexture(textures[i].id);
+    }
+}
 
-        aiString str;
-        mat->GetTexture(type, i, &str);
 
-        // printf("GetTexture(): %s; typeName: %s\n", str.C_Str(), typeName);
 
-        // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-        bool skip = false;
-        for (unsigned int j = 0; j < textures_loaded.size(); ++j) {
-            if (std::strcmp(textures_loaded[j].path, str.C_Str()) == 0) {
-                textures[startIndex + i] = textures_loaded[j];
-                skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                break;
-            }
-        }
+void ComputeModelLods(Model* model)
+{
+    model->m_NumLods = 1;
+    for (int i = 0; i < model->m_NumMeshes; ++i) {
+        model->m_NumLods = std::max(model->m_NumLods, model->m_Meshes[i].numLods);
+    }
+
+    for (int level = 0; level < MAX_MESH_LODS; ++level) {
+        model->m_LodError[level] = 0.0f;
+        model->m_LodTriangles[level] = 0;
 
-        if (!skip) { // if texture hasn't been loaded already, load it
-            Texture texture;
-            texture.id = TextureFromFile(str.C_Str(), directory);
-            texture.type = typeName;
-            texture.path = (char*)malloc(strlen(str.C_Str()) + 1);
-            strcpy(texture.path, str.C_Str());
-            // printf("texture: %s; typeName: %s; index: %d\n", texture.path, texture.type, startIndex + i);
+        for (int i = 0; i < model->m_NumMeshes; ++i) {
+            Mesh* mesh = &model->m_Meshes[i];
+            MeshLod* meshLod = &mesh->lods[std::min(level, mesh->numLods - 1)];
 
-            textures[startIndex + i] = texture;
-            textures_loaded.push_back(texture); // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+            model->m_LodError[level] = std::max(model->m_LodError[level], meshLod->error);
+            model->m_LodTriangles[level] += meshLod->numIndices / 3;
         }
     }
 }
 
+unsigned int modelBoundsCounter = 0;
+
+void ComputeModelBounds(Model* model)
+{
+    ModelBounds* bounds = &model->m_Bounds;
+
+    bounds->min = glm::vec3(FLT_MAX);
+    bounds->max = glm::vec3(-FLT_MAX);
+
+    for (int i = 0; i < model->m_NumMeshes; ++i) {
+        bounds->min = glm::min(bounds->min, model->m_Meshes[i].boundsMin);
+        bounds->max = glm::max(bounds->max, model->m_Meshes[i].boundsMax);
+    }
+
+    if (model->m_NumMeshes == 0) {
+        bounds->min = bounds->max = glm::vec3(0.0f);
+    }
+
+    bounds->animated = model->m_NumAnimations > 0;
+    bounds->id = ++modelBoundsCounter;
+}
 
 std::vector<unsigned int> leaf_nodes;
 
 void DrawModel(Model* model, unsigned int shaderID)
 {
+    DrawModelLod(model, shaderID, 0, NULL);
+}
+
+// Meshes in one arena block share a VAO, it is bound once for them and unbound at the end.
+// With a model matrix the LOD 0 clusters are culled against renderView, skinned models are never culled
+// because the clusters only bound the bind pose.
+void DrawModelLod(Model* model, unsigned int shaderID, int lod, const glm::mat4* modelMatrix)
+{
+    MaterialUniforms* uniforms = FindMaterialUniforms(shaderID);
+
+    ClusterCullInfo cullInfo;
+    bool cullClusters = clusterCulling && modelMatrix != NULL && lod == 0 && model->m_NumAnimations == 0;
+    if (cullClusters) {
+        SetupClusterCull(&cullInfo, *modelMatrix, cullBackfaces);
+    }
+
+    // tracked here instead of asking GL, a query per draw can stall the driver
+    GLuint boundVAO = 0;
+
     for (unsigned int i = 0; i < model->m_NumMeshes; i++) {
-        // bind appropriate textures
-        unsigned int diffuseNr = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
-        unsigned int heightNr = 1;
-        unsigned int emissNr = 1;
+        Mesh* mesh = &model->m_Meshes[i];
 
-        Mesh mesh = model->m_Meshes[i];
+        // without a model matrix the size on screen isn't known, ask for every level
+        float footprint = (modelMatrix != NULL) ? MeshFootprintPixels(mesh->center, mesh->radius, *modelMatrix) : FLT_MAX;
+
+        MeshMaterial material;
+        SetupMeshMaterial(mesh, footprint, &material);
 
-       
-
-        for (unsigned int i = 0; i < mesh.numTextures; i++) {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-
-            // retrieve texture number (the N in diffuse_textureN)
-            std::string number;
-            //printf("mesh.numTextures %d\n", mesh.numTextures);
-            std::string name = std::string(mesh.textures[i].type);
-
-            if (name == "texture_diffuse") {
-                number = std::to_string(diffuseNr++);
-                name = "diffuse";
-            } else if (name == "texture_specular") {
-                number = std::to_string(specularNr++);
-                name = "specular";
-            } else if (name == "texture_normal") {
-                number = std::to_string(normalNr++);
-                name = "normal";
-            } else if (name == "texture_height") {
-                number = std::to_string(heightNr++);
-                name = "height";
-            } else if (name == "texture_emissive") {
-                number = std::to_string(emissNr++);
-                name = "emission";
+        for (int slot = 0; slot < NUM_TEXTURE_TYPES; slot++) {
+            if (BindTextureArray(slot, material.arrays[slot])) {
+                renderStats.textureBinds++;
             }
+        }
+
+        glUniform3fv(uniforms->layers, NUM_TEXTURE_TYPES, material.layers);
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shaderID, ("material." + name).c_str()), i);
+        // normals and tangents are octahedral encoded in packed meshes
+        glUniform1i(uniforms->packedVertices, mesh->packed);
 
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
+        if (mesh->VAO != 0) {
+            if (mesh->VAO != boundVAO) {
+                glBindVertexArray(mesh->VAO);
+                boundVAO = mesh->VAO;
+            }
+            DrawMeshLod(mesh, lod, cullClusters ? &cullInfo : NULL);
         }
+    }
 
-        // draw mesh
-        glBindVertexArray(mesh.VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(mesh.numIndices), GL_UNSIGNED_INT, 0);
+    if (boundVAO != 0) {
         glBindVertexArray(0);
+    }
+
+    // the rest of the frame binds its 2D textures to unit 0
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// The texture arrays of a mesh and its (scale, layer) per texture type, a missing one samples nothing.
+// Reports the footprint to texture_residency.h.
+void SetupMeshMaterial(Mesh* mesh, float footprint, MeshMaterial* material)
+{
+    memset(material, 0, sizeof(MeshMaterial));
+
+    for (unsigned int j = 0; j < mesh->numTextures; j++) {
+        int slot = TextureTypeSlot(mesh->textures[j].type);
+        TextureEntry* entry = FindTexture(mesh->textures[j].id);
+
+        // the first texture of a type wins, the shaders only sample one
+        if (slot < 0 || entry == NULL || material->arrays[slot] != 0) {
+            continue;
+        }
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        NoteTextureFootprint(entry, footprint);
+
+        // still loading, or it couldn't be packed
+        if (entry->array == NULL) {
+            continue;
+        }
+
+        material->arrays[slot] = entry->array->id;
+        material->layers[slot * 3 + 0] = (float)entry->width / entry->array->format.width;
+        material->layers[slot * 3 + 1] = (float)entry->height / entry->array->format.height;
+        material->layers[slot * 3 + 2] = (float)entry->layer;
+    }
+}
+
+// The mesh VAO has to be bound. cullInfo is NULL to draw the level whole.
+void DrawMeshLod(Mesh* mesh, int lod, ClusterCullInfo* cullInfo)
+{
+    MeshLod* meshLod = &mesh->lods[std::min(lod, mesh->numLods - 1)];
+
+    size_t indexSize = (mesh->range.indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    if (cullInfo != NULL && mesh->numClusters > 0) {
+        renderStats.trianglesCulled += CullMeshClusters(mesh->clusters, mesh->numClusters, cullInfo,
+            mesh->range.firstIndex, indexSize, mesh->range.baseVertex);
+
+        if (clusterDrawList.numDraws > 0) {
+            glMultiDrawElementsBaseVertex(GL_TRIANGLES, clusterDrawList.counts, mesh->range.indexType,
+                (const void* const*)clusterDrawList.offsets, clusterDrawList.numDraws, clusterDrawList.baseVertices);
+        }
+    } else {
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<unsigned int>(meshLod->numIndices), mesh->range.indexType,
+            (void*)((size_t)(mesh->range.firstIndex + meshLod->firstIndex) * indexSize), mesh->range.baseVertex);
+    }
+
+    renderStats.meshesDrawn++;
+    renderStats.drawCalls++;
+}
+
+// The mesh VAO has to be bound, the model matrices come from instancing.h
+void DrawMeshLodInstanced(Mesh* mesh, int lod, int firstInstance, int count)
+{
+    MeshLod* meshLod = &mesh->lods[std::min(lod, mesh->numLods - 1)];
+
+    size_t indexSize = (mesh->range.indexType == GL_UNSIGNED_SHORT) ? sizeof(unsigned short) : sizeof(unsigned int);
+
+    BindInstanceAttributes(firstInstance);
+
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<unsigned int>(meshLod->numIndices), mesh->range.indexType,
+        (void*)((size_t)(mesh->range.firstIndex + meshLod->firstIndex) * indexSize), count, mesh->range.baseVertex);
+
+    renderStats.meshesDrawn += count;
+    renderStats.drawCalls++;
+}
+
+// Material samplers by texture type, see TextureTypeNames
+const UniformId MaterialSamplerIds[] = {
+    UNIFORM("material.diffuse"),
+    UNIFORM("material.specular"),
+    UNIFORM("material.normal"),
+    UNIFORM("material.height"),
+    UNIFORM("material.emission")
+};
+
+MaterialUniforms* FindMaterialUniforms(unsigned int shaderID)
+{
+    for (size_t i = 0; i < materialUniforms.size(); ++i) {
+        if (materialUniforms[i].program == shaderID) {
+            return &materialUniforms[i];
+        }
+    }
+
+    MaterialUniforms uniforms;
+    uniforms.program = shaderID;
+    uniforms.packedVertices = ShaderUniformLocation(shaderID, UNIFORM("packedVertices"));
+    uniforms.layers = ShaderUniformLocation(shaderID, UNIFORM("materialLayers"));
+
+    // the program is bound by the caller, samplers keep their unit until it's relinked
+    for (int slot = 0; slot < NUM_TEXTURE_TYPES; slot++) {
+        glUniform1i(ShaderUniformLocation(shaderID, MaterialSamplerIds[slot]), slot);
+    }
+
+    materialUniforms.push_back(uniforms);
+    return &materialUniforms.back();
+}
+
+// After a relink the locations may move and the samplers are back at unit 0
+void ForgetMaterialUniforms(unsigned int shaderID)
+{
+    for (size_t i = 0; i < materialUniforms.size(); ++i) {
+        if (materialUniforms[i].program == shaderID) {
+            materialUniforms.erase(materialUniforms.begin() + i);
+            return;
+        }
     }
 }
 
@@ -488,6 +1010,17 @@ void DrawHitbox(unsigned int VAO, unsigned int shaderID)
     glBindVertexArray(0);
 }
 
+// Model matrices from instancing.h, the shader has to be an instanced one
+void DrawHitboxInstanced(unsigned int VAO, int firstInstance, int count)
+{
+    const int numIndices = 24;
+
+    glBindVertexArray(VAO);
+    BindInstanceAttributes(firstInstance);
+    glDrawElementsInstanced(GL_LINES, numIndices, GL_UNSIGNED_INT, 0, count);
+    glBindVertexArray(0);
+}
+
 unsigned int CreateHitbox()
 {
 
@@ -546,7 +1079,8 @@ unsigned int CreateHitbox()
     return VAO;
 }
 
-void DrawAABB_Model(Model* model, unsigned int shaderID)
+// modelMatrix is the node's, every box is bound with its own color
+void DrawAABB_Model(Model* model, unsigned int shaderID, glm::mat4 const& modelMatrix)
 {
     for (int i = 0; i < model->m_NumMeshes; i++) {
 
@@ -562,7 +1096,7 @@ void DrawAABB_Model(Model* model, unsigned int shaderID)
         glUniform4fv(glGetUniformLocation(shaderID, "color"), 1, &red[0]);
         */
         glm::vec4 red = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
-        glUniform4fv(glGetUniformLocation(shaderID, "color"), 1, &red[0]);
+        BindDrawUniforms(modelMatrix, red);
 
         glm::vec4 color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
         bool collision = false;
@@ -577,7 +1111,7 @@ void DrawAABB_Model(Model* model, unsigned int shaderID)
 
         if (collision) {
             glLineWidth(3.0f);
-            glUniform4fv(glGetUniformLocation(shaderID, "color"), 1, &color[0]);
+            BindDrawUniforms(modelMatrix, color);
             glBindVertexArray(mesh.VAO);
             glDrawElements(GL_LINES, sizeof(unsigned int[24]) / sizeof(unsigned int), GL_UNSIGNED_INT, 0);
             glBindVertexArray(0);
@@ -601,7 +1135,8 @@ void MarkAABBs(AABB_node* node, std::vector<unsigned int>& ids)
 }
 
 
-void LoadHitboxVAOs(AABB_node* node, std::vector<unsigned int>& vaos)
+// Every box gets its own VAO, VBO and EBO, one after the other in buffers
+void LoadHitboxVAOs(AABB_node* node, std::vector<unsigned int>& vaos, std::vector<unsigned int>& buffers, std::vector<AABB>& boxes)
 {
     if (node == NULL) {
         return;
@@ -669,6 +1204,9 @@ void LoadHitboxVAOs(AABB_node* node, std::vector<unsigned int>& vaos)
     glEnableVertexAttribArray(0);
 
     vaos.push_back(VAO);
+    buffers.push_back(VBO);
+    buffers.push_back(EBO);
+    boxes.push_back(aabb);
 
     //aabb_map[VAO] = *node;
     node->id = VAO;
@@ -679,34 +1217,59 @@ void LoadHitboxVAOs(AABB_node* node, std::vector<unsigned int>& vaos)
     }
 
     if (node->left != NULL) {
-        LoadHitboxVAOs(node->left, vaos);
+        LoadHitboxVAOs(node->left, vaos, buffers, boxes);
     }
     if (node->right != NULL) {
-        LoadHitboxVAOs(node->right, vaos);
+        LoadHitboxVAOs(node->right, vaos, buffers, boxes);
     }
     
     
 }
 
+// The meshes have no arena block, UnloadModel deletes their VAOs and buffers.
+// The AABB tree stays with the hitbox, FreeHitbox frees it.
 Model* LoadAABB_Model(AABB_node* node)
 {
     Model* model = (Model*)malloc(sizeof(Model));
 
     std::vector<unsigned int> vaos;
+    std::vector<unsigned int> buffers;
+    std::vector<AABB> boxes;
+
+    LoadHitboxVAOs(node, vaos, buffers, boxes);
 
-    LoadHitboxVAOs(node, vaos);
+    InitLinearArena(&model->m_Arena, ArenaBytes(vaos.size() * sizeof(Mesh)));
 
-    Mesh* meshes = (Mesh*)malloc(vaos.size() * sizeof(Mesh));
+    Mesh* meshes = ArenaAllocArray<Mesh>(&model->m_Arena, vaos.size());
 
     for (int i = 0; i < vaos.size(); i++) {
         meshes[i].VAO = vaos[i];
+        meshes[i].VBO = buffers[i * 2];
+        meshes[i].EBO = buffers[i * 2 + 1];
         meshes[i].numIndices = 24;
 
         meshes[i].numTextures = 0;
+        meshes[i].packed = false;
+        meshes[i].range = { NULL, GL_UNSIGNED_INT, 0, 0, 0, 24 };
+        meshes[i].numLods = 1;
+        meshes[i].lods[0] = { 0, 24, 0.0f };
+        meshes[i].clusters = NULL;
+        meshes[i].numClusters = 0;
+        meshes[i].boundsMin = boxes[i].min;
+        meshes[i].boundsMax = boxes[i].max;
+        meshes[i].center = (boxes[i].min + boxes[i].max) * 0.5f;
+        meshes[i].radius = glm::length(boxes[i].max - boxes[i].min) * 0.5f;
     }
 
+    model->m_Name = NULL;
     model->m_NumMeshes = vaos.size();
     model->m_Meshes = meshes;
+    model->m_NumAnimations = 0;
+    model->m_Animations = NULL;
+    model->m_NumBones = 0;
+    model->rootSkeletonNode = NULL;
+    ComputeModelLods(model);
+    ComputeModelBounds(model);
 
     return model;
 }
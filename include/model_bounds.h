@@ -0,0 +1,65 @@
+/*-------------------------------------------------------------------------------\
+model_bounds.h
+
+Functions:
+    The object space box of a Model, split out of model.h so the culling
+    headers (frustum_cull.h, occlusion_cull.h) don't need it, its importer,
+    GL and texture code. ComputeModelBounds (model.h) fills it.
+
+    ComputeMeshBounds gives a MeshData its box and bounding sphere, for
+    processMesh and for the occluder meshes of occlusion_cull.h.
+
+\-------------------------------------------------------------------------------*/
+#ifndef MODEL_BOUNDS_H
+#define MODEL_BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <float.h>
+
+#include <algorithm>
+
+#include <model_data.h>
+
+struct ModelBounds {
+    // box around every mesh
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // changes whenever the bounds are computed again, scene nodes compare it
+    // to know theirs are stale
+    unsigned int id;
+
+    // animated models are never culled, the box only holds the bind pose
+    bool animated;
+};
+
+void ComputeMeshBounds(MeshData* meshData);
+
+// Box and sphere around the vertices. The later import passes only reorder
+// vertices and add index streams, so these stay valid.
+void ComputeMeshBounds(MeshData* meshData)
+{
+    if (meshData->numVertices == 0) {
+        meshData->boundsMin = meshData->boundsMax = meshData->center = glm::vec3(0.0f);
+        meshData->radius = 0.0f;
+        return;
+    }
+
+    glm::vec3 minimum(FLT_MAX);
+    glm::vec3 maximum(-FLT_MAX);
+    for (unsigned int i = 0; i < meshData->numVertices; ++i) {
+        minimum = glm::min(minimum, meshData->vertices[i].Position);
+        maximum = glm::max(maximum, meshData->vertices[i].Position);
+    }
+
+    meshData->boundsMin = minimum;
+    meshData->boundsMax = maximum;
+    meshData->center = (minimum + maximum) * 0.5f;
+    meshData->radius = 0.0f;
+    for (unsigned int i = 0; i < meshData->numVertices; ++i) {
+        meshData->radius = std::max(meshData->radius, glm::length(meshData->vertices[i].Position - meshData->center));
+    }
+}
+
+#endif
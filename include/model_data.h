@@ -0,0 +1,220 @@
+/*-------------------------------------------------------------------------------\
+model_data.h
+
+CPU side model data. Everything needed to create a Model before anything
+touches OpenGL: final vertex/index streams, texture references, skeleton,
+bone map entries and animations.
+
+Filled either by the Assimp importer (model.h) or from the mesh cache
+(mesh_cache.h).
+
+\-------------------------------------------------------------------------------*/
+#ifndef MODEL_DATA_H
+#define MODEL_DATA_H
+
+#define MAX_BONE_INFLUENCE 4
+#define MAX_MESH_LODS 4
+
+#include <glm/glm.hpp>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <animation.h>
+#include <skeleton.h>
+#include <mapped_file.h>
+
+struct VertexData {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+    glm::vec3 Color;
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    float m_Weights[MAX_BONE_INFLUENCE];
+};
+
+// Byte offsets of each attribute in a packed vertex (vertex_format.h), -1 if it is left out
+struct PackedVertexLayout {
+    int stride;
+    bool skinned;
+    bool colors;
+
+    int normalOffset;
+    int uvOffset;
+    int tangentOffset;
+    int boneIdOffset;
+    int weightOffset;
+    int colorOffset;
+};
+
+// Index range of one level of detail, relative to the start of the mesh's indices
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int numIndices;
+    // object space distance, used for screen space selection
+    float error;
+};
+
+// Contiguous run of LOD 0 triangles with its object space bounds (mesh_cluster.h)
+struct MeshCluster {
+    unsigned int firstIndex;
+    unsigned int numIndices;
+
+    glm::vec3 center;
+    float radius;
+
+    // every triangle normal is within the cone, coneCutoff is the sine of its half angle
+    glm::vec3 coneAxis;
+    float coneCutoff;
+};
+
+struct Texture {
+    unsigned int id;
+    const char* type;
+    char* path;
+};
+
+// Texture.type always points to one of these, so it can be compared and serialized by name
+const char* TextureTypeNames[] = {
+    "texture_diffuse",
+    "texture_specular",
+    "texture_normal",
+    "texture_height",
+    "texture_emissive"
+};
+const int NUM_TEXTURE_TYPES = sizeof(TextureTypeNames) / sizeof(TextureTypeNames[0]);
+
+struct MeshData {
+    VertexData* vertices;
+    unsigned int numVertices;
+
+    // every LOD level, level 0 first
+    unsigned int* indices;
+    unsigned int numIndices;
+
+    // 0 when no LODs were generated, then all indices are level 0
+    int numLods;
+    MeshLod lods[MAX_MESH_LODS];
+
+    // object space, over every vertex. The sphere is centered on the box.
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+    glm::vec3 center;
+    float radius;
+
+    // 0 when the mesh is drawn whole, otherwise the clusters cover level 0
+    MeshCluster* clusters;
+    unsigned int numClusters;
+
+    // id is 0 until the texture is uploaded
+    Texture* textures;
+    unsigned int numTextures;
+
+    // NULL unless PackMeshVertices ran, then uploaded instead of vertices
+    unsigned char* packedVertices;
+    PackedVertexLayout packedLayout;
+
+    // NULL unless ShrinkMeshIndices ran, then uploaded instead of indices
+    unsigned short* shortIndices;
+};
+
+struct ModelData {
+    char* m_Name;
+    char* m_Directory;
+
+    int m_NumMeshes;
+    MeshData* m_Meshes;
+
+    int m_NumAnimations;
+    Animation* m_Animations;
+
+    SkeletonNode* rootSkeletonNode;
+
+    // bones used by this model, their ID is the index in m_Bones
+    int m_NumBones;
+    char** m_BoneNames;
+    BoneStruct* m_Bones;
+
+    // Set when the vertex/index streams point into a mapped cache file
+    MappedFile* m_Mapping;
+};
+
+const char* TextureTypeFromName(const char* name);
+int TextureTypeSlot(const char* type);
+char* CopyString(const char* str);
+void FreeModelData(ModelData* data);
+
+const char* TextureTypeFromName(const char* name)
+{
+    for (int i = 0; i < NUM_TEXTURE_TYPES; ++i) {
+        if (strcmp(TextureTypeNames[i], name) == 0) {
+            return TextureTypeNames[i];
+        }
+    }
+    return NULL;
+}
+
+// Index into TextureTypeNames, also the texture unit the type is drawn with. -1 for a type not from there.
+int TextureTypeSlot(const char* type)
+{
+    for (int i = 0; i < NUM_TEXTURE_TYPES; ++i) {
+        if (TextureTypeNames[i] == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+char* CopyString(const char* str)
+{
+    size_t length = strlen(str);
+    char* copy = (char*)malloc(length + 1);
+    memcpy(copy, str, length + 1);
+    return copy;
+}
+
+// Frees everything. CreateModelFromData copies what the Model keeps into its own arena.
+void FreeModelData(ModelData* data)
+{
+    if (data == NULL) {
+        return;
+    }
+
+    for (int i = 0; i < data->m_NumMeshes; ++i) {
+        MeshData* mesh = &data->m_Meshes[i];
+
+        if (data->m_Mapping == NULL) {
+            free(mesh->vertices);
+            free(mesh->indices);
+            free(mesh->clusters);
+        }
+        free(mesh->packedVertices);
+        free(mesh->shortIndices);
+
+        for (unsigned int j = 0; j < mesh->numTextures; ++j) {
+            free(mesh->textures[j].path);
+        }
+        free(mesh->textures);
+    }
+    free(data->m_Meshes);
+
+    for (int i = 0; i < data->m_NumBones; ++i) {
+        free(data->m_BoneNames[i]);
+    }
+    free(data->m_BoneNames);
+    free(data->m_Bones);
+
+    FreeSkeleton(data->rootSkeletonNode);
+    FreeAnimations(data->m_Animations, data->m_NumAnimations);
+
+    free(data->m_Name);
+    free(data->m_Directory);
+
+    UnmapFile(data->m_Mapping);
+
+    free(data);
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*-------------------------------------------------------------------------------\
+model_instance.h
+
+Functions:
+    Per-object state for a shared Model. The asset manager loads every path
+    once and the Model (meshes, textures, skeleton, animations) is never
+    written while drawing, so any number of objects can use it. What differs
+    between them lives here: transform, animation playback and the bone
+    palette, sizeof(ModelInstance) plus m_NumBones matrices.
+
+    InstanceModel returns the model once the asset is ready (NULL before) and
+    sizes the palette to it, call it before animating. A hot reload that
+    changes the bone count resets the palette to identity.
+
+    Every frame AddInstanceBones copies the palette into the shared bone
+    buffer (bone_palette.h), after UploadBonePalette SetInstanceBones points
+    the shader at it.
+
+\-------------------------------------------------------------------------------*/
+#ifndef MODEL_INSTANCE_H
+#define MODEL_INSTANCE_H
+
+#include <stdlib.h>
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include <animation.h>
+#include <asset_manager.h>
+#include <bone_palette.h>
+#include <shader_m.h>
+
+struct ModelInstance {
+    ModelAsset* asset;
+    glm::mat4 transform;
+
+    int animation;
+    // ticks into the animation
+    float animationTime;
+
+    int numBones;
+    glm::mat4* boneMatrices;
+
+    // first bone in bonePalette this frame
+    int paletteOffset;
+};
+
+ModelInstance* CreateModelInstance(ModelAsset* asset);
+void FreeModelInstance(ModelInstance* instance);
+Model* InstanceModel(ModelInstance* instance);
+void AnimateModelInstance(ModelInstance* instance, float dt);
+void AddInstanceBones(ModelInstance* instance);
+void SetInstanceBones(ModelInstance* instance, unsigned int shaderID);
+
+// Takes a reference on the asset
+ModelInstance* CreateModelInstance(ModelAsset* asset)
+{
+    ModelInstance* instance = (ModelInstance*)malloc(sizeof(ModelInstance));
+
+    asset->refCount++;
+
+    instance->asset = asset;
+    instance->transform = glm::mat4(1.0f);
+    instance->animation = 0;
+    instance->animationTime = 0.0f;
+    instance->numBones = 0;
+    instance->boneMatrices = NULL;
+    instance->paletteOffset = 0;
+
+    InstanceModel(instance);
+
+    return instance;
+}
+
+void FreeModelInstance(ModelInstance* instance)
+{
+    ReleaseModelAsset(instance->asset);
+    free(instance->boneMatrices);
+    free(instance);
+}
+
+Model* InstanceModel(ModelInstance* instance)
+{
+    if (instance->asset->state != ASSET_READY) {
+        return NULL;
+    }
+
+    Model* model = instance->asset->model;
+
+    if (instance->boneMatrices == NULL || instance->numBones != model->m_NumBones) {
+        instance->numBones = model->m_NumBones;
+
+        // at least one, so a model without bones still has a valid palette
+        int count = (instance->numBones > 0) ? instance->numBones : 1;
+        instance->boneMatrices = (glm::mat4*)realloc(instance->boneMatrices, count * sizeof(glm::mat4));
+
+        for (int i = 0; i < count; ++i) {
+            instance->boneMatrices[i] = glm::mat4(1.0f);
+        }
+    }
+
+    return model;
+}
+
+// Plays instance->animation, looping. Each instance keeps its own time.
+void AnimateModelInstance(ModelInstance* instance, float dt)
+{
+    Model* model = InstanceModel(instance);
+    if (model == NULL || instance->animation < 0 || instance->animation >= model->m_NumAnimations) {
+        return;
+    }
+
+    Animation animation = model->m_Animations[instance->animation];
+
+    instance->animationTime += animation.m_TicksPerSecond * dt;
+    instance->animationTime = fmod(instance->animationTime, animation.m_Duration);
+
+    // CalculateNodeTransform samples at the global time
+    m_DeltaTime = dt;
+    m_CurrentTime = instance->animationTime;
+
+    CalculateNodeTransform(animation, model->rootSkeletonNode, instance->boneMatrices, glm::mat4(1.0f));
+}
+
+// Between BeginBonePalette and UploadBonePalette
+void AddInstanceBones(ModelInstance* instance)
+{
+    if (instance->boneMatrices == NULL) {
+        return;
+    }
+
+    int count = (instance->numBones > 0) ? instance->numBones : 1;
+    instance->paletteOffset = AddBonePalette(instance->boneMatrices, count);
+}
+
+// The program has to be bound
+void SetInstanceBones(ModelInstance* instance, unsigned int shaderID)
+{
+    BindBonePalette(shaderID);
+    setShaderInt(shaderID, UNIFORM("boneOffset"), instance->paletteOffset);
+}
+
+#endif
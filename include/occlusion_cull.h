@@ -0,0 +1,601 @@
+/*-------------------------------------------------------------------------------\
+occlusion_cull.h
+
+Functions:
+    Occlusion culling with a depth buffer rendered on the CPU. Hills, walls and
+    the map mesh are drawn depth only into a small buffer, and scene nodes whose
+    box is behind what's there are dropped before they're queued.
+
+    The occluders are the collision meshes of the hitbox nodes. LoadOccluder
+    welds the .obj (or baked .hitbox) triangles and reduces them with the LOD
+    generator of mesh_simplify.h, keeping the coarsest level within
+    OCCLUDER_MAX_ERROR of the mesh radius. Collapses keep vertices on the
+    surface, but a reduced occluder can stick out by up to that error.
+
+    RasterizeTriangle does 4 pixels of a row at once with SSE (scalar without
+    it), pixel centers and the top-left rule like the GPU, so the pixels on
+    the diagonal of a quad belong to one of its triangles. Triangles crossing
+    the near plane are clipped, the rest of the frustum is the buffer rectangle.
+    BuildOcclusionPyramid keeps the farthest depth of each 2x2 block per level,
+    OcclusionBoxVisible picks the level where the projected box covers about
+    2x2 texels and compares the box's nearest depth to the farthest there.
+
+    BeginOcclusion snapshots the occluders inside the frustum and pushes the
+    render to the worker pool, the scene walk runs meanwhile. FinishOcclusion
+    waits for it, or renders on the main thread when no worker took the job yet
+    (the pool may be busy loading models). The occluder matrices are read
+    before the tree walk, a hitbox node moved this frame occludes from the next.
+
+    The rasterizer and box test need no GL context, occlusion_test checks and
+    times them on their own.
+
+\-------------------------------------------------------------------------------*/
+#ifndef OCCLUSION_CULL_H
+#define OCCLUSION_CULL_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OCCLUSION_SSE 1
+#include <emmintrin.h>
+#endif
+
+#include <collider_cache.h>
+#include <frustum_cull.h>
+#include <mesh_simplify.h>
+#include <model_bounds.h>
+#include <render_view.h>
+#include <worker_pool.h>
+
+// width a multiple of 4, both powers of 2 for the pyramid
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+// down to 2x1
+#define OCCLUSION_LEVELS 8
+
+#define OCCLUDER_MAX_ERROR 0.03f
+
+enum OcclusionState {
+    OCCLUSION_IDLE,
+    OCCLUSION_QUEUED,
+    OCCLUSION_RUNNING,
+    OCCLUSION_DONE,
+};
+
+// object space triangles, the node's matrix is read when the frame starts
+struct Occluder {
+    const glm::mat4* matrix;
+
+    std::vector<glm::vec3> vertices;
+    std::vector<unsigned int> indices;
+
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+};
+
+struct OcclusionBuffer {
+    // level 0 is the depth, 0 near 1 far, the others the max of 2x2 below
+    float* levels[OCCLUSION_LEVELS];
+    glm::mat4 viewProjection;
+    // depth was rendered for this frame
+    bool valid;
+
+    // this frame's job, written by BeginOcclusion
+    std::vector<const Occluder*> occluders;
+    std::vector<glm::mat4> matrices;
+    std::vector<glm::vec4> clipVertices;
+
+    std::atomic<int> state;
+    std::mutex mutex;
+    std::condition_variable finished;
+
+    int numTriangles;
+    float milliseconds;
+};
+
+std::vector<Occluder*> occluders;
+OcclusionBuffer sceneOcclusion;
+bool occlusionCulling = true;
+
+bool LoadOccluder(std::string const& path, Occluder* occluder);
+void AddOccluder(std::string const& path, const glm::mat4* matrix);
+void RemoveOccluders(const glm::mat4* matrix);
+
+void InitOcclusionBuffer(OcclusionBuffer* buffer);
+void BeginOcclusion();
+void FinishOcclusion();
+bool OcclusionBoxVisible(OcclusionBuffer* buffer, glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+void RenderOcclusion(OcclusionBuffer* buffer);
+void RenderOcclusionJob(void* arg);
+int RasterizeOccluder(OcclusionBuffer* buffer, glm::mat4 const& clip, const Occluder* occluder);
+void RasterizeTriangle(float* depth, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2);
+void BuildOcclusionPyramid(OcclusionBuffer* buffer);
+
+// Collision triangles welded by position and reduced, false if there are none
+bool LoadOccluder(std::string const& path, Occluder* occluder)
+{
+    std::vector<ColliderTriangle> triangles;
+    if (!LoadColliderTriangles(path, triangles) || triangles.empty()) {
+        return false;
+    }
+
+    std::unordered_map<unsigned long long, unsigned int> welded;
+    std::vector<VertexData> vertices;
+    std::vector<unsigned int> indices;
+
+    for (size_t i = 0; i < triangles.size(); ++i) {
+        for (int k = 0; k < 3; ++k) {
+            glm::vec3 position = triangles[i].vertices[k];
+            unsigned long long key = HashBytes(&position, sizeof(glm::vec3), FNV1A_64_OFFSET);
+
+            std::unordered_map<unsigned long long, unsigned int>::iterator found = welded.find(key);
+            if (found != welded.end()) {
+                indices.push_back(found->second);
+                continue;
+            }
+
+            // no bones, every vertex has the same dominant bone (none)
+            VertexData vertex;
+            memset(&vertex, 0, sizeof(VertexData));
+            vertex.Position = position;
+
+            welded[key] = (unsigned int)vertices.size();
+            indices.push_back((unsigned int)vertices.size());
+            vertices.push_back(vertex);
+        }
+    }
+
+    MeshData mesh;
+    memset(&mesh, 0, sizeof(MeshData));
+    mesh.vertices = vertices.data();
+    mesh.numVertices = (unsigned int)vertices.size();
+    mesh.indices = (unsigned int*)malloc(indices.size() * sizeof(unsigned int));
+    memcpy(mesh.indices, indices.data(), indices.size() * sizeof(unsigned int));
+    mesh.numIndices = (unsigned int)indices.size();
+
+    ComputeMeshBounds(&mesh);
+    GenerateMeshLods(&mesh);
+
+    int level = 0;
+    for (int i = 1; i < mesh.numLods; ++i) {
+        if (mesh.lods[i].error <= OCCLUDER_MAX_ERROR * mesh.radius) {
+            level = i;
+        }
+    }
+
+    MeshLod lod = mesh.lods[level];
+
+    // only the vertices the level still uses, they're transformed every frame
+    std::vector<unsigned int> remap(vertices.size(), 0xFFFFFFFF);
+    occluder->vertices.clear();
+    occluder->indices.clear();
+
+    for (unsigned int i = 0; i < lod.numIndices; ++i) {
+        unsigned int index = mesh.indices[lod.firstIndex + i];
+        if (remap[index] == 0xFFFFFFFF) {
+            remap[index] = (unsigned int)occluder->vertices.size();
+            occluder->vertices.push_back(vertices[index].Position);
+        }
+        occluder->indices.push_back(remap[index]);
+    }
+
+    occluder->boundsMin = mesh.boundsMin;
+    occluder->boundsMax = mesh.boundsMax;
+
+    printf("Occluder %s: %zu -> %zu triangles\n", path.c_str(), triangles.size(), occluder->indices.size() / 3);
+
+    free(mesh.indices);
+    return true;
+}
+
+// matrix is the hitbox node's, RemoveOccluders takes it again
+void AddOccluder(std::string const& path, const glm::mat4* matrix)
+{
+    Occluder* occluder = new Occluder();
+    occluder->matrix = matrix;
+
+    if (!LoadOccluder(path, occluder)) {
+        delete occluder;
+        return;
+    }
+
+    occluders.push_back(occluder);
+}
+
+void RemoveOccluders(const glm::mat4* matrix)
+{
+    for (size_t i = 0; i < occluders.size();) {
+        if (occluders[i]->matrix == matrix) {
+            delete occluders[i];
+            occluders.erase(occluders.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+void InitOcclusionBuffer(OcclusionBuffer* buffer)
+{
+    for (int level = 0; level < OCCLUSION_LEVELS; ++level) {
+        int size = (OCCLUSION_WIDTH >> level) * (OCCLUSION_HEIGHT >> level);
+        buffer->levels[level] = (float*)malloc(size * sizeof(float));
+    }
+
+    buffer->valid = false;
+    buffer->state = OCCLUSION_IDLE;
+    buffer->numTriangles = 0;
+    buffer->milliseconds = 0.0f;
+}
+
+// Main thread, after SetRenderView. Occluders outside the frustum are left out.
+void BeginOcclusion()
+{
+    OcclusionBuffer* buffer = &sceneOcclusion;
+
+    buffer->valid = false;
+    buffer->occluders.clear();
+    buffer->matrices.clear();
+
+    if (!occlusionCulling || !frustumCulling || occluders.empty()) {
+        return;
+    }
+
+    if (buffer->levels[0] == NULL) {
+        InitOcclusionBuffer(buffer);
+    }
+
+    for (size_t i = 0; i < occluders.size(); ++i) {
+        glm::vec3 center;
+        glm::vec3 extent;
+        TransformBounds(*occluders[i]->matrix, occluders[i]->boundsMin, occluders[i]->boundsMax, &center, &extent);
+
+        if (BoxInFrustum(center, extent, renderView.frustum)) {
+            buffer->occluders.push_back(occluders[i]);
+            buffer->matrices.push_back(*occluders[i]->matrix);
+        }
+    }
+
+    if (buffer->occluders.empty()) {
+        return;
+    }
+
+    buffer->viewProjection = renderView.projection * renderView.view;
+
+    // the job only starts once the snapshot above is complete
+    buffer->state = OCCLUSION_QUEUED;
+    PushWorkerJob(RenderOcclusionJob, buffer);
+}
+
+void RenderOcclusionJob(void* arg)
+{
+    OcclusionBuffer* buffer = (OcclusionBuffer*)arg;
+
+    // FinishOcclusion may have done it already, or this is a job from an older frame
+    int expected = OCCLUSION_QUEUED;
+    if (!buffer->state.compare_exchange_strong(expected, OCCLUSION_RUNNING)) {
+        return;
+    }
+
+    RenderOcclusion(buffer);
+
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        buffer->state = OCCLUSION_DONE;
+    }
+    buffer->finished.notify_all();
+}
+
+// Main thread, before the first OcclusionBoxVisible of the frame
+void FinishOcclusion()
+{
+    OcclusionBuffer* buffer = &sceneOcclusion;
+
+    int expected = OCCLUSION_QUEUED;
+    if (buffer->state.compare_exchange_strong(expected, OCCLUSION_RUNNING)) {
+        RenderOcclusion(buffer);
+        buffer->state = OCCLUSION_DONE;
+    } else if (expected == OCCLUSION_RUNNING) {
+        std::unique_lock<std::mutex> lock(buffer->mutex);
+        buffer->finished.wait(lock, [buffer] { return buffer->state == OCCLUSION_DONE; });
+    }
+
+    if (buffer->state == OCCLUSION_DONE) {
+        buffer->state = OCCLUSION_IDLE;
+        buffer->valid = true;
+    }
+}
+
+void RenderOcclusion(OcclusionBuffer* buffer)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    float* depth = buffer->levels[0];
+    for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; ++i) {
+        depth[i] = 1.0f;
+    }
+
+    buffer->numTriangles = 0;
+    for (size_t i = 0; i < buffer->occluders.size(); ++i) {
+        buffer->numTriangles += RasterizeOccluder(buffer, buffer->viewProjection * buffer->matrices[i], buffer->occluders[i]);
+    }
+
+    BuildOcclusionPyramid(buffer);
+
+    buffer->milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Returns the triangles that weren't rejected outright
+int RasterizeOccluder(OcclusionBuffer* buffer, glm::mat4 const& clip, const Occluder* occluder)
+{
+    std::vector<glm::vec4>& vertices = buffer->clipVertices;
+    vertices.resize(occluder->vertices.size());
+
+    for (size_t i = 0; i < occluder->vertices.size(); ++i) {
+        vertices[i] = clip * glm::vec4(occluder->vertices[i], 1.0f);
+    }
+
+    int numDrawn = 0;
+
+    for (size_t i = 0; i + 2 < occluder->indices.size(); i += 3) {
+        glm::vec4 triangle[3] = { vertices[occluder->indices[i]], vertices[occluder->indices[i + 1]], vertices[occluder->indices[i + 2]] };
+
+        // all three outside the same side
+        bool outside = false;
+        for (int axis = 0; axis < 3 && !outside; ++axis) {
+            outside = (triangle[0][axis] > triangle[0].w && triangle[1][axis] > triangle[1].w && triangle[2][axis] > triangle[2].w)
+                || (triangle[0][axis] < -triangle[0].w && triangle[1][axis] < -triangle[1].w && triangle[2][axis] < -triangle[2].w);
+        }
+        if (outside) {
+            continue;
+        }
+
+        // clip against the near plane, z >= -w, gives up to 4 vertices
+        glm::vec4 polygon[4];
+        int numVertices = 0;
+
+        for (int k = 0; k < 3; ++k) {
+            glm::vec4 current = triangle[k];
+            glm::vec4 next = triangle[(k + 1) % 3];
+            float currentDistance = current.z + current.w;
+            float nextDistance = next.z + next.w;
+
+            if (currentDistance >= 0.0f) {
+                polygon[numVertices++] = current;
+            }
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f)) {
+                float t = currentDistance / (currentDistance - nextDistance);
+                polygon[numVertices++] = current + (next - current) * t;
+            }
+        }
+
+        if (numVertices < 3) {
+            continue;
+        }
+
+        glm::vec3 screen[4];
+        for (int k = 0; k < numVertices; ++k) {
+            glm::vec3 ndc = glm::vec3(polygon[k]) / polygon[k].w;
+            screen[k] = glm::vec3((ndc.x * 0.5f + 0.5f) * OCCLUSION_WIDTH, (ndc.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT, ndc.z * 0.5f + 0.5f);
+        }
+
+        for (int k = 1; k + 1 < numVertices; ++k) {
+            RasterizeTriangle(buffer->levels[0], screen[0], screen[k], screen[k + 1]);
+        }
+        numDrawn++;
+    }
+
+    return numDrawn;
+}
+
+// x and y in pixels, z depth. Keeps the nearer depth at every pixel center
+// inside, either winding. A center on an edge is inside when it's a top or left
+// edge, a shared edge has that on one side only.
+void RasterizeTriangle(float* depth, glm::vec3 p0, glm::vec3 p1, glm::vec3 p2)
+{
+    float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+
+    if (!(fabsf(area) > 0.0f)) {
+        return;
+    }
+    if (area < 0.0f) {
+        glm::vec3 swap = p1;
+        p1 = p2;
+        p2 = swap;
+        area = -area;
+    }
+
+    int minX = (int)glm::max(floorf(glm::min(p0.x, glm::min(p1.x, p2.x))), 0.0f);
+    int maxX = (int)glm::min(ceilf(glm::max(p0.x, glm::max(p1.x, p2.x))), (float)(OCCLUSION_WIDTH - 1));
+    int minY = (int)glm::max(floorf(glm::min(p0.y, glm::min(p1.y, p2.y))), 0.0f);
+    int maxY = (int)glm::min(ceilf(glm::max(p0.y, glm::max(p1.y, p2.y))), (float)(OCCLUSION_HEIGHT - 1));
+
+    if (minX > maxX || minY > maxY) {
+        return;
+    }
+
+    // edge a->b is A * (x - originX) + B * (y - originY), positive on the inside.
+    // The origin is the same end of a shared edge in both triangles, so they get
+    // exactly opposite values and rounding can't leave a pixel out of both.
+    glm::vec3 points[3] = { p0, p1, p2 };
+    float edgeA[3], edgeB[3], originX[3], originY[3];
+    bool topLeft[3];
+    for (int k = 0; k < 3; ++k) {
+        glm::vec3 a = points[k];
+        glm::vec3 b = points[(k + 1) % 3];
+        edgeA[k] = a.y - b.y;
+        edgeB[k] = b.x - a.x;
+
+        bool first = a.x < b.x || (a.x == b.x && a.y < b.y);
+        originX[k] = first ? a.x : b.x;
+        originY[k] = first ? a.y : b.y;
+
+        // counter clockwise with y up, the inside is left of a->b
+        topLeft[k] = edgeA[k] > 0.0f || (edgeA[k] == 0.0f && edgeB[k] < 0.0f);
+    }
+
+    // depth is linear in screen space after the divide, taken from p0 to keep
+    // the rounding small on thin triangles
+    float depthX = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / area;
+    float depthY = ((p2.z - p0.z) * (p1.x - p0.x) - (p1.z - p0.z) * (p2.x - p0.x)) / area;
+
+#ifdef OCCLUSION_SSE
+    __m128 laneCenters = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 a0 = _mm_set1_ps(edgeA[0]);
+    __m128 a1 = _mm_set1_ps(edgeA[1]);
+    __m128 a2 = _mm_set1_ps(edgeA[2]);
+    __m128 origin0 = _mm_set1_ps(originX[0]);
+    __m128 origin1 = _mm_set1_ps(originX[1]);
+    __m128 origin2 = _mm_set1_ps(originX[2]);
+    __m128 dx = _mm_set1_ps(depthX);
+    __m128 depthOrigin = _mm_set1_ps(p0.x);
+
+    // all ones on top-left edges, where >= 0 is inside instead of > 0
+    __m128 inclusive[3];
+    for (int k = 0; k < 3; ++k) {
+        inclusive[k] = _mm_castsi128_ps(_mm_set1_epi32(topLeft[k] ? -1 : 0));
+    }
+
+    int startX = minX & ~3;
+
+    for (int y = minY; y <= maxY; ++y) {
+        float centerY = y + 0.5f;
+        __m128 row0 = _mm_set1_ps(edgeB[0] * (centerY - originY[0]));
+        __m128 row1 = _mm_set1_ps(edgeB[1] * (centerY - originY[1]));
+        __m128 row2 = _mm_set1_ps(edgeB[2] * (centerY - originY[2]));
+        __m128 rowDepth = _mm_set1_ps(p0.z + depthY * (centerY - p0.y));
+
+        float* row = depth + y * OCCLUSION_WIDTH;
+
+        for (int x = startX; x <= maxX; x += 4) {
+            __m128 centerX = _mm_add_ps(_mm_set1_ps((float)x), laneCenters);
+
+            __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, _mm_sub_ps(centerX, origin0)), row0);
+            __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, _mm_sub_ps(centerX, origin1)), row1);
+            __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, _mm_sub_ps(centerX, origin2)), row2);
+
+            __m128 inside = _mm_or_ps(_mm_cmpgt_ps(w0, zero), _mm_and_ps(inclusive[0], _mm_cmpeq_ps(w0, zero)));
+            inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(w1, zero), _mm_and_ps(inclusive[1], _mm_cmpeq_ps(w1, zero))));
+            inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(w2, zero), _mm_and_ps(inclusive[2], _mm_cmpeq_ps(w2, zero))));
+
+            if (_mm_movemask_ps(inside) == 0) {
+                continue;
+            }
+
+            __m128 pixelDepth = _mm_add_ps(_mm_mul_ps(dx, _mm_sub_ps(centerX, depthOrigin)), rowDepth);
+            __m128 old = _mm_loadu_ps(row + x);
+            __m128 nearer = _mm_min_ps(old, pixelDepth);
+
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+        }
+    }
+#else
+    for (int y = minY; y <= maxY; ++y) {
+        float centerY = y + 0.5f;
+        float* row = depth + y * OCCLUSION_WIDTH;
+
+        for (int x = minX; x <= maxX; ++x) {
+            float centerX = x + 0.5f;
+            bool inside = true;
+
+            for (int k = 0; k < 3 && inside; ++k) {
+                float w = edgeA[k] * (centerX - originX[k]) + edgeB[k] * (centerY - originY[k]);
+                inside = w > 0.0f || (w == 0.0f && topLeft[k]);
+            }
+
+            if (inside) {
+                row[x] = glm::min(row[x], p0.z + depthY * (centerY - p0.y) + depthX * (centerX - p0.x));
+            }
+        }
+    }
+#endif
+}
+
+void BuildOcclusionPyramid(OcclusionBuffer* buffer)
+{
+    for (int level = 1; level < OCCLUSION_LEVELS; ++level) {
+        int width = OCCLUSION_WIDTH >> level;
+        int height = OCCLUSION_HEIGHT >> level;
+        const float* below = buffer->levels[level - 1];
+        float* current = buffer->levels[level];
+
+        for (int y = 0; y < height; ++y) {
+            const float* row0 = below + (y * 2) * (width * 2);
+            const float* row1 = row0 + width * 2;
+
+            for (int x = 0; x < width; ++x) {
+                current[y * width + x] = glm::max(glm::max(row0[x * 2], row0[x * 2 + 1]), glm::max(row1[x * 2], row1[x * 2 + 1]));
+            }
+        }
+    }
+}
+
+// World space box. True unless the whole box is behind the occluders, so also
+// for boxes crossing the near plane or off screen (the frustum test has those).
+bool OcclusionBoxVisible(OcclusionBuffer* buffer, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    if (!buffer->valid) {
+        return true;
+    }
+
+    glm::vec2 screenMin(FLT_MAX);
+    glm::vec2 screenMax(-FLT_MAX);
+    float nearest = FLT_MAX;
+
+    for (int k = 0; k < 8; ++k) {
+        glm::vec3 corner((k & 1) ? boundsMax.x : boundsMin.x, (k & 2) ? boundsMax.y : boundsMin.y, (k & 4) ? boundsMax.z : boundsMin.z);
+        glm::vec4 clip = buffer->viewProjection * glm::vec4(corner, 1.0f);
+
+        if (clip.z < -clip.w || clip.w <= 0.0f) {
+            return true;
+        }
+
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        screenMin = glm::min(screenMin, glm::vec2(ndc));
+        screenMax = glm::max(screenMax, glm::vec2(ndc));
+        nearest = glm::min(nearest, ndc.z);
+    }
+
+    if (screenMax.x < -1.0f || screenMin.x > 1.0f || screenMax.y < -1.0f || screenMin.y > 1.0f) {
+        return true;
+    }
+
+    int x0 = (int)glm::clamp(floorf((screenMin.x * 0.5f + 0.5f) * OCCLUSION_WIDTH), 0.0f, (float)(OCCLUSION_WIDTH - 1));
+    int x1 = (int)glm::clamp(floorf((screenMax.x * 0.5f + 0.5f) * OCCLUSION_WIDTH), 0.0f, (float)(OCCLUSION_WIDTH - 1));
+    int y0 = (int)glm::clamp(floorf((screenMin.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT), 0.0f, (float)(OCCLUSION_HEIGHT - 1));
+    int y1 = (int)glm::clamp(floorf((screenMax.y * 0.5f + 0.5f) * OCCLUSION_HEIGHT), 0.0f, (float)(OCCLUSION_HEIGHT - 1));
+
+    int level = 0;
+    while (level < OCCLUSION_LEVELS - 1 && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1)) {
+        level++;
+    }
+
+    int width = OCCLUSION_WIDTH >> level;
+    float farthest = 0.0f;
+
+    for (int y = y0 >> level; y <= y1 >> level; ++y) {
+        for (int x = x0 >> level; x <= x1 >> level; ++x) {
+            farthest = glm::max(farthest, buffer->levels[level][y * width + x]);
+        }
+    }
+
+    return nearest * 0.5f + 0.5f <= farthest;
+}
+
+#endif
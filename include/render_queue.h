@@ -0,0 +1,479 @@
+/*-------------------------------------------------------------------------------\
+render_queue.h
+
+Functions:
+    Draws of the scene graph are collected as packets instead of drawn while
+    walking the tree. Every visible mesh of a model node is one packet with a 64 bit
+    sort key, SubmitRenderQueue radix sorts the keys and draws in that order,
+    only changing the program, texture arrays, VAO and model matrix when they
+    differ from the packet before. The model matrix is a DrawUniforms range of
+    the uniform ring (uniform_ring.h), the binding stays across programs.
+
+    Packets of the same mesh, level and program next to each other after the
+    sort are one batch. If the program has an instanced variant (instancing.h)
+    a batch of INSTANCING_MIN_COUNT or more is one instanced draw, so the draw
+    calls follow the unique meshes instead of the nodes.
+
+    On a GL 4.3 context a program with an indirect variant (indirect_draw.h)
+    goes further, every run of packets sharing the program, VAO and texture
+    arrays becomes one glMultiDrawElementsIndirect. Copies of a mesh are one
+    command with instanceCount, visible clusters are a command each.
+
+    key bits    63-62 pass, 61-56 program (index into shaderIdArray),
+                55-40 material (hash of the texture arrays), 39-24 VAO,
+                23-0  view distance, so each state group draws front to back,
+                      or the mesh and level if the program can instance
+                      or draw indirect
+
+    The material and VAO fields are hashes/truncated ids, a collision only
+    makes the order a bit worse, the state itself is always compared.
+
+    RenderStats counts program, texture and VAO switches and draw calls. With
+    renderQueueSorted off the packets are drawn in tree order, to compare.
+
+\-------------------------------------------------------------------------------*/
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string.h>
+
+#include <vector>
+
+#include <indirect_draw.h>
+#include <instancing.h>
+#include <mesh_cluster.h>
+#include <model.h>
+#include <render_view.h>
+#include <shader_uniforms.h>
+#include <uniform_ring.h>
+
+#define RENDER_PASS_OPAQUE 0
+
+// view distance that maps to the largest depth key
+#define RENDER_QUEUE_MAX_DEPTH 10000.0f
+
+// DrawUniforms color of queued nodes, only the hitbox shaders read it
+glm::vec4 renderQueueColor = glm::vec4(1.0f, 0.0f, 0.5f, 0.5f);
+
+struct DrawPacket {
+    unsigned long long key;
+
+    unsigned int program;
+    // FindInstancedProgram of program, 0 to always draw one by one
+    unsigned int instanced;
+    // FindIndirectProgram of program, 0 unless the indirect path is active
+    unsigned int indirect;
+    Mesh* mesh;
+    int lod;
+    // the node's matrix, stays put until the queue is submitted
+    const glm::mat4* modelMatrix;
+    bool cullClusters;
+
+    MeshMaterial material;
+};
+
+struct SortItem {
+    unsigned long long key;
+    unsigned int index;
+};
+
+// items[first] to items[first + count - 1]. firstInstance is -1 unless it draws
+// instanced, firstCommand is -1 unless it's a multi-draw indirect run.
+struct RenderBatch {
+    int first;
+    int count;
+    int firstInstance;
+    int firstCommand;
+    int numCommands;
+};
+
+// GL state while the queue is submitted, to skip what's already set
+struct SubmitState {
+    unsigned int program;
+    MaterialUniforms* uniforms;
+    const glm::mat4* modelMatrix;
+    const MeshMaterial* material;
+    int packed;
+    GLint boundVAO;
+    GLint currentProgram;
+};
+
+struct RenderQueue {
+    std::vector<DrawPacket> packets;
+    std::vector<SortItem> items;
+    std::vector<SortItem> scratch;
+    std::vector<RenderBatch> batches;
+};
+
+RenderQueue renderQueue;
+bool renderQueueSorted = true;
+
+void BeginRenderQueue();
+void QueueModel(Model* model, unsigned int shaderID, unsigned int programIndex, int lod, const glm::mat4* modelMatrix, const unsigned char* meshVisible);
+void BatchRenderQueue();
+void SubmitRenderQueue();
+
+unsigned long long RenderSortKey(int pass, unsigned int programIndex, MeshMaterial const& material, unsigned int vao, unsigned int order);
+bool SameBatch(DrawPacket* a, DrawPacket* b);
+bool SameIndirectRun(DrawPacket* a, DrawPacket* b);
+void AddIndirectRun(int first, int last);
+void ApplyPacketState(SubmitState* state, DrawPacket* packet, unsigned int program);
+void RadixSortItems(std::vector<SortItem>& items, std::vector<SortItem>& scratch);
+
+void BeginRenderQueue()
+{
+    renderQueue.packets.clear();
+    BeginInstances();
+    BeginIndirectDraws();
+}
+
+// Every mesh of the model that meshVisible (one flag per mesh, frustum_cull.h) lets through,
+// NULL queues them all. programIndex is the node's index into shaderIdArray, it goes in the key
+void QueueModel(Model* model, unsigned int shaderID, unsigned int programIndex, int lod, const glm::mat4* modelMatrix, const unsigned char* meshVisible)
+{
+    bool cullClusters = clusterCulling && lod == 0 && model->m_NumAnimations == 0;
+    float distance = glm::length(glm::vec3((*modelMatrix)[3]) - renderView.position);
+    unsigned int depthOrder = (unsigned int)(glm::clamp(distance / RENDER_QUEUE_MAX_DEPTH, 0.0f, 1.0f) * 0xFFFFFF);
+    unsigned int instanced = instancingEnabled ? FindInstancedProgram(shaderID) : 0;
+    unsigned int indirect = IndirectDrawActive() ? FindIndirectProgram(shaderID) : 0;
+
+    for (int i = 0; i < model->m_NumMeshes; i++) {
+        Mesh* mesh = &model->m_Meshes[i];
+
+        if (mesh->VAO == 0 || (meshVisible != NULL && !meshVisible[i])) {
+            continue;
+        }
+
+        DrawPacket packet;
+        packet.program = shaderID;
+        packet.instanced = instanced;
+        packet.indirect = indirect;
+        packet.mesh = mesh;
+        packet.lod = lod;
+        packet.modelMatrix = modelMatrix;
+        packet.cullClusters = cullClusters && mesh->numClusters > 0;
+
+        SetupMeshMaterial(mesh, MeshFootprintPixels(mesh->center, mesh->radius, *modelMatrix), &packet.material);
+
+        // copies of a mesh have to end up next to each other to be batched
+        unsigned int order = depthOrder;
+        if (instanced != 0 || indirect != 0) {
+            size_t batchKey[2] = { (size_t)mesh, (size_t)lod };
+            order = (unsigned int)HashBytes(&batchKey, sizeof(batchKey), FNV1A_64_OFFSET);
+        }
+
+        packet.key = RenderSortKey(RENDER_PASS_OPAQUE, programIndex, packet.material, mesh->VAO, order);
+
+        renderQueue.packets.push_back(packet);
+    }
+}
+
+unsigned long long RenderSortKey(int pass, unsigned int programIndex, MeshMaterial const& material, unsigned int vao, unsigned int order)
+{
+    unsigned long long materialHash = HashBytes(material.arrays, sizeof(material.arrays), FNV1A_64_OFFSET);
+
+    unsigned long long key = 0;
+    key |= (unsigned long long)(pass & 0x3) << 62;
+    key |= (unsigned long long)(programIndex & 0x3F) << 56;
+    key |= (materialHash & 0xFFFF) << 40;
+    key |= (unsigned long long)(vao & 0xFFFF) << 24;
+    key |= (unsigned long long)(order & 0xFFFFFF);
+    return key;
+}
+
+// LSD radix sort, 8 bits a pass. A byte that's the same in every key is skipped.
+void RadixSortItems(std::vector<SortItem>& items, std::vector<SortItem>& scratch)
+{
+    size_t count = items.size();
+    scratch.resize(count);
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = { 0 };
+
+        for (size_t i = 0; i < count; ++i) {
+            offsets[(items[i].key >> shift) & 0xFF]++;
+        }
+
+        if (offsets[(items[0].key >> shift) & 0xFF] == count) {
+            continue;
+        }
+
+        size_t total = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            size_t bucketCount = offsets[bucket];
+            offsets[bucket] = total;
+            total += bucketCount;
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            scratch[offsets[(items[i].key >> shift) & 0xFF]++] = items[i];
+        }
+
+        items.swap(scratch);
+    }
+}
+
+// Sorts the packets and groups them into batches, adds the instanced ones to
+// instancing.h and the indirect runs to indirect_draw.h. UploadInstances and
+// UploadIndirectDraws have to run before SubmitRenderQueue.
+void BatchRenderQueue()
+{
+    std::vector<DrawPacket>& packets = renderQueue.packets;
+    std::vector<SortItem>& items = renderQueue.items;
+    std::vector<RenderBatch>& batches = renderQueue.batches;
+
+    batches.clear();
+
+    if (packets.empty()) {
+        return;
+    }
+
+    items.resize(packets.size());
+    for (size_t i = 0; i < packets.size(); ++i) {
+        items[i].key = packets[i].key;
+        items[i].index = (unsigned int)i;
+    }
+
+    if (renderQueueSorted) {
+        RadixSortItems(items, renderQueue.scratch);
+    }
+
+    int count = (int)items.size();
+
+    for (int first = 0; first < count;) {
+        DrawPacket* packet = &packets[items[first].index];
+
+        RenderBatch batch;
+        batch.first = first;
+        batch.firstInstance = -1;
+        batch.firstCommand = -1;
+        batch.numCommands = 0;
+
+        int last = first + 1;
+
+        if (packet->indirect != 0) {
+            while (last < count && SameIndirectRun(packet, &packets[items[last].index])) {
+                last++;
+            }
+
+            batch.firstCommand = (int)indirectDraw.commands.size();
+            AddIndirectRun(first, last);
+            batch.numCommands = (int)indirectDraw.commands.size() - batch.firstCommand;
+        } else {
+            while (last < count && SameBatch(packet, &packets[items[last].index])) {
+                last++;
+            }
+
+            if (packet->instanced != 0 && last - first >= INSTANCING_MIN_COUNT) {
+                batch.firstInstance = AddInstance(*packet->modelMatrix);
+                for (int i = first + 1; i < last; ++i) {
+                    AddInstance(*packets[items[i].index].modelMatrix);
+                }
+            }
+        }
+
+        batch.count = last - first;
+        batches.push_back(batch);
+        first = last;
+    }
+}
+
+bool SameBatch(DrawPacket* a, DrawPacket* b)
+{
+    return a->program == b->program && a->mesh == b->mesh && a->lod == b->lod;
+}
+
+// Everything one glMultiDrawElementsIndirect can't change between its draws
+bool SameIndirectRun(DrawPacket* a, DrawPacket* b)
+{
+    return a->indirect == b->indirect && a->mesh->VAO == b->mesh->VAO && a->mesh->packed == b->mesh->packed
+        && a->mesh->range.indexType == b->mesh->range.indexType
+        && memcmp(a->material.arrays, b->material.arrays, sizeof(a->material.arrays)) == 0;
+}
+
+// Commands for items[first] to items[last - 1], see SameIndirectRun
+void AddIndirectRun(int first, int last)
+{
+    std::vector<DrawPacket>& packets = renderQueue.packets;
+    std::vector<SortItem>& items = renderQueue.items;
+
+    const MeshMaterial* material = NULL;
+    int materialIndex = -1;
+
+    for (int i = first; i < last;) {
+        DrawPacket* packet = &packets[items[i].index];
+        Mesh* mesh = packet->mesh;
+        MeshLod* meshLod = &mesh->lods[std::min(packet->lod, mesh->numLods - 1)];
+
+        int end = i + 1;
+        while (end < last && SameBatch(packet, &packets[items[end].index])) {
+            end++;
+        }
+
+        if (material == NULL || memcmp(material->layers, packet->material.layers, sizeof(material->layers)) != 0) {
+            material = &packet->material;
+            materialIndex = AddIndirectMaterial(material->layers);
+        }
+
+        GLuint firstIndex = (GLuint)(mesh->range.firstIndex + meshLod->firstIndex);
+
+        // copies are one command, each instance reads its own draw
+        if (instancingEnabled && end - i >= INSTANCING_MIN_COUNT) {
+            int firstDraw = AddIndirectDraw(*packet->modelMatrix, materialIndex);
+            for (int j = i + 1; j < end; ++j) {
+                AddIndirectDraw(*packets[items[j].index].modelMatrix, materialIndex);
+            }
+
+            AddIndirectCommand((GLuint)meshLod->numIndices, (GLuint)(end - i), firstIndex, mesh->range.baseVertex, (GLuint)firstDraw);
+            i = end;
+            continue;
+        }
+
+        for (int j = i; j < end; ++j) {
+            DrawPacket* copy = &packets[items[j].index];
+            int draw = AddIndirectDraw(*copy->modelMatrix, materialIndex);
+
+            if (!copy->cullClusters) {
+                AddIndirectCommand((GLuint)meshLod->numIndices, 1, firstIndex, mesh->range.baseVertex, (GLuint)draw);
+                continue;
+            }
+
+            ClusterCullInfo cullInfo;
+            SetupClusterCull(&cullInfo, *copy->modelMatrix, cullBackfaces);
+
+            // an index size of 1 gives the offsets in indices
+            renderStats.trianglesCulled += CullMeshClusters(mesh->clusters, mesh->numClusters, &cullInfo,
+                mesh->range.firstIndex, 1, mesh->range.baseVertex);
+
+            for (unsigned int d = 0; d < clusterDrawList.numDraws; ++d) {
+                AddIndirectCommand((GLuint)clusterDrawList.counts[d], 1, (GLuint)(size_t)clusterDrawList.offsets[d],
+                    clusterDrawList.baseVertices[d], (GLuint)draw);
+            }
+        }
+        i = end;
+    }
+}
+
+void SubmitRenderQueue()
+{
+    std::vector<DrawPacket>& packets = renderQueue.packets;
+    std::vector<SortItem>& items = renderQueue.items;
+    std::vector<RenderBatch>& batches = renderQueue.batches;
+
+    if (batches.empty()) {
+        return;
+    }
+
+    SubmitState state;
+    state.program = 0;
+    state.uniforms = NULL;
+    state.modelMatrix = NULL;
+    state.material = NULL;
+    state.packed = -1;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &state.boundVAO);
+    // tree order draws glUseProgram'd per node before the queue, count it the same way
+    glGetIntegerv(GL_CURRENT_PROGRAM, &state.currentProgram);
+
+    ClusterCullInfo cullInfo;
+    const glm::mat4* cullMatrix = NULL;
+
+    // the instanced variants take the matrix from an attribute but still read the color
+    BindDrawUniforms(glm::mat4(1.0f), renderQueueColor);
+
+    for (size_t b = 0; b < batches.size(); ++b) {
+        RenderBatch* batch = &batches[b];
+        DrawPacket* packet = &packets[items[batch->first].index];
+
+        if (batch->firstCommand >= 0) {
+            // every cluster culled
+            if (batch->numCommands == 0) {
+                continue;
+            }
+
+            ApplyPacketState(&state, packet, packet->indirect);
+            BindIndirectDrawIds();
+            MultiDrawIndirect(packet->mesh->range.indexType, batch->firstCommand, batch->numCommands);
+
+            renderStats.meshesDrawn += batch->count;
+            renderStats.drawCalls++;
+            continue;
+        }
+
+        if (batch->firstInstance >= 0) {
+            // the instanced variants read the matrix from an attribute
+            ApplyPacketState(&state, packet, packet->instanced);
+            DrawMeshLodInstanced(packet->mesh, packet->lod, batch->firstInstance, batch->count);
+            continue;
+        }
+
+        for (int i = batch->first; i < batch->first + batch->count; ++i) {
+            packet = &packets[items[i].index];
+
+            ApplyPacketState(&state, packet, packet->program);
+
+            if (packet->modelMatrix != state.modelMatrix) {
+                state.modelMatrix = packet->modelMatrix;
+                BindDrawUniforms(*state.modelMatrix, renderQueueColor);
+            }
+
+            ClusterCullInfo* cull = NULL;
+            if (packet->cullClusters) {
+                if (cullMatrix != packet->modelMatrix) {
+                    SetupClusterCull(&cullInfo, *packet->modelMatrix, cullBackfaces);
+                    cullMatrix = packet->modelMatrix;
+                }
+                cull = &cullInfo;
+            }
+
+            DrawMeshLod(packet->mesh, packet->lod, cull);
+        }
+    }
+
+    // the rest of the frame binds its 2D textures to unit 0
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Program, texture arrays, packedVertices and VAO of a packet, only what differs from the state
+void ApplyPacketState(SubmitState* state, DrawPacket* packet, unsigned int program)
+{
+    if (program != state->program) {
+        state->program = program;
+        if ((GLint)program != state->currentProgram) {
+            glUseProgram(program);
+            state->currentProgram = program;
+            renderStats.programSwitches++;
+        }
+
+        state->uniforms = FindMaterialUniforms(program);
+        state->material = NULL;
+        state->packed = -1;
+    }
+
+    if (state->material == NULL || memcmp(state->material, &packet->material, sizeof(MeshMaterial)) != 0) {
+        state->material = &packet->material;
+
+        for (int slot = 0; slot < NUM_TEXTURE_TYPES; slot++) {
+            if (BindTextureArray(slot, state->material->arrays[slot])) {
+                renderStats.textureBinds++;
+            }
+        }
+        glUniform3fv(state->uniforms->layers, NUM_TEXTURE_TYPES, state->material->layers);
+    }
+
+    // normals and tangents are octahedral encoded in packed meshes
+    if ((int)packet->mesh->packed != state->packed) {
+        state->packed = packet->mesh->packed;
+        glUniform1i(state->uniforms->packedVertices, state->packed);
+    }
+
+    if ((GLint)packet->mesh->VAO != state->boundVAO) {
+        glBindVertexArray(packet->mesh->VAO);
+        state->boundVAO = packet->mesh->VAO;
+        renderStats.vaoSwitches++;
+    }
+}
+
+#endif
@@ -0,0 +1,117 @@
+/*-------------------------------------------------------------------------------\
+render_view.h
+
+Functions:
+    Camera state for the frame being drawn, set once per frame by main.cpp with
+    SetRenderView. Used by the scene graph for LOD selection and culling.
+
+    ExtractFrustumPlanes gives the 6 planes of a clip matrix (Gribb/Hartmann),
+    normalized, pointing inwards. Pass projection * view * model to get them in
+    object space.
+
+    RenderStats counts what the scene graph drew this frame, for the dev gui.
+
+\-------------------------------------------------------------------------------*/
+#ifndef RENDER_VIEW_H
+#define RENDER_VIEW_H
+
+#include <glm/glm.hpp>
+
+#include <math.h>
+#include <string.h>
+
+#define MAX_RENDER_LODS 4
+
+struct RenderView {
+    glm::vec3 position;
+    glm::mat4 view;
+    glm::mat4 projection;
+
+    int viewportHeight;
+    // pixels per object space unit at distance 1
+    float projectionScale;
+
+    // world space, left right bottom top near far
+    glm::vec4 frustum[6];
+};
+
+struct RenderStats {
+    int modelsPerLod[MAX_RENDER_LODS];
+    long long trianglesDrawn;
+    // what the same models would have cost at LOD 0
+    long long trianglesFull;
+
+    // frustum_cull.h, scene nodes and the one off draws of main.cpp
+    int modelsVisible;
+    int modelsCulled;
+    int meshesVisible;
+    int meshesCulled;
+
+    // occlusion_cull.h, nodes in the frustum behind the occluders
+    int occlusionCulled;
+    int occluderTriangles;
+    float occlusionMs;
+
+    // LOD 0 clusters rejected by the frustum or normal cone test
+    int clustersDrawn;
+    int clustersCulled;
+    long long trianglesCulled;
+
+    // texture arrays bound by DrawModelLod and the render queue, unchanged units are skipped
+    int textureBinds;
+    int meshesDrawn;
+    // an instanced draw is one call for all of its meshes
+    int drawCalls;
+
+    // state changes of the render queue, see render_queue.h
+    int programSwitches;
+    int vaoSwitches;
+};
+
+RenderView renderView;
+RenderStats renderStats;
+
+void SetRenderView(glm::vec3 position, glm::mat4 view, glm::mat4 projection, float fovRadians, int viewportHeight);
+void ResetRenderStats();
+void ExtractFrustumPlanes(glm::mat4 clip, glm::vec4* planes);
+
+void SetRenderView(glm::vec3 position, glm::mat4 view, glm::mat4 projection, float fovRadians, int viewportHeight)
+{
+    renderView.position = position;
+    renderView.view = view;
+    renderView.projection = projection;
+    renderView.viewportHeight = viewportHeight;
+    renderView.projectionScale = viewportHeight / (2.0f * tanf(fovRadians * 0.5f));
+
+    ExtractFrustumPlanes(projection * view, renderView.frustum);
+}
+
+void ExtractFrustumPlanes(glm::mat4 clip, glm::vec4* planes)
+{
+    // glm is column major, row i of the matrix is (clip[0][i], clip[1][i], clip[2][i], clip[3][i])
+    glm::vec4 row0(clip[0][0], clip[1][0], clip[2][0], clip[3][0]);
+    glm::vec4 row1(clip[0][1], clip[1][1], clip[2][1], clip[3][1]);
+    glm::vec4 row2(clip[0][2], clip[1][2], clip[2][2], clip[3][2]);
+    glm::vec4 row3(clip[0][3], clip[1][3], clip[2][3], clip[3][3]);
+
+    planes[0] = row3 + row0;
+    planes[1] = row3 - row0;
+    planes[2] = row3 + row1;
+    planes[3] = row3 - row1;
+    planes[4] = row3 + row2;
+    planes[5] = row3 - row2;
+
+    for (int i = 0; i < 6; ++i) {
+        float length = glm::length(glm::vec3(planes[i]));
+        if (length > 0.0f) {
+            planes[i] /= length;
+        }
+    }
+}
+
+void ResetRenderStats()
+{
+    memset(&renderStats, 0, sizeof(RenderStats));
+}
+
+#endif
@@ -0,0 +1,761 @@
+/*-------------------------------------------------------------------------------\
+scene_bvh.h
+
+Functions:
+    Dynamic AABB tree for spatial queries over many moving boxes, the scene
+    graph keeps one leaf (proxy) per model node in sceneBvh.
+
+    A leaf stores a fattened box, BVH_MARGIN plus BVH_MARGIN_SCALE of the
+    size on every side. BvhMoveProxy only takes the leaf out and inserts it
+    again when the new box leaves the fat one (or is much smaller), so a node
+    that moves a bit costs nothing.
+
+    Inserting walks down to the sibling that grows the tree's surface area the
+    least, removal replaces the parent with the sibling. Going back up, every
+    node on the path is rotated (BvhBalance) when one child is two levels
+    higher than the other. Only the path is balanced, not the whole tree, but
+    that keeps it O(log n) deep for any insert order.
+
+    Nodes live in one array with a free list, a proxy id is an index into it
+    and stays the same until BvhDestroyProxy.
+
+    Queries return the userData of the leaves whose fat box passes:
+        BvhQueryFrustum  inward planes, a subtree fully inside a plane skips it
+        BvhQuerySphere   box to sphere distance
+        BvhRayCast       nearest hit, the callback tests the exact shape
+
+    BenchmarkBvh builds a tree of random boxes and times it against a linear
+    scan, it's run from the dev gui.
+
+\-------------------------------------------------------------------------------*/
+#ifndef SCENE_BVH_H
+#define SCENE_BVH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include <render_view.h>
+
+#define BVH_NULL -1
+#define BVH_MIN_CAPACITY 16
+
+// fat box margin, world units plus a fraction of the box size
+#define BVH_MARGIN 0.1f
+#define BVH_MARGIN_SCALE 0.1f
+// a fat box this many margins too big is shrunk on the next move
+#define BVH_SHRINK_MARGINS 4.0f
+
+struct BvhNode {
+    glm::vec3 boundsMin;
+    glm::vec3 boundsMax;
+
+    // NULL for internal nodes
+    void* userData;
+
+    // next free node while on the free list
+    int parent;
+    int left;
+    int right;
+
+    // 0 for a leaf, -1 for a free node
+    int height;
+};
+
+struct BvhTree {
+    BvhNode* nodes;
+    int capacity;
+    int numNodes;
+    int freeList;
+    int root;
+
+    int numProxies;
+    // leaves taken out and inserted again by BvhMoveProxy
+    int numReinserts;
+
+    // traversal stack of the queries
+    std::vector<int> stack;
+};
+
+// Returns the hit distance along the ray or a negative value for a miss
+typedef float (*BvhRayCallback)(void* userData, glm::vec3 origin, glm::vec3 direction, float maxDistance);
+
+void InitBvhTree(BvhTree* tree);
+void FreeBvhTree(BvhTree* tree);
+
+int BvhCreateProxy(BvhTree* tree, glm::vec3 boundsMin, glm::vec3 boundsMax, void* userData);
+void BvhDestroyProxy(BvhTree* tree, int proxy);
+bool BvhMoveProxy(BvhTree* tree, int proxy, glm::vec3 boundsMin, glm::vec3 boundsMax);
+int BvhHeight(BvhTree* tree);
+bool BvhValidate(BvhTree* tree);
+
+void BvhQueryFrustum(BvhTree* tree, const glm::vec4* planes, std::vector<void*>& results);
+void BvhQuerySphere(BvhTree* tree, glm::vec3 center, float radius, std::vector<void*>& results);
+void* BvhRayCast(BvhTree* tree, glm::vec3 origin, glm::vec3 direction, float maxDistance, BvhRayCallback callback, float* hitDistance);
+float BvhRayBox(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 boundsMin, glm::vec3 boundsMax, float maxDistance);
+
+void BenchmarkBvh(int count);
+
+int BvhAllocNode(BvhTree* tree);
+void BvhFreeNode(BvhTree* tree, int index);
+void BvhInsertLeaf(BvhTree* tree, int leaf);
+void BvhRemoveLeaf(BvhTree* tree, int leaf);
+int BvhBalance(BvhTree* tree, int index);
+void BvhFatten(glm::vec3 boundsMin, glm::vec3 boundsMax, float margins, glm::vec3* fatMin, glm::vec3* fatMax);
+
+float BvhArea(glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    glm::vec3 size = boundsMax - boundsMin;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool BvhContains(glm::vec3 outerMin, glm::vec3 outerMax, glm::vec3 innerMin, glm::vec3 innerMax)
+{
+    return glm::all(glm::lessThanEqual(outerMin, innerMin)) && glm::all(glm::lessThanEqual(innerMax, outerMax));
+}
+
+void InitBvhTree(BvhTree* tree)
+{
+    tree->nodes = NULL;
+    tree->capacity = 0;
+    tree->numNodes = 0;
+    tree->freeList = BVH_NULL;
+    tree->root = BVH_NULL;
+    tree->numProxies = 0;
+    tree->numReinserts = 0;
+    tree->stack.clear();
+}
+
+void FreeBvhTree(BvhTree* tree)
+{
+    free(tree->nodes);
+    InitBvhTree(tree);
+}
+
+int BvhAllocNode(BvhTree* tree)
+{
+    if (tree->freeList == BVH_NULL) {
+        int capacity = (tree->capacity > 0) ? tree->capacity * 2 : BVH_MIN_CAPACITY;
+        tree->nodes = (BvhNode*)realloc(tree->nodes, capacity * sizeof(BvhNode));
+
+        // the new nodes go on the free list in order
+        for (int i = tree->capacity; i < capacity; ++i) {
+            tree->nodes[i].parent = (i + 1 < capacity) ? i + 1 : BVH_NULL;
+            tree->nodes[i].height = -1;
+        }
+        tree->freeList = tree->capacity;
+        tree->capacity = capacity;
+    }
+
+    int index = tree->freeList;
+    BvhNode* node = &tree->nodes[index];
+    tree->freeList = node->parent;
+
+    node->userData = NULL;
+    node->parent = BVH_NULL;
+    node->left = BVH_NULL;
+    node->right = BVH_NULL;
+    node->height = 0;
+
+    tree->numNodes++;
+    return index;
+}
+
+void BvhFreeNode(BvhTree* tree, int index)
+{
+    tree->nodes[index].parent = tree->freeList;
+    tree->nodes[index].height = -1;
+    tree->freeList = index;
+    tree->numNodes--;
+}
+
+void BvhFatten(glm::vec3 boundsMin, glm::vec3 boundsMax, float margins, glm::vec3* fatMin, glm::vec3* fatMax)
+{
+    glm::vec3 margin = (glm::vec3(BVH_MARGIN) + (boundsMax - boundsMin) * BVH_MARGIN_SCALE) * margins;
+    *fatMin = boundsMin - margin;
+    *fatMax = boundsMax + margin;
+}
+
+// Returns the proxy id, the leaf's index
+int BvhCreateProxy(BvhTree* tree, glm::vec3 boundsMin, glm::vec3 boundsMax, void* userData)
+{
+    int proxy = BvhAllocNode(tree);
+
+    BvhFatten(boundsMin, boundsMax, 1.0f, &tree->nodes[proxy].boundsMin, &tree->nodes[proxy].boundsMax);
+    tree->nodes[proxy].userData = userData;
+
+    BvhInsertLeaf(tree, proxy);
+    tree->numProxies++;
+
+    return proxy;
+}
+
+void BvhDestroyProxy(BvhTree* tree, int proxy)
+{
+    BvhRemoveLeaf(tree, proxy);
+    BvhFreeNode(tree, proxy);
+    tree->numProxies--;
+}
+
+// Returns true if the leaf had to be inserted again
+bool BvhMoveProxy(BvhTree* tree, int proxy, glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+    BvhNode* leaf = &tree->nodes[proxy];
+
+    glm::vec3 largestMin;
+    glm::vec3 largestMax;
+    BvhFatten(boundsMin, boundsMax, BVH_SHRINK_MARGINS, &largestMin, &largestMax);
+
+    if (BvhContains(leaf->boundsMin, leaf->boundsMax, boundsMin, boundsMax)
+        && BvhContains(largestMin, largestMax, leaf->boundsMin, leaf->boundsMax)) {
+        return false;
+    }
+
+    BvhRemoveLeaf(tree, proxy);
+    BvhFatten(boundsMin, boundsMax, 1.0f, &leaf->boundsMin, &leaf->boundsMax);
+    BvhInsertLeaf(tree, proxy);
+
+    tree->numReinserts++;
+    return true;
+}
+
+int BvhHeight(BvhTree* tree)
+{
+    return (tree->root != BVH_NULL) ? tree->nodes[tree->root].height : 0;
+}
+
+void BvhInsertLeaf(BvhTree* tree, int leaf)
+{
+    BvhNode* nodes = tree->nodes;
+
+    if (tree->root == BVH_NULL) {
+        tree->root = leaf;
+        nodes[leaf].parent = BVH_NULL;
+        return;
+    }
+
+    glm::vec3 leafMin = nodes[leaf].boundsMin;
+    glm::vec3 leafMax = nodes[leaf].boundsMax;
+
+    // Walk down to the cheapest sibling. Pairing with a node costs the area of
+    // the new parent, and every ancestor grows by what the leaf adds to it.
+    int index = tree->root;
+    while (nodes[index].height > 0) {
+        int left = nodes[index].left;
+        int right = nodes[index].right;
+
+        float area = BvhArea(nodes[index].boundsMin, nodes[index].boundsMax);
+        float combinedArea = BvhArea(glm::min(nodes[index].boundsMin, leafMin), glm::max(nodes[index].boundsMax, leafMax));
+
+        float cost = 2.0f * combinedArea;
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        float costLeft = BvhArea(glm::min(nodes[left].boundsMin, leafMin), glm::max(nodes[left].boundsMax, leafMax)) + inheritanceCost;
+        if (nodes[left].height > 0) {
+            costLeft -= BvhArea(nodes[left].boundsMin, nodes[left].boundsMax);
+        }
+
+        float costRight = BvhArea(glm::min(nodes[right].boundsMin, leafMin), glm::max(nodes[right].boundsMax, leafMax)) + inheritanceCost;
+        if (nodes[right].height > 0) {
+            costRight -= BvhArea(nodes[right].boundsMin, nodes[right].boundsMax);
+        }
+
+        if (cost < costLeft && cost < costRight) {
+            break;
+        }
+
+        index = (costLeft < costRight) ? left : right;
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+
+    // may move the array
+    int newParent = BvhAllocNode(tree);
+    nodes = tree->nodes;
+
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].boundsMin = glm::min(leafMin, nodes[sibling].boundsMin);
+    nodes[newParent].boundsMax = glm::max(leafMax, nodes[sibling].boundsMax);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling;
+    nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != BVH_NULL) {
+        if (nodes[oldParent].left == sibling) {
+            nodes[oldParent].left = newParent;
+        } else {
+            nodes[oldParent].right = newParent;
+        }
+    } else {
+        tree->root = newParent;
+    }
+
+    for (index = nodes[leaf].parent; index != BVH_NULL; index = nodes[index].parent) {
+        index = BvhBalance(tree, index);
+
+        int left = nodes[index].left;
+        int right = nodes[index].right;
+
+        nodes[index].height = 1 + glm::max(nodes[left].height, nodes[right].height);
+        nodes[index].boundsMin = glm::min(nodes[left].boundsMin, nodes[right].boundsMin);
+        nodes[index].boundsMax = glm::max(nodes[left].boundsMax, nodes[right].boundsMax);
+    }
+}
+
+void BvhRemoveLeaf(BvhTree* tree, int leaf)
+{
+    BvhNode* nodes = tree->nodes;
+
+    if (leaf == tree->root) {
+        tree->root = BVH_NULL;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = (nodes[parent].left == leaf) ? nodes[parent].right : nodes[parent].left;
+
+    BvhFreeNode(tree, parent);
+
+    if (grandParent == BVH_NULL) {
+        tree->root = sibling;
+        nodes[sibling].parent = BVH_NULL;
+        return;
+    }
+
+    if (nodes[grandParent].left == parent) {
+        nodes[grandParent].left = sibling;
+    } else {
+        nodes[grandParent].right = sibling;
+    }
+    nodes[sibling].parent = grandParent;
+
+    for (int index = grandParent; index != BVH_NULL; index = nodes[index].parent) {
+        index = BvhBalance(tree, index);
+
+        int left = nodes[index].left;
+        int right = nodes[index].right;
+
+        nodes[index].height = 1 + glm::max(nodes[left].height, nodes[right].height);
+        nodes[index].boundsMin = glm::min(nodes[left].boundsMin, nodes[right].boundsMin);
+        nodes[index].boundsMax = glm::max(nodes[left].boundsMax, nodes[right].boundsMax);
+    }
+}
+
+// If child c of a is 2 or more levels higher than its sibling b, c takes a's
+// place with a as its left child. c keeps its higher child and hands the lower
+// one to a, next to b. Same the other way round. Returns the node now in a's place.
+int BvhBalance(BvhTree* tree, int a)
+{
+    BvhNode* nodes = tree->nodes;
+
+    if (nodes[a].height < 2) {
+        return a;
+    }
+
+    int b = nodes[a].left;
+    int c = nodes[a].right;
+    int balance = nodes[c].height - nodes[b].height;
+
+    if (balance > 1) {
+        int f = nodes[c].left;
+        int g = nodes[c].right;
+
+        nodes[c].left = a;
+        nodes[c].parent = nodes[a].parent;
+        nodes[a].parent = c;
+
+        if (nodes[c].parent != BVH_NULL) {
+            if (nodes[nodes[c].parent].left == a) {
+                nodes[nodes[c].parent].left = c;
+            } else {
+                nodes[nodes[c].parent].right = c;
+            }
+        } else {
+            tree->root = c;
+        }
+
+        // the higher grandchild stays with c
+        int keep = (nodes[f].height > nodes[g].height) ? f : g;
+        int give = (keep == f) ? g : f;
+
+        nodes[c].right = keep;
+        nodes[a].right = give;
+        nodes[give].parent = a;
+
+        nodes[a].boundsMin = glm::min(nodes[b].boundsMin, nodes[give].boundsMin);
+        nodes[a].boundsMax = glm::max(nodes[b].boundsMax, nodes[give].boundsMax);
+        nodes[a].height = 1 + glm::max(nodes[b].height, nodes[give].height);
+
+        nodes[c].boundsMin = glm::min(nodes[a].boundsMin, nodes[keep].boundsMin);
+        nodes[c].boundsMax = glm::max(nodes[a].boundsMax, nodes[keep].boundsMax);
+        nodes[c].height = 1 + glm::max(nodes[a].height, nodes[keep].height);
+
+        return c;
+    }
+
+    if (balance < -1) {
+        int d = nodes[b].left;
+        int e = nodes[b].right;
+
+        nodes[b].left = a;
+        nodes[b].parent = nodes[a].parent;
+        nodes[a].parent = b;
+
+        if (nodes[b].parent != BVH_NULL) {
+            if (nodes[nodes[b].parent].left == a) {
+                nodes[nodes[b].parent].left = b;
+            } else {
+                nodes[nodes[b].parent].right = b;
+            }
+        } else {
+            tree->root = b;
+        }
+
+        int keep = (nodes[d].height > nodes[e].height) ? d : e;
+        int give = (keep == d) ? e : d;
+
+        nodes[b].right = keep;
+        nodes[a].left = give;
+        nodes[give].parent = a;
+
+        nodes[a].boundsMin = glm::min(nodes[c].boundsMin, nodes[give].boundsMin);
+        nodes[a].boundsMax = glm::max(nodes[c].boundsMax, nodes[give].boundsMax);
+        nodes[a].height = 1 + glm::max(nodes[c].height, nodes[give].height);
+
+        nodes[b].boundsMin = glm::min(nodes[a].boundsMin, nodes[keep].boundsMin);
+        nodes[b].boundsMax = glm::max(nodes[a].boundsMax, nodes[keep].boundsMax);
+        nodes[b].height = 1 + glm::max(nodes[a].height, nodes[keep].height);
+
+        return b;
+    }
+
+    return a;
+}
+
+// Parent links, heights and boxes of the whole tree, for the benchmark
+bool BvhValidate(BvhTree* tree)
+{
+    if (tree->root == BVH_NULL) {
+        return tree->numProxies == 0;
+    }
+
+    std::vector<int> stack;
+    stack.push_back(tree->root);
+
+    int numNodes = 0;
+    int numLeaves = 0;
+
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+
+        BvhNode* node = &tree->nodes[index];
+        numNodes++;
+
+        if (node->height == 0) {
+            numLeaves++;
+            continue;
+        }
+
+        BvhNode* left = &tree->nodes[node->left];
+        BvhNode* right = &tree->nodes[node->right];
+
+        if (left->parent != index || right->parent != index) {
+            return false;
+        }
+        if (node->height != 1 + glm::max(left->height, right->height)) {
+            return false;
+        }
+        if (!BvhContains(node->boundsMin, node->boundsMax, left->boundsMin, left->boundsMax)
+            || !BvhContains(node->boundsMin, node->boundsMax, right->boundsMin, right->boundsMax)) {
+            return false;
+        }
+
+        stack.push_back(node->left);
+        stack.push_back(node->right);
+    }
+
+    return numNodes == tree->numNodes && numLeaves == tree->numProxies;
+}
+
+// Planes as from ExtractFrustumPlanes. Each stack entry carries the planes its
+// box still crosses, a box fully inside a plane doesn't test it again below.
+void BvhQueryFrustum(BvhTree* tree, const glm::vec4* planes, std::vector<void*>& results)
+{
+    if (tree->root == BVH_NULL) {
+        return;
+    }
+
+    std::vector<int>& stack = tree->stack;
+    stack.clear();
+    stack.push_back(tree->root);
+    stack.push_back(0x3F);
+
+    while (!stack.empty()) {
+        int mask = stack.back();
+        stack.pop_back();
+        int index = stack.back();
+        stack.pop_back();
+
+        BvhNode* node = &tree->nodes[index];
+
+        if (mask != 0) {
+            glm::vec3 center = (node->boundsMin + node->boundsMax) * 0.5f;
+            glm::vec3 extent = (node->boundsMax - node->boundsMin) * 0.5f;
+
+            bool outside = false;
+            for (int p = 0; p < 6 && !outside; ++p) {
+                if ((mask & (1 << p)) == 0) {
+                    continue;
+                }
+
+                glm::vec3 normal = glm::vec3(planes[p]);
+                float distance = glm::dot(normal, center) + planes[p].w;
+                float radius = glm::dot(glm::abs(normal), extent);
+
+                if (distance < -radius) {
+                    outside = true;
+                } else if (distance > radius) {
+                    mask &= ~(1 << p);
+                }
+            }
+
+            if (outside) {
+                continue;
+            }
+        }
+
+        if (node->height == 0) {
+            results.push_back(node->userData);
+            continue;
+        }
+
+        stack.push_back(node->left);
+        stack.push_back(mask);
+        stack.push_back(node->right);
+        stack.push_back(mask);
+    }
+}
+
+void BvhQuerySphere(BvhTree* tree, glm::vec3 center, float radius, std::vector<void*>& results)
+{
+    if (tree->root == BVH_NULL) {
+        return;
+    }
+
+    std::vector<int>& stack = tree->stack;
+    stack.clear();
+    stack.push_back(tree->root);
+
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+
+        BvhNode* node = &tree->nodes[index];
+
+        glm::vec3 closest = glm::clamp(center, node->boundsMin, node->boundsMax);
+        glm::vec3 offset = closest - center;
+        if (glm::dot(offset, offset) > radius * radius) {
+            continue;
+        }
+
+        if (node->height == 0) {
+            results.push_back(node->userData);
+            continue;
+        }
+
+        stack.push_back(node->left);
+        stack.push_back(node->right);
+    }
+}
+
+// Slab test. Returns where the ray enters the box (0 if it starts inside), or
+// -1 if it misses it before maxDistance.
+float BvhRayBox(glm::vec3 origin, glm::vec3 inverseDirection, glm::vec3 boundsMin, glm::vec3 boundsMax, float maxDistance)
+{
+    glm::vec3 t0 = (boundsMin - origin) * inverseDirection;
+    glm::vec3 t1 = (boundsMax - origin) * inverseDirection;
+
+    glm::vec3 slabEnter = glm::min(t0, t1);
+    glm::vec3 slabExit = glm::max(t0, t1);
+
+    float enter = glm::max(glm::max(slabEnter.x, slabEnter.y), glm::max(slabEnter.z, 0.0f));
+    float exit = glm::min(glm::min(slabExit.x, slabExit.y), glm::min(slabExit.z, maxDistance));
+
+    return (enter <= exit) ? enter : -1.0f;
+}
+
+// Nearest leaf the callback reports a hit on. The nearer child is visited
+// first, and subtrees that start past the best hit so far are skipped.
+void* BvhRayCast(BvhTree* tree, glm::vec3 origin, glm::vec3 direction, float maxDistance, BvhRayCallback callback, float* hitDistance)
+{
+    void* hit = NULL;
+    float best = maxDistance;
+
+    if (tree->root == BVH_NULL) {
+        return NULL;
+    }
+
+    // a zero component gives inf, the slab test handles it
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    std::vector<int>& stack = tree->stack;
+    stack.clear();
+
+    if (BvhRayBox(origin, inverseDirection, tree->nodes[tree->root].boundsMin, tree->nodes[tree->root].boundsMax, best) >= 0.0f) {
+        stack.push_back(tree->root);
+    }
+
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+
+        BvhNode* node = &tree->nodes[index];
+
+        if (node->height == 0) {
+            float distance = callback(node->userData, origin, direction, best);
+            if (distance >= 0.0f && distance < best) {
+                best = distance;
+                hit = node->userData;
+            }
+            continue;
+        }
+
+        BvhNode* left = &tree->nodes[node->left];
+        BvhNode* right = &tree->nodes[node->right];
+
+        float leftDistance = BvhRayBox(origin, inverseDirection, left->boundsMin, left->boundsMax, best);
+        float rightDistance = BvhRayBox(origin, inverseDirection, right->boundsMin, right->boundsMax, best);
+
+        // the nearer one is pushed last so it's popped first
+        if (leftDistance >= 0.0f && rightDistance >= 0.0f) {
+            bool leftFirst = leftDistance <= rightDistance;
+            stack.push_back(leftFirst ? node->right : node->left);
+            stack.push_back(leftFirst ? node->left : node->right);
+        } else if (leftDistance >= 0.0f) {
+            stack.push_back(node->left);
+        } else if (rightDistance >= 0.0f) {
+            stack.push_back(node->right);
+        }
+    }
+
+    if (hitDistance != NULL) {
+        *hitDistance = best;
+    }
+    return hit;
+}
+
+// userData of the benchmark's leaves points at its tight box
+float BenchmarkRayCallback(void* userData, glm::vec3 origin, glm::vec3 direction, float maxDistance)
+{
+    glm::vec3* box = (glm::vec3*)userData;
+    return BvhRayBox(origin, 1.0f / direction, box[0], box[1], maxDistance);
+}
+
+// count random boxes in a cube that grows with the count. Times building the
+// tree, moving every box a little, and frustum, sphere and ray queries
+// against testing every box.
+void BenchmarkBvh(int count)
+{
+    float size = 10.0f * cbrtf((float)count);
+    std::vector<glm::vec3> boxes(count * 2);
+
+    srand(1);
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 position = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * size;
+        glm::vec3 extent = glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 2.0f + 0.25f;
+        boxes[i * 2] = position - extent;
+        boxes[i * 2 + 1] = position + extent;
+    }
+
+    BvhTree tree;
+    InitBvhTree(&tree);
+    std::vector<int> proxies(count);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        proxies[i] = BvhCreateProxy(&tree, boxes[i * 2], boxes[i * 2 + 1], &boxes[i * 2]);
+    }
+    std::chrono::steady_clock::time_point built = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < count; ++i) {
+        glm::vec3 step = (glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX - 0.5f) * 0.5f;
+        boxes[i * 2] += step;
+        boxes[i * 2 + 1] += step;
+        BvhMoveProxy(&tree, proxies[i], boxes[i * 2], boxes[i * 2 + 1]);
+    }
+    std::chrono::steady_clock::time_point moved = std::chrono::steady_clock::now();
+
+    glm::vec3 eye = glm::vec3(size * 0.5f, size * 0.5f, -size * 0.1f);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, size * 0.5f);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(size * 0.5f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec4 planes[6];
+    ExtractFrustumPlanes(projection * view, planes);
+
+    const int queries = 100;
+    std::vector<void*> results;
+    size_t treeHits = 0;
+    size_t scanHits = 0;
+
+    std::chrono::steady_clock::time_point queryStart = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+        results.clear();
+        BvhQueryFrustum(&tree, planes, results);
+        treeHits += results.size();
+    }
+    std::chrono::steady_clock::time_point queryTree = std::chrono::steady_clock::now();
+    for (int q = 0; q < queries; ++q) {
+        for (int i = 0; i < count; ++i) {
+            glm::vec3 center = (boxes[i * 2] + boxes[i * 2 + 1]) * 0.5f;
+            glm::vec3 extent = (boxes[i * 2 + 1] - boxes[i * 2]) * 0.5f;
+
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; ++p) {
+                glm::vec3 normal = glm::vec3(planes[p]);
+                inside = glm::dot(normal, center) + planes[p].w >= -glm::dot(glm::abs(normal), extent);
+            }
+            scanHits += inside;
+        }
+    }
+    std::chrono::steady_clock::time_point queryScan = std::chrono::steady_clock::now();
+
+    size_t sphereHits = 0;
+    for (int q = 0; q < queries; ++q) {
+        results.clear();
+        BvhQuerySphere(&tree, glm::vec3(size * 0.01f * q), 10.0f, results);
+        sphereHits += results.size();
+    }
+    std::chrono::steady_clock::time_point querySphere = std::chrono::steady_clock::now();
+
+    int rayHits = 0;
+    for (int q = 0; q < queries; ++q) {
+        glm::vec3 direction = glm::normalize(glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX + 0.1f);
+        rayHits += BvhRayCast(&tree, glm::vec3(0.0f), direction, FLT_MAX, BenchmarkRayCallback, NULL) != NULL;
+    }
+    std::chrono::steady_clock::time_point queryRay = std::chrono::steady_clock::now();
+
+    auto ms = [](std::chrono::steady_clock::time_point a, std::chrono::steady_clock::time_point b) {
+        return std::chrono::duration<double, std::milli>(b - a).count();
+    };
+
+    printf("Bvh: %d boxes, height %d, %s. build %.2f ms, move %.2f ms (%d reinserted)\n", count, BvhHeight(&tree),
+        BvhValidate(&tree) ? "valid" : "INVALID", ms(start, built), ms(built, moved), tree.numReinserts);
+    printf("Bvh: frustum %.3f ms (%zu fat boxes), scan %.3f ms (%zu boxes), sphere %.4f ms (%zu), ray %.4f ms (%d hits)\n",
+        ms(queryStart, queryTree) / queries, treeHits / queries, ms(queryTree, queryScan) / queries, scanHits / queries,
+        ms(queryScan, querySphere) / queries, sphereHits / queries, ms(querySphere, queryRay) / queries, rayHits);
+
+    FreeBvhTree(&tree);
+}
+
+#endif
@@ -8,11 +8,41 @@ Draws the node tree.
 Builds a tree from every top level node in the json array, then adds that node to
 the root node.
 
+Models are loaded through the asset manager. Until a node's model is uploaded the
+node draws a placeholder box in its place. Nodes with the same filepath share one
+Model, the node itself holds the transform.
+
+Model nodes are queued while walking the tree and drawn by DrawScene in state
+order, see render_queue.h.
+
+Every model node keeps the world space boxes of its model and meshes, redone
+when dirty_flag moves it or its model changes. The model box is also a leaf in
+sceneBvh (scene_bvh.h), created the first frame the node has a model, whether it
+came from the json, CreateNode or AddChild, and moved with the node.
+
+DrawScene asks sceneBvh for the nodes in the frustum instead of testing every
+node, CullSceneMeshes then tests the meshes of those in one pass
+(frustum_cull.h) and only the visible ones are queued. QuerySceneSphere and
+PickSceneNode answer "what is near" and "what is under the cursor" the same way.
+
+Hitbox nodes are also occluders (occlusion_cull.h). Their depth is rendered on a
+worker while the tree is walked, and nodes from the BVH query that are entirely
+behind it are dropped before their meshes are tested.
+
+ReloadScene diffs the json against the live tree (hot_reload.h). Nodes are matched
+by name among their siblings. A node whose type, file or shader changed is built
+again, one whose transform changed is only moved, and the rest are left alone.
+
 \-------------------------------------------------------------------------------*/
 #ifndef SCENE_GRAPH_H
 #define SCENE_GRAPH_H
 
 #include <model.h>
+#include <frustum_cull.h>
+#include <render_queue.h>
+#include <scene_bvh.h>
+#include <occlusion_cull.h>
+#include <asset_manager.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <cjson/cJSON.h>
 
@@ -27,9 +57,26 @@ struct SceneNode {
     char type[24];
     int id;
 
+    // "filepath" from the json, NULL for the root
+    char* path;
+
     Model* model;
     unsigned int shaderID;
 
+    // model stays NULL until the asset is ready
+    ModelAsset* asset;
+
+    // level of detail drawn last frame, see SelectModelLod
+    int lodLevel;
+
+    // world space center and half extent of the model, then of each mesh.
+    // boundsId is the model's m_Bounds.id they were made from.
+    glm::vec3* worldBounds;
+    int numWorldBounds;
+    unsigned int boundsId;
+    // leaf in sceneBvh, BVH_NULL until the node has a model
+    int bvhProxy;
+
     Hitbox hitbox;
 
     // Global Position
@@ -48,11 +95,37 @@ struct SceneNode {
 };
 
 SceneNode* root_node;
+std::string scenePath;
 unsigned int id;
 unsigned int shaderIdArray[10];
 
 bool drawHitboxes = false;
 
+unsigned int placeholderVAO = 0;
+// nodes still loading this frame, drawn together after the models
+std::vector<glm::mat4> placeholderMatrices;
+int placeholderInstance;
+
+// model nodes inside the frustum this frame, firstBox is where their meshes
+// start in sceneCullBoxes, -1 for skinned models which are never culled
+struct CullCandidate {
+    SceneNode* node;
+    int firstBox;
+};
+
+std::vector<CullCandidate> cullCandidates;
+CullBoxes sceneCullBoxes;
+
+BvhTree sceneBvh = { NULL, 0, 0, BVH_NULL, BVH_NULL, 0, 0, {} };
+std::vector<void*> bvhResults;
+// model nodes left for the sceneBvh frustum query this frame, for the stats
+int bvhCullNodes;
+int bvhCullMeshes;
+
+// screen space error allowed for a LOD, in pixels (dev gui slider)
+float lodPixelError = 1.0f;
+#define LOD_HYSTERESIS 0.75f
+
 SceneNode* CreateNode(SceneNode* parent, std::string const& path);
 void AddChild(SceneNode* parent, SceneNode* child);
 
@@ -60,9 +133,33 @@ SceneNode* CreateTreeNode(cJSON* jsonNode, glm::mat4 matrix);
 SceneNode* BuildTree(cJSON* jsonNode, glm::mat4 matrix);
 
 int LoadScene(std::string const& path);
+cJSON* ReadSceneJson(std::string const& path);
+
+struct SceneDiff {
+    int added;
+    int removed;
+    int rebuilt;
+    int moved;
+};
+
+int ReloadScene(std::string const& path);
+void DiffSceneChildren(SceneNode* parent, cJSON* jsonChild, SceneDiff* diff);
+bool SceneNodeMatches(SceneNode* node, cJSON* jsonNode);
+void ReadNodeTransform(cJSON* jsonNode, glm::vec3* translation, glm::vec3* rotation, glm::vec3* scale);
+void FreeSceneTree(SceneNode* node);
+bool SceneContainsNode(SceneNode* root, SceneNode* node);
+void MarkChildNodes(SceneNode* node);
 
 void DrawScene(SceneNode* root);
 void DrawSceneNode(SceneNode* node, glm::mat4 parentTransform);
+void DrawPlaceholders();
+void UpdateNodeBounds(SceneNode* node);
+void AddCullCandidate(SceneNode* node);
+void CullSceneMeshes();
+void QuerySceneSphere(glm::vec3 center, float radius, std::vector<SceneNode*>& nodes);
+SceneNode* PickSceneNode(glm::vec3 origin, glm::vec3 direction, float* distance);
+float SceneNodeRayDistance(void* userData, glm::vec3 origin, glm::vec3 direction, float maxDistance);
+int SelectModelLod(Model* model, glm::mat4 modelMatrix, int currentLod);
 
 int generate_random_int(unsigned int address);
 
@@ -74,10 +171,23 @@ SceneNode* CreateNode(SceneNode* parent, std::string const& path) {
     node->firstChild = NULL;
     node->nextSibling = NULL;
 
-    node->model = LoadModel(path);
-    
+    node->model = NULL;
+    node->asset = LoadModelAsync(path);
+    node->lodLevel = 0;
+    node->worldBounds = NULL;
+    node->numWorldBounds = 0;
+    node->boundsId = 0;
+    node->bvhProxy = BVH_NULL;
+    node->path = CopyString(path.c_str());
+
+    // Same name LoadModel gives the model, it isn't loaded yet
+    size_t lastSlashPos = path.find_last_of('/');
+    std::string substring = path.substr(lastSlashPos + 1);
+    std::string nameFromPath = substring.substr(0, substring.find('.'));
+
     strncpy(node->type, "model", sizeof(node->type));
-    strncpy(node->name, node->model->m_Name, sizeof(node->name));
+    strncpy(node->name, nameFromPath.c_str(), sizeof(node->name));
+    node->name[sizeof(node->name) - 1] = '\0';
     node->shaderID = 0;
 
     node->m_modelMatrix = glm::mat4(1.0f);
@@ -121,22 +231,24 @@ SceneNode* CreateTreeNode(cJSON* jsonNode, glm::mat4 matrix)
     
     std::string path = cJSON_GetObjectItem(jsonNode, "filepath")->valuestring;
 
+    node->path = CopyString(path.c_str());
+    node->model = NULL;
+    node->asset = NULL;
+    node->lodLevel = 0;
+    node->worldBounds = NULL;
+    node->numWorldBounds = 0;
+    node->boundsId = 0;
+    node->bvhProxy = BVH_NULL;
+
     if (strcmp(node->type, "model") == 0) {
-        node->model = LoadModel(filepath(path));
+        node->asset = LoadModelAsync(filepath(path));
     }
 
     glm::vec3 translation;
     glm::vec3 rotation;
     glm::vec3 scale;
 
-    const char* translation_str = cJSON_GetObjectItem(jsonNode, "translation")->valuestring;
-    sscanf(translation_str, "%f, %f, %f", &translation.x, &translation.y, &translation.z);
-
-    const char* scale_str = cJSON_GetObjectItem(jsonNode, "scale")->valuestring;
-    sscanf(scale_str, "%f, %f, %f", &scale.x, &scale.y, &scale.z);
-
-    const char* rotation_str = cJSON_GetObjectItem(jsonNode, "rotation")->valuestring;
-    sscanf(rotation_str, "%f, %f, %f", &rotation.x, &rotation.y, &rotation.z);
+    ReadNodeTransform(jsonNode, &translation, &rotation, &scale);
 
     node->m_pos = translation;
     node->m_eulerRot = rotation;
@@ -160,6 +272,8 @@ SceneNode* CreateTreeNode(cJSON* jsonNode, glm::mat4 matrix)
         hitbox.m_Matrix = &(node->m_modelMatrix);
         hitbox.rootAABB = aabb_node;
         hitboxes.push_back(hitbox);
+
+        AddOccluder(filepath(path), &node->m_modelMatrix);
     }
 
     node->firstChild = NULL;
@@ -203,15 +317,74 @@ SceneNode* BuildTree(cJSON* jsonNode, glm::mat4 matrix)
     return node;
 }
 
+void ReadNodeTransform(cJSON* jsonNode, glm::vec3* translation, glm::vec3* rotation, glm::vec3* scale)
+{
+    const char* translation_str = cJSON_GetObjectItem(jsonNode, "translation")->valuestring;
+    sscanf(translation_str, "%f, %f, %f", &translation->x, &translation->y, &translation->z);
+
+    const char* scale_str = cJSON_GetObjectItem(jsonNode, "scale")->valuestring;
+    sscanf(scale_str, "%f, %f, %f", &scale->x, &scale->y, &scale->z);
+
+    const char* rotation_str = cJSON_GetObjectItem(jsonNode, "rotation")->valuestring;
+    sscanf(rotation_str, "%f, %f, %f", &rotation->x, &rotation->y, &rotation->z);
+}
+
 // Read json and load models
 int LoadScene(std::string const& path)
+{
+    cJSON* root = ReadSceneJson(path);
+
+    if (root == NULL) {
+        return 1;
+    }
+
+    scenePath = path;
+
+    int num_models = cJSON_GetArraySize(root);
+
+    id = 0;
+
+    root_node = (SceneNode*)malloc(sizeof(SceneNode));
+    strncpy(root_node->name, "root_node", sizeof(root_node->name));
+    root_node->shaderID = 0;
+    root_node->m_modelMatrix = glm::mat4(1.0f);
+    root_node->path = NULL;
+    root_node->model = NULL;
+    root_node->asset = NULL;
+    root_node->lodLevel = 0;
+    root_node->worldBounds = NULL;
+    root_node->numWorldBounds = 0;
+    root_node->boundsId = 0;
+    root_node->bvhProxy = BVH_NULL;
+    root_node->firstChild = NULL;
+    root_node->nextSibling = NULL;
+    root_node->id = id;
+
+    for (int i = 0; i < num_models; ++i)
+    {
+        cJSON* model = cJSON_GetArrayItem(root, i);
+
+        SceneNode* node = (SceneNode*)malloc(sizeof(SceneNode));
+
+        node = BuildTree(model, root_node->m_modelMatrix);
+
+        AddChild(root_node, node);
+    }
+
+    cJSON_Delete(root);
+
+    return 0;
+}
+
+// Parsed scene file, NULL if it can't be read. Free with cJSON_Delete
+cJSON* ReadSceneJson(std::string const& path)
 {
     const char* filename = path.c_str();
 
     FILE* file = fopen(filename, "r");
     if (file == NULL) {
         printf("Error opening file\n");
-        return 1;
+        return NULL;
     }
 
     // Calculate the size of the file
@@ -224,7 +397,7 @@ int LoadScene(std::string const& path)
     if (json_buffer == NULL) {
         printf("Error allocating memory\n");
         fclose(file);
-        return 1;
+        return NULL;
     }
 
     size_t bytes_read = fread(json_buffer, 1, file_size, file);
@@ -239,43 +412,182 @@ int LoadScene(std::string const& path)
         if (error_ptr != NULL) {
             fprintf(stderr, "Error before: %s\n", error_ptr);
         }
-        free(json_buffer);
-        return 1;
     }
 
-    int num_models = cJSON_GetArraySize(root);
+    free(json_buffer);
 
-    id = 0;
+    return root;
+}
 
-    root_node = (SceneNode*)malloc(sizeof(SceneNode));
-    strncpy(root_node->name, "root_node", sizeof(root_node->name));
-    root_node->shaderID = 0;
-    root_node->m_modelMatrix = glm::mat4(1.0f);
-    root_node->firstChild = NULL;
-    root_node->nextSibling = NULL;
-    root_node->id = id;
+// Applies the scene file to the live tree, touching only what changed
+int ReloadScene(std::string const& path)
+{
+    cJSON* root = ReadSceneJson(path);
 
-    for (int i = 0; i < num_models; ++i)
-    {
-        cJSON* model = cJSON_GetArrayItem(root, i);
+    // usually a half written file, the next save triggers another reload
+    if (root == NULL || !cJSON_IsArray(root)) {
+        cJSON_Delete(root);
+        return 1;
+    }
 
-        SceneNode* node = (SceneNode*)malloc(sizeof(SceneNode));
+    SceneDiff diff = { 0, 0, 0, 0 };
 
-        node = BuildTree(model, root_node->m_modelMatrix);
+    DiffSceneChildren(root_node, root->child, &diff);
 
-        AddChild(root_node, node);
-    }
+    printf("Scene %s: %d added, %d removed, %d rebuilt, %d moved\n", path.c_str(), diff.added, diff.removed, diff.rebuilt, diff.moved);
 
     cJSON_Delete(root);
-    free(json_buffer);
 
     return 0;
 }
 
+// Makes parent's children match the json siblings starting at jsonChild, in json order
+void DiffSceneChildren(SceneNode* parent, cJSON* jsonChild, SceneDiff* diff)
+{
+    std::vector<SceneNode*> live;
+    for (SceneNode* child = parent->firstChild; child != NULL; child = child->nextSibling) {
+        live.push_back(child);
+    }
+
+    std::vector<bool> matched(live.size(), false);
+    std::vector<SceneNode*> children;
+
+    for (cJSON* jsonNode = jsonChild; jsonNode != NULL; jsonNode = jsonNode->next) {
+        cJSON* name = cJSON_GetObjectItem(jsonNode, "name");
+        if (!cJSON_IsString(name)) {
+            continue;
+        }
+
+        // first unmatched sibling with the same (truncated) name
+        SceneNode* node = NULL;
+        for (size_t i = 0; i < live.size(); ++i) {
+            if (!matched[i] && strncmp(live[i]->name, name->valuestring, sizeof(live[i]->name)) == 0) {
+                matched[i] = true;
+                node = live[i];
+                break;
+            }
+        }
+
+        if (node == NULL) {
+            children.push_back(BuildTree(jsonNode, parent->m_modelMatrix));
+            diff->added++;
+            continue;
+        }
+
+        if (!SceneNodeMatches(node, jsonNode)) {
+            // built first, so models both trees use aren't unloaded in between
+            children.push_back(BuildTree(jsonNode, parent->m_modelMatrix));
+            FreeSceneTree(node);
+            diff->rebuilt++;
+            continue;
+        }
+
+        glm::vec3 translation;
+        glm::vec3 rotation;
+        glm::vec3 scale;
+        ReadNodeTransform(jsonNode, &translation, &rotation, &scale);
+
+        if (translation != node->m_pos || rotation != node->m_eulerRot || scale != node->m_scale) {
+            node->m_pos = translation;
+            node->m_eulerRot = rotation;
+            node->m_scale = scale;
+            MarkChildNodes(node);
+            diff->moved++;
+        }
+
+        cJSON* jsonChildren = cJSON_GetObjectItem(jsonNode, "children");
+        DiffSceneChildren(node, cJSON_IsArray(jsonChildren) ? jsonChildren->child : NULL, diff);
+
+        children.push_back(node);
+    }
+
+    for (size_t i = 0; i < live.size(); ++i) {
+        if (!matched[i]) {
+            FreeSceneTree(live[i]);
+            diff->removed++;
+        }
+    }
+
+    parent->firstChild = NULL;
+    for (size_t i = children.size(); i-- > 0;) {
+        children[i]->nextSibling = parent->firstChild;
+        parent->firstChild = children[i];
+    }
+}
+
+// Same type, file and shader, so the node can be kept and only moved
+bool SceneNodeMatches(SceneNode* node, cJSON* jsonNode)
+{
+    cJSON* type = cJSON_GetObjectItem(jsonNode, "type");
+    cJSON* path = cJSON_GetObjectItem(jsonNode, "filepath");
+    cJSON* shaderId = cJSON_GetObjectItem(jsonNode, "shaderId");
+
+    if (!cJSON_IsString(type) || strncmp(node->type, type->valuestring, sizeof(node->type)) != 0) {
+        return false;
+    }
+    if (!cJSON_IsString(path) || node->path == NULL || strcmp(node->path, path->valuestring) != 0) {
+        return false;
+    }
+
+    return shaderId == NULL || (unsigned int)shaderId->valueint == node->shaderID;
+}
+
+// Unlinks nothing, the caller fixes up the sibling list. A model is unloaded with the last
+// reference to its asset, hitbox models belong to the node.
+void FreeSceneTree(SceneNode* node)
+{
+    SceneNode* child = node->firstChild;
+    while (child != NULL) {
+        SceneNode* next = child->nextSibling;
+        FreeSceneTree(child);
+        child = next;
+    }
+
+    // hitbox nodes registered their matrix and AABB tree for collision
+    for (size_t i = 0; i < hitboxes.size();) {
+        if (hitboxes[i].m_Matrix == &node->m_modelMatrix) {
+            FreeHitbox(hitboxes[i].rootAABB);
+            hitboxes.erase(hitboxes.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+    RemoveOccluders(&node->m_modelMatrix);
+
+    if (node->asset != NULL) {
+        ReleaseModelAsset(node->asset);
+    } else {
+        UnloadModel(node->model);
+    }
+
+    if (node->bvhProxy != BVH_NULL) {
+        BvhDestroyProxy(&sceneBvh, node->bvhProxy);
+    }
+
+    free(node->worldBounds);
+    free(node->path);
+    free(node);
+}
+
+bool SceneContainsNode(SceneNode* root, SceneNode* node)
+{
+    if (root == node) {
+        return true;
+    }
+
+    for (SceneNode* child = root->firstChild; child != NULL; child = child->nextSibling) {
+        if (SceneContainsNode(child, node)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 
 void DrawSceneNode(SceneNode* node, glm::mat4 parentTransform)
 {
     glm::mat4 model = node->m_modelMatrix;
+    bool moved = node->dirty_flag;
 
     if (node->dirty_flag) {
 
@@ -299,10 +611,25 @@ void DrawSceneNode(SceneNode* node, glm::mat4 parentTransform)
         // From what I've read that is favorable due to the high cost of switching
         // shader programs.
 
-        glUseProgram(shaderIdArray[node->shaderID]);
-        setShaderMat4(shaderIdArray[node->shaderID], "model", model);
+        if (node->model == NULL && node->asset != NULL && node->asset->state == ASSET_READY) {
+            node->model = node->asset->model;
+        }
+
+        if (node->model != NULL) {
+            if (moved || node->boundsId != node->model->m_Bounds.id) {
+                UpdateNodeBounds(node);
+            }
 
-        DrawModel(node->model, shaderIdArray[node->shaderID]);
+            // skinned models are never culled, the rest wait for the sceneBvh query
+            if (node->model->m_NumAnimations > 0 || !frustumCulling) {
+                AddCullCandidate(node);
+            } else {
+                bvhCullNodes++;
+                bvhCullMeshes += node->model->m_NumMeshes;
+            }
+        } else if (node->asset == NULL || node->asset->state == ASSET_PENDING) {
+            placeholderMatrices.push_back(model);
+        }
     }
 
     if (strcmp(node->type, "hitbox") == 0 && drawHitboxes)
@@ -321,15 +648,11 @@ void DrawSceneNode(SceneNode* node, glm::mat4 parentTransform)
         {
             if (element == node->id) {
                 printf("colliding\n");
-                setShaderVec4(shaderIdArray[1], "color", glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
-
             }
         }
-        //setShaderVec4(shaderIdArray[1], "color", glm::vec4(0.0f, 1.0f, 0.0f, 1.0f));
-
-        setShaderMat4(shaderIdArray[1], "model", model);
 
-        DrawAABB_Model(node->model, shaderIdArray[1]);
+        // every box has its own color, DrawAABB_Model binds the draw uniforms per mesh
+        DrawAABB_Model(node->model, shaderIdArray[1], model);
     }
 
     SceneNode* child = node->firstChild;
@@ -339,15 +662,283 @@ void DrawSceneNode(SceneNode* node, glm::mat4 parentTransform)
     }
 }
 
+void UpdateNodeBounds(SceneNode* node)
+{
+    Model* model = node->model;
+    int numBounds = 2 + model->m_NumMeshes * 2;
+
+    if (numBounds != node->numWorldBounds) {
+        node->worldBounds = (glm::vec3*)realloc(node->worldBounds, numBounds * sizeof(glm::vec3));
+        node->numWorldBounds = numBounds;
+    }
+
+    TransformBounds(node->m_modelMatrix, model->m_Bounds.min, model->m_Bounds.max, &node->worldBounds[0], &node->worldBounds[1]);
+
+    for (int i = 0; i < model->m_NumMeshes; ++i) {
+        Mesh* mesh = &model->m_Meshes[i];
+        TransformBounds(node->m_modelMatrix, mesh->boundsMin, mesh->boundsMax, &node->worldBounds[2 + i * 2], &node->worldBounds[3 + i * 2]);
+    }
+
+    node->boundsId = model->m_Bounds.id;
+
+    glm::vec3 boundsMin = node->worldBounds[0] - node->worldBounds[1];
+    glm::vec3 boundsMax = node->worldBounds[0] + node->worldBounds[1];
+
+    if (node->bvhProxy == BVH_NULL) {
+        node->bvhProxy = BvhCreateProxy(&sceneBvh, boundsMin, boundsMax, node);
+    } else {
+        BvhMoveProxy(&sceneBvh, node->bvhProxy, boundsMin, boundsMax);
+    }
+}
+
+// The meshes wait for CullSceneMeshes
+void AddCullCandidate(SceneNode* node)
+{
+    Model* model = node->model;
+    CullCandidate candidate = { node, -1 };
+
+    if (model->m_NumAnimations == 0) {
+        candidate.firstBox = sceneCullBoxes.count;
+        for (int i = 0; i < model->m_NumMeshes; ++i) {
+            AddCullBox(&sceneCullBoxes, node->worldBounds[2 + i * 2], node->worldBounds[3 + i * 2]);
+        }
+    }
+
+    cullCandidates.push_back(candidate);
+}
+
+// Adds the nodes sceneBvh finds in the frustum, tests every collected mesh box,
+// then picks the LOD of each node with a visible mesh and queues those meshes
+void CullSceneMeshes()
+{
+    if (frustumCulling) {
+        bvhResults.clear();
+        BvhQueryFrustum(&sceneBvh, renderView.frustum, bvhResults);
+
+        FinishOcclusion();
+        renderStats.occluderTriangles = sceneOcclusion.valid ? sceneOcclusion.numTriangles : 0;
+        renderStats.occlusionMs = sceneOcclusion.valid ? sceneOcclusion.milliseconds : 0.0f;
+
+        for (size_t i = 0; i < bvhResults.size(); ++i) {
+            SceneNode* node = (SceneNode*)bvhResults[i];
+
+            // already a candidate
+            if (node->model->m_NumAnimations > 0) {
+                continue;
+            }
+
+            if (occlusionCulling && node->numWorldBounds > 0) {
+                glm::vec3 center = node->worldBounds[0];
+                glm::vec3 extent = node->worldBounds[1];
+
+                if (!OcclusionBoxVisible(&sceneOcclusion, center - extent, center + extent)) {
+                    renderStats.occlusionCulled++;
+                    continue;
+                }
+            }
+
+            AddCullCandidate(node);
+            bvhCullNodes--;
+            bvhCullMeshes -= node->model->m_NumMeshes;
+        }
+
+        renderStats.modelsCulled += bvhCullNodes;
+        renderStats.meshesCulled += bvhCullMeshes;
+    }
+
+    CullBoxesAgainstFrustum(&sceneCullBoxes, renderView.frustum);
+
+    for (size_t c = 0; c < cullCandidates.size(); ++c) {
+        SceneNode* node = cullCandidates[c].node;
+        Model* model = node->model;
+        const unsigned char* visible = (cullCandidates[c].firstBox >= 0) ? sceneCullBoxes.visible + cullCandidates[c].firstBox : NULL;
+
+        int numVisible = 0;
+        for (int i = 0; i < model->m_NumMeshes; ++i) {
+            numVisible += (visible == NULL || visible[i]) ? 1 : 0;
+        }
+
+        renderStats.meshesVisible += numVisible;
+        renderStats.meshesCulled += model->m_NumMeshes - numVisible;
+
+        if (numVisible == 0 && model->m_NumMeshes > 0) {
+            renderStats.modelsCulled++;
+            continue;
+        }
+        renderStats.modelsVisible++;
+
+        node->lodLevel = SelectModelLod(model, node->m_modelMatrix, node->lodLevel);
+
+        QueueModel(model, shaderIdArray[node->shaderID], node->shaderID, node->lodLevel, &node->m_modelMatrix, visible);
+
+        renderStats.modelsPerLod[node->lodLevel]++;
+        renderStats.trianglesFull += model->m_LodTriangles[0];
+
+        if (numVisible == model->m_NumMeshes) {
+            renderStats.trianglesDrawn += model->m_LodTriangles[node->lodLevel];
+            continue;
+        }
+
+        for (int i = 0; i < model->m_NumMeshes; ++i) {
+            Mesh* mesh = &model->m_Meshes[i];
+            if (visible[i]) {
+                renderStats.trianglesDrawn += mesh->lods[std::min(node->lodLevel, mesh->numLods - 1)].numIndices / 3;
+            }
+        }
+    }
+}
+
+// Model nodes whose world box touches the sphere
+void QuerySceneSphere(glm::vec3 center, float radius, std::vector<SceneNode*>& nodes)
+{
+    bvhResults.clear();
+    BvhQuerySphere(&sceneBvh, center, radius, bvhResults);
+
+    for (size_t i = 0; i < bvhResults.size(); ++i) {
+        SceneNode* node = (SceneNode*)bvhResults[i];
+
+        // the tree holds fat boxes
+        glm::vec3 closest = glm::clamp(center, node->worldBounds[0] - node->worldBounds[1], node->worldBounds[0] + node->worldBounds[1]);
+        if (glm::length(closest - center) <= radius) {
+            nodes.push_back(node);
+        }
+    }
+}
+
+float SceneNodeRayDistance(void* userData, glm::vec3 origin, glm::vec3 direction, float maxDistance)
+{
+    SceneNode* node = (SceneNode*)userData;
+    glm::vec3 inverseDirection = 1.0f / direction;
+
+    // the model box first, then the nearest mesh box
+    if (BvhRayBox(origin, inverseDirection, node->worldBounds[0] - node->worldBounds[1], node->worldBounds[0] + node->worldBounds[1], maxDistance) < 0.0f) {
+        return -1.0f;
+    }
+
+    float nearest = -1.0f;
+    for (int i = 0; i < node->model->m_NumMeshes; ++i) {
+        glm::vec3 center = node->worldBounds[2 + i * 2];
+        glm::vec3 extent = node->worldBounds[3 + i * 2];
+
+        float distance = BvhRayBox(origin, inverseDirection, center - extent, center + extent, maxDistance);
+        if (distance >= 0.0f && (nearest < 0.0f || distance < nearest)) {
+            nearest = distance;
+        }
+    }
+    return nearest;
+}
+
+// Nearest model node whose mesh boxes the ray hits, NULL if none.
+// direction has to be normalized for distance to be in world units.
+SceneNode* PickSceneNode(glm::vec3 origin, glm::vec3 direction, float* distance)
+{
+    return (SceneNode*)BvhRayCast(&sceneBvh, origin, direction, FLT_MAX, SceneNodeRayDistance, distance);
+}
+
+// Coarsest level whose error projects to less than lodPixelError pixels.
+// Going coarser needs the error to be LOD_HYSTERESIS times lower, so a model
+// near a threshold doesn't flip between two levels every frame.
+int SelectModelLod(Model* model, glm::mat4 modelMatrix, int currentLod)
+{
+    if (model->m_NumLods <= 1) {
+        return 0;
+    }
+
+    glm::vec3 position = glm::vec3(modelMatrix[3]);
+    float distance = glm::max(glm::length(position - renderView.position), 0.001f);
+
+    float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+
+    // pixels per object space unit at this distance
+    float pixelsPerUnit = scale * renderView.projectionScale / distance;
+
+    int lod = 0;
+    for (int level = 1; level < model->m_NumLods; ++level) {
+        float threshold = (level > currentLod) ? lodPixelError * LOD_HYSTERESIS : lodPixelError;
+
+        if (model->m_LodError[level] * pixelsPerUnit > threshold) {
+            break;
+        }
+        lod = level;
+    }
+
+    return lod;
+}
+
+// Wire boxes drawn with the hitbox shader while the models are still loading,
+// one instanced draw when the hitbox shader has an instanced variant
+void DrawPlaceholders()
+{
+    int count = (int)placeholderMatrices.size();
+
+    if (count == 0) {
+        return;
+    }
+
+    if (placeholderVAO == 0) {
+        placeholderVAO = CreateHitbox();
+    }
+
+    glm::vec4 color = glm::vec4(0.6f, 0.6f, 0.6f, 1.0f);
+    unsigned int instanced = instancingEnabled ? FindInstancedProgram(shaderIdArray[1]) : 0;
+
+    if (instanced != 0) {
+        glUseProgram(instanced);
+        BindDrawUniforms(glm::mat4(1.0f), color);
+
+        DrawHitboxInstanced(placeholderVAO, placeholderInstance, count);
+        renderStats.drawCalls++;
+        return;
+    }
+
+    glUseProgram(shaderIdArray[1]);
+
+    for (int i = 0; i < count; ++i) {
+        BindDrawUniforms(placeholderMatrices[i], color);
+        DrawHitbox(placeholderVAO, shaderIdArray[1]);
+        renderStats.drawCalls++;
+    }
+}
+
 void DrawScene(SceneNode* root)
 {
     glm::mat4 matrix = glm::mat4(1.0f);
 
+    ResetRenderStats();
+    BeginRenderQueue();
+    BeginCullBoxes(&sceneCullBoxes);
+    cullCandidates.clear();
+    bvhCullNodes = 0;
+    bvhCullMeshes = 0;
+    placeholderMatrices.clear();
+
+    // the occluder depth renders on a worker while the tree is walked
+    BeginOcclusion();
+
+    if (cullBackfaces) {
+        glEnable(GL_CULL_FACE);
+    }
+
+    // hitboxes still draw right away, models and placeholders are collected
     SceneNode* child = root->firstChild;
     while (child != NULL) {
         DrawSceneNode(child, matrix);
         child = child->nextSibling;
     }
+
+    CullSceneMeshes();
+    BatchRenderQueue();
+    placeholderInstance = AddInstances(placeholderMatrices.data(), (int)placeholderMatrices.size());
+    UploadInstances();
+    UploadIndirectDraws();
+
+    SubmitRenderQueue();
+    DrawPlaceholders();
+
+    glDisable(GL_CULL_FACE);
+
+    // DrawModel leaves the mesh arena VAO bound between models
+    glBindVertexArray(0);
 }
 
 
@@ -8,15 +8,44 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
-void checkCompileErrors(GLuint shader, std::string type);
+#include <shader_uniforms.h>
+#include <uniform_ring.h>
+
+// Every program made by createShader, so hot_reload.h can rebuild it from its files
+struct ShaderProgram {
+    unsigned int id;
+    std::string vertexPath;
+    std::string fragmentPath;
+};
+
+std::vector<ShaderProgram> shaderPrograms;
+
+bool checkCompileErrors(GLuint shader, std::string type);
+bool buildShaderProgram(unsigned int shaderID, std::string vertexPathStr, std::string fragmentPathStr);
+bool reloadShaderProgram(ShaderProgram* program);
 
 
 // constructor generates the shader on the fly
 // ------------------------------------------------------------------------
 unsigned int createShader(std::string vertexPathStr, std::string fragmentPathStr)
 {
-    unsigned int shaderID;
+    unsigned int shaderID = glCreateProgram();
+
+    buildShaderProgram(shaderID, vertexPathStr, fragmentPathStr);
+    ReflectShaderUniforms(shaderID);
+    BindUniformBlocks(shaderID);
+
+    shaderPrograms.push_back({ shaderID, vertexPathStr, fragmentPathStr });
+
+    return shaderID;
+}
+
+// Compiles both files and links them into shaderID, replacing whatever it held.
+// Returns false if anything failed to compile or link.
+bool buildShaderProgram(unsigned int shaderID, std::string vertexPathStr, std::string fragmentPathStr)
+{
     const char* vertexPath = vertexPathStr.c_str();
     const char* fragmentPath = fragmentPathStr.c_str();
 
@@ -63,93 +92,171 @@ unsigned int createShader(std::string vertexPathStr, std::string fragmentPathStr
     vertex = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertex, 1, &vShaderCode, NULL);
     glCompileShader(vertex);
-    checkCompileErrors(vertex, "VERTEX");
+    bool success = checkCompileErrors(vertex, "VERTEX");
 
     // fragment Shader
     fragment = glCreateShader(GL_FRAGMENT_SHADER);
     glShaderSource(fragment, 1, &fShaderCode, NULL);
     glCompileShader(fragment);
-    checkCompileErrors(fragment, "FRAGMENT");
+    success = checkCompileErrors(fragment, "FRAGMENT") && success;
 
     // shader Program
-    shaderID = glCreateProgram();
     glAttachShader(shaderID, vertex);
     glAttachShader(shaderID, fragment);
     glLinkProgram(shaderID);
-    checkCompileErrors(shaderID, "PROGRAM");
+    success = checkCompileErrors(shaderID, "PROGRAM") && success;
+
+    // detach so the program can be linked again with new shaders, it keeps the linked binary
+    glDetachShader(shaderID, vertex);
+    glDetachShader(shaderID, fragment);
 
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
 
-    return shaderID;
+    return success;
 }
 
+// Relinks the program in place, so its id stays valid everywhere. The files are built into a
+// scratch program first, if they don't compile the old program is left untouched.
+// Uniforms go back to their defaults, anything only set at startup has to be set again.
+bool reloadShaderProgram(ShaderProgram* program)
+{
+    unsigned int scratch = glCreateProgram();
+    bool success = buildShaderProgram(scratch, program->vertexPath, program->fragmentPath);
+    glDeleteProgram(scratch);
+
+    if (!success) {
+        std::cout << "SHADER:: " << program->vertexPath << " did not build, keeping the old program" << std::endl;
+        return false;
+    }
+
+    success = buildShaderProgram(program->id, program->vertexPath, program->fragmentPath);
+    ReflectShaderUniforms(program->id);
+    BindUniformBlocks(program->id);
+
+    return success;
+}
 
 
-// utility uniform functions
+
+// utility uniform functions, UNIFORM("name") keeps the hash a constant.
+// The std::string versions hash the name on every call, for names built at runtime.
 // ------------------------------------------------------------------------
+void setShaderBool(unsigned int shaderID, UniformId id, bool value)
+{
+    glUniform1i(ShaderUniformLocation(shaderID, id), (int)value);
+}
 void setShaderBool(unsigned int shaderID, const std::string& name, bool value)
 {
-    glUniform1i(glGetUniformLocation(shaderID, name.c_str()), (int)value);
+    setShaderBool(shaderID, UniformHash(name.c_str()), value);
 }
 // ------------------------------------------------------------------------
+void setShaderInt(unsigned int shaderID, UniformId id, int value)
+{
+    glUniform1i(ShaderUniformLocation(shaderID, id), value);
+}
 void setShaderInt(unsigned int shaderID, const std::string& name, int value)
 {
-    glUniform1i(glGetUniformLocation(shaderID, name.c_str()), value);
+    setShaderInt(shaderID, UniformHash(name.c_str()), value);
 }
 // ------------------------------------------------------------------------
+void setShaderFloat(unsigned int shaderID, UniformId id, float value)
+{
+    glUniform1f(ShaderUniformLocation(shaderID, id), value);
+}
 void setShaderFloat(unsigned int shaderID, const std::string& name, float value)
 {
-    glUniform1f(glGetUniformLocation(shaderID, name.c_str()), value);
+    setShaderFloat(shaderID, UniformHash(name.c_str()), value);
 }
 // ------------------------------------------------------------------------
+void setShaderVec2(unsigned int shaderID, UniformId id, const glm::vec2& value)
+{
+    glUniform2fv(ShaderUniformLocation(shaderID, id), 1, &value[0]);
+}
+void setShaderVec2(unsigned int shaderID, UniformId id, float x, float y)
+{
+    glUniform2f(ShaderUniformLocation(shaderID, id), x, y);
+}
 void setShaderVec2(unsigned int shaderID, const std::string& name, const glm::vec2& value)
 {
-    glUniform2fv(glGetUniformLocation(shaderID, name.c_str()), 1, &value[0]);
+    setShaderVec2(shaderID, UniformHash(name.c_str()), value);
 }
 void setShaderVec2(unsigned int shaderID, const std::string& name, float x, float y)
 {
-    glUniform2f(glGetUniformLocation(shaderID, name.c_str()), x, y);
+    setShaderVec2(shaderID, UniformHash(name.c_str()), x, y);
 }
 // ------------------------------------------------------------------------
+void setShaderVec3(unsigned int shaderID, UniformId id, const glm::vec3& value)
+{
+    glUniform3fv(ShaderUniformLocation(shaderID, id), 1, &value[0]);
+}
+void setShaderVec3(unsigned int shaderID, UniformId id, float x, float y, float z)
+{
+    glUniform3f(ShaderUniformLocation(shaderID, id), x, y, z);
+}
 void setShaderVec3(unsigned int shaderID, const std::string& name, const glm::vec3& value)
 {
-    glUniform3fv(glGetUniformLocation(shaderID, name.c_str()), 1, &value[0]);
+    setShaderVec3(shaderID, UniformHash(name.c_str()), value);
 }
 void setShaderVec3(unsigned int shaderID, const std::string& name, float x, float y, float z)
 {
-    glUniform3f(glGetUniformLocation(shaderID, name.c_str()), x, y, z);
+    setShaderVec3(shaderID, UniformHash(name.c_str()), x, y, z);
 }
 // ------------------------------------------------------------------------
+void setShaderVec4(unsigned int shaderID, UniformId id, const glm::vec4& value)
+{
+    glUniform4fv(ShaderUniformLocation(shaderID, id), 1, &value[0]);
+}
 void setShaderVec4(unsigned int shaderID, const std::string& name, const glm::vec4& value)
 {
-    glUniform4fv(glGetUniformLocation(shaderID, name.c_str()), 1, &value[0]);
+    setShaderVec4(shaderID, UniformHash(name.c_str()), value);
+}
+void setVec4(unsigned int shaderID, UniformId id, float x, float y, float z, float w)
+{
+    glUniform4f(ShaderUniformLocation(shaderID, id), x, y, z, w);
 }
 void setVec4(unsigned int shaderID, const std::string& name, float x, float y, float z, float w)
 {
-    glUniform4f(glGetUniformLocation(shaderID, name.c_str()), x, y, z, w);
+    setVec4(shaderID, UniformHash(name.c_str()), x, y, z, w);
 }
 // ------------------------------------------------------------------------
+void setMat2(unsigned int shaderID, UniformId id, const glm::mat2& mat)
+{
+    glUniformMatrix2fv(ShaderUniformLocation(shaderID, id), 1, GL_FALSE, &mat[0][0]);
+}
 void setMat2(unsigned int shaderID, const std::string& name, const glm::mat2& mat)
 {
-    glUniformMatrix2fv(glGetUniformLocation(shaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    setMat2(shaderID, UniformHash(name.c_str()), mat);
 }
 // ------------------------------------------------------------------------
+void setShaderMat3(unsigned int shaderID, UniformId id, const glm::mat3& mat)
+{
+    glUniformMatrix3fv(ShaderUniformLocation(shaderID, id), 1, GL_FALSE, &mat[0][0]);
+}
 void setShaderMat3(unsigned int shaderID, const std::string& name, const glm::mat3& mat)
 {
-    glUniformMatrix3fv(glGetUniformLocation(shaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    setShaderMat3(shaderID, UniformHash(name.c_str()), mat);
 }
 // ------------------------------------------------------------------------
+void setShaderMat4(unsigned int shaderID, UniformId id, const glm::mat4& mat)
+{
+    glUniformMatrix4fv(ShaderUniformLocation(shaderID, id), 1, GL_FALSE, &mat[0][0]);
+}
 void setShaderMat4(unsigned int shaderID, const std::string& name, const glm::mat4& mat)
 {
-    glUniformMatrix4fv(glGetUniformLocation(shaderID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    setShaderMat4(shaderID, UniformHash(name.c_str()), mat);
+}
+// count matrices from the start of an array uniform, in one call
+void setShaderMat4Array(unsigned int shaderID, UniformId id, int count, const glm::mat4* mats)
+{
+    glUniformMatrix4fv(ShaderUniformLocation(shaderID, id), count, GL_FALSE, &mats[0][0][0]);
 }
 
 
 // utility function for checking shader compilation/linking errors.
 // ------------------------------------------------------------------------
-void checkCompileErrors(GLuint shader, std::string type)
+bool checkCompileErrors(GLuint shader, std::string type)
 {
     GLint success;
     GLchar infoLog[1024];
@@ -168,6 +275,7 @@ void checkCompileErrors(GLuint shader, std::string type)
                       << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
         }
     }
+    return success;
 }
 
 #endif
\ No newline at end of file
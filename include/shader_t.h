@@ -9,6 +9,8 @@
 #include <sstream>
 #include <string>
 
+#include <shader_uniforms.h>
+
 void ShaderT_CheckCompileErrors(GLuint shader, std::string type);
 
 unsigned int CreateShaderT(std::string vertexPathStr, std::string fragmentPathStr, std::string geometryPathStr,
@@ -132,6 +134,7 @@ unsigned int CreateShaderT(std::string vertexPathStr, std::string fragmentPathSt
         glAttachShader(ID, tessEval);
     glLinkProgram(ID);
     checkCompileErrors(ID, "PROGRAM");
+    ReflectShaderUniforms(ID);
     // delete the shaders as they're linked into our program now and no longer necessary
     glDeleteShader(vertex);
     glDeleteShader(fragment);
@@ -145,63 +148,63 @@ void SetShaderT_use(unsigned int ID)
 {
     glUseProgram(ID);
 }
-// utility uniform functions
+// utility uniform functions, pass UNIFORM("name")
 // ------------------------------------------------------------------------
-void SetShaderT_Bool(unsigned int ID, const std::string& name, bool value)
+void SetShaderT_Bool(unsigned int ID, UniformId id, bool value)
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    glUniform1i(ShaderUniformLocation(ID, id), (int)value);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Int(unsigned int ID, const std::string& name, int value)
+void SetShaderT_Int(unsigned int ID, UniformId id, int value)
 {
-    glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1i(ShaderUniformLocation(ID, id), value);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Float(unsigned int ID, const std::string& name, float value)
+void SetShaderT_Float(unsigned int ID, UniformId id, float value)
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(ShaderUniformLocation(ID, id), value);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Vec2(unsigned int ID, const std::string& name, const glm::vec2& value)
+void SetShaderT_Vec2(unsigned int ID, UniformId id, const glm::vec2& value)
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(ShaderUniformLocation(ID, id), 1, &value[0]);
 }
-void SetShaderT_Vec2(unsigned int ID, const std::string& name, float x, float y)
+void SetShaderT_Vec2(unsigned int ID, UniformId id, float x, float y)
 {
-    glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    glUniform2f(ShaderUniformLocation(ID, id), x, y);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Vec3(unsigned int ID, const std::string& name, const glm::vec3& value)
+void SetShaderT_Vec3(unsigned int ID, UniformId id, const glm::vec3& value)
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(ShaderUniformLocation(ID, id), 1, &value[0]);
 }
-void SetShaderT_Vec3(unsigned int ID, const std::string& name, float x, float y, float z)
+void SetShaderT_Vec3(unsigned int ID, UniformId id, float x, float y, float z)
 {
-    glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    glUniform3f(ShaderUniformLocation(ID, id), x, y, z);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Vec4(unsigned int ID, const std::string& name, const glm::vec4& value)
+void SetShaderT_Vec4(unsigned int ID, UniformId id, const glm::vec4& value)
 {
-    glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform4fv(ShaderUniformLocation(ID, id), 1, &value[0]);
 }
-void SetShaderT_Vec4(unsigned int ID, const std::string& name, float x, float y, float z, float w)
+void SetShaderT_Vec4(unsigned int ID, UniformId id, float x, float y, float z, float w)
 {
-    glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+    glUniform4f(ShaderUniformLocation(ID, id), x, y, z, w);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Mat2(unsigned int ID, const std::string& name, const glm::mat2& mat)
+void SetShaderT_Mat2(unsigned int ID, UniformId id, const glm::mat2& mat)
 {
-    glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix2fv(ShaderUniformLocation(ID, id), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Mat3(unsigned int ID, const std::string& name, const glm::mat3& mat)
+void SetShaderT_Mat3(unsigned int ID, UniformId id, const glm::mat3& mat)
 {
-    glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix3fv(ShaderUniformLocation(ID, id), 1, GL_FALSE, &mat[0][0]);
 }
 // ------------------------------------------------------------------------
-void SetShaderT_Mat4(unsigned int ID, const std::string& name, const glm::mat4& mat)
+void SetShaderT_Mat4(unsigned int ID, UniformId id, const glm::mat4& mat)
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix4fv(ShaderUniformLocation(ID, id), 1, GL_FALSE, &mat[0][0]);
 }
 
 // utility function for checking shader compilation/linking errors.
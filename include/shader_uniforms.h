@@ -0,0 +1,306 @@
+/*-------------------------------------------------------------------------------\
+shader_uniforms.h
+
+Functions:
+    Uniform locations of every shader program, found by a hash of the name
+    instead of glGetUniformLocation. ReflectShaderUniforms reads the active
+    uniforms and uniform blocks once after each link into an open addressed
+    table per program, indexed by the program id.
+
+    UNIFORM("name") is the 64 bit FNV-1a hash of the name, folded at compile
+    time, so a call site keeps a constant and a set is one table probe. Names
+    built at runtime go through UniformHash, which is the same function.
+
+    An array of a basic type has an entry for "name", "name[0]" and every
+    "name[i]". Arrays of structs are listed by GL member by member, so
+    "pointLights[2].position" has its own entry like any other uniform.
+
+    A name the program doesn't have (or the compiler removed) gives -1, which
+    glUniform* ignores, the same as glGetUniformLocation did.
+
+    BenchmarkShaderUniforms times the old string lookups against the table for
+    every uniform of a program. It's run from the dev gui and by the
+    uniform_bench console program.
+
+\-------------------------------------------------------------------------------*/
+#ifndef SHADER_UNIFORMS_H
+#define SHADER_UNIFORMS_H
+
+#include <glad/glad.h>
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <mapped_file.h>
+
+typedef unsigned long long UniformId;
+
+constexpr UniformId UniformHash(const char* name)
+{
+    UniformId hash = FNV1A_64_OFFSET;
+
+    for (; *name != '\0'; ++name) {
+        hash ^= (unsigned char)*name;
+        hash *= FNV1A_64_PRIME;
+    }
+
+    return hash;
+}
+
+// integral_constant makes the compiler fold the hash even in a debug build
+#define UNIFORM(name) (std::integral_constant<UniformId, UniformHash(name)>::value)
+
+struct ShaderUniform {
+    // 0 for an empty slot
+    UniformId id;
+    GLint location;
+};
+
+struct ShaderUniformBlock {
+    UniformId id;
+    GLuint index;
+    GLint dataSize;
+};
+
+struct ShaderUniformTable {
+    // power of two, at most half full
+    std::vector<ShaderUniform> slots;
+    unsigned int mask;
+    int numUniforms;
+
+    // for BenchmarkShaderUniforms and collision checks
+    std::vector<std::string> names;
+
+    std::vector<ShaderUniformBlock> blocks;
+};
+
+// Since ResetShaderUniformStats, the dev gui shows them once per frame
+struct ShaderUniformStats {
+    int numLookups;
+    int numMissing;
+};
+
+// indexed by program id, empty for programs that aren't reflected
+std::vector<ShaderUniformTable> shaderUniformTables;
+ShaderUniformStats shaderUniformStats;
+
+void ReflectShaderUniforms(unsigned int program);
+GLint ShaderUniformLocation(unsigned int program, UniformId id);
+GLuint ShaderUniformBlockIndex(unsigned int program, UniformId id);
+void ResetShaderUniformStats();
+bool BenchmarkShaderUniforms(unsigned int program, int frames);
+
+void AddShaderUniform(ShaderUniformTable* table, std::string const& name, GLint location);
+
+// After every successful link, locations can change with any edit of the source
+void ReflectShaderUniforms(unsigned int program)
+{
+    if (program >= shaderUniformTables.size()) {
+        shaderUniformTables.resize(program + 1);
+    }
+
+    ShaderUniformTable* table = &shaderUniformTables[program];
+    table->names.clear();
+    table->blocks.clear();
+    table->numUniforms = 0;
+
+    GLint numActive = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numActive);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<char> buffer(maxLength + 1);
+    std::vector<std::string> names;
+    std::vector<GLint> sizes;
+
+    for (GLint i = 0; i < numActive; ++i) {
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)buffer.size(), NULL, &size, &type, buffer.data());
+
+        names.push_back(buffer.data());
+        sizes.push_back(size);
+    }
+
+    // every array element has its own name, room for all of them
+    size_t numEntries = 0;
+    for (size_t i = 0; i < names.size(); ++i) {
+        numEntries += (sizes[i] > 1) ? sizes[i] + 1 : 2;
+    }
+
+    size_t capacity = 16;
+    while (capacity < numEntries * 2) {
+        capacity *= 2;
+    }
+
+    ShaderUniform empty = { 0, -1 };
+    table->slots.assign(capacity, empty);
+    table->mask = (unsigned int)(capacity - 1);
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        std::string const& name = names[i];
+        GLint location = glGetUniformLocation(program, name.c_str());
+
+        // uniforms inside a block have no location
+        if (location < 0) {
+            continue;
+        }
+
+        AddShaderUniform(table, name, location);
+
+        // GL reports arrays as "name[0]"
+        size_t bracket = name.rfind("[0]");
+        if (bracket == std::string::npos || bracket + 3 != name.size()) {
+            continue;
+        }
+
+        std::string base = name.substr(0, bracket);
+        AddShaderUniform(table, base, location);
+
+        for (GLint element = 1; element < sizes[i]; ++element) {
+            std::string elementName = base + "[" + std::to_string(element) + "]";
+            AddShaderUniform(table, elementName, glGetUniformLocation(program, elementName.c_str()));
+        }
+    }
+
+    GLint numBlocks = 0;
+    GLint maxBlockLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &numBlocks);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxBlockLength);
+
+    buffer.resize(maxBlockLength + 1);
+
+    for (GLint i = 0; i < numBlocks; ++i) {
+        glGetActiveUniformBlockName(program, (GLuint)i, (GLsizei)buffer.size(), NULL, buffer.data());
+
+        ShaderUniformBlock block;
+        block.id = UniformHash(buffer.data());
+        block.index = (GLuint)i;
+        glGetActiveUniformBlockiv(program, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+
+        table->blocks.push_back(block);
+    }
+}
+
+void AddShaderUniform(ShaderUniformTable* table, std::string const& name, GLint location)
+{
+    UniformId id = UniformHash(name.c_str());
+    unsigned int slot = (unsigned int)id & table->mask;
+
+    while (table->slots[slot].id != 0) {
+        if (table->slots[slot].id == id) {
+            printf("ShaderUniforms: %s has the same hash as another uniform\n", name.c_str());
+            return;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+
+    table->slots[slot].id = id;
+    table->slots[slot].location = location;
+    table->names.push_back(name);
+    table->numUniforms++;
+}
+
+GLint ShaderUniformLocation(unsigned int program, UniformId id)
+{
+    shaderUniformStats.numLookups++;
+
+    if (program >= shaderUniformTables.size() || shaderUniformTables[program].slots.empty()) {
+        shaderUniformStats.numMissing++;
+        return -1;
+    }
+
+    ShaderUniformTable* table = &shaderUniformTables[program];
+    unsigned int slot = (unsigned int)id & table->mask;
+
+    while (table->slots[slot].id != 0) {
+        if (table->slots[slot].id == id) {
+            return table->slots[slot].location;
+        }
+        slot = (slot + 1) & table->mask;
+    }
+
+    shaderUniformStats.numMissing++;
+    return -1;
+}
+
+GLuint ShaderUniformBlockIndex(unsigned int program, UniformId id)
+{
+    if (program < shaderUniformTables.size()) {
+        std::vector<ShaderUniformBlock>& blocks = shaderUniformTables[program].blocks;
+
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            if (blocks[i].id == id) {
+                return blocks[i].index;
+            }
+        }
+    }
+    return GL_INVALID_INDEX;
+}
+
+void ResetShaderUniformStats()
+{
+    shaderUniformStats.numLookups = 0;
+    shaderUniformStats.numMissing = 0;
+}
+
+// Looks up every uniform of the program once per frame, the way the setters used to
+// (a std::string built from the name and glGetUniformLocation) and through the table.
+// Returns false if the program has no uniforms or the table gave a different location
+// than GL for any of them.
+bool BenchmarkShaderUniforms(unsigned int program, int frames)
+{
+    if (program >= shaderUniformTables.size() || shaderUniformTables[program].numUniforms == 0) {
+        printf("ShaderUniforms: program %u has no uniforms\n", program);
+        return false;
+    }
+
+    ShaderUniformTable* table = &shaderUniformTables[program];
+
+    std::vector<UniformId> ids;
+    for (size_t i = 0; i < table->names.size(); ++i) {
+        ids.push_back(UniformHash(table->names[i].c_str()));
+    }
+
+    ShaderUniformStats saved = shaderUniformStats;
+
+    // both loops sum the locations they get, the sums are compared and reported so
+    // neither loop can be optimized away
+    long long driverSum = 0;
+    long long tableSum = 0;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        for (size_t i = 0; i < table->names.size(); ++i) {
+            std::string name = table->names[i];
+            driverSum += glGetUniformLocation(program, name.c_str());
+        }
+    }
+    std::chrono::steady_clock::time_point middle = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            tableSum += ShaderUniformLocation(program, ids[i]);
+        }
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    shaderUniformStats = saved;
+
+    double driverMs = std::chrono::duration<double, std::milli>(middle - start).count();
+    double tableMs = std::chrono::duration<double, std::milli>(end - middle).count();
+
+    printf("ShaderUniforms: program %u, %d uniforms, %d frames: glGetUniformLocation %.3f ms/frame, table %.4f ms/frame, location sums %lld/%lld\n",
+        program, table->numUniforms, frames, driverMs / frames, tableMs / frames, driverSum, tableSum);
+
+    if (driverSum != tableSum) {
+        printf("ShaderUniforms: program %u, the table doesn't match glGetUniformLocation\n", program);
+        return false;
+    }
+    return true;
+}
+
+#endif
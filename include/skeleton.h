@@ -21,8 +21,10 @@ Functions:
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 
 #include <assimp_glm_helpers.h>
+#include <linear_arena.h>
 
 struct BoneStruct {
     int ID;
@@ -44,12 +46,17 @@ std::vector<std::string> BoneNames;
 std::map<std::string, BoneStruct> BoneMap;
 int BoneID = 0;
 
-// For aiNode.FindNode(const char *name). Used to find Node in hierarchy = aiBone.mName
+// For FindBoneNode. Used to find Node in hierarchy = aiBone.mName
 aiNode* aiRootNode;
 
+// Models are imported on worker threads (asset_manager.h). Lock this around anything
+// touching BoneNames, BoneMap, BoneID or aiRootNode.
+std::mutex skeletonMutex;
+
 void BoneCheckRoot(aiNode* node, const aiScene* scene);
 void BoneCheck(aiNode* node, const aiScene* scene);
 void BoneCheckParents(aiNode* boneNode, aiNode* meshNode);
+aiNode* FindBoneNode(aiNode* node, const char* name);
 
 void CreateBoneMap(aiNode* node, const aiScene* scene);
 void CreateBoneMap2(const aiScene* scene);
@@ -57,6 +64,10 @@ void CreateBoneMap2(const aiScene* scene);
 SkeletonNode* CreateNode(const aiNode* node, int mNumChildren);
 SkeletonNode* CopyNodeTree(const aiNode* root);
 
+void FreeSkeleton(SkeletonNode* node);
+size_t SkeletonArenaBytes(const SkeletonNode* node);
+SkeletonNode* CopySkeleton(LinearArena* arena, const SkeletonNode* node);
+
 SkeletonNode* LoadSkeleton(const aiScene* scene)
 {
     // Used in BoneCheck to find Node associated with Bone
@@ -74,6 +85,24 @@ SkeletonNode* LoadSkeleton(const aiScene* scene)
 }
 
 
+// Same search as aiNode::FindNode, which lives in the Assimp library. Headers that only
+// need the model data types (occlusion_test) then link without it.
+aiNode* FindBoneNode(aiNode* node, const char* name)
+{
+    if (strcmp(node->mName.data, name) == 0) {
+        return node;
+    }
+
+    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+        aiNode* found = FindBoneNode(node->mChildren[i], name);
+        if (found != NULL) {
+            return found;
+        }
+    }
+
+    return NULL;
+}
+
 bool isStringInBoneVector(const std::string& target) {
     for (const auto& str : BoneNames) {
         if (str == target) {
@@ -140,7 +169,7 @@ void BoneCheck(aiNode* node, const aiScene* scene)
 
                 if (!isStringInBoneVector(boneNodeName.C_Str())) {
                     BoneNames.push_back(boneNodeName.C_Str());
-                    aiNode* boneNode = aiRootNode->FindNode(boneNodeName);
+                    aiNode* boneNode = FindBoneNode(aiRootNode, boneNodeName.C_Str());
                     BoneCheckParents(boneNode, node);
                 }
             }
@@ -249,7 +278,7 @@ SkeletonNode* CreateNode(const aiNode* node, int mNumChildren)
     const char* nodemName = node->mName.C_Str();
     size_t nameLength     = node->mName.length;
 
-    newNode->m_NodeName = (char*)malloc(nameLength * sizeof(char));
+    newNode->m_NodeName = (char*)malloc((nameLength + 1) * sizeof(char));
     std::strcpy(newNode->m_NodeName, nodemName);
 
     newNode->m_NumChildren = mNumChildren;
@@ -277,4 +306,53 @@ SkeletonNode* CopyNodeTree(const aiNode* root)
     return newRoot;
 }
 
+// Only for trees from CopyNodeTree or the mesh cache, not ones in an arena
+void FreeSkeleton(SkeletonNode* node)
+{
+    if (node == NULL) {
+        return;
+    }
+
+    for (unsigned int i = 0; i < node->m_NumChildren; ++i) {
+        FreeSkeleton(node->m_Children[i]);
+    }
+
+    free(node->m_NodeName);
+    free(node->m_Children);
+    free(node);
+}
+
+// What CopySkeleton takes from the arena
+size_t SkeletonArenaBytes(const SkeletonNode* node)
+{
+    if (node == NULL) {
+        return 0;
+    }
+
+    size_t size = ArenaBytes(sizeof(SkeletonNode)) + ArenaStringBytes(node->m_NodeName)
+        + ArenaBytes(node->m_NumChildren * sizeof(SkeletonNode*));
+
+    for (unsigned int i = 0; i < node->m_NumChildren; ++i) {
+        size += SkeletonArenaBytes(node->m_Children[i]);
+    }
+    return size;
+}
+
+SkeletonNode* CopySkeleton(LinearArena* arena, const SkeletonNode* node)
+{
+    if (node == NULL) {
+        return NULL;
+    }
+
+    SkeletonNode* copy = (SkeletonNode*)ArenaCopy(arena, node, sizeof(SkeletonNode));
+
+    copy->m_NodeName = ArenaCopyString(arena, node->m_NodeName);
+    copy->m_Children = ArenaAllocArray<SkeletonNode*>(arena, node->m_NumChildren);
+
+    for (unsigned int i = 0; i < node->m_NumChildren; ++i) {
+        copy->m_Children[i] = CopySkeleton(arena, node->m_Children[i]);
+    }
+    return copy;
+}
+
 #endif
\ No newline at end of file
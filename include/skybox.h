@@ -15,6 +15,7 @@ skybox.h
 
 #include <shader_m.h>
 #include <camera.h>
+#include <texture_registry.h>
 
 #include <iostream>
 #include <vector>
@@ -90,8 +91,6 @@ void LoadSkybox(std::string (*filepath)(std::string path), std::string skybox)
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
 
-    stbi_set_flip_vertically_on_load(false);
-
     std::vector<std::string> faces {
         filepath("/resources/skybox/" + skybox + "/side.jpg"),
         filepath("/resources/skybox/" + skybox + "/side.jpg"),
@@ -114,14 +113,12 @@ void LoadSkybox(std::string (*filepath)(std::string path), std::string skybox)
 
     cloudMapTexture = loadCubemapAlpha(cloud);
 
-    stbi_set_flip_vertically_on_load(true);
-
     cloudTexture = TextureFromFile("clouds.png", filepath("/resources/textures"));
 
     glUseProgram(skyboxShader);
-    setShaderInt(skyboxShader, "skybox", 0);
-    setShaderInt(skyboxShader, "clouds", 1);
-    setShaderInt(skyboxShader, "cloudMap", 2);
+    setShaderInt(skyboxShader, UNIFORM("skybox"), 0);
+    setShaderInt(skyboxShader, UNIFORM("clouds"), 1);
+    setShaderInt(skyboxShader, UNIFORM("cloudMap"), 2);
 }
 
 void DrawSkybox(Camera camera, glm::mat4 view, glm::mat4 projection, float currentTime) 
@@ -129,10 +126,10 @@ void DrawSkybox(Camera camera, glm::mat4 view, glm::mat4 projection, float curre
     glDepthFunc(GL_LEQUAL); // change depth function so depth test passes when values are equal to depth buffer's content
     glUseProgram(skyboxShader);
     view = glm::mat4(glm::mat3(GetViewMatrix(camera))); // remove translation from the view matrix
-    setShaderMat4(skyboxShader, "view", view);
-    setShaderMat4(skyboxShader, "projection", projection);
+    setShaderMat4(skyboxShader, UNIFORM("view"), view);
+    setShaderMat4(skyboxShader, UNIFORM("projection"), projection);
 
-    setShaderFloat(skyboxShader, "time", currentTime);
+    setShaderFloat(skyboxShader, UNIFORM("time"), currentTime);
     // skybox cube
     glBindVertexArray(skyboxVAO);
 
@@ -152,57 +149,15 @@ void DrawSkybox(Camera camera, glm::mat4 view, glm::mat4 projection, float curre
 
 unsigned int loadCubemapAlpha(std::vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,  0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        } else {
-            std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}  
+    TextureSettings settings = CubemapTextureSettings();
+    settings.desiredChannels = 4;
+
+    return AcquireCubemap(faces, settings);
+}
 
 unsigned int loadCubemap(std::vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++) {
-        unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data) {
-
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-
-            stbi_image_free(data);
-        } else {
-            std::cout << "Cubemap tex failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
-}  
+    return AcquireCubemap(faces, CubemapTextureSettings());
+}
 
 #endif
\ No newline at end of file
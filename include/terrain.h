@@ -44,31 +44,33 @@ void LoadTerrain(std::string (*filepath)(std::string path), std::string heightma
 
     // load and create a heightmap texture
     // -------------------------
-    glGenTextures(1, &texture_heightmap);
-    //To support non-power-of-two heightmap textures (e.g. 1025x1025)
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture_heightmap); // all upcoming GL_TEXTURE_2D operations now have effect on this texture object
-    // set texture filtering parameters
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    // load image, create texture and generate mipmaps
-    int width, height, nrChannels;
-    // The FileSystem::getPath(...) is part of the GitHub repository so we can find files on any IDE/platform; replace it with your own image path.
-    unsigned short* data = stbi_load_16(heightmap, &width, &height, &nrChannels, STBI_grey);
+    // single channel 16 bit, uploaded as GL_R16 / GL_UNSIGNED_SHORT
+    TextureSettings settings = DefaultTextureSettings();
+    settings.minFilter = GL_LINEAR;
+    settings.mipmaps = false;
+    settings.maxLevel = -1.0f;
+    settings.flip = false;
+    settings.desiredChannels = STBI_grey;
+    settings.bits16 = true;
+
+    texture_heightmap = AcquireTexture(heightmap, settings);
+
+    // the terrain mesh is sized from the heightmap, so this one can't be loaded in the background
+    int width = 0, height = 0;
 
-    if (data) {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, width, height, 0, GL_RED, GL_UNSIGNED_SHORT, data); // Notice GL_UNSIGNED_SHORT
+    if (WaitForTexture(texture_heightmap)) {
+        TextureEntry* entry = FindTexture(texture_heightmap);
+        width = entry->width;
+        height = entry->height;
 
-        SetShaderT_Int(tessHeightMapShader, "heightMap", 0);
+        SetShaderT_Int(tessHeightMapShader, UNIFORM("heightMap"), 0);
 
-        SetShaderT_Float(tessHeightMapShader, "uTexelSize", 1.0f - width);
+        SetShaderT_Float(tessHeightMapShader, UNIFORM("uTexelSize"), 1.0f - width);
 
         std::cout << "Loaded heightmap of size " << height << " x " << width << std::endl;
     } else {
         std::cout << "Failed to load texture" << std::endl;
     }
-    stbi_image_free(data);
 
 
 
@@ -133,29 +135,29 @@ void DrawTerrain(glm::mat4 view, glm::mat4 projection, glm::vec3 sunDirection, g
 {
     glUseProgram(tessHeightMapShader);
 
-    SetShaderT_Mat4(tessHeightMapShader, "view", view);
-    SetShaderT_Mat4(tessHeightMapShader, "projection", projection);
+    SetShaderT_Mat4(tessHeightMapShader, UNIFORM("view"), view);
+    SetShaderT_Mat4(tessHeightMapShader, UNIFORM("projection"), projection);
 
     // world transformation
     glm::mat4 model = glm::mat4(1.0f);
-    SetShaderT_Mat4(tessHeightMapShader, "model", model);
+    SetShaderT_Mat4(tessHeightMapShader, UNIFORM("model"), model);
 
     //lighting
-    SetShaderT_Vec3(tessHeightMapShader, "dirLight.direction", sunDirection);
-    SetShaderT_Vec3(tessHeightMapShader, "dirLight.ambient", color.x, color.y, color.z);
-    SetShaderT_Vec3(tessHeightMapShader, "dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-    SetShaderT_Vec3(tessHeightMapShader, "dirLight.specular", 0.5f, 0.5f, 0.5f);
+    SetShaderT_Vec3(tessHeightMapShader, UNIFORM("dirLight.direction"), sunDirection);
+    SetShaderT_Vec3(tessHeightMapShader, UNIFORM("dirLight.ambient"), color.x, color.y, color.z);
+    SetShaderT_Vec3(tessHeightMapShader, UNIFORM("dirLight.diffuse"), 0.4f, 0.4f, 0.4f);
+    SetShaderT_Vec3(tessHeightMapShader, UNIFORM("dirLight.specular"), 0.5f, 0.5f, 0.5f);
 
-    SetShaderT_Vec3(tessHeightMapShader, "viewPos", viewPos);
+    SetShaderT_Vec3(tessHeightMapShader, UNIFORM("viewPos"), viewPos);
 
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, texture_heightmap);
-    SetShaderT_Int(tessHeightMapShader, "heightMap", 0);
+    SetShaderT_Int(tessHeightMapShader, UNIFORM("heightMap"), 0);
 
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, texture_diffuse);
-    SetShaderT_Int(tessHeightMapShader, "texture_diffuse", 1);
+    SetShaderT_Int(tessHeightMapShader, UNIFORM("texture_diffuse"), 1);
 
 
     // render the terrain
@@ -0,0 +1,496 @@
+/*-------------------------------------------------------------------------------\
+texture_array.h
+
+Functions:
+    Material texture packer. A packed texture (settings.packed, every mesh
+    texture) gets no storage of its own, the loader hands its image to the
+    registry which puts it in a layer of a GL_TEXTURE_2D_ARRAY shared with every
+    other image of the same size, format, mip chain and sampler settings.
+    DrawModelLod binds one array per texture type and passes the layer of each
+    texture as a uniform, so meshes whose textures share arrays draw without
+    binding anything.
+
+    Power of two images smaller than TEXTURE_ATLAS_SIZE come in already tiled
+    to that size (texture_loader.h), so all the small textures of a format
+    share one array whatever their size. The shader scales the texture
+    coordinates by image size / layer size. A real atlas with one rectangle per
+    texture would break GL_REPEAT and bleed between neighbours in the smaller
+    mip levels.
+
+    An array starts with TEXTURE_ARRAY_MIN_LAYERS layers and doubles when it's
+    full, the old layers are copied on the GPU through a pixel buffer. Freed
+    layers are reused, an array is deleted with its last layer.
+
+    Every layer has the same levels resident, texture_residency.h streams and
+    evicts levels of a whole array (mips). An array without a baked chain
+    generates its mipmaps again after every new layer and is never streamed.
+
+    BindTextureArray skips binds of an array already on the unit. Anything else
+    that binds GL_TEXTURE_2D_ARRAY calls ForgetTextureArrayBindings after.
+
+\-------------------------------------------------------------------------------*/
+#ifndef TEXTURE_ARRAY_H
+#define TEXTURE_ARRAY_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <texture_loader.h>
+
+#define TEXTURE_ARRAY_MIN_LAYERS 4
+// units BindTextureArray keeps track of, DrawModelLod uses one per texture type
+#define TEXTURE_ARRAY_UNITS 8
+#define TEXTURE_ARRAY_UNKNOWN 0xFFFFFFFFu
+
+struct TextureEntry;
+
+// What every layer of an array has in common
+struct TextureArrayFormat {
+    int width;
+    int height;
+    int channels;
+    // 0 unless the layers are block compressed
+    GLenum compressedFormat;
+    int blockBytes;
+    bool grey;
+
+    // levels allocated for every layer
+    int numLevels;
+    // no baked chain, glGenerateMipmap fills the levels after 0
+    bool generateMips;
+    bool streamed;
+
+    // sampler state belongs to the texture object
+    GLint wrap;
+    GLint minFilter;
+    GLint magFilter;
+};
+
+struct TextureArray {
+    unsigned int id;
+    TextureArrayFormat format;
+
+    // the texture in each layer, NULL where it's free. The size is the layer capacity.
+    std::vector<TextureEntry*> layers;
+    int numUsed;
+
+    // texture_residency.h, the same levels are resident in every layer
+    MipResidency mips;
+    // level being streamed into every layer, -1 when none
+    int streamLevel;
+    // a layer of streamLevel didn't load
+    bool streamFailed;
+
+    size_t vramBytes;
+};
+
+struct TextureArrays {
+    std::vector<TextureArray*> arrays;
+    size_t totalVRAM;
+    int numGrown;
+
+    // array bound to each unit, TEXTURE_ARRAY_UNKNOWN after ForgetTextureArrayBindings
+    unsigned int bound[TEXTURE_ARRAY_UNITS];
+};
+
+TextureArrays textureArrays;
+
+TextureArrayFormat TextureArrayFormatFor(TextureJob* job, TextureSettings const& settings, bool streamable);
+bool TextureArrayFormatsEqual(TextureArrayFormat const& a, TextureArrayFormat const& b);
+int TextureArrayStartLevel(TextureArrayFormat const& format, int maxSize);
+
+TextureArray* FindTextureArray(TextureArrayFormat const& format);
+TextureArray* CreateTextureArray(TextureArrayFormat const& format, int startLevel);
+int AllocTextureArrayLayer(TextureArray* array, TextureEntry* entry);
+void FreeTextureArrayLayer(TextureArray* array, int layer);
+bool UploadTextureArrayLayer(TextureArray* array, int layer, TextureJob* job, const void* pixels, int firstLevel, int lastLevel);
+
+void AllocTextureArrayLevel(TextureArray* array, int level);
+void FreeTextureArrayLevel(TextureArray* array, int level);
+void SetTextureArrayBaseLevel(TextureArray* array, int level);
+size_t TextureArrayLevelBytes(TextureArray* array, int level);
+
+bool BindTextureArray(int unit, unsigned int id);
+void ForgetTextureArrayBindings();
+
+void GrowTextureArray(TextureArray* array);
+void SetTextureArrayParameters(TextureArray* array);
+void TextureArrayPixelFormat(TextureArrayFormat const& format, GLenum* pixelFormat, GLint* internalFormat);
+void DeleteTextureArray(TextureArray* array);
+
+// The array a decoded image goes to. streamable when the residency manager is on.
+TextureArrayFormat TextureArrayFormatFor(TextureJob* job, TextureSettings const& settings, bool streamable)
+{
+    TextureArrayFormat format;
+    memset(&format, 0, sizeof(format));
+
+    format.width = job->width;
+    format.height = job->height;
+    format.channels = job->channels;
+    format.compressedFormat = job->compressedFormat;
+    format.blockBytes = job->blockBytes;
+    format.grey = job->grey;
+    format.wrap = settings.wrap;
+    format.minFilter = settings.minFilter;
+    format.magFilter = settings.magFilter;
+
+    int chainLevels = TextureLevelCount(job->width, job->height);
+    bool baked = job->firstLevel + job->numLevels > 1;
+
+    format.generateMips = settings.mipmaps && !baked;
+    format.streamed = settings.streamed && streamable && baked;
+
+    // the levels a standalone texture would sample, up to settings.maxLevel
+    format.numLevels = 1;
+    if (format.streamed) {
+        format.numLevels = chainLevels;
+    } else if (settings.mipmaps) {
+        format.numLevels = (settings.maxLevel >= 0.0f) ? std::min((int)settings.maxLevel + 1, chainLevels) : chainLevels;
+    }
+
+    return format;
+}
+
+bool TextureArrayFormatsEqual(TextureArrayFormat const& a, TextureArrayFormat const& b)
+{
+    return a.width == b.width && a.height == b.height && a.channels == b.channels
+        && a.compressedFormat == b.compressedFormat && a.blockBytes == b.blockBytes && a.grey == b.grey
+        && a.numLevels == b.numLevels && a.generateMips == b.generateMips && a.streamed == b.streamed
+        && a.wrap == b.wrap && a.minFilter == b.minFilter && a.magFilter == b.magFilter;
+}
+
+// First level no larger than maxSize, texture_residency.h never drops below it
+int TextureArrayStartLevel(TextureArrayFormat const& format, int maxSize)
+{
+    if (!format.streamed || maxSize <= 0) {
+        return 0;
+    }
+
+    int level = 0;
+    int size = std::max(format.width, format.height);
+
+    while (level < format.numLevels - 1 && size > maxSize) {
+        size = std::max(size / 2, 1);
+        level++;
+    }
+    return level;
+}
+
+TextureArray* FindTextureArray(TextureArrayFormat const& format)
+{
+    for (size_t i = 0; i < textureArrays.arrays.size(); ++i) {
+        if (TextureArrayFormatsEqual(textureArrays.arrays[i]->format, format)) {
+            return textureArrays.arrays[i];
+        }
+    }
+    return NULL;
+}
+
+// Main thread. Allocates TEXTURE_ARRAY_MIN_LAYERS layers with the levels startLevel and up.
+TextureArray* CreateTextureArray(TextureArrayFormat const& format, int startLevel)
+{
+    TextureArray* array = new TextureArray();
+    array->format = format;
+    array->layers.resize(TEXTURE_ARRAY_MIN_LAYERS, NULL);
+    array->numUsed = 0;
+    array->streamLevel = -1;
+    array->streamFailed = false;
+    array->vramBytes = 0;
+
+    array->mips.streamed = format.streamed;
+    array->mips.numLevels = format.numLevels;
+    array->mips.residentLevel = startLevel;
+    array->mips.wantedLevel = startLevel;
+    array->mips.lastUsedFrame = 0;
+    array->mips.streaming = 0;
+
+    glGenTextures(1, &array->id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->id);
+
+    SetTextureArrayParameters(array);
+
+    for (int level = startLevel; level < format.numLevels; ++level) {
+        AllocTextureArrayLevel(array, level);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    ForgetTextureArrayBindings();
+
+    textureArrays.arrays.push_back(array);
+
+    return array;
+}
+
+// Grows the array when every layer is taken
+int AllocTextureArrayLayer(TextureArray* array, TextureEntry* entry)
+{
+    if (array->numUsed == (int)array->layers.size()) {
+        GrowTextureArray(array);
+    }
+
+    for (size_t layer = 0; layer < array->layers.size(); ++layer) {
+        if (array->layers[layer] == NULL) {
+            array->layers[layer] = entry;
+            array->numUsed++;
+            return (int)layer;
+        }
+    }
+    return -1;
+}
+
+// The pixels stay until the layer is used again. Deletes the array with its last layer.
+void FreeTextureArrayLayer(TextureArray* array, int layer)
+{
+    array->layers[layer] = NULL;
+    array->numUsed--;
+
+    if (array->numUsed == 0 && array->mips.streaming == 0) {
+        DeleteTextureArray(array);
+    }
+}
+
+// Main thread, pixels is a pointer or an offset into the bound pixel buffer. Uploads the
+// levels firstLevel..lastLevel that the job has, false if it was missing any.
+bool UploadTextureArrayLayer(TextureArray* array, int layer, TextureJob* job, const void* pixels, int firstLevel, int lastLevel)
+{
+    TextureArrayFormat* format = &array->format;
+
+    GLenum pixelFormat;
+    GLint internalFormat;
+    TextureArrayPixelFormat(*format, &pixelFormat, &internalFormat);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->id);
+
+    int width = job->width;
+    int height = job->height;
+    size_t offset = 0;
+
+    for (int level = 0; level < job->firstLevel; level++) {
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    for (int level = job->firstLevel; level < job->firstLevel + job->numLevels; level++) {
+        size_t levelBytes = (format->compressedFormat != 0) ? CompressedLevelBytes(width, height, format->blockBytes, 0)
+                                                            : (size_t)width * height * format->channels;
+
+        if (level >= firstLevel && level <= lastLevel) {
+            if (format->compressedFormat != 0) {
+                glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, format->compressedFormat,
+                    (GLsizei)levelBytes, (const char*)pixels + offset);
+            } else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, width, height, 1, pixelFormat, GL_UNSIGNED_BYTE,
+                    (const char*)pixels + offset);
+            }
+        }
+
+        offset += levelBytes;
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    if (format->generateMips && format->numLevels > 1) {
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    ForgetTextureArrayBindings();
+
+    return job->firstLevel <= firstLevel && job->firstLevel + job->numLevels > lastLevel;
+}
+
+// Storage for one level of every layer, the array must be bound
+void AllocTextureArrayLevel(TextureArray* array, int level)
+{
+    TextureArrayFormat* format = &array->format;
+    int depth = (int)array->layers.size();
+    int width = std::max(format->width >> level, 1);
+    int height = std::max(format->height >> level, 1);
+
+    if (format->compressedFormat != 0) {
+        glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, format->compressedFormat, width, height, depth, 0,
+            (GLsizei)(CompressedLevelBytes(width, height, format->blockBytes, 0) * depth), NULL);
+    } else {
+        GLenum pixelFormat;
+        GLint internalFormat;
+        TextureArrayPixelFormat(*format, &pixelFormat, &internalFormat);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, level, internalFormat, width, height, depth, 0, pixelFormat, GL_UNSIGNED_BYTE, NULL);
+    }
+
+    size_t bytes = TextureArrayLevelBytes(array, level);
+    array->vramBytes += bytes;
+    textureArrays.totalVRAM += bytes;
+}
+
+// Reallocates the level with size 0, the array must be bound
+void FreeTextureArrayLevel(TextureArray* array, int level)
+{
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+
+    size_t bytes = TextureArrayLevelBytes(array, level);
+    array->vramBytes -= bytes;
+    textureArrays.totalVRAM -= bytes;
+}
+
+// The array must be bound
+void SetTextureArrayBaseLevel(TextureArray* array, int level)
+{
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, level);
+    array->mips.residentLevel = level;
+}
+
+// One level of every layer
+size_t TextureArrayLevelBytes(TextureArray* array, int level)
+{
+    TextureArrayFormat* format = &array->format;
+    return TextureLevelVRAMBytes(format->width, format->height, level, format->channels, format->blockBytes) * array->layers.size();
+}
+
+// Returns true if it had to bind
+bool BindTextureArray(int unit, unsigned int id)
+{
+    if (textureArrays.bound[unit] == id) {
+        return false;
+    }
+
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+    textureArrays.bound[unit] = id;
+    return true;
+}
+
+void ForgetTextureArrayBindings()
+{
+    for (int unit = 0; unit < TEXTURE_ARRAY_UNITS; ++unit) {
+        textureArrays.bound[unit] = TEXTURE_ARRAY_UNKNOWN;
+    }
+}
+
+// Doubles the layers. The allocated levels are read back into a pixel buffer and
+// uploaded into the new storage from it, the data stays on the GPU.
+void GrowTextureArray(TextureArray* array)
+{
+    TextureArrayFormat* format = &array->format;
+
+    GLenum pixelFormat;
+    GLint internalFormat;
+    TextureArrayPixelFormat(*format, &pixelFormat, &internalFormat);
+
+    int oldLayers = (int)array->layers.size();
+    int firstLevel = array->mips.residentLevel;
+    if (array->streamLevel >= 0) {
+        firstLevel = std::min(firstLevel, array->streamLevel);
+    }
+
+    unsigned int oldId = array->id;
+    size_t oldBytes = array->vramBytes;
+
+    array->layers.resize(oldLayers * 2, NULL);
+    array->vramBytes = 0;
+    textureArrays.totalVRAM -= oldBytes;
+
+    glGenTextures(1, &array->id);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->id);
+    SetTextureArrayParameters(array);
+    for (int level = firstLevel; level < format->numLevels; ++level) {
+        AllocTextureArrayLevel(array, level);
+    }
+
+    GLint packAlignment;
+    GLint unpackAlignment;
+    glGetIntegerv(GL_PACK_ALIGNMENT, &packAlignment);
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    unsigned int pbo;
+    glGenBuffers(1, &pbo);
+
+    for (int level = firstLevel; level < format->numLevels; ++level) {
+        int width = std::max(format->width >> level, 1);
+        int height = std::max(format->height >> level, 1);
+        size_t bytes = TextureLevelVRAMBytes(format->width, format->height, level, format->channels, format->blockBytes) * oldLayers;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_COPY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, oldId);
+        if (format->compressedFormat != 0) {
+            glGetCompressedTexImage(GL_TEXTURE_2D_ARRAY, level, (void*)0);
+        } else {
+            glGetTexImage(GL_TEXTURE_2D_ARRAY, level, pixelFormat, GL_UNSIGNED_BYTE, (void*)0);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, array->id);
+        if (format->compressedFormat != 0) {
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, oldLayers, format->compressedFormat,
+                (GLsizei)bytes, (const void*)0);
+        } else {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, oldLayers, pixelFormat, GL_UNSIGNED_BYTE, (const void*)0);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    glDeleteBuffers(1, &pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, packAlignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glDeleteTextures(1, &oldId);
+    ForgetTextureArrayBindings();
+
+    textureArrays.numGrown++;
+}
+
+// The array must be bound
+void SetTextureArrayParameters(TextureArray* array)
+{
+    TextureArrayFormat* format = &array->format;
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, format->wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, format->wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, format->minFilter);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, format->magFilter);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, array->mips.residentLevel);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, format->numLevels - 1);
+    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LOD, (float)(format->numLevels - 1));
+
+    GLint greySwizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+    GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+    glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, format->grey ? greySwizzle : swizzle);
+}
+
+// Same formats the loader uses for a standalone texture
+void TextureArrayPixelFormat(TextureArrayFormat const& format, GLenum* pixelFormat, GLint* internalFormat)
+{
+    if (format.channels == 1)
+        *pixelFormat = GL_RED;
+    else if (format.channels == 2)
+        *pixelFormat = GL_RG;
+    else if (format.channels == 3)
+        *pixelFormat = GL_RGB;
+    else
+        *pixelFormat = GL_RGBA;
+
+    *internalFormat = (GLint)*pixelFormat;
+}
+
+void DeleteTextureArray(TextureArray* array)
+{
+    std::vector<TextureArray*>::iterator found = std::find(textureArrays.arrays.begin(), textureArrays.arrays.end(), array);
+    if (found != textureArrays.arrays.end()) {
+        textureArrays.arrays.erase(found);
+    }
+
+    textureArrays.totalVRAM -= array->vramBytes;
+    glDeleteTextures(1, &array->id);
+    ForgetTextureArrayBindings();
+
+    delete array;
+}
+
+#endif
@@ -0,0 +1,241 @@
+/*-------------------------------------------------------------------------------\
+texture_cache.h
+
+Functions:
+    Baked textures, written next to the source image as <source>.texcache by
+    the asset baker. Holds the decoded pixels and the whole mip chain, so the
+    loader skips stb_image and glGenerateMipmap.
+
+    Keyed by source mtime, size and content hash the same way as mesh_cache.h.
+    Rows are stored top to bottom like the file, the loader flips them if the
+    texture settings ask for it.
+
+    BuildTextureMips makes the chain with a 2x2 box filter, an odd edge repeats
+    its last row/column.
+
+Layout (native endian):
+    TextureCacheHeader
+    levels     { width * height * channels bytes } level 0 first, tightly packed
+
+\-------------------------------------------------------------------------------*/
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+#include <mapped_file.h>
+
+#define TEXTURE_CACHE_VERSION 1
+#define TEXTURE_CACHE_EXTENSION ".texcache"
+
+struct TextureCacheHeader {
+    char magic[4];
+    unsigned int version;
+    long long sourceMtime;
+    unsigned long long sourceSize;
+    unsigned long long contentHash;
+    int width;
+    int height;
+    int channels;
+    int numLevels;
+};
+
+std::string TextureCachePath(std::string const& path);
+int TextureLevelCount(int width, int height);
+size_t TextureLevelBytes(int width, int height, int channels, int level);
+
+unsigned char* BuildTextureMips(const unsigned char* pixels, int width, int height, int channels, int* numLevels, size_t* totalSize);
+bool WriteTextureCache(std::string const& path, const unsigned char* pixels, int width, int height, int channels);
+MappedFile* ReadTextureCache(std::string const& path, TextureCacheHeader* header);
+
+std::string TextureCachePath(std::string const& path)
+{
+    return path + TEXTURE_CACHE_EXTENSION;
+}
+
+// Full chain down to 1x1
+int TextureLevelCount(int width, int height)
+{
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+        levels++;
+    }
+    return levels;
+}
+
+size_t TextureLevelBytes(int width, int height, int channels, int level)
+{
+    for (int i = 0; i < level; ++i) {
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+    return (size_t)width * height * channels;
+}
+
+// Returns every level in one allocation, level 0 is a copy of pixels
+unsigned char* BuildTextureMips(const unsigned char* pixels, int width, int height, int channels, int* numLevels, size_t* totalSize)
+{
+    *numLevels = TextureLevelCount(width, height);
+
+    *totalSize = 0;
+    for (int level = 0; level < *numLevels; ++level) {
+        *totalSize += TextureLevelBytes(width, height, channels, level);
+    }
+
+    unsigned char* levels = (unsigned char*)malloc(*totalSize);
+    memcpy(levels, pixels, (size_t)width * height * channels);
+
+    const unsigned char* src = levels;
+    unsigned char* dst = levels + (size_t)width * height * channels;
+
+    for (int level = 1; level < *numLevels; ++level) {
+        int dstWidth = (width > 1) ? width / 2 : 1;
+        int dstHeight = (height > 1) ? height / 2 : 1;
+
+        for (int y = 0; y < dstHeight; ++y) {
+            int y0 = y * 2;
+            int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+
+            for (int x = 0; x < dstWidth; ++x) {
+                int x0 = x * 2;
+                int x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+
+                for (int c = 0; c < channels; ++c) {
+                    int sum = src[((size_t)y0 * width + x0) * channels + c]
+                        + src[((size_t)y0 * width + x1) * channels + c]
+                        + src[((size_t)y1 * width + x0) * channels + c]
+                        + src[((size_t)y1 * width + x1) * channels + c];
+
+                    dst[((size_t)y * dstWidth + x) * channels + c] = (unsigned char)((sum + 2) / 4);
+                }
+            }
+        }
+
+        src = dst;
+        dst += (size_t)dstWidth * dstHeight * channels;
+        width = dstWidth;
+        height = dstHeight;
+    }
+
+    return levels;
+}
+
+bool WriteTextureCache(std::string const& path, const unsigned char* pixels, int width, int height, int channels)
+{
+    long long mtime;
+    unsigned long long size;
+    if (!GetSourceStamp(path, &mtime, &size)) {
+        return false;
+    }
+
+    bool hashed;
+    unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+    if (!hashed) {
+        return false;
+    }
+
+    TextureCacheHeader header;
+    memcpy(header.magic, "AVTC", 4);
+    header.version = TEXTURE_CACHE_VERSION;
+    header.sourceMtime = mtime;
+    header.sourceSize = size;
+    header.contentHash = hash;
+    header.width = width;
+    header.height = height;
+    header.channels = channels;
+
+    size_t levelsSize;
+    unsigned char* levels = BuildTextureMips(pixels, width, height, channels, &header.numLevels, &levelsSize);
+
+    // Written under a unique name and renamed, so a reader never maps a half written file
+    std::string cachePath = TextureCachePath(path);
+    std::string tempPath = TempFilePath(cachePath);
+
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == NULL) {
+        std::cout << "TEXTURE_CACHE:: could not create " << tempPath << std::endl;
+        free(levels);
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(levels, 1, levelsSize, file) == levelsSize;
+
+    written = (fclose(file) == 0) && written;
+    free(levels);
+
+    if (!written) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) {
+        remove(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// Returns NULL if there is no cache or it is stale. The levels start at
+// mapping->data + sizeof(TextureCacheHeader).
+MappedFile* ReadTextureCache(std::string const& path, TextureCacheHeader* header)
+{
+    long long mtime;
+    unsigned long long size;
+    if (!GetSourceStamp(path, &mtime, &size)) {
+        return NULL;
+    }
+
+    MappedFile* mapping = MapFile(TextureCachePath(path).c_str());
+    if (mapping == NULL) {
+        return NULL;
+    }
+
+    bool valid = mapping->size >= sizeof(TextureCacheHeader);
+
+    if (valid) {
+        memcpy(header, mapping->data, sizeof(TextureCacheHeader));
+
+        valid = memcmp(header->magic, "AVTC", 4) == 0
+            && header->version == TEXTURE_CACHE_VERSION
+            && header->sourceSize == size
+            && header->width > 0 && header->height > 0
+            && header->channels >= 1 && header->channels <= 4
+            && header->numLevels == TextureLevelCount(header->width, header->height);
+    }
+
+    if (valid) {
+        size_t levelsSize = 0;
+        for (int level = 0; level < header->numLevels; ++level) {
+            levelsSize += TextureLevelBytes(header->width, header->height, header->channels, level);
+        }
+        valid = mapping->size >= sizeof(TextureCacheHeader) + levelsSize;
+    }
+
+    // Same size but touched since the cache was written, check the contents
+    if (valid && header->sourceMtime != mtime) {
+        bool hashed;
+        unsigned long long hash = HashFileContents(path.c_str(), &hashed);
+        valid = hashed && hash == header->contentHash;
+    }
+
+    if (!valid) {
+        UnmapFile(mapping);
+        return NULL;
+    }
+
+    return mapping;
+}
+
+#endif
@@ -0,0 +1,756 @@
+/*-------------------------------------------------------------------------------\
+texture_compress.h
+
+Functions:
+    CPU block compression for the asset baker. WriteCompressedTexture picks a
+    format, builds the mip chain, encodes every level and writes <source>.ktx2
+    (ktx2_texture.h).
+
+    BC1  opaque colour
+    BC7  colour with alpha, mode 6 only (one subset, 7.7.7.7 + p-bit endpoints)
+    BC5  normal maps, x and y. z has to be rebuilt in the shader.
+    BC4  grey images, uploaded with a red swizzle so .rgb reads the same
+
+    Normal maps are found by name (normal, _ddn, _nrm), the rest by content.
+
+    Mips use a 2x2 box filter like texture_cache.h, but colour is averaged in
+    linear light and converted back to sRGB, and normals are renormalized.
+
+    Endpoints come from the principal axis of the block, then one least squares
+    refit. The nearest palette entry search runs four pixels at a time with SSE2
+    when the compiler targets it. The baker compresses one texture per worker.
+
+\-------------------------------------------------------------------------------*/
+#ifndef TEXTURE_COMPRESS_H
+#define TEXTURE_COMPRESS_H
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESS_SSE2
+#endif
+
+#include <ktx2_texture.h>
+
+// bump when the encoders change, part of the baker's texture version
+#define TEXTURE_COMPRESS_VERSION 1
+
+enum TextureCompression {
+    TEXTURE_BC1,
+    TEXTURE_BC4,
+    TEXTURE_BC5,
+    TEXTURE_BC7
+};
+
+const char* TextureCompressionNames[] = { "BC1", "BC4", "BC5", "BC7" };
+
+// One 4x4 block, a channel per row
+struct BlockPixels {
+    float channels[4][16];
+};
+
+bool WriteCompressedTexture(std::string const& path, const unsigned char* pixels, int width, int height, int channels, TextureCompression* used);
+
+TextureCompression ChooseTextureCompression(std::string const& path, const unsigned char* rgba, int width, int height);
+unsigned int TextureCompressionFormat(TextureCompression compression);
+unsigned char* ExpandToRGBA(const unsigned char* pixels, int width, int height, int channels, bool flip);
+void DownsampleRGBA(const unsigned char* src, int width, int height, unsigned char* dst, TextureCompression compression);
+void CompressTextureLevel(const unsigned char* rgba, int width, int height, TextureCompression compression, unsigned char* out);
+
+void LoadBlockPixels(const unsigned char* rgba, int width, int height, int blockX, int blockY, BlockPixels* block);
+float FitBlockIndices(const BlockPixels* block, int numChannels, const float palette[][4], int numColors, unsigned char* indices);
+void FitBlockEndpoints(const BlockPixels* block, int numChannels, float* start, float* end);
+bool RefitBlockEndpoints(const BlockPixels* block, int numChannels, const unsigned char* indices, const float* weights, float* start, float* end);
+
+void CompressBlockBC1(const BlockPixels* block, unsigned char* out);
+void CompressBlockBC4(const BlockPixels* block, int channel, unsigned char* out);
+void CompressBlockBC7(const BlockPixels* block, unsigned char* out);
+
+float SrgbToLinear(unsigned char value);
+unsigned char LinearToSrgb(float value);
+void PutBlockBits(unsigned char* out, int* bit, unsigned int value, int count);
+
+// pixels as stb_image returns them, top row first
+bool WriteCompressedTexture(std::string const& path, const unsigned char* pixels, int width, int height, int channels, TextureCompression* used)
+{
+    // TextureFromFile loads flipped, store the rows the way OpenGL wants them
+    unsigned char* level = ExpandToRGBA(pixels, width, height, channels, true);
+
+    TextureCompression compression = ChooseTextureCompression(path, level, width, height);
+    unsigned int vkFormat = TextureCompressionFormat(compression);
+    int blockBytes = Ktx2BlockBytes(vkFormat);
+
+    int numLevels = 1;
+    for (int w = width, h = height; (w > 1 || h > 1) && numLevels < KTX2_MAX_LEVELS; ++numLevels) {
+        w = (w > 1) ? w / 2 : 1;
+        h = (h > 1) ? h / 2 : 1;
+    }
+
+    std::vector<std::vector<unsigned char> > levels(numLevels);
+
+    int levelWidth = width;
+    int levelHeight = height;
+
+    for (int i = 0; i < numLevels; ++i) {
+        levels[i].resize(CompressedLevelBytes(width, height, blockBytes, i));
+        CompressTextureLevel(level, levelWidth, levelHeight, compression, levels[i].data());
+
+        if (i + 1 < numLevels) {
+            int nextWidth = (levelWidth > 1) ? levelWidth / 2 : 1;
+            int nextHeight = (levelHeight > 1) ? levelHeight / 2 : 1;
+
+            unsigned char* next = (unsigned char*)malloc((size_t)nextWidth * nextHeight * 4);
+            DownsampleRGBA(level, levelWidth, levelHeight, next, compression);
+
+            free(level);
+            level = next;
+            levelWidth = nextWidth;
+            levelHeight = nextHeight;
+        }
+    }
+
+    free(level);
+
+    *used = compression;
+
+    return WriteKtx2Texture(path, vkFormat, width, height, true, levels);
+}
+
+TextureCompression ChooseTextureCompression(std::string const& path, const unsigned char* rgba, int width, int height)
+{
+    std::string name = std::filesystem::path(path).filename().generic_string();
+    std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+    if (name.find("normal") != std::string::npos || name.find("_ddn") != std::string::npos || name.find("_nrm") != std::string::npos) {
+        return TEXTURE_BC5;
+    }
+
+    bool alpha = false;
+    bool grey = true;
+
+    for (size_t i = 0; i < (size_t)width * height * 4; i += 4) {
+        if (rgba[i + 3] != 255) {
+            alpha = true;
+        }
+        // jpeg leaves a little colour in grey images
+        if (abs(rgba[i] - rgba[i + 1]) > 2 || abs(rgba[i + 1] - rgba[i + 2]) > 2) {
+            grey = false;
+        }
+    }
+
+    if (alpha) {
+        return TEXTURE_BC7;
+    }
+    return grey ? TEXTURE_BC4 : TEXTURE_BC1;
+}
+
+// Colour is tagged sRGB, the viewer still uploads it as UNORM like the uncompressed path
+unsigned int TextureCompressionFormat(TextureCompression compression)
+{
+    switch (compression) {
+    case TEXTURE_BC1:
+        return KTX2_BC1_RGB_SRGB;
+    case TEXTURE_BC4:
+        return KTX2_BC4_UNORM;
+    case TEXTURE_BC5:
+        return KTX2_BC5_UNORM;
+    case TEXTURE_BC7:
+        return KTX2_BC7_SRGB;
+    }
+    return 0;
+}
+
+// Grey becomes (v, v, v), a missing alpha 255
+unsigned char* ExpandToRGBA(const unsigned char* pixels, int width, int height, int channels, bool flip)
+{
+    unsigned char* rgba = (unsigned char*)malloc((size_t)width * height * 4);
+
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* src = pixels + (size_t)(flip ? height - 1 - y : y) * width * channels;
+        unsigned char* dst = rgba + (size_t)y * width * 4;
+
+        for (int x = 0; x < width; ++x, src += channels, dst += 4) {
+            if (channels <= 2) {
+                dst[0] = dst[1] = dst[2] = src[0];
+                dst[3] = (channels == 2) ? src[1] : 255;
+            } else {
+                dst[0] = src[0];
+                dst[1] = src[1];
+                dst[2] = src[2];
+                dst[3] = (channels == 4) ? src[3] : 255;
+            }
+        }
+    }
+
+    return rgba;
+}
+
+struct SrgbTable {
+    float values[256];
+
+    SrgbTable()
+    {
+        for (int i = 0; i < 256; ++i) {
+            float c = i / 255.0f;
+            values[i] = (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+        }
+    }
+};
+
+float SrgbToLinear(unsigned char value)
+{
+    // built once, the first call on any worker
+    static const SrgbTable table;
+    return table.values[value];
+}
+
+unsigned char LinearToSrgb(float value)
+{
+    value = std::min(std::max(value, 0.0f), 1.0f);
+    float c = (value <= 0.0031308f) ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+    return (unsigned char)(c * 255.0f + 0.5f);
+}
+
+// 2x2 box filter, an odd edge repeats its last row/column
+void DownsampleRGBA(const unsigned char* src, int width, int height, unsigned char* dst, TextureCompression compression)
+{
+    int dstWidth = (width > 1) ? width / 2 : 1;
+    int dstHeight = (height > 1) ? height / 2 : 1;
+
+    for (int y = 0; y < dstHeight; ++y) {
+        int y0 = y * 2;
+        int y1 = (y0 + 1 < height) ? y0 + 1 : y0;
+
+        for (int x = 0; x < dstWidth; ++x) {
+            int x0 = x * 2;
+            int x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+
+            const unsigned char* taps[4] = {
+                src + ((size_t)y0 * width + x0) * 4,
+                src + ((size_t)y0 * width + x1) * 4,
+                src + ((size_t)y1 * width + x0) * 4,
+                src + ((size_t)y1 * width + x1) * 4
+            };
+            unsigned char* out = dst + ((size_t)y * dstWidth + x) * 4;
+
+            if (compression == TEXTURE_BC1 || compression == TEXTURE_BC7) {
+                for (int c = 0; c < 3; ++c) {
+                    float sum = SrgbToLinear(taps[0][c]) + SrgbToLinear(taps[1][c]) + SrgbToLinear(taps[2][c]) + SrgbToLinear(taps[3][c]);
+                    out[c] = LinearToSrgb(sum * 0.25f);
+                }
+                out[3] = (unsigned char)((taps[0][3] + taps[1][3] + taps[2][3] + taps[3][3] + 2) / 4);
+            } else if (compression == TEXTURE_BC5) {
+                float n[3] = { 0.0f, 0.0f, 0.0f };
+                for (int i = 0; i < 4; ++i) {
+                    for (int c = 0; c < 3; ++c) {
+                        n[c] += taps[i][c] / 127.5f - 1.0f;
+                    }
+                }
+
+                float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length < 1e-6f) {
+                    n[0] = 0.0f;
+                    n[1] = 0.0f;
+                    n[2] = length = 1.0f;
+                }
+
+                for (int c = 0; c < 3; ++c) {
+                    float value = (n[c] / length + 1.0f) * 127.5f;
+                    out[c] = (unsigned char)std::min(std::max(value + 0.5f, 0.0f), 255.0f);
+                }
+                out[3] = 255;
+            } else {
+                for (int c = 0; c < 4; ++c) {
+                    out[c] = (unsigned char)((taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+void CompressTextureLevel(const unsigned char* rgba, int width, int height, TextureCompression compression, unsigned char* out)
+{
+    int blocksWide = (width + 3) / 4;
+    int blocksHigh = (height + 3) / 4;
+
+    BlockPixels block;
+
+    for (int blockY = 0; blockY < blocksHigh; ++blockY) {
+        for (int blockX = 0; blockX < blocksWide; ++blockX) {
+            LoadBlockPixels(rgba, width, height, blockX, blockY, &block);
+
+            if (compression == TEXTURE_BC1) {
+                CompressBlockBC1(&block, out);
+                out += 8;
+            } else if (compression == TEXTURE_BC4) {
+                CompressBlockBC4(&block, 0, out);
+                out += 8;
+            } else if (compression == TEXTURE_BC5) {
+                CompressBlockBC4(&block, 0, out);
+                CompressBlockBC4(&block, 1, out + 8);
+                out += 16;
+            } else {
+                CompressBlockBC7(&block, out);
+                out += 16;
+            }
+        }
+    }
+}
+
+// Pixels past the edge repeat the last row/column
+void LoadBlockPixels(const unsigned char* rgba, int width, int height, int blockX, int blockY, BlockPixels* block)
+{
+    for (int i = 0; i < 16; ++i) {
+        int x = std::min(blockX * 4 + (i & 3), width - 1);
+        int y = std::min(blockY * 4 + (i >> 2), height - 1);
+
+        const unsigned char* pixel = rgba + ((size_t)y * width + x) * 4;
+        for (int c = 0; c < 4; ++c) {
+            block->channels[c][i] = pixel[c];
+        }
+    }
+}
+
+// Nearest palette entry for every pixel, returns the summed squared error
+float FitBlockIndices(const BlockPixels* block, int numChannels, const float palette[][4], int numColors, unsigned char* indices)
+{
+    float error = 0.0f;
+
+#ifdef TEXTURE_COMPRESS_SSE2
+    for (int group = 0; group < 16; group += 4) {
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIndex = _mm_setzero_si128();
+
+        for (int p = 0; p < numColors; ++p) {
+            __m128 distance = _mm_setzero_ps();
+
+            for (int c = 0; c < numChannels; ++c) {
+                __m128 d = _mm_sub_ps(_mm_loadu_ps(&block->channels[c][group]), _mm_set1_ps(palette[p][c]));
+                distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+            }
+
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+            best = _mm_min_ps(distance, best);
+        }
+
+        int lanes[4];
+        float distances[4];
+        _mm_storeu_si128((__m128i*)lanes, bestIndex);
+        _mm_storeu_ps(distances, best);
+
+        for (int i = 0; i < 4; ++i) {
+            indices[group + i] = (unsigned char)lanes[i];
+            error += distances[i];
+        }
+    }
+#else
+    for (int i = 0; i < 16; ++i) {
+        float best = FLT_MAX;
+
+        for (int p = 0; p < numColors; ++p) {
+            float distance = 0.0f;
+            for (int c = 0; c < numChannels; ++c) {
+                float d = block->channels[c][i] - palette[p][c];
+                distance += d * d;
+            }
+            if (distance < best) {
+                best = distance;
+                indices[i] = (unsigned char)p;
+            }
+        }
+        error += best;
+    }
+#endif
+
+    return error;
+}
+
+// Ends of the principal axis through the block's pixels
+void FitBlockEndpoints(const BlockPixels* block, int numChannels, float* start, float* end)
+{
+    float mean[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int c = 0; c < numChannels; ++c) {
+        for (int i = 0; i < 16; ++i) {
+            mean[c] += block->channels[c][i];
+        }
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[4][4] = {};
+    for (int i = 0; i < 16; ++i) {
+        for (int a = 0; a < numChannels; ++a) {
+            for (int b = 0; b < numChannels; ++b) {
+                covariance[a][b] += (block->channels[a][i] - mean[a]) * (block->channels[b][i] - mean[b]);
+            }
+        }
+    }
+
+    // power iteration, starting from the bounding box diagonal
+    float axis[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for (int c = 0; c < numChannels; ++c) {
+        float low = block->channels[c][0];
+        float high = low;
+        for (int i = 1; i < 16; ++i) {
+            low = std::min(low, block->channels[c][i]);
+            high = std::max(high, block->channels[c][i]);
+        }
+        axis[c] = high - low;
+    }
+
+    for (int iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        float length = 0.0f;
+
+        for (int a = 0; a < numChannels; ++a) {
+            for (int b = 0; b < numChannels; ++b) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+            length += next[a] * next[a];
+        }
+
+        if (length < 1e-12f) {
+            break;
+        }
+
+        length = 1.0f / sqrtf(length);
+        for (int c = 0; c < numChannels; ++c) {
+            axis[c] = next[c] * length;
+        }
+    }
+
+    float axisLength = 0.0f;
+    for (int c = 0; c < numChannels; ++c) {
+        axisLength += axis[c] * axis[c];
+    }
+
+    // flat block
+    if (axisLength < 1e-12f) {
+        for (int c = 0; c < numChannels; ++c) {
+            start[c] = end[c] = mean[c];
+        }
+        return;
+    }
+
+    axisLength = 1.0f / sqrtf(axisLength);
+    for (int c = 0; c < numChannels; ++c) {
+        axis[c] *= axisLength;
+    }
+
+    float low = FLT_MAX;
+    float high = -FLT_MAX;
+    for (int i = 0; i < 16; ++i) {
+        float t = 0.0f;
+        for (int c = 0; c < numChannels; ++c) {
+            t += (block->channels[c][i] - mean[c]) * axis[c];
+        }
+        low = std::min(low, t);
+        high = std::max(high, t);
+    }
+
+    for (int c = 0; c < numChannels; ++c) {
+        start[c] = std::min(std::max(mean[c] + axis[c] * low, 0.0f), 255.0f);
+        end[c] = std::min(std::max(mean[c] + axis[c] * high, 0.0f), 255.0f);
+    }
+}
+
+// Least squares endpoints for fixed indices. weights[i] is how far palette entry i is from start to end.
+bool RefitBlockEndpoints(const BlockPixels* block, int numChannels, const unsigned char* indices, const float* weights, float* start, float* end)
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    float bx[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    for (int i = 0; i < 16; ++i) {
+        float b = weights[indices[i]];
+        float a = 1.0f - b;
+
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+
+        for (int c = 0; c < numChannels; ++c) {
+            ax[c] += a * block->channels[c][i];
+            bx[c] += b * block->channels[c][i];
+        }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (fabsf(determinant) < 1e-6f) {
+        return false;
+    }
+
+    determinant = 1.0f / determinant;
+    for (int c = 0; c < numChannels; ++c) {
+        start[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) * determinant, 0.0f), 255.0f);
+        end[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) * determinant, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+void PutBlockBits(unsigned char* out, int* bit, unsigned int value, int count)
+{
+    for (int i = 0; i < count; ++i, ++*bit) {
+        if (value & (1u << i)) {
+            out[*bit >> 3] |= (unsigned char)(1 << (*bit & 7));
+        }
+    }
+}
+
+unsigned short PackColor565(const float* color)
+{
+    int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+    return (unsigned short)((r << 11) | (g << 5) | b);
+}
+
+void UnpackColor565(unsigned short packed, float* color)
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = (float)((r << 3) | (r >> 2));
+    color[1] = (float)((g << 2) | (g >> 4));
+    color[2] = (float)((b << 3) | (b >> 2));
+    color[3] = 255.0f;
+}
+
+// Four colour mode, color0 > color1. Returns the error.
+float EncodeBC1(const BlockPixels* block, const float* start, const float* end, unsigned char* out)
+{
+    unsigned short color0 = PackColor565(end);
+    unsigned short color1 = PackColor565(start);
+
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+
+    float palette[4][4];
+    UnpackColor565(color0, palette[0]);
+    UnpackColor565(color1, palette[1]);
+    for (int c = 0; c < 3; ++c) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    unsigned char indices[16];
+    float error;
+
+    if (color0 == color1) {
+        // would be three colour mode, where index 3 is black
+        memset(indices, 0, sizeof(indices));
+        error = FitBlockIndices(block, 3, palette, 1, indices);
+    } else {
+        error = FitBlockIndices(block, 3, palette, 4, indices);
+    }
+
+    memset(out, 0, 8);
+    out[0] = (unsigned char)(color0 & 0xFF);
+    out[1] = (unsigned char)(color0 >> 8);
+    out[2] = (unsigned char)(color1 & 0xFF);
+    out[3] = (unsigned char)(color1 >> 8);
+
+    for (int i = 0; i < 16; ++i) {
+        out[4 + i / 4] |= (unsigned char)(indices[i] << ((i % 4) * 2));
+    }
+
+    return error;
+}
+
+void CompressBlockBC1(const BlockPixels* block, unsigned char* out)
+{
+    float start[4];
+    float end[4];
+    FitBlockEndpoints(block, 3, start, end);
+
+    float error = EncodeBC1(block, start, end, out);
+
+    // palette entries 0..3 sit at these points between color0 and color1
+    static const float weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    unsigned short color0 = (unsigned short)(out[0] | (out[1] << 8));
+    unsigned short color1 = (unsigned short)(out[2] | (out[3] << 8));
+    if (color0 == color1) {
+        return;
+    }
+
+    unsigned char indices[16];
+    for (int i = 0; i < 16; ++i) {
+        indices[i] = (out[4 + i / 4] >> ((i % 4) * 2)) & 3;
+    }
+
+    if (RefitBlockEndpoints(block, 3, indices, weights, start, end)) {
+        unsigned char refit[8];
+        // start is color0 here, EncodeBC1 puts its second argument first
+        if (EncodeBC1(block, end, start, refit) < error) {
+            memcpy(out, refit, 8);
+        }
+    }
+}
+
+// Eight value mode, min and max of the channel as the endpoints
+void CompressBlockBC4(const BlockPixels* block, int channel, unsigned char* out)
+{
+    float low = 255.0f;
+    float high = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        low = std::min(low, block->channels[channel][i]);
+        high = std::max(high, block->channels[channel][i]);
+    }
+
+    int value0 = (int)(high + 0.5f);
+    int value1 = (int)(low + 0.5f);
+
+    float palette[8][4];
+    palette[0][0] = (float)value0;
+    palette[1][0] = (float)value1;
+    for (int i = 1; i < 7; ++i) {
+        palette[i + 1][0] = (float)(((7 - i) * value0 + i * value1) / 7);
+    }
+
+    // FitBlockIndices reads channel 0
+    BlockPixels single;
+    memcpy(single.channels[0], block->channels[channel], sizeof(single.channels[0]));
+
+    unsigned char indices[16];
+    if (value0 == value1) {
+        memset(indices, 0, sizeof(indices));
+    } else {
+        FitBlockIndices(&single, 1, palette, 8, indices);
+    }
+
+    memset(out, 0, 8);
+    out[0] = (unsigned char)value0;
+    out[1] = (unsigned char)value1;
+
+    int bit = 16;
+    for (int i = 0; i < 16; ++i) {
+        PutBlockBits(out, &bit, indices[i], 3);
+    }
+}
+
+// Endpoint rounded to 7 bits plus the p-bit that fits it best
+void QuantizeBC7Endpoint(const float* color, int* values, int* pbit)
+{
+    float bestError = FLT_MAX;
+
+    for (int p = 0; p < 2; ++p) {
+        float error = 0.0f;
+        int quantized[4];
+
+        for (int c = 0; c < 4; ++c) {
+            quantized[c] = std::min(std::max((int)((color[c] - p) * 0.5f + 0.5f), 0), 127);
+            float d = (float)(quantized[c] * 2 + p) - color[c];
+            error += d * d;
+        }
+
+        if (error < bestError) {
+            bestError = error;
+            *pbit = p;
+            memcpy(values, quantized, sizeof(quantized));
+        }
+    }
+}
+
+const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Mode 6. Returns the error.
+float EncodeBC7Mode6(const BlockPixels* block, const float* start, const float* end, unsigned char* out)
+{
+    int values[2][4];
+    int pbits[2];
+    QuantizeBC7Endpoint(start, values[0], &pbits[0]);
+    QuantizeBC7Endpoint(end, values[1], &pbits[1]);
+
+    int endpoints[2][4];
+    for (int e = 0; e < 2; ++e) {
+        for (int c = 0; c < 4; ++c) {
+            endpoints[e][c] = values[e][c] * 2 + pbits[e];
+        }
+    }
+
+    float palette[16][4];
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < 4; ++c) {
+            palette[i][c] = (float)(((64 - BC7Weights4[i]) * endpoints[0][c] + BC7Weights4[i] * endpoints[1][c] + 32) >> 6);
+        }
+    }
+
+    unsigned char indices[16];
+    float error = FitBlockIndices(block, 4, palette, 16, indices);
+
+    // the anchor index only has 3 bits, flip the endpoints so its top bit is 0
+    if (indices[0] & 8) {
+        std::swap(pbits[0], pbits[1]);
+        for (int c = 0; c < 4; ++c) {
+            std::swap(values[0][c], values[1][c]);
+        }
+        for (int i = 0; i < 16; ++i) {
+            indices[i] = (unsigned char)(15 - indices[i]);
+        }
+    }
+
+    memset(out, 0, 16);
+    int bit = 0;
+
+    PutBlockBits(out, &bit, 1 << 6, 7);
+    for (int c = 0; c < 4; ++c) {
+        PutBlockBits(out, &bit, values[0][c], 7);
+        PutBlockBits(out, &bit, values[1][c], 7);
+    }
+    PutBlockBits(out, &bit, pbits[0], 1);
+    PutBlockBits(out, &bit, pbits[1], 1);
+
+    for (int i = 0; i < 16; ++i) {
+        PutBlockBits(out, &bit, indices[i], (i == 0) ? 3 : 4);
+    }
+
+    return error;
+}
+
+void CompressBlockBC7(const BlockPixels* block, unsigned char* out)
+{
+    float start[4];
+    float end[4];
+    FitBlockEndpoints(block, 4, start, end);
+
+    float error = EncodeBC7Mode6(block, start, end, out);
+
+    // read the indices back, with the anchor swap already applied they still
+    // go from the first endpoint written to the second
+    unsigned char indices[16];
+    int bit = 65;
+    for (int i = 0; i < 16; ++i) {
+        int count = (i == 0) ? 3 : 4;
+        indices[i] = 0;
+        for (int j = 0; j < count; ++j, ++bit) {
+            indices[i] |= (unsigned char)(((out[bit >> 3] >> (bit & 7)) & 1) << j);
+        }
+    }
+
+    float weights[16];
+    for (int i = 0; i < 16; ++i) {
+        weights[i] = BC7Weights4[i] / 64.0f;
+    }
+
+    if (RefitBlockEndpoints(block, 4, indices, weights, start, end)) {
+        unsigned char refit[16];
+        if (EncodeBC7Mode6(block, start, end, refit) < error) {
+            memcpy(out, refit, 16);
+        }
+    }
+}
+
+#endif
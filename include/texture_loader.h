@@ -0,0 +1,1062 @@
+/*-------------------------------------------------------------------------------\
+texture_loader.h
+
+Functions:
+    Texture loading pipeline. LoadTextureAsync / LoadCubemapAsync return the
+    OpenGL texture id straight away, the image shows up a few frames later.
+
+    1. worker thread:  map the file, hash it, stbi_load, channel swizzle (gltf)
+    2. main thread:    create a pixel buffer object and map it
+    3. worker thread:  copy the pixels into the mapped buffer
+    4. main thread:    unmap, glTexImage2D from the buffer, mipmaps, parameters
+
+    PollTextureLoader runs steps 2 and 4 and must be called once per frame.
+    Decode, copy and upload times are printed for every texture.
+
+    If the asset baker left a current <path>.texcache next to the image
+    (texture_cache.h) step 1 copies the pixels and mip chain out of it instead,
+    and step 4 uploads every level rather than calling glGenerateMipmap.
+
+    A current <path>.ktx2 (ktx2_texture.h) is preferred over both when the
+    settings match how it was baked (flipped, file channels, no channel op)
+    and the driver has the format. Its BC1/BC4/BC5/BC7 levels go to
+    glCompressedTexImage2D, BC4 gets a red swizzle so it reads as grey.
+
+    Baked mip chains can be loaded in part for texture_residency.h:
+    maxResidentSize skips the levels larger than it and sets GL_TEXTURE_BASE_LEVEL
+    past them, streamLevel uploads one more level into an existing texture.
+
+    With onUploadImage set the image doesn't go to the texture id, the callback
+    puts it in a layer of a texture array (texture_array.h) and the texture
+    parameters are left to it. Packed power of two images no larger than
+    TEXTURE_ATLAS_SIZE are tiled on the worker until they fill a layer of that
+    size, so every small texture of a format can share one array.
+
+    Cubemap faces that use the same file are decoded once and uploaded to every
+    face. When the last image is in, upload->onFinished is called with the size,
+    VRAM estimate and content hash (texture_registry.h uses this).
+
+\-------------------------------------------------------------------------------*/
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+// main.cpp defines STB_IMAGE_IMPLEMENTATION, a second include would define it twice
+#ifndef STBI_INCLUDE_STB_IMAGE_H
+#include <stb_image.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <ktx2_texture.h>
+#include <mapped_file.h>
+#include <texture_cache.h>
+#include <worker_pool.h>
+
+// packed power of two images up to this size are tiled to fill a layer of it
+#define TEXTURE_ATLAS_SIZE 256
+
+// glad.h is generated for the 4.1 core profile without these
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+
+struct TextureSettings {
+    GLint wrap;
+    GLint minFilter;
+    GLint magFilter;
+    bool mipmaps;
+    // < 0 leaves GL_TEXTURE_MAX_LEVEL/MAX_LOD alone
+    float maxLevel;
+    bool flip;
+    // stbi req_comp, 0 keeps the channels in the file
+    int desiredChannels;
+    // gltf_load_texture type: 1 metallic (blue), 2 roughness (green), 3 occlusion (red)
+    int channelOp;
+    // stbi_load_16, uploaded as GL_R16 / GL_RG16 / ... (terrain heightmap)
+    bool bits16;
+    // texture_residency.h picks the levels, only for textures whose draws report a footprint
+    bool streamed;
+    // goes in a layer of a texture array shared with every image like it (texture_array.h)
+    bool packed;
+};
+
+// texture_residency.h state of a texture or texture array whose levels are streamed.
+// The levels residentLevel..numLevels-1 are in VRAM.
+struct MipResidency {
+    bool streamed;
+    int numLevels;
+    int residentLevel;
+    // finest level asked for while drawing
+    int wantedLevel;
+    unsigned long long lastUsedFrame;
+    // level uploads in flight, it can't be deleted until they finish
+    int streaming;
+};
+
+struct TextureJob;
+
+// One OpenGL texture, a cubemap has six images
+struct TextureUpload {
+    unsigned int id;
+    GLenum bindTarget;
+    int imagesLeft;
+    int imagesLoaded;
+    // images that came with their whole mip chain
+    int imagesWithMips;
+    TextureSettings settings;
+
+    // filled in as images arrive
+    int width;
+    int height;
+    int channels;
+    // 0 unless the images came from a .ktx2
+    int blockBytes;
+    bool grey;
+    // first level uploaded and the end of the chain, 1 level without a baked chain
+    int baseLevel;
+    int numLevels;
+    size_t vramBytes;
+    unsigned long long contentHash;
+
+    // texture_residency.h. Levels of a baked chain larger than this are skipped,
+    // 0 uploads them all. streamLevel >= 0 uploads only that level and leaves the
+    // texture parameters alone, it fails without a baked chain.
+    int maxResidentSize;
+    int streamLevel;
+
+    // times the image was repeated across and down to fill an atlas layer,
+    // width and height are the size of the whole layer
+    int tilesX;
+    int tilesY;
+
+    // main thread, uploads the image instead of the loader. False if it couldn't.
+    bool (*onUploadImage)(TextureUpload* upload, TextureJob* job, const void* pixels);
+
+    // main thread, after the last image. Called with imagesLoaded == 0 on failure.
+    void (*onFinished)(TextureUpload* upload);
+    void* user;
+};
+
+enum TextureJobStage {
+    TEXTURE_DECODE,
+    TEXTURE_COPY
+};
+
+struct TextureJob {
+    TextureUpload* upload;
+    // every cubemap face that uses this file
+    GLenum targets[6];
+    int numTargets;
+    char* path;
+
+    TextureJobStage stage;
+
+    unsigned char* pixels;
+    int width;
+    int height;
+    int channels;
+    // 1 unless the pixels came from a texcache or .ktx2, size covers every level.
+    // The first one is level firstLevel of the chain.
+    int firstLevel;
+    int numLevels;
+    // see TextureUpload::tilesX
+    int tilesX;
+    int tilesY;
+    size_t size;
+    unsigned long long contentHash;
+
+    // set when the levels are block compressed
+    GLenum compressedFormat;
+    int blockBytes;
+    // BC4, shown as (r, r, r, 1)
+    bool grey;
+
+    unsigned int pbo;
+    void* mapped;
+
+    double decodeMs;
+    double copyMs;
+    double uploadMs;
+};
+
+struct TextureLoader {
+    std::mutex mutex;
+    std::vector<TextureJob*> finished;
+
+    // main thread only
+    int numPending;
+
+    // compressed formats the driver takes, checked on the first upload.
+    // Workers only read them afterwards.
+    bool checkedFormats;
+    bool s3tc;
+    bool bptc;
+};
+
+TextureLoader textureLoader;
+
+TextureSettings DefaultTextureSettings();
+TextureSettings CubemapTextureSettings();
+
+unsigned int LoadTextureAsync(std::string const& path, TextureSettings settings);
+unsigned int LoadCubemapAsync(std::vector<std::string> const& faces, TextureSettings settings);
+
+TextureUpload* CreateTextureUpload(GLenum bindTarget, TextureSettings settings);
+TextureUpload* ReuseTextureUpload(unsigned int id, GLenum bindTarget, TextureSettings settings);
+void QueueTextureUpload(TextureUpload* upload, std::vector<std::string> const& paths);
+
+void PollTextureLoader();
+void WaitForTextures();
+
+void QueueTextureImage(TextureUpload* upload, GLenum* targets, int numTargets, std::string const& path);
+void TextureWorkerJob(void* arg);
+void DecodeTextureImage(TextureJob* job);
+bool DecodeCompressedTexture(TextureJob* job);
+bool DecodeBakedTexture(TextureJob* job);
+bool TextureLevelRange(TextureUpload* upload, int width, int height, int numLevels, int* firstLevel, int* lastLevel);
+bool TextureAtlasTiled(TextureJob* job);
+void TileTextureImage(TextureJob* job);
+void CheckCompressedFormats();
+void MapTexturePBO(TextureJob* job);
+void UploadTextureImage(TextureJob* job);
+void FinishTextureJob(TextureJob* job, bool uploaded);
+size_t TextureVRAMBytes(TextureUpload* upload);
+size_t TextureLevelVRAMBytes(int width, int height, int level, int pixelBytes, int blockBytes);
+bool TextureUploadStreamed(TextureUpload* upload);
+double ElapsedMs(std::chrono::steady_clock::time_point start);
+
+// Same settings TextureFromFile always used
+TextureSettings DefaultTextureSettings()
+{
+    TextureSettings settings;
+    settings.wrap = GL_REPEAT;
+    settings.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    settings.magFilter = GL_LINEAR;
+    settings.mipmaps = true;
+    settings.maxLevel = 2.0f;
+    settings.flip = true;
+    settings.desiredChannels = 0;
+    settings.channelOp = 0;
+    settings.bits16 = false;
+    settings.streamed = false;
+    settings.packed = false;
+    return settings;
+}
+
+TextureSettings CubemapTextureSettings()
+{
+    TextureSettings settings;
+    settings.wrap = GL_CLAMP_TO_EDGE;
+    settings.minFilter = GL_LINEAR;
+    settings.magFilter = GL_LINEAR;
+    settings.mipmaps = false;
+    settings.maxLevel = -1.0f;
+    settings.flip = false;
+    settings.desiredChannels = 3;
+    settings.channelOp = 0;
+    settings.bits16 = false;
+    settings.streamed = false;
+    settings.packed = false;
+    return settings;
+}
+
+double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+unsigned int LoadTextureAsync(std::string const& path, TextureSettings settings)
+{
+    TextureUpload* upload = CreateTextureUpload(GL_TEXTURE_2D, settings);
+    QueueTextureUpload(upload, std::vector<std::string>(1, path));
+    return upload->id;
+}
+
+unsigned int LoadCubemapAsync(std::vector<std::string> const& faces, TextureSettings settings)
+{
+    TextureUpload* upload = CreateTextureUpload(GL_TEXTURE_CUBE_MAP, settings);
+    QueueTextureUpload(upload, faces);
+    return upload->id;
+}
+
+// Set onFinished / user before QueueTextureUpload
+TextureUpload* CreateTextureUpload(GLenum bindTarget, TextureSettings settings)
+{
+    if (!textureLoader.checkedFormats) {
+        CheckCompressedFormats();
+    }
+
+    unsigned int id;
+    glGenTextures(1, &id);
+
+    return ReuseTextureUpload(id, bindTarget, settings);
+}
+
+// Main thread. BC4/BC5 are core, BC1 and BC7 are extensions on 4.1.
+void CheckCompressedFormats()
+{
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+
+    textureLoader.bptc = major > 4 || (major == 4 && minor >= 2);
+    textureLoader.s3tc = false;
+
+    GLint numExtensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+    for (GLint i = 0; i < numExtensions; i++) {
+        const char* name = (const char*)glGetStringi(GL_EXTENSIONS, i);
+
+        if (name == NULL) {
+            continue;
+        }
+        if (strcmp(name, "GL_EXT_texture_compression_s3tc") == 0) {
+            textureLoader.s3tc = true;
+        } else if (strcmp(name, "GL_ARB_texture_compression_bptc") == 0) {
+            textureLoader.bptc = true;
+        }
+    }
+
+    textureLoader.checkedFormats = true;
+}
+
+// Uploads into an existing texture, its images are replaced once the new ones are decoded
+TextureUpload* ReuseTextureUpload(unsigned int id, GLenum bindTarget, TextureSettings settings)
+{
+    TextureUpload* upload = (TextureUpload*)calloc(1, sizeof(TextureUpload));
+
+    upload->id = id;
+    upload->bindTarget = bindTarget;
+    upload->settings = settings;
+    upload->contentHash = FNV1A_64_OFFSET;
+    upload->streamLevel = -1;
+    upload->tilesX = 1;
+    upload->tilesY = 1;
+
+    return upload;
+}
+
+// One path for a 2D texture, six for a cubemap (+X -X +Y -Y +Z -Z)
+void QueueTextureUpload(TextureUpload* upload, std::vector<std::string> const& paths)
+{
+    upload->imagesLeft = (int)paths.size();
+    upload->imagesLoaded = 0;
+    upload->imagesWithMips = 0;
+
+    if (upload->bindTarget != GL_TEXTURE_CUBE_MAP) {
+        GLenum target = upload->bindTarget;
+        QueueTextureImage(upload, &target, 1, paths[0]);
+        return;
+    }
+
+    // faces that share a file are decoded once
+    std::vector<bool> queued(paths.size(), false);
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (queued[i]) {
+            continue;
+        }
+
+        GLenum targets[6];
+        int numTargets = 0;
+
+        for (size_t j = i; j < paths.size() && numTargets < 6; j++) {
+            if (!queued[j] && paths[j] == paths[i]) {
+                targets[numTargets++] = GL_TEXTURE_CUBE_MAP_POSITIVE_X + (GLenum)j;
+                queued[j] = true;
+            }
+        }
+
+        QueueTextureImage(upload, targets, numTargets, paths[i]);
+    }
+}
+
+void QueueTextureImage(TextureUpload* upload, GLenum* targets, int numTargets, std::string const& path)
+{
+    TextureJob* job = (TextureJob*)calloc(1, sizeof(TextureJob));
+
+    job->upload = upload;
+    memcpy(job->targets, targets, numTargets * sizeof(GLenum));
+    job->numTargets = numTargets;
+    job->path = (char*)malloc(path.size() + 1);
+    strcpy(job->path, path.c_str());
+    job->stage = TEXTURE_DECODE;
+    job->tilesX = 1;
+    job->tilesY = 1;
+
+    textureLoader.numPending++;
+
+    PushWorkerJob(TextureWorkerJob, job);
+}
+
+// Worker thread, no OpenGL calls
+void TextureWorkerJob(void* arg)
+{
+    TextureJob* job = (TextureJob*)arg;
+
+    if (job->stage == TEXTURE_DECODE) {
+        DecodeTextureImage(job);
+    } else {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        memcpy(job->mapped, job->pixels, job->size);
+        stbi_image_free(job->pixels);
+        job->pixels = NULL;
+
+        job->copyMs = ElapsedMs(start);
+    }
+
+    std::lock_guard<std::mutex> lock(textureLoader.mutex);
+    textureLoader.finished.push_back(job);
+}
+
+void DecodeTextureImage(TextureJob* job)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    TextureSettings* settings = &job->upload->settings;
+
+    job->numLevels = 1;
+
+    if (DecodeCompressedTexture(job) || DecodeBakedTexture(job)) {
+        if (TextureAtlasTiled(job)) {
+            TileTextureImage(job);
+        }
+        job->decodeMs = ElapsedMs(start);
+        return;
+    }
+
+    // a single level only comes out of a baked chain
+    if (job->upload->streamLevel >= 0) {
+        job->decodeMs = ElapsedMs(start);
+        return;
+    }
+
+    MappedFile* file = MapFile(job->path);
+    if (file == NULL) {
+        job->decodeMs = ElapsedMs(start);
+        return;
+    }
+
+    job->contentHash = HashBytes(file->data, file->size, FNV1A_64_OFFSET);
+
+    // the global flag is shared with the main thread, this one is per thread
+    stbi_set_flip_vertically_on_load_thread(settings->flip);
+
+    int fileChannels;
+    if (settings->bits16) {
+        job->pixels = (unsigned char*)stbi_load_16_from_memory((const stbi_uc*)file->data, (int)file->size,
+            &job->width, &job->height, &fileChannels, settings->desiredChannels);
+    } else {
+        job->pixels = stbi_load_from_memory((const stbi_uc*)file->data, (int)file->size,
+            &job->width, &job->height, &fileChannels, settings->desiredChannels);
+    }
+    job->channels = (settings->desiredChannels != 0) ? settings->desiredChannels : fileChannels;
+
+    UnmapFile(file);
+
+    if (job->pixels != NULL) {
+        job->size = (size_t)job->width * job->height * job->channels * (settings->bits16 ? 2 : 1);
+
+        unsigned char* data = job->pixels;
+        int numChannels = job->channels;
+
+        if (numChannels >= 3 && !settings->bits16) {
+            if (settings->channelOp == 1) {
+                // metallness value in "blue" color channel
+                for (size_t i = 0; i < job->size; i += numChannels) {
+                    data[i] = data[i + 2];
+                    data[i + 1] = data[i + 2];
+                }
+            } else if (settings->channelOp == 2) {
+                // roughness value in "green" color channel
+                for (size_t i = 0; i < job->size; i += numChannels) {
+                    data[i] = data[i + 1];
+                    data[i + 2] = data[i + 1];
+                }
+            } else if (settings->channelOp == 3) {
+                for (size_t i = 0; i < job->size; i += numChannels) {
+                    data[i + 1] = data[i];
+                    data[i + 2] = data[i];
+                }
+            }
+        }
+
+        if (TextureAtlasTiled(job)) {
+            TileTextureImage(job);
+        }
+    }
+
+    job->decodeMs = ElapsedMs(start);
+}
+
+// Copies the compressed levels out of <path>.ktx2. False if there is none, it's stale,
+// the settings don't match the bake or the driver can't sample the format.
+bool DecodeCompressedTexture(TextureJob* job)
+{
+    TextureSettings* settings = &job->upload->settings;
+
+    if (settings->bits16 || settings->channelOp != 0 || settings->desiredChannels != 0) {
+        return false;
+    }
+
+    Ktx2Texture texture;
+    MappedFile* mapping = ReadKtx2Texture(job->path, &texture);
+    if (mapping == NULL) {
+        return false;
+    }
+
+    GLenum format = 0;
+    switch (texture.vkFormat) {
+    case KTX2_BC1_RGB_UNORM:
+    case KTX2_BC1_RGB_SRGB:
+        // sRGB data, sampled as UNORM like the uncompressed GL_RGB path
+        format = textureLoader.s3tc ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0;
+        break;
+    case KTX2_BC4_UNORM:
+        format = GL_COMPRESSED_RED_RGTC1;
+        break;
+    case KTX2_BC5_UNORM:
+        format = GL_COMPRESSED_RG_RGTC2;
+        break;
+    case KTX2_BC7_UNORM:
+    case KTX2_BC7_SRGB:
+        format = textureLoader.bptc ? GL_COMPRESSED_RGBA_BPTC_UNORM : 0;
+        break;
+    }
+
+    if (format == 0 || texture.flipped != settings->flip) {
+        UnmapFile(mapping);
+        return false;
+    }
+
+    int firstLevel, lastLevel;
+    if (!TextureLevelRange(job->upload, texture.width, texture.height, settings->mipmaps ? texture.numLevels : 1, &firstLevel, &lastLevel)) {
+        UnmapFile(mapping);
+        return false;
+    }
+
+    job->width = texture.width;
+    job->height = texture.height;
+    job->channels = (texture.vkFormat == KTX2_BC4_UNORM) ? 1 : (texture.vkFormat == KTX2_BC5_UNORM) ? 2 : 4;
+    job->firstLevel = firstLevel;
+    job->numLevels = lastLevel - firstLevel + 1;
+    job->contentHash = texture.contentHash;
+    job->compressedFormat = format;
+    job->blockBytes = texture.blockBytes;
+    job->grey = texture.vkFormat == KTX2_BC4_UNORM;
+
+    job->size = 0;
+    for (int level = firstLevel; level <= lastLevel; level++) {
+        job->size += texture.levelBytes[level];
+    }
+
+    // freed with stbi_image_free, which is free()
+    job->pixels = (unsigned char*)malloc(job->size);
+
+    unsigned char* dst = job->pixels;
+    for (int level = firstLevel; level <= lastLevel; level++) {
+        memcpy(dst, texture.levels[level], texture.levelBytes[level]);
+        dst += texture.levelBytes[level];
+    }
+
+    UnmapFile(mapping);
+
+    return true;
+}
+
+// Copies the levels out of <path>.texcache. False if there is none, it's stale or
+// the settings need something the baker didn't store, stb_image is used then.
+bool DecodeBakedTexture(TextureJob* job)
+{
+    TextureSettings* settings = &job->upload->settings;
+
+    if (settings->bits16 || settings->channelOp != 0) {
+        return false;
+    }
+
+    TextureCacheHeader header;
+    MappedFile* mapping = ReadTextureCache(job->path, &header);
+    if (mapping == NULL) {
+        return false;
+    }
+
+    if (settings->desiredChannels != 0 && settings->desiredChannels != header.channels) {
+        UnmapFile(mapping);
+        return false;
+    }
+
+    int firstLevel, lastLevel;
+    if (!TextureLevelRange(job->upload, header.width, header.height, settings->mipmaps ? header.numLevels : 1, &firstLevel, &lastLevel)) {
+        UnmapFile(mapping);
+        return false;
+    }
+
+    job->width = header.width;
+    job->height = header.height;
+    job->channels = header.channels;
+    job->firstLevel = firstLevel;
+    job->numLevels = lastLevel - firstLevel + 1;
+    job->contentHash = header.contentHash;
+
+    job->size = 0;
+    for (int level = firstLevel; level <= lastLevel; level++) {
+        job->size += TextureLevelBytes(header.width, header.height, header.channels, level);
+    }
+
+    // freed with stbi_image_free, which is free()
+    job->pixels = (unsigned char*)malloc(job->size);
+
+    const unsigned char* src = mapping->data + sizeof(TextureCacheHeader);
+    unsigned char* dst = job->pixels;
+    int width = header.width;
+    int height = header.height;
+
+    for (int level = 0; level <= lastLevel; level++) {
+        size_t rowBytes = (size_t)width * header.channels;
+
+        if (level >= firstLevel) {
+            if (settings->flip) {
+                for (int y = 0; y < height; y++) {
+                    memcpy(dst + y * rowBytes, src + (height - 1 - y) * rowBytes, rowBytes);
+                }
+            } else {
+                memcpy(dst, src, rowBytes * height);
+            }
+            dst += rowBytes * height;
+        }
+
+        src += rowBytes * height;
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+
+    UnmapFile(mapping);
+
+    return true;
+}
+
+// Levels of a baked chain to copy, see TextureUpload::maxResidentSize and streamLevel.
+// False if the chain doesn't have streamLevel. A packed image takes its 1x1 level
+// instead, an atlas layer has more levels than a smaller image tiled into it.
+bool TextureLevelRange(TextureUpload* upload, int width, int height, int numLevels, int* firstLevel, int* lastLevel)
+{
+    if (upload->streamLevel >= 0) {
+        int level = upload->settings.packed ? std::min(upload->streamLevel, numLevels - 1) : upload->streamLevel;
+        *firstLevel = level;
+        *lastLevel = level;
+        return level < numLevels;
+    }
+
+    *firstLevel = 0;
+    *lastLevel = numLevels - 1;
+
+    if (upload->maxResidentSize > 0 && upload->bindTarget == GL_TEXTURE_2D) {
+        while (*firstLevel < *lastLevel && std::max(width, height) > upload->maxResidentSize) {
+            width = (width > 1) ? width / 2 : 1;
+            height = (height > 1) ? height / 2 : 1;
+            (*firstLevel)++;
+        }
+    }
+
+    return true;
+}
+
+// A packed power of two image smaller than a TEXTURE_ATLAS_SIZE square, uncompressed
+bool TextureAtlasTiled(TextureJob* job)
+{
+    TextureSettings* settings = &job->upload->settings;
+
+    if (!settings->packed || settings->bits16 || job->compressedFormat != 0 || job->pixels == NULL) {
+        return false;
+    }
+    if (job->width > TEXTURE_ATLAS_SIZE || job->height > TEXTURE_ATLAS_SIZE) {
+        return false;
+    }
+    if (job->width == TEXTURE_ATLAS_SIZE && job->height == TEXTURE_ATLAS_SIZE) {
+        return false;
+    }
+    return (job->width & (job->width - 1)) == 0 && (job->height & (job->height - 1)) == 0;
+}
+
+// Worker thread. Repeats every level of the image until it fills a TEXTURE_ATLAS_SIZE
+// square. Whole copies keep GL_REPEAT and the mip filtering right, the shader only
+// scales the texture coordinates. Levels past the end of the image chain repeat its
+// 1x1 level, an image without a chain only has level 0 (mipmaps are generated).
+void TileTextureImage(TextureJob* job)
+{
+    TextureUpload* upload = job->upload;
+
+    int width = job->width;
+    int height = job->height;
+    int channels = job->channels;
+    int imageLevels = TextureLevelCount(width, height);
+    int lastJobLevel = job->firstLevel + job->numLevels - 1;
+
+    int firstLevel = job->firstLevel;
+    int lastLevel = (job->numLevels > 1) ? TextureLevelCount(TEXTURE_ATLAS_SIZE, TEXTURE_ATLAS_SIZE) - 1 : job->firstLevel;
+
+    if (upload->streamLevel >= 0) {
+        firstLevel = upload->streamLevel;
+        lastLevel = upload->streamLevel;
+    }
+
+    size_t size = 0;
+    for (int level = firstLevel; level <= lastLevel; level++) {
+        size += TextureLevelBytes(TEXTURE_ATLAS_SIZE, TEXTURE_ATLAS_SIZE, channels, level);
+    }
+
+    unsigned char* tiled = (unsigned char*)malloc(size);
+    unsigned char* dst = tiled;
+
+    for (int level = firstLevel; level <= lastLevel; level++) {
+        int source = std::max(job->firstLevel, std::min(std::min(level, imageLevels - 1), lastJobLevel));
+
+        const unsigned char* src = job->pixels;
+        for (int i = job->firstLevel; i < source; i++) {
+            src += TextureLevelBytes(width, height, channels, i);
+        }
+
+        int sourceWidth = std::max(width >> source, 1);
+        int sourceHeight = std::max(height >> source, 1);
+        int levelWidth = std::max(TEXTURE_ATLAS_SIZE >> level, 1);
+        int levelHeight = std::max(TEXTURE_ATLAS_SIZE >> level, 1);
+        size_t rowBytes = (size_t)sourceWidth * channels;
+
+        for (int y = 0; y < levelHeight; y++) {
+            const unsigned char* row = src + (y % sourceHeight) * rowBytes;
+            for (int x = 0; x < levelWidth; x += sourceWidth) {
+                memcpy(dst + ((size_t)y * levelWidth + x) * channels, row, rowBytes);
+            }
+        }
+
+        dst += (size_t)levelWidth * levelHeight * channels;
+    }
+
+    // freed with stbi_image_free, which is free()
+    stbi_image_free(job->pixels);
+
+    job->pixels = tiled;
+    job->size = size;
+    job->tilesX = TEXTURE_ATLAS_SIZE / width;
+    job->tilesY = TEXTURE_ATLAS_SIZE / height;
+    job->width = TEXTURE_ATLAS_SIZE;
+    job->height = TEXTURE_ATLAS_SIZE;
+    job->firstLevel = firstLevel;
+    job->numLevels = lastLevel - firstLevel + 1;
+}
+
+// Main thread, once per frame
+void PollTextureLoader()
+{
+    std::vector<TextureJob*> finished;
+
+    {
+        std::lock_guard<std::mutex> lock(textureLoader.mutex);
+        finished.swap(textureLoader.finished);
+    }
+
+    for (size_t i = 0; i < finished.size(); ++i) {
+        TextureJob* job = finished[i];
+
+        if (job->stage == TEXTURE_DECODE) {
+            if (job->pixels == NULL) {
+                std::cout << "Texture failed to load at path: " << job->path << std::endl;
+                FinishTextureJob(job, false);
+                continue;
+            }
+            MapTexturePBO(job);
+        } else {
+            UploadTextureImage(job);
+        }
+    }
+}
+
+void MapTexturePBO(TextureJob* job)
+{
+    glGenBuffers(1, &job->pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, job->size, NULL, GL_STREAM_DRAW);
+
+    job->mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, job->size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (job->mapped == NULL) {
+        // upload straight from client memory instead
+        glDeleteBuffers(1, &job->pbo);
+        job->pbo = 0;
+        UploadTextureImage(job);
+        return;
+    }
+
+    job->stage = TEXTURE_COPY;
+    PushWorkerJob(TextureWorkerJob, job);
+}
+
+void UploadTextureImage(TextureJob* job)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    TextureUpload* upload = job->upload;
+
+    GLenum format;
+    if (job->channels == 1)
+        format = GL_RED;
+    else if (job->channels == 2)
+        format = GL_RG;
+    else if (job->channels == 3)
+        format = GL_RGB;
+    else
+        format = GL_RGBA;
+
+    GLint internalFormat = format;
+    GLenum type = GL_UNSIGNED_BYTE;
+
+    if (upload->settings.bits16) {
+        type = GL_UNSIGNED_SHORT;
+        if (job->channels == 1)
+            internalFormat = GL_R16;
+        else if (job->channels == 2)
+            internalFormat = GL_RG16;
+        else if (job->channels == 3)
+            internalFormat = GL_RGB16;
+        else
+            internalFormat = GL_RGBA16;
+    }
+
+    const void* pixels = job->pixels;
+    bool uploaded = true;
+
+    if (job->pbo != 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, job->pbo);
+        if (glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_FALSE) {
+            std::cout << "Texture buffer was lost while mapped: " << job->path << std::endl;
+            uploaded = false;
+        }
+        // offset into the bound pixel buffer
+        pixels = (const void*)0;
+    }
+
+    if (uploaded && upload->onUploadImage != NULL) {
+        GLint unpackAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        uploaded = upload->onUploadImage(upload, job, pixels);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    } else if (uploaded) {
+        // rows are tightly packed
+        GLint unpackAlignment;
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &unpackAlignment);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        glBindTexture(upload->bindTarget, upload->id);
+
+        int width = job->width;
+        int height = job->height;
+        size_t offset = 0;
+
+        for (int level = 0; level < job->firstLevel; level++) {
+            width = (width > 1) ? width / 2 : 1;
+            height = (height > 1) ? height / 2 : 1;
+        }
+
+        for (int level = job->firstLevel; level < job->firstLevel + job->numLevels; level++) {
+            size_t levelBytes = (size_t)width * height * job->channels;
+
+            if (job->compressedFormat != 0) {
+                levelBytes = CompressedLevelBytes(width, height, job->blockBytes, 0);
+
+                for (int i = 0; i < job->numTargets; i++) {
+                    glCompressedTexImage2D(job->targets[i], level, job->compressedFormat, width, height, 0, (GLsizei)levelBytes, (const char*)pixels + offset);
+                }
+            } else {
+                for (int i = 0; i < job->numTargets; i++) {
+                    glTexImage2D(job->targets[i], level, internalFormat, width, height, 0, format, type, (const char*)pixels + offset);
+                }
+            }
+
+            offset += levelBytes;
+            width = (width > 1) ? width / 2 : 1;
+            height = (height > 1) ? height / 2 : 1;
+        }
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+    }
+
+    if (job->pbo != 0) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glDeleteBuffers(1, &job->pbo);
+        job->pbo = 0;
+    }
+
+    job->uploadMs = ElapsedMs(start);
+
+    FinishTextureJob(job, uploaded);
+}
+
+void FinishTextureJob(TextureJob* job, bool uploaded)
+{
+    TextureUpload* upload = job->upload;
+
+    if (uploaded) {
+        upload->imagesLoaded += job->numTargets;
+        if (job->numLevels > 1) {
+            upload->imagesWithMips += job->numTargets;
+        }
+        upload->width = job->width;
+        upload->height = job->height;
+        upload->channels = job->channels;
+        upload->blockBytes = job->blockBytes;
+        upload->grey = job->grey;
+        upload->baseLevel = job->firstLevel;
+        upload->numLevels = job->firstLevel + job->numLevels;
+        upload->tilesX = job->tilesX;
+        upload->tilesY = job->tilesY;
+        upload->contentHash = HashBytes(&job->contentHash, sizeof(job->contentHash), upload->contentHash);
+
+        const char* baked = (job->compressedFormat != 0) ? " compressed" : (job->numLevels > 1) ? " baked" : "";
+
+        if (upload->streamLevel < 0) {
+            printf("Texture: %s %dx%d%s decode %.2f ms copy %.2f ms upload %.2f ms\n",
+                job->path, job->width, job->height, baked, job->decodeMs, job->copyMs, job->uploadMs);
+        }
+    }
+
+    upload->imagesLeft -= job->numTargets;
+
+    if (upload->imagesLeft == 0 && upload->imagesLoaded > 0 && upload->streamLevel < 0 && upload->onUploadImage == NULL) {
+        TextureSettings* settings = &upload->settings;
+
+        glBindTexture(upload->bindTarget, upload->id);
+
+        if (settings->mipmaps && upload->imagesWithMips < upload->imagesLoaded) {
+            glGenerateMipmap(upload->bindTarget);
+        }
+
+        // finer levels may be left from before a reload, free them
+        for (int level = 0; level < upload->baseLevel; level++) {
+            glTexImage2D(upload->bindTarget, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        }
+        glTexParameteri(upload->bindTarget, GL_TEXTURE_BASE_LEVEL, upload->baseLevel);
+
+        glTexParameteri(upload->bindTarget, GL_TEXTURE_WRAP_S, settings->wrap);
+        glTexParameteri(upload->bindTarget, GL_TEXTURE_WRAP_T, settings->wrap);
+        if (upload->bindTarget == GL_TEXTURE_CUBE_MAP) {
+            glTexParameteri(upload->bindTarget, GL_TEXTURE_WRAP_R, settings->wrap);
+        }
+
+        if (TextureUploadStreamed(upload)) {
+            // the base level can move past settings->maxLevel
+            glTexParameteri(upload->bindTarget, GL_TEXTURE_MAX_LEVEL, upload->numLevels - 1);
+            glTexParameterf(upload->bindTarget, GL_TEXTURE_MAX_LOD, (float)(upload->numLevels - 1));
+        } else if (settings->maxLevel >= 0.0f) {
+            glTexParameterf(upload->bindTarget, GL_TEXTURE_MAX_LEVEL, settings->maxLevel);
+            glTexParameterf(upload->bindTarget, GL_TEXTURE_MAX_LOD, settings->maxLevel);
+        }
+
+        glTexParameteri(upload->bindTarget, GL_TEXTURE_MIN_FILTER, settings->minFilter);
+        glTexParameteri(upload->bindTarget, GL_TEXTURE_MAG_FILTER, settings->magFilter);
+
+        // set every time, a reload can replace a BC4 image with an RGB one
+        GLint greySwizzle[4] = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        GLint swizzle[4] = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+        glTexParameteriv(upload->bindTarget, GL_TEXTURE_SWIZZLE_RGBA, upload->grey ? greySwizzle : swizzle);
+
+        glBindTexture(upload->bindTarget, 0);
+
+        upload->vramBytes = TextureVRAMBytes(upload);
+    }
+
+    if (upload->imagesLeft == 0) {
+        if (upload->onFinished != NULL) {
+            upload->onFinished(upload);
+        }
+        free(upload);
+    }
+
+    stbi_image_free(job->pixels);
+    free(job->path);
+    free(job);
+
+    textureLoader.numPending--;
+}
+
+// The residency manager owns the levels of a 2D texture that came with its baked chain
+bool TextureUploadStreamed(TextureUpload* upload)
+{
+    return upload->maxResidentSize > 0 && upload->bindTarget == GL_TEXTURE_2D
+        && upload->numLevels > 1 && upload->imagesWithMips == upload->imagesLoaded;
+}
+
+// Estimate from the last image size, counting the mip levels from the base up to maxLevel.
+// Drivers may pad RGB to RGBA, so this is a lower bound. Compressed images are exact.
+size_t TextureVRAMBytes(TextureUpload* upload)
+{
+    TextureSettings* settings = &upload->settings;
+
+    int pixelBytes = upload->channels * (settings->bits16 ? 2 : 1);
+    size_t faces = (upload->bindTarget == GL_TEXTURE_CUBE_MAP) ? 6 : 1;
+
+    int maxLevel = settings->mipmaps ? (settings->maxLevel >= 0.0f ? (int)settings->maxLevel : 1000) : 0;
+    if (TextureUploadStreamed(upload)) {
+        maxLevel = upload->numLevels - 1;
+    }
+    maxLevel = std::min(maxLevel, TextureLevelCount(upload->width, upload->height) - 1);
+
+    size_t bytes = 0;
+    for (int level = upload->baseLevel; level <= maxLevel; level++) {
+        bytes += TextureLevelVRAMBytes(upload->width, upload->height, level, pixelBytes, upload->blockBytes);
+    }
+
+    return bytes * faces;
+}
+
+// One level of an image with the given level 0 size
+size_t TextureLevelVRAMBytes(int width, int height, int level, int pixelBytes, int blockBytes)
+{
+    for (int i = 0; i < level; i++) {
+        width = (width > 1) ? width / 2 : 1;
+        height = (height > 1) ? height / 2 : 1;
+    }
+
+    if (blockBytes > 0) {
+        return CompressedLevelBytes(width, height, blockBytes, 0);
+    }
+    return (size_t)width * height * pixelBytes;
+}
+
+// Blocks until every queued texture is uploaded
+void WaitForTextures()
+{
+    while (true) {
+        unsigned long long jobsFinished = WorkerJobsFinished();
+
+        PollTextureLoader();
+
+        if (textureLoader.numPending == 0) {
+            return;
+        }
+
+        WaitForWorkerJobs(jobsFinished);
+    }
+}
+
+#endif
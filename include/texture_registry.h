@@ -0,0 +1,454 @@
+/*-------------------------------------------------------------------------------\
+texture_registry.h
+
+Functions:
+    Process wide texture cache on top of texture_loader.h. Every loader goes
+    through AcquireTexture / AcquireCubemap, so a file is decoded and uploaded
+    once no matter how many models use it.
+
+    Entries are keyed by the normalized path (mapped_file.h) plus the load settings
+    (the same file loaded flipped and unflipped is two textures), with a second
+    map from OpenGL id back to the entry. Both are hash maps.
+
+    Acquire increments the reference count, ReleaseTexture decrements it and
+    deletes the OpenGL texture when it reaches 0.
+
+    The content hash of the file is filled in when the upload finishes. Ids are
+    handed out before the file is read, so two paths with identical content
+    still get two textures; they are reported once both finish.
+
+    TextureRegistryWindow lists every texture with its VRAM estimate.
+
+    ReloadTexture decodes the files again into the same OpenGL id (hot_reload.h).
+
+    With streamStartSize set (texture_residency.h) a texture loaded with
+    settings.streamed that has a baked mip chain starts at the level no larger
+    than that. The residency manager adds and drops levels afterwards through
+    the fields below.
+
+    A texture loaded with settings.packed keeps its id as a handle but its image
+    goes to a layer of a texture array (texture_array.h), placed by
+    TextureRegistryUploadLayer when the loader has it decoded. A reload that
+    changes the size or format moves it to another array. The arrays count
+    towards TextureVRAMTotal, the entries themselves don't.
+
+\-------------------------------------------------------------------------------*/
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <imgui/imgui.h>
+
+#include <mapped_file.h>
+#include <texture_array.h>
+#include <texture_loader.h>
+
+enum TextureState {
+    TEXTURE_PENDING,
+    TEXTURE_READY,
+    TEXTURE_FAILED
+};
+
+struct TextureEntry {
+    unsigned int id;
+    std::string key;
+    // first path, for printing
+    std::string name;
+
+    // what to load again on ReloadTexture
+    GLenum bindTarget;
+    std::vector<std::string> paths;
+    TextureSettings settings;
+
+    TextureState state;
+    int refCount;
+    // released while the upload was still in flight
+    bool released;
+
+    int width;
+    int height;
+    int channels;
+    int blockBytes;
+    size_t vramBytes;
+    unsigned long long contentHash;
+
+    // texture_residency.h. Only standalone textures with a baked chain are
+    // streamed, a packed one goes with its array.
+    MipResidency mips;
+
+    // settings.packed, NULL until the first image is placed. width and height
+    // are the image size, the layer can be larger (TEXTURE_ATLAS_SIZE).
+    TextureArray* array;
+    int layer;
+};
+
+struct TextureRegistry {
+    std::unordered_map<std::string, TextureEntry*> byKey;
+    std::unordered_map<unsigned int, TextureEntry*> byId;
+
+    size_t totalVRAM;
+    int numHits;
+    int numMisses;
+
+    // largest level a new texture starts with, 0 loads every level
+    int streamStartSize;
+};
+
+TextureRegistry textureRegistry;
+
+unsigned int AcquireTexture(std::string const& path, TextureSettings settings);
+unsigned int AcquireCubemap(std::vector<std::string> const& faces, TextureSettings settings);
+void RetainTexture(unsigned int id);
+void ReleaseTexture(unsigned int id);
+bool ReloadTexture(TextureEntry* entry);
+
+TextureEntry* FindTexture(unsigned int id);
+bool WaitForTexture(unsigned int id);
+
+size_t TextureVRAMTotal();
+void PrintTextureRegistry();
+void TextureRegistryWindow();
+
+std::string TextureSettingsKey(TextureSettings const& settings);
+unsigned int AcquireTextureUpload(GLenum bindTarget, std::vector<std::string> const& paths, TextureSettings settings);
+void TextureRegistryUploaded(TextureUpload* upload);
+bool TextureRegistryUploadLayer(TextureUpload* upload, TextureJob* job, const void* pixels);
+void FreeTextureEntry(TextureEntry* entry);
+
+std::string TextureSettingsKey(TextureSettings const& settings)
+{
+    char key[128];
+    snprintf(key, sizeof(key), "|%d,%d,%d,%d,%g,%d,%d,%d,%d,%d,%d",
+        settings.wrap, settings.minFilter, settings.magFilter, settings.mipmaps, settings.maxLevel,
+        settings.flip, settings.desiredChannels, settings.channelOp, settings.bits16, settings.streamed, settings.packed);
+    return std::string(key);
+}
+
+unsigned int AcquireTexture(std::string const& path, TextureSettings settings)
+{
+    return AcquireTextureUpload(GL_TEXTURE_2D, std::vector<std::string>(1, path), settings);
+}
+
+unsigned int AcquireCubemap(std::vector<std::string> const& faces, TextureSettings settings)
+{
+    return AcquireTextureUpload(GL_TEXTURE_CUBE_MAP, faces, settings);
+}
+
+unsigned int AcquireTextureUpload(GLenum bindTarget, std::vector<std::string> const& paths, TextureSettings settings)
+{
+    std::vector<std::string> resolved;
+    std::string key;
+
+    for (size_t i = 0; i < paths.size(); i++) {
+        resolved.push_back(NormalizePath(paths[i]));
+        key += resolved[i];
+        key += ';';
+    }
+    key += TextureSettingsKey(settings);
+
+    std::unordered_map<std::string, TextureEntry*>::iterator found = textureRegistry.byKey.find(key);
+    if (found != textureRegistry.byKey.end()) {
+        found->second->refCount++;
+        textureRegistry.numHits++;
+        return found->second->id;
+    }
+
+    textureRegistry.numMisses++;
+
+    TextureUpload* upload = CreateTextureUpload(bindTarget, settings);
+
+    TextureEntry* entry = new TextureEntry();
+    entry->id = upload->id;
+    entry->key = key;
+    entry->name = paths[0];
+    entry->bindTarget = bindTarget;
+    entry->paths = resolved;
+    entry->settings = settings;
+    entry->state = TEXTURE_PENDING;
+    entry->refCount = 1;
+    entry->released = false;
+    entry->width = 0;
+    entry->height = 0;
+    entry->channels = 0;
+    entry->blockBytes = 0;
+    entry->vramBytes = 0;
+    entry->contentHash = 0;
+    entry->mips.streamed = false;
+    entry->mips.numLevels = 1;
+    entry->mips.residentLevel = 0;
+    entry->mips.wantedLevel = 0;
+    entry->mips.lastUsedFrame = 0;
+    entry->mips.streaming = 0;
+    entry->array = NULL;
+    entry->layer = -1;
+
+    textureRegistry.byKey[key] = entry;
+    textureRegistry.byId[entry->id] = entry;
+
+    upload->onFinished = TextureRegistryUploaded;
+    upload->user = entry;
+    if (settings.packed) {
+        // every level is decoded, the array decides which ones go up
+        upload->onUploadImage = TextureRegistryUploadLayer;
+    } else if (settings.streamed) {
+        upload->maxResidentSize = textureRegistry.streamStartSize;
+    }
+
+    QueueTextureUpload(upload, resolved);
+
+    return entry->id;
+}
+
+// Called by UploadTextureImage on the main thread for a packed texture. Puts the image
+// in its layer, or in a new one if it has none yet or doesn't fit the array any more.
+bool TextureRegistryUploadLayer(TextureUpload* upload, TextureJob* job, const void* pixels)
+{
+    TextureEntry* entry = (TextureEntry*)upload->user;
+
+    if (job->numTargets != 1 || upload->settings.bits16) {
+        printf("TextureRegistry: %s can't be packed\n", entry->name.c_str());
+        return false;
+    }
+
+    // a level for an array texture_residency.h is streaming, it only fits where it was asked for
+    if (upload->streamLevel >= 0) {
+        TextureArray* array = entry->array;
+        return array != NULL && job->width == array->format.width && job->height == array->format.height
+            && job->channels == array->format.channels && job->compressedFormat == array->format.compressedFormat
+            && UploadTextureArrayLayer(array, entry->layer, job, pixels, array->streamLevel, array->streamLevel);
+    }
+
+    TextureArrayFormat format = TextureArrayFormatFor(job, upload->settings, textureRegistry.streamStartSize > 0);
+
+    if (entry->array != NULL && !TextureArrayFormatsEqual(entry->array->format, format)) {
+        FreeTextureArrayLayer(entry->array, entry->layer);
+        entry->array = NULL;
+        entry->layer = -1;
+    }
+
+    if (entry->array == NULL) {
+        TextureArray* array = FindTextureArray(format);
+        if (array == NULL) {
+            array = CreateTextureArray(format, TextureArrayStartLevel(format, textureRegistry.streamStartSize));
+        }
+        entry->array = array;
+        entry->layer = AllocTextureArrayLayer(array, entry);
+    }
+
+    TextureArray* array = entry->array;
+
+    // a level being streamed in goes up too, the stream only covers the layers it started with
+    int firstLevel = array->mips.residentLevel;
+    if (array->streamLevel >= 0) {
+        firstLevel = std::min(firstLevel, array->streamLevel);
+    }
+    int lastLevel = array->format.generateMips ? 0 : array->format.numLevels - 1;
+
+    return UploadTextureArrayLayer(array, entry->layer, job, pixels, firstLevel, lastLevel);
+}
+
+// Called by FinishTextureJob on the main thread
+void TextureRegistryUploaded(TextureUpload* upload)
+{
+    TextureEntry* entry = (TextureEntry*)upload->user;
+
+    if (entry->released) {
+        // nobody is left to draw with it
+        FreeTextureEntry(entry);
+        return;
+    }
+
+    if (upload->imagesLoaded == 0) {
+        entry->state = TEXTURE_FAILED;
+        entry->mips.streamed = false;
+        return;
+    }
+
+    entry->state = TEXTURE_READY;
+    entry->width = upload->width / upload->tilesX;
+    entry->height = upload->height / upload->tilesY;
+    entry->channels = upload->channels;
+    entry->blockBytes = upload->blockBytes;
+    entry->vramBytes = upload->vramBytes;
+    entry->contentHash = upload->contentHash;
+
+    entry->mips.streamed = TextureUploadStreamed(upload);
+    entry->mips.numLevels = upload->numLevels;
+    entry->mips.residentLevel = upload->baseLevel;
+    entry->mips.wantedLevel = upload->baseLevel;
+
+    textureRegistry.totalVRAM += entry->vramBytes;
+
+    std::unordered_map<unsigned int, TextureEntry*>::iterator it;
+    for (it = textureRegistry.byId.begin(); it != textureRegistry.byId.end(); ++it) {
+        TextureEntry* other = it->second;
+        if (other != entry && other->state == TEXTURE_READY && other->contentHash == entry->contentHash) {
+            printf("TextureRegistry: %s has the same content as %s\n", entry->name.c_str(), other->name.c_str());
+            break;
+        }
+    }
+}
+
+void RetainTexture(unsigned int id)
+{
+    TextureEntry* entry = FindTexture(id);
+    if (entry != NULL) {
+        entry->refCount++;
+    }
+}
+
+void ReleaseTexture(unsigned int id)
+{
+    TextureEntry* entry = FindTexture(id);
+    if (entry == NULL) {
+        return;
+    }
+
+    entry->refCount--;
+    if (entry->refCount > 0) {
+        return;
+    }
+
+    textureRegistry.byKey.erase(entry->key);
+    textureRegistry.byId.erase(entry->id);
+
+    if (entry->state == TEXTURE_PENDING || entry->mips.streaming > 0) {
+        // the loader still holds the id, TextureRegistryUploaded or TextureLevelStreamed deletes it
+        entry->released = true;
+        return;
+    }
+
+    FreeTextureEntry(entry);
+}
+
+// Returns false while the texture is still loading
+bool ReloadTexture(TextureEntry* entry)
+{
+    if (entry->state == TEXTURE_PENDING || entry->mips.streaming > 0) {
+        return false;
+    }
+
+    textureRegistry.totalVRAM -= entry->vramBytes;
+    entry->vramBytes = 0;
+    entry->state = TEXTURE_PENDING;
+
+    TextureUpload* upload = ReuseTextureUpload(entry->id, entry->bindTarget, entry->settings);
+    upload->onFinished = TextureRegistryUploaded;
+    upload->user = entry;
+    if (entry->settings.packed) {
+        upload->onUploadImage = TextureRegistryUploadLayer;
+    } else if (entry->settings.streamed) {
+        upload->maxResidentSize = textureRegistry.streamStartSize;
+    }
+
+    QueueTextureUpload(upload, entry->paths);
+
+    return true;
+}
+
+void FreeTextureEntry(TextureEntry* entry)
+{
+    if (entry->array != NULL) {
+        FreeTextureArrayLayer(entry->array, entry->layer);
+    }
+
+    textureRegistry.totalVRAM -= entry->vramBytes;
+    glDeleteTextures(1, &entry->id);
+    delete entry;
+}
+
+TextureEntry* FindTexture(unsigned int id)
+{
+    std::unordered_map<unsigned int, TextureEntry*>::iterator found = textureRegistry.byId.find(id);
+    if (found == textureRegistry.byId.end()) {
+        return NULL;
+    }
+    return found->second;
+}
+
+// Blocks until the texture is uploaded. Returns false if it failed to load.
+bool WaitForTexture(unsigned int id)
+{
+    while (true) {
+        unsigned long long jobsFinished = WorkerJobsFinished();
+
+        PollTextureLoader();
+
+        TextureEntry* entry = FindTexture(id);
+        if (entry == NULL) {
+            return false;
+        }
+        if (entry->state != TEXTURE_PENDING) {
+            return entry->state == TEXTURE_READY;
+        }
+
+        WaitForWorkerJobs(jobsFinished);
+    }
+}
+
+size_t TextureVRAMTotal()
+{
+    return textureRegistry.totalVRAM + textureArrays.totalVRAM;
+}
+
+void PrintTextureRegistry()
+{
+    printf("TextureRegistry: %d textures, %.2f MB, %d arrays, %d hits, %d misses\n",
+        (int)textureRegistry.byId.size(), TextureVRAMTotal() / (1024.0 * 1024.0), (int)textureArrays.arrays.size(),
+        textureRegistry.numHits, textureRegistry.numMisses);
+
+    std::unordered_map<unsigned int, TextureEntry*>::iterator it;
+    for (it = textureRegistry.byId.begin(); it != textureRegistry.byId.end(); ++it) {
+        TextureEntry* entry = it->second;
+        printf("    %3u refs %2d %5dx%-5d %8.2f KB %016llx %s\n", entry->id, entry->refCount,
+            entry->width, entry->height, entry->vramBytes / 1024.0, entry->contentHash, entry->name.c_str());
+    }
+}
+
+void TextureRegistryWindow()
+{
+    ImGui::Begin("Textures");
+
+    ImGui::Text("%d textures, %.2f MB VRAM", (int)textureRegistry.byId.size(), TextureVRAMTotal() / (1024.0 * 1024.0));
+    ImGui::Text("%d cache hits, %d misses", textureRegistry.numHits, textureRegistry.numMisses);
+
+    if (ImGui::CollapsingHeader("Texture arrays")) {
+        ImGui::Text("%d arrays, %.2f MB, grown %d times", (int)textureArrays.arrays.size(),
+            textureArrays.totalVRAM / (1024.0 * 1024.0), textureArrays.numGrown);
+
+        for (size_t i = 0; i < textureArrays.arrays.size(); ++i) {
+            TextureArray* array = textureArrays.arrays[i];
+            ImGui::Text("%3u  %d/%d layers  %dx%d%s  %.1f KB  mip %d/%d", array->id, array->numUsed, (int)array->layers.size(),
+                array->format.width, array->format.height, array->format.compressedFormat != 0 ? " BC" : "",
+                array->vramBytes / 1024.0, array->mips.residentLevel, array->format.numLevels - 1);
+        }
+    }
+    ImGui::Separator();
+
+    std::unordered_map<unsigned int, TextureEntry*>::iterator it;
+    for (it = textureRegistry.byId.begin(); it != textureRegistry.byId.end(); ++it) {
+        TextureEntry* entry = it->second;
+
+        const char* state = (entry->state == TEXTURE_READY) ? "" : (entry->state == TEXTURE_PENDING) ? " (loading)" : " (failed)";
+        std::string file = std::filesystem::path(entry->name).filename().string();
+
+        ImGui::Text("%3u  x%d  %dx%d  %.1f KB  %s%s", entry->id, entry->refCount, entry->width, entry->height,
+            entry->vramBytes / 1024.0, file.c_str(), state);
+
+        if (entry->array != NULL) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("array %u layer %d", entry->array->id, entry->layer);
+        } else if (entry->mips.streamed) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("mip %d/%d%s", entry->mips.residentLevel, entry->mips.numLevels - 1, entry->mips.streaming > 0 ? " +" : "");
+        }
+    }
+
+    ImGui::End();
+}
+
+#endif
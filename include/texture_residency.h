@@ -0,0 +1,539 @@
+/*-------------------------------------------------------------------------------\
+texture_residency.h
+
+Functions:
+    Keeps textures under a VRAM budget by choosing which mip levels of each one
+    are resident. Only mesh textures (settings.streamed) with a baked mip chain
+    (.ktx2 or .texcache) are managed, the rest stay as they were loaded and
+    only count against the budget.
+
+    Packed textures (texture_array.h) share their levels with the rest of their
+    array, so the array is what's managed: it wants the finest level any of its
+    textures wants, and a level is streamed into every layer before it's used.
+
+    New textures start with the levels no larger than RESIDENCY_START_SIZE
+    (TextureRegistry::streamStartSize). While drawing, DrawModelLod reports
+    the screen size of every mesh with NoteTextureFootprint, from the mesh
+    bounding sphere, the model matrix and renderView. That gives the finest
+    level each texture needs, about one texel per pixel if the UVs cover the
+    texture once across the mesh.
+
+    UpdateTextureResidency runs once per frame, before drawing:
+      - over budget, levels are dropped from the least recently drawn textures
+        first. Levels finer than wanted go first, then any level of a texture
+        that wasn't drawn last frame. A texture never goes coarser than its
+        start level.
+      - textures drawn last frame that want a finer level get one more level,
+        RESIDENCY_UPLOADS_PER_FRAME at most and only while it fits in the
+        budget. The level is read and uploaded by texture_loader.h.
+
+    OpenGL 4.1 has no sparse textures, so a texture keeps its id and only the
+    levels residentLevel..numLevels-1 are allocated. GL_TEXTURE_BASE_LEVEL
+    points at the finest one, a dropped level is reallocated with size 0.
+    An array allocates a level for every layer when it starts streaming it.
+
+    TextureResidencyWindow shows the budget, resident bytes and pending uploads.
+
+\-------------------------------------------------------------------------------*/
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <float.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <imgui/imgui.h>
+
+#include <render_view.h>
+#include <texture_array.h>
+#include <texture_loader.h>
+#include <texture_registry.h>
+
+#define RESIDENCY_START_SIZE 128
+#define RESIDENCY_DEFAULT_BUDGET_MB 256
+#define RESIDENCY_UPLOADS_PER_FRAME 4
+#define RESIDENCY_MAX_PENDING 16
+
+struct TextureResidency {
+    bool enabled;
+    size_t budgetBytes;
+    // added to the wanted level, negative keeps textures sharper
+    float mipBias;
+
+    // NoteTextureFootprint marks textures with this, starts at 1
+    unsigned long long frame;
+
+    // level streams in flight, an array counts once
+    int numPending;
+    // what they add once they finish, arrays allocate the level up front
+    size_t pendingBytes;
+
+    // since InitTextureResidency
+    int numStreamed;
+    int numEvicted;
+    int numFailed;
+
+    // last UpdateTextureResidency
+    int numManaged;
+    int numWanting;
+    size_t managedBytes;
+};
+
+// A standalone streamed texture or a texture array, whichever owns the levels
+struct ResidentTexture {
+    TextureEntry* entry;
+    TextureArray* array;
+    MipResidency* mips;
+};
+
+TextureResidency textureResidency;
+
+void InitTextureResidency(size_t budgetBytes);
+void UpdateTextureResidency();
+void NoteTextureFootprint(TextureEntry* entry, float pixels);
+float MeshFootprintPixels(glm::vec3 center, float radius, glm::mat4 const& modelMatrix);
+void TextureResidencyWindow();
+
+int TextureFootprintLevel(int width, int height, int numLevels, float pixels);
+int ResidentStartLevel(ResidentTexture* texture);
+size_t ResidentLevelBytes(ResidentTexture* texture, int level);
+size_t ResidentVRAMBytes(ResidentTexture* texture);
+void StreamResidentLevel(ResidentTexture* texture, int level);
+void EvictResidentLevel(ResidentTexture* texture);
+
+void StreamTextureLevel(TextureEntry* entry, int level);
+void TextureLevelStreamed(TextureUpload* upload);
+void EvictTextureLevel(TextureEntry* entry);
+void StreamArrayLevel(TextureArray* array, int level);
+void ArrayLevelStreamed(TextureUpload* upload);
+void FinishArrayLevel(TextureArray* array);
+void EvictArrayLevel(TextureArray* array);
+
+// Before the first texture is acquired, textures loaded earlier keep every level
+void InitTextureResidency(size_t budgetBytes)
+{
+    textureResidency.enabled = true;
+    textureResidency.budgetBytes = budgetBytes;
+    textureResidency.mipBias = 0.0f;
+    textureResidency.frame = 1;
+
+    textureRegistry.streamStartSize = RESIDENCY_START_SIZE;
+}
+
+// Screen diameter in pixels of an object space bounding sphere, FLT_MAX with the camera inside it
+float MeshFootprintPixels(glm::vec3 center, float radius, glm::mat4 const& modelMatrix)
+{
+    glm::vec3 worldCenter = glm::vec3(modelMatrix * glm::vec4(center, 1.0f));
+
+    float scale = glm::max(glm::length(glm::vec3(modelMatrix[0])), glm::max(glm::length(glm::vec3(modelMatrix[1])), glm::length(glm::vec3(modelMatrix[2]))));
+    float worldRadius = radius * scale;
+
+    // nearest point of the sphere, so a large mesh isn't blurred where it's close
+    float distance = glm::length(worldCenter - renderView.position) - worldRadius;
+    if (distance <= 0.001f) {
+        return FLT_MAX;
+    }
+
+    return 2.0f * worldRadius * renderView.projectionScale / distance;
+}
+
+// Main thread, while drawing. pixels is the screen size of what the texture covers.
+void NoteTextureFootprint(TextureEntry* entry, float pixels)
+{
+    if (!textureResidency.enabled || entry == NULL) {
+        return;
+    }
+
+    MipResidency* mips = (entry->array != NULL) ? &entry->array->mips : &entry->mips;
+    if (!mips->streamed) {
+        return;
+    }
+
+    // a tiled image has the level numbers of its layer, so its own size gives the level
+    int level = TextureFootprintLevel(entry->width, entry->height, mips->numLevels, pixels);
+
+    if (mips->lastUsedFrame != textureResidency.frame) {
+        mips->lastUsedFrame = textureResidency.frame;
+        mips->wantedLevel = level;
+    } else {
+        mips->wantedLevel = std::min(mips->wantedLevel, level);
+    }
+}
+
+int TextureFootprintLevel(int width, int height, int numLevels, float pixels)
+{
+    float texels = (float)std::max(width, height);
+
+    if (pixels >= texels) {
+        return 0;
+    }
+    if (pixels < 1.0f) {
+        return numLevels - 1;
+    }
+
+    int level = (int)floorf(log2f(texels / pixels) + textureResidency.mipBias);
+    return std::max(0, std::min(level, numLevels - 1));
+}
+
+// The level the loader started it with, it's never dropped below that
+int ResidentStartLevel(ResidentTexture* texture)
+{
+    if (texture->array != NULL) {
+        return TextureArrayStartLevel(texture->array->format, textureRegistry.streamStartSize);
+    }
+
+    TextureEntry* entry = texture->entry;
+    int level = 0;
+    int size = std::max(entry->width, entry->height);
+
+    while (level < entry->mips.numLevels - 1 && size > textureRegistry.streamStartSize) {
+        size = std::max(size / 2, 1);
+        level++;
+    }
+    return level;
+}
+
+size_t ResidentLevelBytes(ResidentTexture* texture, int level)
+{
+    if (texture->array != NULL) {
+        return TextureArrayLevelBytes(texture->array, level);
+    }
+
+    TextureEntry* entry = texture->entry;
+    return TextureLevelVRAMBytes(entry->width, entry->height, level, entry->channels, entry->blockBytes);
+}
+
+size_t ResidentVRAMBytes(ResidentTexture* texture)
+{
+    return (texture->array != NULL) ? texture->array->vramBytes : texture->entry->vramBytes;
+}
+
+void StreamResidentLevel(ResidentTexture* texture, int level)
+{
+    if (texture->array != NULL) {
+        StreamArrayLevel(texture->array, level);
+    } else {
+        StreamTextureLevel(texture->entry, level);
+    }
+}
+
+void EvictResidentLevel(ResidentTexture* texture)
+{
+    if (texture->array != NULL) {
+        EvictArrayLevel(texture->array);
+    } else {
+        EvictTextureLevel(texture->entry);
+    }
+}
+
+// Main thread, once per frame before drawing. Uses what NoteTextureFootprint saw last frame.
+void UpdateTextureResidency()
+{
+    if (!textureResidency.enabled) {
+        return;
+    }
+
+    unsigned long long lastFrame = textureResidency.frame;
+
+    std::vector<ResidentTexture> managed;
+
+    std::unordered_map<unsigned int, TextureEntry*>::iterator it;
+    for (it = textureRegistry.byId.begin(); it != textureRegistry.byId.end(); ++it) {
+        TextureEntry* entry = it->second;
+
+        if (entry->state == TEXTURE_READY && entry->array == NULL && entry->mips.streamed) {
+            ResidentTexture texture = { entry, NULL, &entry->mips };
+            managed.push_back(texture);
+        }
+    }
+
+    for (size_t i = 0; i < textureArrays.arrays.size(); ++i) {
+        TextureArray* array = textureArrays.arrays[i];
+
+        if (array->mips.streamed) {
+            ResidentTexture texture = { NULL, array, &array->mips };
+            managed.push_back(texture);
+        }
+    }
+
+    textureResidency.numManaged = (int)managed.size();
+    textureResidency.managedBytes = 0;
+    textureResidency.numWanting = 0;
+
+    // furthest from what they want first
+    std::vector<ResidentTexture> wanting;
+    for (size_t i = 0; i < managed.size(); ++i) {
+        MipResidency* mips = managed[i].mips;
+
+        textureResidency.managedBytes += ResidentVRAMBytes(&managed[i]);
+
+        if (mips->lastUsedFrame == lastFrame && mips->wantedLevel < mips->residentLevel) {
+            textureResidency.numWanting++;
+
+            if (mips->streaming == 0) {
+                wanting.push_back(managed[i]);
+            }
+        }
+    }
+
+    std::sort(wanting.begin(), wanting.end(), [](ResidentTexture const& a, ResidentTexture const& b) {
+        return a.mips->residentLevel - a.mips->wantedLevel > b.mips->residentLevel - b.mips->wantedLevel;
+    });
+
+    int numStarts = std::min((int)wanting.size(), std::min(RESIDENCY_UPLOADS_PER_FRAME, RESIDENCY_MAX_PENDING - textureResidency.numPending));
+
+    // room for this frame's uploads is made too, otherwise a texture that
+    // needs a level would wait until something else pushes over the budget
+    size_t demand = textureResidency.pendingBytes;
+    for (int i = 0; i < numStarts; ++i) {
+        demand += ResidentLevelBytes(&wanting[i], wanting[i].mips->residentLevel - 1);
+    }
+    size_t limit = (textureResidency.budgetBytes > demand) ? textureResidency.budgetBytes - demand : 0;
+
+    // least recently drawn first
+    std::sort(managed.begin(), managed.end(), [](ResidentTexture const& a, ResidentTexture const& b) {
+        return a.mips->lastUsedFrame < b.mips->lastUsedFrame;
+    });
+
+    // pass 0 drops levels nobody wants, pass 1 anything not drawn last frame
+    for (int pass = 0; pass < 2 && TextureVRAMTotal() > limit; ++pass) {
+        for (size_t i = 0; i < managed.size() && TextureVRAMTotal() > limit; ++i) {
+            MipResidency* mips = managed[i].mips;
+
+            if (mips->streaming > 0 || (pass == 1 && mips->lastUsedFrame == lastFrame)) {
+                continue;
+            }
+
+            int startLevel = ResidentStartLevel(&managed[i]);
+
+            while (mips->residentLevel < startLevel && TextureVRAMTotal() > limit
+                && (pass == 1 || mips->residentLevel < mips->wantedLevel)) {
+                EvictResidentLevel(&managed[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < numStarts; ++i) {
+        ResidentTexture* texture = &wanting[i];
+        size_t bytes = ResidentLevelBytes(texture, texture->mips->residentLevel - 1);
+
+        // a smaller level further down may still fit
+        if (TextureVRAMTotal() + textureResidency.pendingBytes + bytes > textureResidency.budgetBytes) {
+            continue;
+        }
+
+        StreamResidentLevel(texture, texture->mips->residentLevel - 1);
+    }
+
+    textureResidency.frame++;
+}
+
+void StreamTextureLevel(TextureEntry* entry, int level)
+{
+    TextureUpload* upload = ReuseTextureUpload(entry->id, GL_TEXTURE_2D, entry->settings);
+    upload->streamLevel = level;
+    upload->onFinished = TextureLevelStreamed;
+    upload->user = entry;
+
+    entry->mips.streaming = 1;
+
+    textureResidency.numPending++;
+    textureResidency.pendingBytes += TextureLevelVRAMBytes(entry->width, entry->height, level, entry->channels, entry->blockBytes);
+
+    QueueTextureUpload(upload, entry->paths);
+}
+
+// Called by FinishTextureJob on the main thread
+void TextureLevelStreamed(TextureUpload* upload)
+{
+    TextureEntry* entry = (TextureEntry*)upload->user;
+    int level = upload->streamLevel;
+    size_t bytes = TextureLevelVRAMBytes(entry->width, entry->height, level, entry->channels, entry->blockBytes);
+
+    textureResidency.numPending--;
+    textureResidency.pendingBytes -= bytes;
+
+    entry->mips.streaming = 0;
+
+    if (entry->released) {
+        FreeTextureEntry(entry);
+        return;
+    }
+
+    // the baked file went stale or changed format, the level is outside the base..max range so it's never sampled
+    bool matches = upload->imagesLoaded > 0 && level == entry->mips.residentLevel - 1
+        && upload->width == entry->width && upload->height == entry->height
+        && upload->channels == entry->channels && upload->blockBytes == entry->blockBytes;
+
+    glBindTexture(GL_TEXTURE_2D, entry->id);
+
+    if (!matches) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        printf("TextureResidency: could not stream level %d of %s, keeping level %d\n", level, entry->name.c_str(), entry->mips.residentLevel);
+        entry->mips.streamed = false;
+        textureResidency.numFailed++;
+        return;
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entry->mips.residentLevel = level;
+    entry->vramBytes += bytes;
+    textureRegistry.totalVRAM += bytes;
+
+    textureResidency.numStreamed++;
+}
+
+// Drops the finest resident level
+void EvictTextureLevel(TextureEntry* entry)
+{
+    int level = entry->mips.residentLevel;
+    size_t bytes = TextureLevelVRAMBytes(entry->width, entry->height, level, entry->channels, entry->blockBytes);
+
+    glBindTexture(GL_TEXTURE_2D, entry->id);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level + 1);
+    glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entry->mips.residentLevel = level + 1;
+    entry->vramBytes -= bytes;
+    textureRegistry.totalVRAM -= bytes;
+
+    textureResidency.numEvicted++;
+}
+
+// Allocates the level for every layer and reads it for each texture in the array.
+// Textures still loading get it with their first upload (TextureRegistryUploadLayer).
+void StreamArrayLevel(TextureArray* array, int level)
+{
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->id);
+    AllocTextureArrayLevel(array, level);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    ForgetTextureArrayBindings();
+
+    array->streamLevel = level;
+    array->streamFailed = false;
+
+    textureResidency.numPending++;
+
+    for (size_t layer = 0; layer < array->layers.size(); ++layer) {
+        TextureEntry* entry = array->layers[layer];
+        if (entry == NULL || entry->state == TEXTURE_PENDING) {
+            continue;
+        }
+
+        TextureUpload* upload = ReuseTextureUpload(entry->id, GL_TEXTURE_2D, entry->settings);
+        upload->streamLevel = level;
+        upload->onUploadImage = TextureRegistryUploadLayer;
+        upload->onFinished = ArrayLevelStreamed;
+        upload->user = entry;
+
+        entry->mips.streaming++;
+        array->mips.streaming++;
+
+        QueueTextureUpload(upload, entry->paths);
+    }
+
+    if (array->mips.streaming == 0) {
+        FinishArrayLevel(array);
+    }
+}
+
+// Called by FinishTextureJob on the main thread, for one layer
+void ArrayLevelStreamed(TextureUpload* upload)
+{
+    TextureEntry* entry = (TextureEntry*)upload->user;
+    TextureArray* array = entry->array;
+
+    entry->mips.streaming--;
+    array->mips.streaming--;
+
+    if (upload->imagesLoaded == 0) {
+        printf("TextureResidency: could not stream level %d of %s\n", array->streamLevel, entry->name.c_str());
+        array->streamFailed = true;
+    }
+
+    if (array->mips.streaming == 0) {
+        FinishArrayLevel(array);
+    }
+
+    // after the array is done with it, this can delete an empty array
+    if (entry->released) {
+        FreeTextureEntry(entry);
+    }
+}
+
+// Every layer has the level, or one of them failed and the array stays where it was
+void FinishArrayLevel(TextureArray* array)
+{
+    int level = array->streamLevel;
+    array->streamLevel = -1;
+
+    textureResidency.numPending--;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->id);
+
+    if (array->streamFailed) {
+        // the level is outside the base..max range, so it was never sampled
+        FreeTextureArrayLevel(array, level);
+        array->mips.streamed = false;
+        textureResidency.numFailed++;
+    } else {
+        SetTextureArrayBaseLevel(array, level);
+        textureResidency.numStreamed++;
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    ForgetTextureArrayBindings();
+
+    if (array->numUsed == 0) {
+        DeleteTextureArray(array);
+    }
+}
+
+// Drops the finest resident level of every layer
+void EvictArrayLevel(TextureArray* array)
+{
+    int level = array->mips.residentLevel;
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array->id);
+    SetTextureArrayBaseLevel(array, level + 1);
+    FreeTextureArrayLevel(array, level);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    ForgetTextureArrayBindings();
+
+    textureResidency.numEvicted++;
+}
+
+void TextureResidencyWindow()
+{
+    ImGui::Begin("Texture residency");
+
+    if (!textureResidency.enabled) {
+        ImGui::Text("Off, every level is loaded");
+        ImGui::End();
+        return;
+    }
+
+    int budgetMB = (int)(textureResidency.budgetBytes / (1024 * 1024));
+    if (ImGui::SliderInt("Budget (MB)", &budgetMB, 16, 4096)) {
+        textureResidency.budgetBytes = (size_t)budgetMB * 1024 * 1024;
+    }
+    ImGui::SliderFloat("Mip bias", &textureResidency.mipBias, -2.0f, 2.0f, "%.1f");
+
+    ImGui::Text("Resident: %.2f MB, %.2f MB in %d streamed textures and arrays", TextureVRAMTotal() / (1024.0 * 1024.0),
+        textureResidency.managedBytes / (1024.0 * 1024.0), textureResidency.numManaged);
+    ImGui::Text("Pending uploads: %d, %.2f MB", textureResidency.numPending, textureResidency.pendingBytes / (1024.0 * 1024.0));
+    ImGui::Text("Wanting finer levels: %d", textureResidency.numWanting);
+    ImGui::Text("Levels streamed %d, evicted %d, failed %d", textureResidency.numStreamed, textureResidency.numEvicted, textureResidency.numFailed);
+
+    ImGui::End();
+}
+
+#endif
@@ -0,0 +1,404 @@
+/*-------------------------------------------------------------------------------\
+uniform_ring.h
+
+Functions:
+    Per frame uniform data in one buffer. The camera, the lights and the model
+    matrix and color of every single draw are written once into a ring and
+    bound by offset to a uniform block with glBindBufferRange, instead of a
+    glUniform call per value per program.
+
+        FrameUniforms   binding 0   projection, view, viewPos
+        LightUniforms   binding 1   dirLight, pointLights[4], shininess
+        DrawUniforms    binding 2   model, color
+
+    The structs below are the std140 layout of the blocks in the shaders, vec3
+    members are followed by a float or padding. BindUniformBlocks is run after
+    every link (shader_m.h) and points a program's blocks at the bindings, it
+    prints a block whose size doesn't match its struct.
+
+    With GL 4.4 or ARB_buffer_storage the ring is persistently mapped, three
+    frames long. WriteUniforms only aligns the offset and copies, a frame's
+    region gets a fence when the frame ends and BeginUniformFrame waits for
+    that fence before writing the region again three frames later. The GPU
+    never waits on the CPU, the CPU only waits if it's 3 frames ahead.
+
+    Without it (4.1) the writes go to memory and are uploaded with
+    glBufferSubData right before a range is bound, the buffer is orphaned at
+    the start of every frame like instancing.h does.
+
+    A frame that writes more than its region grows the ring. What the frame
+    wrote so far is copied over and the bound ranges are bound again, the old
+    buffer is deleted and GL keeps it until the draws that used it are done.
+
+\-------------------------------------------------------------------------------*/
+#ifndef UNIFORM_RING_H
+#define UNIFORM_RING_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <shader_uniforms.h>
+
+#ifndef GL_VERSION_4_4
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+PFNGLBUFFERSTORAGEPROC glad_glBufferStorage;
+#define glBufferStorage glad_glBufferStorage
+#endif
+
+#define UNIFORM_FRAME_BINDING 0
+#define UNIFORM_LIGHTS_BINDING 1
+#define UNIFORM_DRAW_BINDING 2
+
+#define UNIFORM_RING_FRAMES 3
+// bytes per frame to start with
+#define UNIFORM_RING_MIN_SIZE (256 * 1024)
+#define NUM_POINT_LIGHTS 4
+
+struct FrameUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos;
+    float padding;
+};
+
+struct DirLightUniforms {
+    glm::vec3 direction;
+    float padding0;
+    glm::vec3 ambient;
+    float padding1;
+    glm::vec3 diffuse;
+    float padding2;
+    glm::vec3 specular;
+    float padding3;
+};
+
+// member order of PointLight in 6.multiple_lights.fs
+struct PointLightUniforms {
+    glm::vec3 position;
+    float constant;
+    glm::vec3 ambient;
+    float linear;
+    glm::vec3 diffuse;
+    float quadratic;
+    glm::vec3 specular;
+    float padding;
+};
+
+struct LightUniforms {
+    DirLightUniforms dirLight;
+    PointLightUniforms pointLights[NUM_POINT_LIGHTS];
+    float shininess;
+    float padding[3];
+};
+
+struct DrawUniforms {
+    glm::mat4 model;
+    glm::vec4 color;
+};
+
+struct UniformRing {
+    GLuint buffer;
+    // whole ring when persistently mapped, NULL otherwise
+    char* mapped;
+    // this frame's writes before they're uploaded, without persistent maps
+    char* staging;
+    GLsync fences[UNIFORM_RING_FRAMES];
+
+    size_t frameSize;
+    size_t alignment;
+    int frame;
+    // start of this frame's region and the next write, both in the buffer
+    size_t begin;
+    size_t offset;
+    // end of what's uploaded from staging
+    size_t uploaded;
+
+    // last range bound to each binding this frame, size 0 if none
+    GLintptr boundOffset[3];
+    size_t boundSize[3];
+
+    // frames BeginUniformFrame had to wait for the GPU, and the last frame's use
+    int fenceWaits;
+    size_t bytesUsed;
+};
+
+UniformRing uniformRing;
+bool uniformRingPersistent = false;
+
+void InitUniformRing(GLADloadproc load);
+void CreateUniformRingBuffer(size_t frameSize);
+void GrowUniformRing(size_t size);
+void BindUniformBlocks(unsigned int program);
+
+void BeginUniformFrame();
+void EndUniformFrame();
+GLintptr WriteUniforms(const void* data, size_t size);
+void BindUniforms(GLuint binding, GLintptr offset, size_t size);
+
+void SetFrameUniforms(glm::mat4 const& projection, glm::mat4 const& view, glm::vec3 viewPos);
+void SetLightUniforms(LightUniforms const& lights);
+void BindDrawUniforms(glm::mat4 const& model, glm::vec4 color);
+
+// After gladLoadGLLoader, with the context current
+void InitUniformRing(GLADloadproc load)
+{
+    uniformRingPersistent = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+
+    if (!uniformRingPersistent) {
+        GLint numExtensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+
+        for (GLint i = 0; i < numExtensions && !uniformRingPersistent; ++i) {
+            uniformRingPersistent = strcmp((const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i), "GL_ARB_buffer_storage") == 0;
+        }
+    }
+
+#ifndef GL_VERSION_4_4
+    if (uniformRingPersistent) {
+        glad_glBufferStorage = (PFNGLBUFFERSTORAGEPROC)load("glBufferStorage");
+        uniformRingPersistent = glad_glBufferStorage != NULL;
+    }
+#endif
+
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    uniformRing.alignment = (size_t)alignment;
+
+    CreateUniformRingBuffer(UNIFORM_RING_MIN_SIZE);
+
+    printf("UniformRing: %s, %zu KB per frame, offsets aligned to %d\n",
+        uniformRingPersistent ? "persistently mapped" : "orphaned each frame", uniformRing.frameSize / 1024, alignment);
+}
+
+// Drops the old buffer and its fences, the current frame starts over at its region.
+// The staging memory keeps its contents.
+void CreateUniformRingBuffer(size_t frameSize)
+{
+    UniformRing* ring = &uniformRing;
+
+    if (ring->buffer != 0) {
+        glDeleteBuffers(1, &ring->buffer);
+    }
+    for (int i = 0; i < UNIFORM_RING_FRAMES; ++i) {
+        if (ring->fences[i] != NULL) {
+            glDeleteSync(ring->fences[i]);
+            ring->fences[i] = NULL;
+        }
+    }
+
+    ring->frameSize = frameSize;
+    ring->mapped = NULL;
+
+    glGenBuffers(1, &ring->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer);
+
+    if (uniformRingPersistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, frameSize * UNIFORM_RING_FRAMES, NULL, flags);
+        ring->mapped = (char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, frameSize * UNIFORM_RING_FRAMES, flags);
+        ring->begin = frameSize * ring->frame;
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, frameSize, NULL, GL_STREAM_DRAW);
+        ring->staging = (char*)realloc(ring->staging, frameSize);
+        ring->begin = 0;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    ring->offset = ring->begin;
+    ring->uploaded = ring->begin;
+}
+
+// Room for size more bytes this frame
+void GrowUniformRing(size_t size)
+{
+    UniformRing* ring = &uniformRing;
+
+    size_t used = ring->offset - ring->begin;
+    size_t oldBegin = ring->begin;
+
+    size_t frameSize = ring->frameSize * 2;
+    while (frameSize < used + size + ring->alignment) {
+        frameSize *= 2;
+    }
+
+    // the mapping goes away with the old buffer
+    char* frameData = NULL;
+    if (uniformRingPersistent) {
+        frameData = (char*)malloc(used + 1);
+        memcpy(frameData, ring->mapped + ring->begin, used);
+    }
+
+    CreateUniformRingBuffer(frameSize);
+
+    if (uniformRingPersistent) {
+        memcpy(ring->mapped + ring->begin, frameData, used);
+        free(frameData);
+    }
+    ring->offset = ring->begin + used;
+
+    // deleting the buffer unbound it
+    for (GLuint binding = 0; binding < 3; ++binding) {
+        if (ring->boundSize[binding] > 0) {
+            BindUniforms(binding, ring->boundOffset[binding] - oldBegin + ring->begin, ring->boundSize[binding]);
+        }
+    }
+
+    printf("UniformRing: grew to %zu KB per frame\n", frameSize / 1024);
+}
+
+// After every link, block bindings are reset with it
+void BindUniformBlocks(unsigned int program)
+{
+    struct {
+        UniformId id;
+        const char* name;
+        GLuint binding;
+        size_t size;
+    } blocks[] = {
+        { UNIFORM("FrameUniforms"), "FrameUniforms", UNIFORM_FRAME_BINDING, sizeof(FrameUniforms) },
+        { UNIFORM("LightUniforms"), "LightUniforms", UNIFORM_LIGHTS_BINDING, sizeof(LightUniforms) },
+        { UNIFORM("DrawUniforms"), "DrawUniforms", UNIFORM_DRAW_BINDING, sizeof(DrawUniforms) },
+    };
+
+    for (int i = 0; i < 3; ++i) {
+        GLuint index = ShaderUniformBlockIndex(program, blocks[i].id);
+        if (index == GL_INVALID_INDEX) {
+            continue;
+        }
+
+        glUniformBlockBinding(program, index, blocks[i].binding);
+
+        GLint dataSize = 0;
+        glGetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &dataSize);
+        if ((size_t)dataSize > blocks[i].size) {
+            printf("UniformRing: %s of program %u is %d bytes, the struct has %zu\n", blocks[i].name, program, dataSize, blocks[i].size);
+        }
+    }
+}
+
+// Before the first write of the frame
+void BeginUniformFrame()
+{
+    UniformRing* ring = &uniformRing;
+
+    ring->frame = (ring->frame + 1) % UNIFORM_RING_FRAMES;
+
+    if (uniformRingPersistent) {
+        GLsync fence = ring->fences[ring->frame];
+
+        // the region was last used 3 frames ago, normally long done
+        if (fence != NULL) {
+            GLenum result = glClientWaitSync(fence, 0, 0);
+            if (result == GL_TIMEOUT_EXPIRED) {
+                ring->fenceWaits++;
+                while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {
+                }
+            }
+            glDeleteSync(fence);
+            ring->fences[ring->frame] = NULL;
+        }
+
+        ring->begin = ring->frameSize * ring->frame;
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer);
+        glBufferData(GL_UNIFORM_BUFFER, ring->frameSize, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        ring->begin = 0;
+    }
+
+    ring->offset = ring->begin;
+    ring->uploaded = ring->begin;
+
+    for (int i = 0; i < 3; ++i) {
+        ring->boundSize[i] = 0;
+    }
+}
+
+// After the last draw that reads the frame's uniforms
+void EndUniformFrame()
+{
+    UniformRing* ring = &uniformRing;
+
+    ring->bytesUsed = ring->offset - ring->begin;
+
+    if (uniformRingPersistent) {
+        ring->fences[ring->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
+
+// Returns the offset in the buffer to bind, valid until the frame ends
+GLintptr WriteUniforms(const void* data, size_t size)
+{
+    UniformRing* ring = &uniformRing;
+
+    size_t offset = (ring->offset + ring->alignment - 1) / ring->alignment * ring->alignment;
+
+    if (offset + size > ring->begin + ring->frameSize) {
+        GrowUniformRing(size);
+        offset = (ring->offset + ring->alignment - 1) / ring->alignment * ring->alignment;
+    }
+
+    if (uniformRingPersistent) {
+        memcpy(ring->mapped + offset, data, size);
+    } else {
+        memcpy(ring->staging + offset, data, size);
+    }
+
+    ring->offset = offset + size;
+    return (GLintptr)offset;
+}
+
+void BindUniforms(GLuint binding, GLintptr offset, size_t size)
+{
+    UniformRing* ring = &uniformRing;
+
+    // everything written since the last bind in one upload
+    if (!uniformRingPersistent && ring->offset > ring->uploaded) {
+        glBindBuffer(GL_UNIFORM_BUFFER, ring->buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, ring->uploaded, ring->offset - ring->uploaded, ring->staging + ring->uploaded);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+        ring->uploaded = ring->offset;
+    }
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, ring->buffer, offset, size);
+
+    ring->boundOffset[binding] = offset;
+    ring->boundSize[binding] = size;
+}
+
+void SetFrameUniforms(glm::mat4 const& projection, glm::mat4 const& view, glm::vec3 viewPos)
+{
+    FrameUniforms frame;
+    frame.projection = projection;
+    frame.view = view;
+    frame.viewPos = viewPos;
+    frame.padding = 0.0f;
+
+    BindUniforms(UNIFORM_FRAME_BINDING, WriteUniforms(&frame, sizeof(frame)), sizeof(frame));
+}
+
+void SetLightUniforms(LightUniforms const& lights)
+{
+    BindUniforms(UNIFORM_LIGHTS_BINDING, WriteUniforms(&lights, sizeof(lights)), sizeof(lights));
+}
+
+// For the next draw with a program that has DrawUniforms
+void BindDrawUniforms(glm::mat4 const& model, glm::vec4 color)
+{
+    DrawUniforms draw;
+    draw.model = model;
+    draw.color = color;
+
+    BindUniforms(UNIFORM_DRAW_BINDING, WriteUniforms(&draw, sizeof(draw)), sizeof(draw));
+}
+
+#endif
@@ -0,0 +1,246 @@
+/*-------------------------------------------------------------------------------\
+vertex_format.h
+
+Functions:
+    Packed GPU vertex layout. VertexData is 92 bytes, a packed vertex is
+    28 bytes for a static mesh and 40 for a skinned one (+4 with colours).
+
+    position    3 x float       location 0
+    normal      2 x snorm16     location 1   octahedral
+    uv          2 x half        location 2
+    tangent     3 x snorm16     location 3   octahedral xy, z = bitangent sign
+    bone ids    4 x u8          location 5   skinned meshes only
+    weights     4 x unorm16     location 6   skinned meshes only
+    colour      4 x unorm8      location 7   only if the mesh has vertex colours
+
+    Attributes missing from a mesh are left disabled. Without bones the
+    skinning shader reads ids -1 and weights 0, like an unpacked static mesh,
+    and draws the bind pose. Shaders decode the normal, tangent and bitangent
+    when the "packedVertices" uniform is set (DrawModel).
+
+    PackMeshVertices runs on the loader thread after the mesh cache, so the
+    cache keeps the full VertexData. A mesh stays unpacked if it has more than
+    256 bones or a UV that moves by more than half a texel of a
+    PACKED_UV_TEXELS wide texture when rounded to a half float. Between 1 and
+    2 a half float steps by 1/1024, so meshes tiling UVs past 2 keep floats.
+
+\-------------------------------------------------------------------------------*/
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <model_data.h>
+
+// texture width the half float UV error is measured against
+#define PACKED_UV_TEXELS 1024.0f
+
+// set to false to upload VertexData as is
+bool usePackedVertices = true;
+
+bool PackMeshVertices(MeshData* mesh);
+float HalfRoundTripError(float value);
+PackedVertexLayout GetPackedVertexLayout(bool skinned, bool colors);
+void SetPackedVertexAttributes(PackedVertexLayout* layout);
+
+void OctEncode(glm::vec3 n, short* out);
+short PackSnorm16(float value);
+
+PackedVertexLayout GetPackedVertexLayout(bool skinned, bool colors)
+{
+    PackedVertexLayout layout;
+    layout.skinned = skinned;
+    layout.colors = colors;
+
+    int offset = 0;
+
+    // position
+    offset += 3 * sizeof(float);
+    layout.normalOffset = offset;
+    offset += 2 * sizeof(short);
+    layout.uvOffset = offset;
+    offset += 2 * sizeof(unsigned short);
+    layout.tangentOffset = offset;
+    offset += 3 * sizeof(short);
+    // keep the next attribute 4 byte aligned
+    offset += sizeof(short);
+
+    layout.boneIdOffset = -1;
+    layout.weightOffset = -1;
+    if (skinned) {
+        layout.boneIdOffset = offset;
+        offset += 4 * sizeof(unsigned char);
+        layout.weightOffset = offset;
+        offset += 4 * sizeof(unsigned short);
+    }
+
+    layout.colorOffset = -1;
+    if (colors) {
+        layout.colorOffset = offset;
+        offset += 4 * sizeof(unsigned char);
+    }
+
+    layout.stride = offset;
+
+    return layout;
+}
+
+short PackSnorm16(float value)
+{
+    value = glm::clamp(value, -1.0f, 1.0f);
+    return (short)roundf(value * 32767.0f);
+}
+
+// Maps the unit sphere onto the [-1, 1] square. A zero vector decodes to +Z.
+void OctEncode(glm::vec3 n, short* out)
+{
+    float sum = fabsf(n.x) + fabsf(n.y) + fabsf(n.z);
+    if (sum == 0.0f) {
+        out[0] = 0;
+        out[1] = 0;
+        return;
+    }
+
+    n /= sum;
+
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f) {
+        p.x = (1.0f - fabsf(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        p.y = (1.0f - fabsf(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    out[0] = PackSnorm16(p.x);
+    out[1] = PackSnorm16(p.y);
+}
+
+// How far a value moves when stored as a half float, infinite past its range
+float HalfRoundTripError(float value)
+{
+    return fabsf(glm::unpackHalf1x16(glm::packHalf1x16(value)) - value);
+}
+
+// Fills mesh->packedVertices. Returns false and leaves the mesh alone if it can't be packed.
+bool PackMeshVertices(MeshData* mesh)
+{
+    bool skinned = false;
+    bool colors = false;
+
+    // half a texel
+    const float maxUvError = 0.5f / PACKED_UV_TEXELS;
+
+    for (unsigned int i = 0; i < mesh->numVertices; ++i) {
+        VertexData* v = &mesh->vertices[i];
+
+        if (HalfRoundTripError(v->TexCoords.x) > maxUvError || HalfRoundTripError(v->TexCoords.y) > maxUvError) {
+            return false;
+        }
+
+        for (int k = 0; k < MAX_BONE_INFLUENCE; ++k) {
+            if (v->m_BoneIDs[k] > 255) {
+                return false;
+            }
+            if (v->m_BoneIDs[k] >= 0) {
+                skinned = true;
+            }
+        }
+
+        if (v->Color != glm::vec3(0.0f)) {
+            colors = true;
+        }
+    }
+
+    PackedVertexLayout layout = GetPackedVertexLayout(skinned, colors);
+    unsigned char* packed = (unsigned char*)calloc(mesh->numVertices, layout.stride);
+
+    for (unsigned int i = 0; i < mesh->numVertices; ++i) {
+        VertexData* v = &mesh->vertices[i];
+        unsigned char* out = packed + (size_t)i * layout.stride;
+
+        memcpy(out, &v->Position, 3 * sizeof(float));
+
+        OctEncode(v->Normal, (short*)(out + layout.normalOffset));
+
+        unsigned short* uv = (unsigned short*)(out + layout.uvOffset);
+        uv[0] = glm::packHalf1x16(v->TexCoords.x);
+        uv[1] = glm::packHalf1x16(v->TexCoords.y);
+
+        // the bitangent is rebuilt as cross(normal, tangent) * sign
+        short* tangent = (short*)(out + layout.tangentOffset);
+        OctEncode(v->Tangent, tangent);
+        tangent[2] = (glm::dot(glm::cross(v->Normal, v->Tangent), v->Bitangent) < 0.0f) ? -32767 : 32767;
+
+        if (skinned) {
+            unsigned char* ids = out + layout.boneIdOffset;
+            unsigned short* weights = (unsigned short*)(out + layout.weightOffset);
+
+            // unused slots become bone 0 with weight 0
+            for (int k = 0; k < MAX_BONE_INFLUENCE; ++k) {
+                bool used = v->m_BoneIDs[k] >= 0;
+                ids[k] = used ? (unsigned char)v->m_BoneIDs[k] : 0;
+                weights[k] = used ? (unsigned short)roundf(glm::clamp(v->m_Weights[k], 0.0f, 1.0f) * 65535.0f) : 0;
+            }
+        }
+
+        if (colors) {
+            unsigned char* color = out + layout.colorOffset;
+            color[0] = (unsigned char)roundf(glm::clamp(v->Color.r, 0.0f, 1.0f) * 255.0f);
+            color[1] = (unsigned char)roundf(glm::clamp(v->Color.g, 0.0f, 1.0f) * 255.0f);
+            color[2] = (unsigned char)roundf(glm::clamp(v->Color.b, 0.0f, 1.0f) * 255.0f);
+            color[3] = 255;
+        }
+    }
+
+    mesh->packedVertices = packed;
+    mesh->packedLayout = layout;
+
+    return true;
+}
+
+// VAO and GL_ARRAY_BUFFER must be bound
+void SetPackedVertexAttributes(PackedVertexLayout* layout)
+{
+    GLsizei stride = layout->stride;
+
+    // vertex Positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+    // vertex normals, octahedral
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, stride, (void*)(size_t)layout->normalOffset);
+    // vertex texture coords
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)(size_t)layout->uvOffset);
+    // vertex tangent, octahedral + bitangent sign
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_SHORT, GL_TRUE, stride, (void*)(size_t)layout->tangentOffset);
+
+    if (layout->skinned) {
+        // ids
+        glEnableVertexAttribArray(5);
+        glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)(size_t)layout->boneIdOffset);
+        // weights
+        glEnableVertexAttribArray(6);
+        glVertexAttribPointer(6, 4, GL_UNSIGNED_SHORT, GL_TRUE, stride, (void*)(size_t)layout->weightOffset);
+    } else {
+        // disabled arrays read the current value, context state rather than VAO state.
+        // The GL default (0, 0, 0, 1) would give bone 3 a weight of 1.
+        glVertexAttribI4i(5, -1, -1, -1, -1);
+        glVertexAttrib4f(6, 0.0f, 0.0f, 0.0f, 0.0f);
+    }
+
+    if (layout->colors) {
+        // vertex colors
+        glEnableVertexAttribArray(7);
+        glVertexAttribPointer(7, 3, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)layout->colorOffset);
+    }
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*-------------------------------------------------------------------------------\
+worker_pool.h
+
+Functions:
+    Fixed pool of worker threads shared by every loader (asset_manager.h,
+    texture_loader.h). Jobs are a function pointer and an argument.
+
+    Jobs must not make OpenGL calls, the context only lives on the main thread.
+    Loaders hand their results back through their own queues and finish the work
+    in a Poll function on the main thread.
+
+\-------------------------------------------------------------------------------*/
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <stdio.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerJob {
+    void (*function)(void* arg);
+    void* arg;
+};
+
+struct WorkerPool {
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobDone;
+    std::deque<WorkerJob> jobs;
+    bool shutdown;
+
+    // incremented after every job, used to sleep until something finished
+    unsigned long long jobsFinished;
+};
+
+WorkerPool workerPool;
+
+void InitWorkerPool(unsigned int numThreads);
+void ShutdownWorkerPool();
+
+void PushWorkerJob(void (*function)(void* arg), void* arg);
+
+unsigned long long WorkerJobsFinished();
+void WaitForWorkerJobs(unsigned long long jobsFinished);
+
+void WorkerThread();
+
+// numThreads = 0 uses one thread per core minus the main thread
+void InitWorkerPool(unsigned int numThreads)
+{
+    if (numThreads == 0) {
+        unsigned int cores = std::thread::hardware_concurrency();
+        numThreads = (cores > 1) ? cores - 1 : 1;
+    }
+
+    workerPool.shutdown = false;
+    workerPool.jobsFinished = 0;
+
+    for (unsigned int i = 0; i < numThreads; ++i) {
+        workerPool.threads.push_back(std::thread(WorkerThread));
+    }
+
+    printf("WorkerPool: %u threads\n", numThreads);
+}
+
+// Jobs that have not started are dropped
+void ShutdownWorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(workerPool.mutex);
+        workerPool.shutdown = true;
+        workerPool.jobs.clear();
+    }
+    workerPool.jobAvailable.notify_all();
+
+    for (size_t i = 0; i < workerPool.threads.size(); ++i) {
+        workerPool.threads[i].join();
+    }
+    workerPool.threads.clear();
+}
+
+void WorkerThread()
+{
+    while (true) {
+        WorkerJob job;
+
+        {
+            std::unique_lock<std::mutex> lock(workerPool.mutex);
+            workerPool.jobAvailable.wait(lock, [] { return workerPool.shutdown || !workerPool.jobs.empty(); });
+
+            if (workerPool.shutdown) {
+                return;
+            }
+
+            job = workerPool.jobs.front();
+            workerPool.jobs.pop_front();
+        }
+
+        job.function(job.arg);
+
+        {
+            std::lock_guard<std::mutex> lock(workerPool.mutex);
+            workerPool.jobsFinished++;
+        }
+        workerPool.jobDone.notify_all();
+    }
+}
+
+void PushWorkerJob(void (*function)(void* arg), void* arg)
+{
+    {
+        std::lock_guard<std::mutex> lock(workerPool.mutex);
+        workerPool.jobs.push_back({ function, arg });
+    }
+    workerPool.jobAvailable.notify_one();
+}
+
+unsigned long long WorkerJobsFinished()
+{
+    std::lock_guard<std::mutex> lock(workerPool.mutex);
+    return workerPool.jobsFinished;
+}
+
+// Sleeps until another job finished. Read WorkerJobsFinished() before polling
+// for results, so a job finishing in between isn't missed.
+void WaitForWorkerJobs(unsigned long long jobsFinished)
+{
+    std::unique_lock<std::mutex> lock(workerPool.mutex);
+    workerPool.jobDone.wait(lock, [jobsFinished] { return workerPool.jobsFinished != jobsFinished; });
+}
+
+#endif
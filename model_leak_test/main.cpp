@@ -0,0 +1,252 @@
+/*-------------------------------------------------------------------------------\
+model_leak_test
+
+    model_leak_test [model paths] [-n rounds]
+
+    Loads and unloads models over and over, once through LoadModel/UnloadModel
+    and once through the asset manager (LoadModelAsync/ReleaseModelAsset), and
+    fails if anything is left behind. Paths are relative to ../resources (run
+    from model_leak_test/ like the viewer runs from assimp_viewer/), by default
+    a textured .obj and a skinned .dae with animations. The first model is
+    also loaded as a hitbox node's collider and freed like FreeSceneTree.
+
+    The first round imports the models, writes their mesh cache and grows the
+    registries, the later ones read the cache. After the last round:
+
+    - no ModelAsset, registered texture or used mesh arena range is left
+    - no hitbox VAO or buffer, AABB tree or collider polygon is left
+    - MSVC debug builds compare the CRT debug heap against the first round
+    - Release|x64 is built with AddressSanitizer, a use after free or double
+      free in the unload path aborts. With gcc/clang -fsanitize=address also
+      runs LeakSanitizer, which fails the run at exit for unreachable blocks
+
+    A hidden window gives the GL context for the uploads.
+
+    Exit code is 1 if a model failed to load or anything leaked.
+
+\-------------------------------------------------------------------------------*/
+#define STB_IMAGE_IMPLEMENTATION
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#if defined(_MSC_VER) && defined(_DEBUG) && !defined(__SANITIZE_ADDRESS__)
+#define LEAK_TEST_CRT_HEAP
+#include <crtdbg.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <asset_manager.h>
+#include <collision.h>
+#include <model.h>
+#include <texture_loader.h>
+#include <texture_registry.h>
+#include <worker_pool.h>
+
+void PrintUsage()
+{
+    printf("usage: model_leak_test [model paths] [-n rounds]\n");
+}
+
+// vertices still allocated in all mesh arena blocks
+unsigned int MeshArenaVerticesUsed()
+{
+    unsigned int used = 0;
+
+    for (int layout = 0; layout < MESH_ARENA_LAYOUTS * 2; ++layout) {
+        std::vector<MeshArenaBlock*>& blocks = meshArenaBlocks[layout / 2][layout % 2];
+
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            unsigned int freeVertices = 0;
+            for (size_t j = 0; j < blocks[i]->freeVertices.size(); ++j) {
+                freeVertices += blocks[i]->freeVertices[j].count;
+            }
+            used += blocks[i]->vertexCapacity - freeVertices;
+        }
+    }
+
+    return used;
+}
+
+// Hitbox VAOs and buffers GL still knew after their model was unloaded
+int hitboxObjectsLeft = 0;
+
+// A hitbox node's model and AABB tree, freed the way FreeSceneTree does. False if it failed to load.
+bool LoadUnloadHitbox(std::string const& path)
+{
+    AABB_node* rootAABB = CreateHitbox(path, glm::mat4(1.0f));
+    if (rootAABB == NULL) {
+        printf("model_leak_test: CreateHitbox failed for %s\n", path.c_str());
+        return false;
+    }
+
+    Model* model = LoadAABB_Model(rootAABB);
+
+    std::vector<unsigned int> vaos;
+    std::vector<unsigned int> buffers;
+    for (int i = 0; i < model->m_NumMeshes; ++i) {
+        vaos.push_back(model->m_Meshes[i].VAO);
+        buffers.push_back(model->m_Meshes[i].VBO);
+        buffers.push_back(model->m_Meshes[i].EBO);
+    }
+
+    UnloadModel(model);
+    FreeHitbox(rootAABB);
+
+    for (size_t i = 0; i < vaos.size(); ++i) {
+        if (glIsVertexArray(vaos[i])) {
+            hitboxObjectsLeft++;
+        }
+    }
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        if (glIsBuffer(buffers[i])) {
+            hitboxObjectsLeft++;
+        }
+    }
+
+    return true;
+}
+
+// One load and unload of every model, both ways, and of the first one as a hitbox.
+// False if one failed to load.
+bool LoadUnloadRound(std::vector<std::string> const& paths)
+{
+    bool loaded = LoadUnloadHitbox(paths[0]);
+
+    for (size_t i = 0; i < paths.size(); ++i) {
+        Model* model = LoadModel(paths[i]);
+        if (model == NULL) {
+            printf("model_leak_test: LoadModel failed for %s\n", paths[i].c_str());
+            loaded = false;
+        }
+        WaitForTextures();
+        UnloadModel(model);
+    }
+
+    std::vector<ModelAsset*> assets;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        assets.push_back(LoadModelAsync(paths[i]));
+        // a second handle for the same path, released separately
+        assets.push_back(LoadModelAsync(paths[i]));
+    }
+    for (size_t i = 0; i < assets.size(); ++i) {
+        if (WaitForModel(assets[i]) == NULL) {
+            printf("model_leak_test: LoadModelAsync failed for %s\n", assets[i]->path);
+            loaded = false;
+        }
+    }
+    WaitForTextures();
+    for (size_t i = 0; i < assets.size(); ++i) {
+        ReleaseModelAsset(assets[i]);
+    }
+
+    return loaded;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> paths;
+    int rounds = 5;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            rounds = atoi(argv[++i]);
+        } else if (argv[i][0] == '-') {
+            PrintUsage();
+            return 2;
+        } else {
+            paths.push_back(std::string("../resources/") + argv[i]);
+        }
+    }
+
+    if (paths.empty()) {
+        paths.push_back("../resources/models/test/test_map3.obj");
+        paths.push_back("../resources/objects/vampire/dancing_vampire.dae");
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "model_leak_test", NULL, NULL);
+    if (window == NULL) {
+        printf("model_leak_test: failed to create an OpenGL context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        printf("model_leak_test: failed to initialize GLAD\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    InitWorkerPool(0);
+
+    bool loaded = LoadUnloadRound(paths);
+
+#ifdef LEAK_TEST_CRT_HEAP
+    _CrtMemState before;
+    _CrtMemCheckpoint(&before);
+#endif
+
+    for (int round = 0; round < rounds; ++round) {
+        loaded = LoadUnloadRound(paths) && loaded;
+    }
+
+    bool leaked = false;
+
+    if (!assetManager.assets.empty()) {
+        printf("model_leak_test: %d model assets still loaded\n", (int)assetManager.assets.size());
+        leaked = true;
+    }
+    if (!textureRegistry.byId.empty()) {
+        printf("model_leak_test: %d textures still registered\n", (int)textureRegistry.byId.size());
+        leaked = true;
+    }
+    if (hitboxObjectsLeft != 0) {
+        printf("model_leak_test: %d hitbox VAOs and buffers not deleted\n", hitboxObjectsLeft);
+        leaked = true;
+    }
+    if (!root_AABB_nodes.empty() || !potentialColliders.empty()) {
+        printf("model_leak_test: %d AABB trees and %d collider polygons still registered\n",
+            (int)root_AABB_nodes.size(), (int)potentialColliders.size());
+        leaked = true;
+    }
+    unsigned int verticesUsed = MeshArenaVerticesUsed();
+    if (verticesUsed != 0) {
+        printf("model_leak_test: %u mesh arena vertices still allocated\n", verticesUsed);
+        leaked = true;
+    }
+
+#ifdef LEAK_TEST_CRT_HEAP
+    _CrtMemState after;
+    _CrtMemState difference;
+    _CrtMemCheckpoint(&after);
+    if (_CrtMemDifference(&difference, &before, &after) && difference.lCounts[_NORMAL_BLOCK] > 0) {
+        printf("model_leak_test: heap grew by %d blocks over %d rounds\n", (int)difference.lCounts[_NORMAL_BLOCK], rounds);
+        _CrtMemDumpStatistics(&difference);
+        leaked = true;
+    }
+#endif
+
+    ShutdownWorkerPool();
+    FreeMeshArena();
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    printf("model_leak_test: %d models, %d rounds, %s\n", (int)paths.size(), rounds,
+        !loaded ? "load failed" : (leaked ? "leaked" : "no leaks"));
+
+    return (loaded && !leaked) ? 0 : 1;
+}
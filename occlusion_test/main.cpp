@@ -0,0 +1,281 @@
+/*-------------------------------------------------------------------------------\
+occlusion_test
+
+    occlusion_test [-n triangles]
+
+    Checks the CPU occlusion rasterizer, pyramid and box test of
+    occlusion_cull.h on known cases and against a reference rasterizer in
+    double precision, then times them. It needs no window or GL context and
+    links no libraries, occlusion_cull.h only uses the model data types.
+
+    -n  triangles in the benchmark, 20000 by default, 0 skips it
+
+    Exit code is 1 if a test failed.
+
+\-------------------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <occlusion_cull.h>
+
+void PrintUsage()
+{
+    printf("usage: occlusion_test [-n triangles]\n");
+}
+
+// A quad as two triangles, for the tests
+void AddOccluderQuad(Occluder* occluder, glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d)
+{
+    unsigned int first = (unsigned int)occluder->vertices.size();
+    occluder->vertices.push_back(a);
+    occluder->vertices.push_back(b);
+    occluder->vertices.push_back(c);
+    occluder->vertices.push_back(d);
+
+    unsigned int quad[6] = { 0, 1, 2, 0, 2, 3 };
+    for (int i = 0; i < 6; ++i) {
+        occluder->indices.push_back(first + quad[i]);
+    }
+}
+
+void RenderTestOccluder(OcclusionBuffer* buffer, const Occluder* occluder, glm::mat4 const& viewProjection)
+{
+    buffer->viewProjection = viewProjection;
+    buffer->occluders.assign(1, occluder);
+    buffer->matrices.assign(1, glm::mat4(1.0f));
+    RenderOcclusion(buffer);
+    buffer->valid = true;
+}
+
+// Checks the rasterizer and the box test on known cases, prints each failure
+bool TestOcclusionCulling()
+{
+    OcclusionBuffer* buffer = new OcclusionBuffer();
+    InitOcclusionBuffer(buffer);
+
+    int failed = 0;
+    glm::mat4 identity = glm::mat4(1.0f);
+
+    // a quad over the whole screen at ndc z 0, clip space is world space
+    Occluder screen;
+    AddOccluderQuad(&screen, glm::vec3(-1, -1, 0), glm::vec3(1, -1, 0), glm::vec3(1, 1, 0), glm::vec3(-1, 1, 0));
+    RenderTestOccluder(buffer, &screen, identity);
+
+    int wrong = 0;
+    for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; ++i) {
+        wrong += fabsf(buffer->levels[0][i] - 0.5f) > 1e-6f;
+    }
+    if (wrong > 0) {
+        printf("TestOcclusion: full screen quad left %d pixels wrong\n", wrong);
+        failed++;
+    }
+    if (OcclusionBoxVisible(buffer, glm::vec3(-0.2f, -0.2f, 0.2f), glm::vec3(0.2f, 0.2f, 0.6f))) {
+        printf("TestOcclusion: box behind the quad is visible\n");
+        failed++;
+    }
+    if (!OcclusionBoxVisible(buffer, glm::vec3(-0.2f, -0.2f, -0.6f), glm::vec3(0.2f, 0.2f, -0.2f))) {
+        printf("TestOcclusion: box in front of the quad is occluded\n");
+        failed++;
+    }
+    if (!OcclusionBoxVisible(buffer, glm::vec3(-0.2f, -0.2f, -0.2f), glm::vec3(0.2f, 0.2f, 0.2f))) {
+        printf("TestOcclusion: box through the quad is occluded\n");
+        failed++;
+    }
+
+    // the left half only
+    Occluder half;
+    AddOccluderQuad(&half, glm::vec3(-1, -1, 0), glm::vec3(0, -1, 0), glm::vec3(0, 1, 0), glm::vec3(-1, 1, 0));
+    RenderTestOccluder(buffer, &half, identity);
+
+    if (OcclusionBoxVisible(buffer, glm::vec3(-0.8f, -0.5f, 0.5f), glm::vec3(-0.3f, 0.5f, 0.9f))) {
+        printf("TestOcclusion: box behind the left half is visible\n");
+        failed++;
+    }
+    if (!OcclusionBoxVisible(buffer, glm::vec3(0.3f, -0.5f, 0.5f), glm::vec3(0.8f, 0.5f, 0.9f))) {
+        printf("TestOcclusion: box right of the half quad is occluded\n");
+        failed++;
+    }
+    if (!OcclusionBoxVisible(buffer, glm::vec3(-0.2f, -0.5f, 0.5f), glm::vec3(0.2f, 0.5f, 0.9f))) {
+        printf("TestOcclusion: box over the edge of the half quad is occluded\n");
+        failed++;
+    }
+
+    // a wall through the near plane in a perspective view
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    Occluder wall;
+    AddOccluderQuad(&wall, glm::vec3(-50, -50, 5), glm::vec3(50, -50, 5), glm::vec3(50, 50, -10), glm::vec3(-50, 50, -10));
+    RenderTestOccluder(buffer, &wall, projection * view);
+
+    int covered = 0;
+    bool inRange = true;
+    for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; ++i) {
+        covered += buffer->levels[0][i] < 1.0f;
+        inRange = inRange && buffer->levels[0][i] >= 0.0f && buffer->levels[0][i] <= 1.0f;
+    }
+    if (covered == 0 || !inRange) {
+        printf("TestOcclusion: near clipped wall covered %d pixels, depth %s\n", covered, inRange ? "in range" : "out of range");
+        failed++;
+    }
+
+    // a quad past the screen edges, its diagonal shouldn't leave holes
+    Occluder facing;
+    AddOccluderQuad(&facing, glm::vec3(-50, -50, -10), glm::vec3(50, -50, -10), glm::vec3(50, 50, -10), glm::vec3(-50, 50, -10));
+    RenderTestOccluder(buffer, &facing, projection * view);
+
+    int holes = 0;
+    for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; ++i) {
+        holes += buffer->levels[0][i] == 1.0f;
+    }
+    if (holes > 0) {
+        printf("TestOcclusion: %d pixels left uncovered by a quad over the whole screen\n", holes);
+        failed++;
+    }
+    if (OcclusionBoxVisible(buffer, glm::vec3(-1.0f, -1.0f, -30.0f), glm::vec3(1.0f, 1.0f, -20.0f))) {
+        printf("TestOcclusion: box behind the perspective quad is visible\n");
+        failed++;
+    }
+
+    // every pyramid texel is the max of the 4 below it
+    for (int level = 1; level < OCCLUSION_LEVELS; ++level) {
+        int width = OCCLUSION_WIDTH >> level;
+        for (int i = 0; i < width * (OCCLUSION_HEIGHT >> level); ++i) {
+            int x = i % width;
+            int y = i / width;
+            const float* below = buffer->levels[level - 1] + (y * 2) * (width * 2) + x * 2;
+            float expected = glm::max(glm::max(below[0], below[1]), glm::max(below[width * 2], below[width * 2 + 1]));
+
+            if (buffer->levels[level][i] != expected) {
+                printf("TestOcclusion: pyramid level %d texel %d,%d is not the max below\n", level, x, y);
+                failed++;
+                level = OCCLUSION_LEVELS;
+                break;
+            }
+        }
+    }
+
+    // random triangles against a per pixel reference in double precision
+    srand(5);
+    int mismatched = 0;
+    for (int t = 0; t < 200; ++t) {
+        glm::vec3 p[3];
+        for (int k = 0; k < 3; ++k) {
+            p[k] = glm::vec3(rand() / (float)RAND_MAX * (OCCLUSION_WIDTH + 40) - 20, rand() / (float)RAND_MAX * (OCCLUSION_HEIGHT + 40) - 20, rand() / (float)RAND_MAX);
+        }
+
+        for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; ++i) {
+            buffer->levels[0][i] = 1.0f;
+        }
+        RasterizeTriangle(buffer->levels[0], p[0], p[1], p[2]);
+
+        double area = (double)(p[1].x - p[0].x) * (p[2].y - p[0].y) - (double)(p[1].y - p[0].y) * (p[2].x - p[0].x);
+
+        for (int y = 0; y < OCCLUSION_HEIGHT; ++y) {
+            for (int x = 0; x < OCCLUSION_WIDTH; ++x) {
+                double cx = x + 0.5;
+                double cy = y + 0.5;
+                double w0 = ((double)(p[2].x - p[1].x) * (cy - p[1].y) - (double)(p[2].y - p[1].y) * (cx - p[1].x)) / area;
+                double w1 = ((double)(p[0].x - p[2].x) * (cy - p[2].y) - (double)(p[0].y - p[2].y) * (cx - p[2].x)) / area;
+                double w2 = 1.0 - w0 - w1;
+
+                float value = buffer->levels[0][y * OCCLUSION_WIDTH + x];
+                bool inside = w0 > 0.0 && w1 > 0.0 && w2 > 0.0;
+
+                // pixel centers right on an edge may go either way
+                bool onEdge = fabs(w0) < 1e-4 || fabs(w1) < 1e-4 || fabs(w2) < 1e-4;
+                if (onEdge) {
+                    continue;
+                }
+
+                double reference = w0 * p[0].z + w1 * p[1].z + w2 * p[2].z;
+                if (inside != (value < 1.0f) || (inside && fabs(value - reference) > 1e-4)) {
+                    mismatched++;
+                }
+            }
+        }
+    }
+    if (mismatched > 0) {
+        printf("TestOcclusion: %d pixels differ from the reference rasterizer\n", mismatched);
+        failed++;
+    }
+
+    printf("TestOcclusion: %s, %d failed\n", failed == 0 ? "passed" : "FAILED", failed);
+
+    for (int level = 0; level < OCCLUSION_LEVELS; ++level) {
+        free(buffer->levels[level]);
+    }
+    delete buffer;
+
+    return failed == 0;
+}
+
+// numTriangles random triangles in front of a perspective camera, times the
+// render with the pyramid and box tests against it
+void BenchmarkOcclusion(int numTriangles)
+{
+    OcclusionBuffer* buffer = new OcclusionBuffer();
+    InitOcclusionBuffer(buffer);
+
+    srand(9);
+    Occluder occluder;
+    for (int i = 0; i < numTriangles; ++i) {
+        glm::vec3 center = glm::vec3(rand() / (float)RAND_MAX * 200.0f - 100.0f, rand() / (float)RAND_MAX * 60.0f - 30.0f, -rand() / (float)RAND_MAX * 200.0f - 5.0f);
+        for (int k = 0; k < 3; ++k) {
+            occluder.vertices.push_back(center + glm::vec3(rand(), rand(), rand()) / (float)RAND_MAX * 6.0f - 3.0f);
+            occluder.indices.push_back((unsigned int)occluder.vertices.size() - 1);
+        }
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    const int frames = 20;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; ++frame) {
+        RenderTestOccluder(buffer, &occluder, projection * view);
+    }
+    std::chrono::steady_clock::time_point rendered = std::chrono::steady_clock::now();
+
+    const int numBoxes = 10000;
+    int numVisible = 0;
+    for (int i = 0; i < numBoxes; ++i) {
+        glm::vec3 center = glm::vec3(rand() / (float)RAND_MAX * 200.0f - 100.0f, rand() / (float)RAND_MAX * 60.0f - 30.0f, -rand() / (float)RAND_MAX * 200.0f - 5.0f);
+        numVisible += OcclusionBoxVisible(buffer, center - 1.0f, center + 1.0f);
+    }
+    std::chrono::steady_clock::time_point tested = std::chrono::steady_clock::now();
+
+    double renderMs = std::chrono::duration<double, std::milli>(rendered - start).count() / frames;
+    double testUs = std::chrono::duration<double, std::micro>(tested - rendered).count() / numBoxes;
+
+    printf("BenchmarkOcclusion: %d triangles at %dx%d, %.3f ms per frame (%.1f M triangles/s), box test %.3f us, %d of %d boxes visible\n",
+        numTriangles, OCCLUSION_WIDTH, OCCLUSION_HEIGHT, renderMs, numTriangles / renderMs / 1000.0, testUs, numVisible, numBoxes);
+
+    for (int level = 0; level < OCCLUSION_LEVELS; ++level) {
+        free(buffer->levels[level]);
+    }
+    delete buffer;
+}
+
+int main(int argc, char** argv)
+{
+    int numTriangles = 20000;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            numTriangles = atoi(argv[++i]);
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    bool passed = TestOcclusionCulling();
+
+    if (numTriangles > 0) {
+        BenchmarkOcclusion(numTriangles);
+    }
+
+    return passed ? 0 : 1;
+}
@@ -202,6 +202,9 @@ int main()
 
     window = InitializeWindow();
     playerCamera = CreateCameraVector(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f), YAW, PITCH);
+
+    InitWorkerPool(0);
+
     /*
      * GLTF Load
      */
@@ -245,6 +248,8 @@ int main()
 
     while (!glfwWindowShouldClose(window)) {
 
+        PollTextureLoader();
+
         currentTime = glfwGetTime();
         float deltaTime = previousTime - currentTime;
 
@@ -308,6 +313,8 @@ int main()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    ShutdownWorkerPool();
+
     glfwTerminate();
     return 1;
 }
\ No newline at end of file
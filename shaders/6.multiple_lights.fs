@@ -2,10 +2,9 @@
 out vec4 FragColor;
 
 struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    sampler2D emission;
-    float shininess;
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    sampler2DArray emission;
 }; 
 
 struct DirLight {
@@ -16,15 +15,14 @@ struct DirLight {
     vec3 specular;
 };
 
+// each vec3 with a float after it, PointLightUniforms in uniform_ring.h
 struct PointLight {
     vec3 position;
-    
     float constant;
-    float linear;
-    float quadratic;
-	
     vec3 ambient;
+    float linear;
     vec3 diffuse;
+    float quadratic;
     vec3 specular;
 };
 
@@ -50,12 +48,32 @@ in vec3 Normal;
 in vec2 TexCoords;
 in vec3 VertexColor;
 
-uniform vec3 viewPos;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+// camera of the frame, see uniform_ring.h
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+layout (std140) uniform LightUniforms {
+    DirLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    float shininess;
+};
+
 uniform SpotLight spotLight;
 uniform Material material;
 
+// texture coordinate scale and layer of each texture type (TextureTypeNames), from the
+// materialLayers uniform or the indirect draw's material
+flat in vec3 MaterialLayers[5];
+
+vec4 MaterialTexture(sampler2DArray tex, int type, vec2 uv)
+{
+    vec3 layer = MaterialLayers[type];
+    return texture(tex, vec3(uv * layer.xy, layer.z));
+}
+
 uniform float time;
 
 // function prototypes
@@ -87,7 +105,7 @@ void main()
     //result += CalcSpotLight(spotLight, norm, FragPos, viewDir); 
     
     //emission
-    //vec3 emission = texture(material.emission, TexCoords).rgb;
+    //vec3 emission = MaterialTexture(material.emission, 4, TexCoords).rgb;
     //result += emission;
     //result *= vec3(OverlayMovingTexture(time));
 
@@ -116,7 +134,7 @@ vec4 OverlayMovingTexture(float time)
     if (newTexCoord.x > 1.0)
         newTexCoord.x -= 1.0;
 
-    vec4 movingColor = texture(material.emission, newTexCoord);
+    vec4 movingColor = MaterialTexture(material.emission, 4, newTexCoord);
 
     return movingColor;
 }
@@ -129,11 +147,11 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(MaterialTexture(material.diffuse, 0, TexCoords));
+    vec3 diffuse = light.diffuse * diff * vec3(MaterialTexture(material.diffuse, 0, TexCoords));
+    vec3 specular = light.specular * spec * vec3(MaterialTexture(material.specular, 1, TexCoords));
     return (ambient + diffuse + specular);
 }
 
@@ -145,14 +163,14 @@ vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(MaterialTexture(material.diffuse, 0, TexCoords));
+    vec3 diffuse = light.diffuse * diff * vec3(MaterialTexture(material.diffuse, 0, TexCoords));
+    vec3 specular = light.specular * spec * vec3(MaterialTexture(material.specular, 1, TexCoords));
     ambient *= attenuation;
     diffuse *= attenuation;
     specular *= attenuation;
@@ -167,7 +185,7 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float diff = max(dot(normal, lightDir), 0.0);
     // specular shading
     vec3 reflectDir = reflect(-lightDir, normal);
-    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
     // attenuation
     float distance = length(light.position - fragPos);
     float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));    
@@ -176,9 +194,9 @@ vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
     float epsilon = light.cutOff - light.outerCutOff;
     float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
     // combine results
-    vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-    vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-    vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
+    vec3 ambient = light.ambient * vec3(MaterialTexture(material.diffuse, 0, TexCoords));
+    vec3 diffuse = light.diffuse * diff * vec3(MaterialTexture(material.diffuse, 0, TexCoords));
+    vec3 specular = light.specular * spec * vec3(MaterialTexture(material.specular, 1, TexCoords));
     ambient *= attenuation * intensity;
     diffuse *= attenuation * intensity;
     specular *= attenuation * intensity;
@@ -0,0 +1,67 @@
+#version 430 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec3 Color;
+// the command's baseInstance plus the instance, see indirect_draw.h
+layout (location = 12) in uint drawIndex;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec3 VertexColor;
+flat out vec3 MaterialLayers[5];
+
+struct DrawData {
+    mat4 model;
+    uint material;
+};
+
+// xy texture coordinate scale, z layer, per texture type
+struct MaterialData {
+    vec4 layers[5];
+};
+
+layout (std430, binding = 0) readonly buffer DrawBuffer {
+    DrawData draws[];
+};
+
+layout (std430, binding = 1) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+
+// camera of the frame, see uniform_ring.h
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// packed vertices (vertex_format.h) store normals and tangents octahedral encoded
+uniform bool packedVertices;
+
+vec3 OctDecode(vec2 e)
+{
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.x += (v.x >= 0.0) ? -t : t;
+    v.y += (v.y >= 0.0) ? -t : t;
+    return normalize(v);
+}
+
+void main()
+{
+    mat4 model = draws[drawIndex].model;
+    uint material = draws[drawIndex].material;
+
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 normal = packedVertices ? OctDecode(aNormal.xy) : aNormal;
+    Normal = mat3(transpose(inverse(model))) * normal;  
+    TexCoords = aTexCoords;
+    VertexColor = Color;
+    for (int i = 0; i < 5; ++i) {
+        MaterialLayers[i] = materials[material].layers[i].xyz;
+    }
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
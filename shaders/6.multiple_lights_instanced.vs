@@ -0,0 +1,47 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 7) in vec3 Color;
+// one per instance, see instancing.h
+layout (location = 8) in mat4 model;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+out vec3 VertexColor;
+flat out vec3 MaterialLayers[5];
+
+// camera of the frame, see uniform_ring.h
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+uniform vec3 materialLayers[5];
+
+// packed vertices (vertex_format.h) store normals and tangents octahedral encoded
+uniform bool packedVertices;
+
+vec3 OctDecode(vec2 e)
+{
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.x += (v.x >= 0.0) ? -t : t;
+    v.y += (v.y >= 0.0) ? -t : t;
+    return normalize(v);
+}
+
+void main()
+{
+    FragPos = vec3(model * vec4(aPos, 1.0));
+    vec3 normal = packedVertices ? OctDecode(aNormal.xy) : aNormal;
+    Normal = mat3(transpose(inverse(model))) * normal;  
+    TexCoords = aTexCoords;
+    VertexColor = Color;
+    for (int i = 0; i < 5; ++i) {
+        MaterialLayers[i] = materialLayers[i];
+    }
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
\ No newline at end of file
@@ -2,18 +2,25 @@
 out vec4 FragColor;
 
 struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    sampler2D emission;
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    sampler2DArray emission;
     float shininess;
 }; 
 
 in vec2 TexCoords;
 uniform Material material;
+uniform vec3 materialLayers[5];
+
+vec4 MaterialTexture(sampler2DArray tex, int type, vec2 uv)
+{
+    vec3 layer = materialLayers[type];
+    return texture(tex, vec3(uv * layer.xy, layer.z));
+}
 
 void main()
 {    
-    vec4 texColor = texture(material.diffuse, TexCoords);
+    vec4 texColor = MaterialTexture(material.diffuse, 0, TexCoords);
     if(texColor.a < 0.1)
         discard;
     FragColor = texColor;
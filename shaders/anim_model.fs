@@ -3,9 +3,16 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D texture_diffuse1;
+uniform sampler2DArray texture_diffuse1;
+uniform vec3 materialLayers[5];
+
+vec4 MaterialTexture(sampler2DArray tex, int type, vec2 uv)
+{
+    vec3 layer = materialLayers[type];
+    return texture(tex, vec3(uv * layer.xy, layer.z));
+}
 
 void main()
 {    
-    FragColor = texture(texture_diffuse1, TexCoords);
+    FragColor = MaterialTexture(texture_diffuse1, 0, TexCoords);
 }
\ No newline at end of file
@@ -9,18 +9,61 @@ layout(location = 4) in vec3 bitangent;
 layout(location = 5) in ivec4 boneIds; 
 layout(location = 6) in vec4 weights;
 
-uniform mat4 projection;
-uniform mat4 view;
-uniform mat4 model;
+// camera of the frame, see uniform_ring.h
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// the draw's model matrix and color, see uniform_ring.h
+layout (std140) uniform DrawUniforms {
+    mat4 model;
+    vec4 color;
+};
 
-const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+
+// every skinned instance of the frame (bone_palette.h), 3 texels per bone
+// holding the top rows of its matrix, this instance starts at boneOffset
+uniform samplerBuffer bonePalette;
+uniform int boneOffset;
+
+mat4 BoneMatrix(int bone)
+{
+    int texel = (boneOffset + bone) * 3;
+    vec4 row0 = texelFetch(bonePalette, texel);
+    vec4 row1 = texelFetch(bonePalette, texel + 1);
+    vec4 row2 = texelFetch(bonePalette, texel + 2);
+    return transpose(mat4(row0, row1, row2, vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
+// packed vertices (vertex_format.h) store normals and tangents octahedral encoded
+uniform bool packedVertices;
+
+vec3 OctDecode(vec2 e)
+{
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.x += (v.x >= 0.0) ? -t : t;
+    v.y += (v.y >= 0.0) ? -t : t;
+    return normalize(v);
+}
 
 out vec2 TexCoords;
 
 void main()
 {
+    vec3 normal = norm;
+    vec3 tangentDir = tangent;
+    vec3 bitangentDir = bitangent;
+    if (packedVertices) {
+        normal = OctDecode(norm.xy);
+        tangentDir = OctDecode(tangent.xy);
+        // tangent.z holds the handedness
+        bitangentDir = cross(normal, tangentDir) * tangent.z;
+    }
+
     vec4 totalPosition = vec4(0.0f);
 
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
@@ -28,16 +71,15 @@ void main()
         if(boneIds[i] == -1) 
             continue;
 
-        if(boneIds[i] >= MAX_BONES) 
-        {
-            totalPosition = vec4(pos,1.0f);
-            break;
-        }
-
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
+        mat4 bone = BoneMatrix(boneIds[i]);
+        vec4 localPosition = bone * vec4(pos,1.0f);
         totalPosition += localPosition * weights[i];
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
+        vec3 localNormal = mat3(bone) * normal;
    }
+
+    // no bones, a static mesh keeps its bind pose
+    if (all(equal(boneIds, ivec4(-1))))
+        totalPosition = vec4(pos, 1.0f);
 	
     mat4 viewModel = view * model;
     gl_Position =  projection * viewModel * totalPosition;
@@ -2,15 +2,22 @@
 out vec4 FragColor;
 
 struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    sampler2D emission;
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    sampler2DArray emission;
     float shininess;
 }; 
 
 in vec2 TexCoords;
 
 uniform Material material;
+uniform vec3 materialLayers[5];
+
+vec4 MaterialTexture(sampler2DArray tex, int type, vec2 uv)
+{
+    vec3 layer = materialLayers[type];
+    return texture(tex, vec3(uv * layer.xy, layer.z));
+}
 
 uniform float time;
 
@@ -30,10 +37,10 @@ void main()
     if (newTexCoord.x > 1.0)
         newTexCoord.x -= 1.0;
 
-    FragColor = texture(material.diffuse, newTexCoord);
+    FragColor = MaterialTexture(material.diffuse, 0, newTexCoord);
 
     // for layered textures
-    //vec4 staticColor = texture(material.diffuse, TexCoords);
-    //vec4 movingColor = texture(material.emission, newTexCoord);
+    //vec4 staticColor = MaterialTexture(material.diffuse, 0, TexCoords);
+    //vec4 movingColor = MaterialTexture(material.emission, 4, newTexCoord);
     //FragColor = movingColor * staticColor; // You can adjust the blend factor (0.5) to control the balance between the two textures.
 }
\ No newline at end of file
@@ -3,10 +3,17 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D texture1;
+uniform sampler2DArray texture1;
+uniform vec3 materialLayers[5];
+
+vec4 MaterialTexture(sampler2DArray tex, int type, vec2 uv)
+{
+    vec3 layer = materialLayers[type];
+    return texture(tex, vec3(uv * layer.xy, layer.z));
+}
 
 void main()
 {
-    FragColor = texture(texture1, TexCoords);
+    FragColor = MaterialTexture(texture1, 0, TexCoords);
     //FragColor = vec4(1.0f, 0.0f, 0.0f, 1.0f);
 }
\ No newline at end of file
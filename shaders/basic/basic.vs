@@ -5,9 +5,18 @@ layout (location = 2) in vec2 tex;
 
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// camera of the frame, see uniform_ring.h
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+// the draw's model matrix and color, see uniform_ring.h
+layout (std140) uniform DrawUniforms {
+    mat4 model;
+    vec4 color;
+};
 
 void main()
 {
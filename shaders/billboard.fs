@@ -3,11 +3,18 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D texture_diffuse1;
+uniform sampler2DArray texture_diffuse1;
+uniform vec3 materialLayers[5];
+
+vec4 MaterialTexture(sampler2DArray tex, int type, vec2 uv)
+{
+    vec3 layer = materialLayers[type];
+    return texture(tex, vec3(uv * layer.xy, layer.z));
+}
 
 void main()
 {    
-    vec4 texColor = texture(texture_diffuse1, TexCoords);
+    vec4 texColor = MaterialTexture(texture_diffuse1, 0, TexCoords);
     if(texColor.a < 0.1)
         discard;
     FragColor = texColor;
@@ -2,9 +2,9 @@
 out vec4 FragColor;
 
 struct Material {
-    sampler2D diffuse;
-    sampler2D specular;
-    sampler2D emission;
+    sampler2DArray diffuse;
+    sampler2DArray specular;
+    sampler2DArray emission;
     float shininess;
 }; 
 
@@ -12,11 +12,23 @@ in vec2 TexCoords;
 in vec3 FragPos;
 
 uniform Material material;
-uniform vec4 color;
+uniform vec3 materialLayers[5];
+
+vec4 MaterialTexture(sampler2DArray tex, int type, vec2 uv)
+{
+    vec3 layer = materialLayers[type];
+    return texture(tex, vec3(uv * layer.xy, layer.z));
+}
+
+// the draw's model matrix and color, see uniform_ring.h
+layout (std140) uniform DrawUniforms {
+    mat4 model;
+    vec4 color;
+};
 
 void main()
 {    
-    vec4 texColor = texture(material.diffuse, TexCoords);
+    vec4 texColor = MaterialTexture(material.diffuse, 0, TexCoords);
     if(texColor.a > 0) {
         FragColor = color;
     } else {
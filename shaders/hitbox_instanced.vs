@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 norm;
+layout (location = 2) in vec2 tex;
+// one per instance, see instancing.h
+layout (location = 8) in mat4 model;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+
+// camera of the frame, see uniform_ring.h
+layout (std140) uniform FrameUniforms {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+void main()
+{
+    FragPos = aPos;
+    TexCoords = tex;  
+    gl_Position = projection * view * model * vec4(aPos, 1.0);
+}
\ No newline at end of file
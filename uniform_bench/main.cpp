@@ -0,0 +1,116 @@
+/*-------------------------------------------------------------------------------\
+uniform_bench
+
+    uniform_bench [-n frames]
+
+    Builds the viewer's shader programs from ../shaders (run from
+    uniform_bench/ like the viewer runs from assimp_viewer/) and runs
+    BenchmarkShaderUniforms on each of them. See shader_uniforms.h.
+
+    -n  lookups of every uniform per program, 1000 by default
+
+    A hidden window gives the GL context, nothing is drawn.
+
+    Exit code is 1 if a program failed to build or its uniform table gave
+    different locations than glGetUniformLocation.
+
+\-------------------------------------------------------------------------------*/
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include <shader_m.h>
+#include <shader_uniforms.h>
+
+void PrintUsage()
+{
+    printf("usage: uniform_bench [-n frames]\n");
+}
+
+int main(int argc, char** argv)
+{
+    int frames = 1000;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 1);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    GLFWwindow* window = glfwCreateWindow(64, 64, "uniform_bench", NULL, NULL);
+    if (window == NULL) {
+        printf("uniform_bench: failed to create an OpenGL context\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+        printf("uniform_bench: failed to initialize GLAD\n");
+        glfwTerminate();
+        return 1;
+    }
+
+    // the programs main.cpp builds, vertex and fragment shader
+    const char* shaders[][2] = {
+        { "basic/basic.vs", "basic/basic.fs" },
+        { "6.multiple_lights.vs", "6.multiple_lights.fs" },
+        { "anim_model.vs", "anim_model.fs" },
+        { "hitbox.vs", "hitbox.fs" },
+        { "6.multiple_lights_instanced.vs", "6.multiple_lights.fs" },
+        { "hitbox_instanced.vs", "hitbox.fs" },
+        { "animated_texture.vs", "animated_texture.fs" },
+        { "alpha/alpha.vs", "alpha/alpha.fs" },
+        { "billboard.vs", "billboard.fs" },
+        { "grid/textured_grid.vs", "grid/textured_grid.fs" },
+        { "grid/auto_grid.vs", "grid/auto_grid.fs" },
+    };
+    int numShaders = sizeof(shaders) / sizeof(shaders[0]);
+
+    int numFailed = 0;
+
+    for (int i = 0; i < numShaders; ++i) {
+        std::string vertexPath = std::string("../shaders/") + shaders[i][0];
+        std::string fragmentPath = std::string("../shaders/") + shaders[i][1];
+
+        unsigned int program = createShader(vertexPath, fragmentPath);
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE) {
+            printf("uniform_bench: %s failed to build\n", shaders[i][0]);
+            numFailed++;
+            continue;
+        }
+
+        // everything in uniform blocks, nothing to look up
+        if (program >= shaderUniformTables.size() || shaderUniformTables[program].numUniforms == 0) {
+            printf("uniform_bench: %s has no loose uniforms\n", shaders[i][0]);
+            continue;
+        }
+
+        printf("uniform_bench: %s\n", shaders[i][0]);
+        if (!BenchmarkShaderUniforms(program, frames)) {
+            numFailed++;
+        }
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+
+    return (numFailed == 0) ? 0 : 1;
+}